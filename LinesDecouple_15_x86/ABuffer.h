@@ -0,0 +1,434 @@
+#ifndef ABUFFER_H
+#define ABUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstring>
+
+#include "commonVars.h"
+#include "FragmentSort.h"
+#include "Parallel.h"
+#include "RenderParams.h"
+
+//CPU side of the A-buffers: per-pixel linked lists(build.fs, resolve.fs) and
+//contiguous per-pixel spans(count.fs, scan.cs, fill.fs, resolveSpans.fs)
+
+//one list node, the uvec4 of build.fs
+struct FragmentNode
+{
+	GLuint next;//0 terminates a list
+	GLfloat depth;
+	GLfloat weight;//blending weight: segment id + fraction
+	GLuint color;//packUnorm4x8
+};
+static_assert(sizeof(FragmentNode) == 16, "FragmentNode mirrors a uvec4");
+
+//same as MAX_NODES_NUM in sort.glsl
+const int MAX_RESOLVE_NODES = 800;
+
+//head pointer image + node pool, node 0 is never used so that 0 can end a list
+struct FragmentLists
+{
+	int width = 0;
+	int height = 0;
+	vector<GLuint> heads;
+	vector<FragmentNode> nodes;
+	GLuint nodeNum = 1;//high-water mark of the pool, same as listCounter
+	GLuint fragmentNum = 0;//nodes in use(the CPU build may leave unused gaps below nodeNum)
+	GLuint dropped = 0;//fragments that did not fit into the pool
+
+	void reset(int w, int h, GLuint capacity)
+	{
+		width = w;
+		height = h;
+		heads.assign((size_t)w * h, 0);
+		if (nodes.size() != capacity) nodes.resize(capacity);
+		nodeNum = 1;
+		fragmentNum = 0;
+		dropped = 0;
+	}
+};
+
+//the fragments of pixel p are nodes[offsets[p], offsets[p + 1]), clamped to the pool
+//nodes are stored in the same uvec4 layout, next is unused
+struct FragmentSpans
+{
+	int width = 0;
+	int height = 0;
+	vector<GLuint> offsets;//pixels + 1 entries
+	vector<FragmentNode> nodes;
+	GLuint fragmentNum = 0;
+	GLuint dropped = 0;
+
+	void reset(int w, int h, GLuint capacity)
+	{
+		width = w;
+		height = h;
+		offsets.assign((size_t)w * h + 1, 0);
+		if (nodes.size() != capacity) nodes.resize(capacity);
+		fragmentNum = 0;
+		dropped = 0;
+	}
+};
+
+#pragma region GLSL helpers
+inline GLuint packUnorm4x8(const glm::vec4 &v)
+{
+	GLuint r = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		float c = std::min(std::max(v[i], 0.0f), 1.0f);
+		r |= (GLuint)std::lround(c * 255.0f) << (8 * i);
+	}
+	return r;
+}
+
+inline glm::vec4 unpackUnorm4x8(GLuint p)
+{
+	return glm::vec4((p & 0xFF) / 255.0f, ((p >> 8) & 0xFF) / 255.0f, ((p >> 16) & 0xFF) / 255.0f, (p >> 24) / 255.0f);
+}
+
+inline float glslMix(float a, float b, float t)
+{
+	return a * (1.0f - t) + b * t;
+}
+#pragma endregion
+
+#pragma region build.fs(shading.glsl)
+//interpolated inputs of build.fs
+struct FragmentInput
+{
+	float fragCoordZ;
+	float fragCoordW;
+	glm::vec2 texCoords;
+	float weight;
+	glm::vec3 fragPos;
+	glm::vec3 T;
+};
+
+inline bool isCenter(const FragmentInput &in)
+{
+	return std::abs(in.texCoords.y - 0.5f) < 0.35f;
+}
+
+inline float fragmentDepth(const FragmentInput &in, const RenderParams &params)
+{
+	if (isCenter(in)) return in.fragCoordZ / in.fragCoordW;
+	return (in.fragCoordZ + params.stripWidth * std::abs(in.texCoords.y - 0.5f)) / in.fragCoordW;
+}
+
+//the terms of setColor() in shading.glsl: center is false on the dark strip border
+struct ShadingTerms
+{
+	bool center;
+	float diffuse;//ambient + 0.5 * diffuse
+	float specular;
+};
+
+inline ShadingTerms shadingTerms(const FragmentInput &in, const RenderParams &params)
+{
+	if (!isCenter(in)) return { false, 0.0f, 0.0f };
+
+	glm::vec3 L = glm::normalize(params.lightPos - in.fragPos);
+	glm::vec3 V = glm::normalize(-in.fragPos);
+	float LT = std::abs(glm::dot(L, in.T));
+	float VT = std::abs(glm::dot(V, in.T));
+
+	float ambient = 0.3f;
+	float diffuse = std::sqrt(std::max(1.0f - LT * LT, 0.0f));
+	float specular = LT * VT - std::sqrt(std::max(1.0f - LT * LT, 0.0f)) * std::sqrt(std::max(1.0f - VT * VT, 0.0f));
+	specular = std::pow(std::abs(specular), 64.0f);
+	return { true, ambient + 0.5f * diffuse, specular };
+}
+
+inline glm::vec3 shadeColor(const ShadingTerms &terms, const RenderParams &params)
+{
+	if (!terms.center) return glm::vec3(0.1f, 0.1f, 0.1f);
+	glm::vec3 color = params.lineColor * terms.diffuse + params.lightColor * (0.7f * terms.specular);
+	return glm::clamp(color, glm::vec3(0.0f), glm::vec3(1.0f));
+}
+
+//the opacity of a fragment, interpolated between its two segment nodes
+inline float fragmentOpacity(float weight, const float *opacity, int opacityNum)
+{
+	int segId = (int)weight;
+	float opa1 = segId < opacityNum ? opacity[segId] : 0.0f;
+	float opa2 = segId + 1 < opacityNum ? opacity[segId + 1] : 0.0f;
+	return glslMix(opa1, opa2, weight - std::floor(weight));
+}
+
+//setColor() of shading.glsl
+inline glm::vec4 shadeFragment(const FragmentInput &in, const RenderParams &params, const float *opacity, int opacityNum)
+{
+	return glm::vec4(shadeColor(shadingTerms(in, params), params), fragmentOpacity(in.weight, opacity, opacityNum));
+}
+#pragma endregion
+
+#pragma region compact nodes
+//FULL_NODES store FragmentNode(16 bytes), COMPACT_NODES store CompactNode(8 bytes, twice the fragments in SBO_LIST)
+//compact nodes are only used by the contiguous layout, a list node needs its first 32 bits for the next pointer
+enum NodeFormat { FULL_NODES, COMPACT_NODES };
+
+inline GLuint nodeCapacity(NodeFormat format)
+{
+	return format == COMPACT_NODES ? 2 * MAX_FRAGMENT_NUM : MAX_FRAGMENT_NUM;
+}
+
+//the uvec2 of fill.fs/resolveSpans.fs(compactNode.glsl):
+//	depthColor: bits 0-21 the depth as unorm of [0, compactDepthRange()], bits 22-31 the color code
+//	weight:     the blending weight, exact
+//color code 0 is the strip border, otherwise bits 0-4 hold ambient + 0.5 * diffuse in [0.3, 0.8](codes 1-31)
+//and bits 5-9 sqrt(specular); the color is rebuilt from lineColor and lightColor
+//the opacity is not stored, the resolve interpolates it from the opacity buffer with the weight
+struct CompactNode
+{
+	GLuint depthColor;
+	GLfloat weight;
+};
+static_assert(sizeof(CompactNode) == 8, "CompactNode mirrors a uvec2");
+
+const int COMPACT_DEPTH_BITS = 22;
+const GLuint COMPACT_DEPTH_MAX = (1u << COMPACT_DEPTH_BITS) - 1;
+
+//largest depth of build.fs: z_window * w_clip <= far, the border adds up to half the strip width
+inline float compactDepthRange(const RenderParams &params)
+{
+	return params.farPlane * (1.0f + 0.5f * params.stripWidth);
+}
+
+inline GLuint encodeCompactColor(const ShadingTerms &terms)
+{
+	if (!terms.center) return 0;
+	GLuint d = 1 + (GLuint)(std::min(std::max((terms.diffuse - 0.3f) / 0.5f, 0.0f), 1.0f) * 30.0f + 0.5f);
+	GLuint s = (GLuint)(std::min(std::sqrt(std::max(terms.specular, 0.0f)), 1.0f) * 31.0f + 0.5f);
+	return d | (s << 5);
+}
+
+inline ShadingTerms decodeCompactColor(GLuint code)
+{
+	if (code == 0) return { false, 0.0f, 0.0f };
+	float s = (code >> 5) / 31.0f;
+	return { true, 0.3f + 0.5f * ((code & 31) - 1) / 30.0f, s * s };
+}
+
+inline CompactNode encodeCompactNode(float depth, float weight, const ShadingTerms &terms, float depthRange)
+{
+	float d = std::min(std::max(depth / depthRange, 0.0f), 1.0f);
+	CompactNode node;
+	node.depthColor = (GLuint)(d * COMPACT_DEPTH_MAX + 0.5f) | (encodeCompactColor(terms) << COMPACT_DEPTH_BITS);
+	node.weight = weight;
+	return node;
+}
+
+//the uvec4 resolveSpans.fs rebuilds from a compact node
+inline FragmentNode decodeCompactNode(const CompactNode &node, const RenderParams &params, const float *opacity, int opacityNum)
+{
+	FragmentNode full;
+	full.next = 0;
+	full.depth = (node.depthColor & COMPACT_DEPTH_MAX) * (compactDepthRange(params) / COMPACT_DEPTH_MAX);
+	full.weight = node.weight;
+	glm::vec3 color = shadeColor(decodeCompactColor(node.depthColor >> COMPACT_DEPTH_BITS), params);
+	full.color = packUnorm4x8(glm::vec4(color, fragmentOpacity(node.weight, opacity, opacityNum)));
+	return full;
+}
+#pragma endregion
+
+#pragma region resolve.fs
+//gather the list of one pixel into 'out'(at most maxNodes entries, from the head on), returns the count
+inline int gatherFragments(const FragmentLists &lists, int pixel, FragmentNode *out, int maxNodes)
+{
+	int cnt = 0;
+	GLuint cur = lists.heads[pixel];
+	while (cur != 0 && cnt < maxNodes)
+	{
+		out[cnt++] = lists.nodes[cur];
+		cur = lists.nodes[cur].next;
+	}
+	return cnt;
+}
+
+inline int gatherFragments(const FragmentSpans &spans, int pixel, FragmentNode *out, int maxNodes)
+{
+	GLuint capacity = (GLuint)spans.nodes.size();
+	GLuint begin = std::min(spans.offsets[pixel], capacity);
+	GLuint end = std::min(spans.offsets[pixel + 1], capacity);
+	int cnt = std::min((int)(end - begin), maxNodes);
+	if (cnt > 0) memcpy(out, &spans.nodes[begin], cnt * sizeof(FragmentNode));
+	return cnt;
+}
+
+inline glm::vec4 compositeFragments(const FragmentNode *nodes, int cnt)
+{
+	glm::vec4 finalColor(1.0f);
+	for (int i = 0; i < cnt; ++i)
+	{
+		glm::vec4 fragColor = unpackUnorm4x8(nodes[i].color);
+		finalColor = finalColor * (1.0f - fragColor.w) + fragColor * fragColor.w;
+	}
+	return finalColor;
+}
+
+//resolve every pixel of FragmentLists or FragmentSpans, rgba8 output with row 0 at the bottom(as glReadPixels)
+template <typename Fragments>
+void resolveFragments(const Fragments &lists, vector<GLuint> &image, SortStrategy strategy = SORT_ADAPTIVE)
+{
+	image.assign((size_t)lists.width * lists.height, 0);
+	parallelFor(0, lists.height, [&](int y)
+	{
+		vector<FragmentNode> nodeList(MAX_RESOLVE_NODES);
+		FragmentSorter sorter;
+		sorter.strategy = strategy;
+		for (int x = 0; x < lists.width; ++x)
+		{
+			int pixel = y * lists.width + x;
+			int cnt = gatherFragments(lists, pixel, &nodeList[0], MAX_RESOLVE_NODES);
+			sorter.sort(&nodeList[0], cnt);
+			image[pixel] = packUnorm4x8(compositeFragments(&nodeList[0], cnt));
+		}
+	}, 4);
+}
+#pragma endregion
+
+#pragma region screen tiles
+//a scissor rectangle of a tiled frame(row 0 at the bottom) and the fragments of the span layout its pixels own,
+//[firstFragment, firstFragment + fragmentNum) in the offsets of the whole frame
+struct ScreenTile
+{
+	int x, y, width, height;
+	GLuint firstFragment;
+	GLuint fragmentNum;
+};
+
+//tiles of at most 'budget' fragments from the offsets of the count pass(pixels + 1 entries): whole rows while they fit,
+//a row over the budget is split into runs of pixels, a single pixel over the budget still gets a tile of its own
+inline vector<ScreenTile> planScreenTiles(const vector<GLuint> &offsets, int width, int height, GLuint budget)
+{
+	vector<ScreenTile> tiles;
+	int y = 0;
+	while (y < height)
+	{
+		GLuint first = offsets[y * width];
+		int y1 = y + 1;
+		if (offsets[y1 * width] - first > budget)
+		{
+			for (int x = 0; x < width;)
+			{
+				int p = y * width + x;
+				int x1 = x + 1;
+				while (x1 < width && offsets[y * width + x1 + 1] - offsets[p] <= budget) ++x1;
+				tiles.push_back({ x, y, x1 - x, 1, offsets[p], offsets[y * width + x1] - offsets[p] });
+				x = x1;
+			}
+			y = y1;
+			continue;
+		}
+		while (y1 < height && offsets[(y1 + 1) * width] - first <= budget) ++y1;
+		tiles.push_back({ 0, y, width, y1 - y, first, offsets[y1 * width] - first });
+		y = y1;
+	}
+	return tiles;
+}
+#pragma endregion
+
+#pragma region memory traffic
+//bytes moved by the build and resolve passes of both layouts, counting every atomic as a read and a write
+//the list resolve reads its nodes scattered over the pool, the span resolve reads them in order
+struct ABufferTraffic
+{
+	double buildBytes = 0.0;
+	double resolveBytes = 0.0;
+};
+
+inline ABufferTraffic linkedListTraffic(long long pixelNum, long long fragmentNum)
+{
+	ABufferTraffic t;
+	//clear heads; per fragment: counter, head exchange, node write
+	t.buildBytes = 4.0 * pixelNum + fragmentNum * (8.0 + 8.0 + sizeof(FragmentNode));
+	//heads, then one node per fragment
+	t.resolveBytes = 4.0 * pixelNum + fragmentNum * (double)sizeof(FragmentNode);
+	return t;
+}
+
+inline ABufferTraffic contiguousSpanTraffic(long long pixelNum, long long fragmentNum)
+{
+	ABufferTraffic t;
+	//clear counts, count, scan(read counts, write offsets, add block sums), clear cursors,
+	//fill: offset, cursor and node write per fragment
+	t.buildBytes = 4.0 * pixelNum + 8.0 * fragmentNum + 4.0 * pixelNum * 4.0 + 4.0 * pixelNum
+		+ fragmentNum * (4.0 + 8.0 + sizeof(FragmentNode));
+	//two offsets per pixel, then the span
+	t.resolveBytes = 8.0 * pixelNum + fragmentNum * (double)sizeof(FragmentNode);
+	return t;
+}
+#pragma endregion
+
+#pragma region comparison
+struct FragmentListsDiff
+{
+	long long pixelsDifferent = 0;//pixels whose fragment counts differ
+	long long fragmentsCompared = 0;
+	float maxDepthError = 0.0f;
+	float maxWeightError = 0.0f;
+	int maxColorError = 0;//largest channel difference out of 255
+};
+
+//compare two A-buffers independent of node order: each pixel list is sorted by depth and matched in order
+inline FragmentListsDiff compareFragmentLists(const FragmentLists &a, const FragmentLists &b)
+{
+	FragmentListsDiff diff;
+	if (a.width != b.width || a.height != b.height)
+	{
+		diff.pixelsDifferent = (long long)a.width * a.height;
+		return diff;
+	}
+
+	int pixelNum = a.width * a.height;
+	vector<FragmentListsDiff> perThread(threadNum());
+	parallelBlocks(pixelNum, [&](int t, int begin, int end)
+	{
+		FragmentListsDiff &d = perThread[t];
+		vector<FragmentNode> la, lb;
+		for (int p = begin; p < end; ++p)
+		{
+			la.clear();
+			lb.clear();
+			for (GLuint cur = a.heads[p]; cur != 0; cur = a.nodes[cur].next) la.push_back(a.nodes[cur]);
+			for (GLuint cur = b.heads[p]; cur != 0; cur = b.nodes[cur].next) lb.push_back(b.nodes[cur]);
+			if (la.size() != lb.size())
+			{
+				++d.pixelsDifferent;
+				continue;
+			}
+			auto byDepth = [](const FragmentNode &x, const FragmentNode &y) { return x.depth < y.depth || (x.depth == y.depth && x.weight < y.weight); };
+			sort(la.begin(), la.end(), byDepth);
+			sort(lb.begin(), lb.end(), byDepth);
+			for (size_t i = 0; i < la.size(); ++i)
+			{
+				d.maxDepthError = std::max(d.maxDepthError, std::abs(la[i].depth - lb[i].depth));
+				d.maxWeightError = std::max(d.maxWeightError, std::abs(la[i].weight - lb[i].weight));
+				for (int c = 0; c < 4; ++c)
+				{
+					int ca = (la[i].color >> (8 * c)) & 0xFF;
+					int cb = (lb[i].color >> (8 * c)) & 0xFF;
+					d.maxColorError = std::max(d.maxColorError, std::abs(ca - cb));
+				}
+			}
+			d.fragmentsCompared += la.size();
+		}
+	});
+
+	for (auto &d : perThread)
+	{
+		diff.pixelsDifferent += d.pixelsDifferent;
+		diff.fragmentsCompared += d.fragmentsCompared;
+		diff.maxDepthError = std::max(diff.maxDepthError, d.maxDepthError);
+		diff.maxWeightError = std::max(diff.maxWeightError, d.maxWeightError);
+		diff.maxColorError = std::max(diff.maxColorError, d.maxColorError);
+	}
+	return diff;
+}
+#pragma endregion
+
+#endif // !ABUFFER_H
@@ -0,0 +1,130 @@
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+#include "commonVars.h"
+
+//camera path of render-path, a text file with one key per line; # starts a comment
+//	fps <n>			frames are sampled n per second from the first to the last key, Catmull-Rom between the keys;
+//					without it every key is one frame
+//	<time> <position x y z> <target x y z> <zoom> <rotateHorizontal> <rotateVertical>
+//the camera sits at position looking at target with the vertical field of view zoom(degrees, as Camera::Zoom), the
+//data is rotated by rotateHorizontal around y, then rotateVertical around x(radians, as the viewer's rotMat)
+//keys are sorted by time
+
+struct CameraKey
+{
+	float time = 0.0f;
+	glm::vec3 position = glm::vec3(0.0f, 0.0f, 1.5f);
+	glm::vec3 target = glm::vec3(0.0f);
+	float zoom = 45.0f;
+	float rotateHorizontal = 0.0f;
+	float rotateVertical = 0.0f;
+};
+
+class CameraPath
+{
+public:
+	float fps = 0.0f;//0: one frame per key
+	vector<CameraKey> keys;
+
+	bool load(const string &path, string &error)
+	{
+		ifstream fileIn(path);
+		if (!fileIn)
+		{
+			error = "CANNOT_OPEN " + path;
+			return false;
+		}
+		keys.clear();
+		fps = 0.0f;
+		string line;
+		int lineNum = 0;
+		while (getline(fileIn, line))
+		{
+			++lineNum;
+			size_t comment = line.find('#');
+			if (comment != string::npos) line.resize(comment);
+			stringstream ss(line);
+			string first;
+			if (!(ss >> first)) continue;
+			if (first == "fps")
+			{
+				if (!(ss >> fps) || fps <= 0.0f)
+				{
+					error = "BAD_FPS line " + to_string(lineNum);
+					return false;
+				}
+				continue;
+			}
+			CameraKey key;
+			key.time = (float)atof(first.c_str());
+			if (!(ss >> key.position.x >> key.position.y >> key.position.z >> key.target.x >> key.target.y >> key.target.z
+				>> key.zoom >> key.rotateHorizontal >> key.rotateVertical))
+			{
+				error = "BAD_KEY line " + to_string(lineNum);
+				return false;
+			}
+			if (!keys.empty() && key.time < keys.back().time)
+			{
+				error = "UNSORTED_KEY line " + to_string(lineNum);
+				return false;
+			}
+			keys.push_back(key);
+		}
+		if (keys.empty())
+		{
+			error = "NO_KEYS " + path;
+			return false;
+		}
+		return true;
+	}
+
+	int frameNum() const
+	{
+		if (fps <= 0.0f || keys.empty()) return (int)keys.size();
+		return (int)std::floor((keys.back().time - keys.front().time) * fps + 1e-4f) + 1;
+	}
+
+	float frameTime(int frame) const
+	{
+		return fps > 0.0f ? keys.front().time + frame / fps : keys[frame].time;
+	}
+
+	CameraKey frame(int frame) const
+	{
+		if (fps <= 0.0f) return keys[frame];
+		float t = frameTime(frame);
+		int k = 0;
+		while (k + 2 < (int)keys.size() && keys[k + 1].time <= t) ++k;
+		if (keys.size() == 1) return keys[0];
+
+		//uniform Catmull-Rom over k - 1 .. k + 2, the end keys repeated
+		const CameraKey &p0 = keys[std::max(k - 1, 0)], &p1 = keys[k], &p2 = keys[k + 1];
+		const CameraKey &p3 = keys[std::min(k + 2, (int)keys.size() - 1)];
+		float span = p2.time - p1.time;
+		float u = span > 0.0f ? glm::clamp((t - p1.time) / span, 0.0f, 1.0f) : 1.0f;
+		auto spline = [u](float a, float b, float c, float d)
+		{
+			return 0.5f * (2.0f * b + (c - a) * u + (2.0f * a - 5.0f * b + 4.0f * c - d) * u * u + (3.0f * b - a - 3.0f * c + d) * u * u * u);
+		};
+		CameraKey key;
+		key.time = t;
+		for (int c = 0; c < 3; ++c)
+		{
+			key.position[c] = spline(p0.position[c], p1.position[c], p2.position[c], p3.position[c]);
+			key.target[c] = spline(p0.target[c], p1.target[c], p2.target[c], p3.target[c]);
+		}
+		key.zoom = spline(p0.zoom, p1.zoom, p2.zoom, p3.zoom);
+		key.rotateHorizontal = spline(p0.rotateHorizontal, p1.rotateHorizontal, p2.rotateHorizontal, p3.rotateHorizontal);
+		key.rotateVertical = spline(p0.rotateVertical, p1.rotateVertical, p2.rotateVertical, p3.rotateVertical);
+		return key;
+	}
+};
+
+#endif // !CAMERAPATH_H
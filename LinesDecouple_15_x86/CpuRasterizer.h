@@ -0,0 +1,431 @@
+#ifndef CPURASTERIZER_H
+#define CPURASTERIZER_H
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cmath>
+
+#include "commonVars.h"
+#include "ABuffer.h"
+#include "LineStorage.h"
+#include "Parallel.h"
+#include "RenderParams.h"
+
+//CPU reference of the build pass: rasterizes the screen-facing ribbons of build.vs and
+//writes the same per-pixel lists as build.fs, or the contiguous spans of count.fs/fill.fs
+//the screen is split into tiles, every tile is owned by one thread at a time, so head pointers need no atomics;
+//nodes come from per-thread bump allocators that grab blocks of the pool instead of one counter per fragment
+
+const int RASTER_TILE_SIZE = 32;
+const GLuint NODE_BLOCK_SIZE = 4096;
+
+#pragma region ribbon geometry
+//a transformed ribbon vertex: the outputs of build.vs
+struct ClipVertex
+{
+	glm::vec4 clip;
+	glm::vec2 texCoords;
+	float weight;
+	glm::vec3 fragPos;
+	glm::vec3 T;
+};
+
+//central differences inside a line, one-sided at the ends
+inline glm::vec3 ribbonDirection(const LineSet &lines, int begin, int end, int j)
+{
+	int a = std::max(j - 1, begin);
+	int b = std::min(j + 1, end - 1);
+	glm::vec3 d = lines.positions[b] - lines.positions[a];
+	float len = glm::length(d);
+	return len > 0.0f ? d / len : glm::vec3(1.0f, 0.0f, 0.0f);
+}
+
+//build.vs for the two ribbon vertices of line point j(texCoords.y = 0 and 1)
+inline void ribbonVertices(const LineSet &lines, int begin, int end, int j, const RenderParams &params, ClipVertex out[2])
+{
+	glm::vec3 pos = lines.positions[j];
+	glm::vec3 dir = ribbonDirection(lines, begin, end, j);
+	float along = end - begin > 1 ? (float)(j - begin) / (end - begin - 1) : 0.0f;
+
+	glm::vec3 d = glm::vec3(params.transform * glm::vec4(dir, 0.0f));
+	glm::vec3 side = glm::cross(d, params.viewDirection);
+	float sideLen = glm::length(side);
+	side = sideLen > 0.0f ? side / sideLen : glm::vec3(0.0f);
+	glm::vec4 center = params.transform * glm::vec4(pos, 1.0f);
+
+	for (int k = 0; k < 2; ++k)
+	{
+		float texY = (float)k;
+		glm::vec3 offset = side * ((texY - 0.5f) * params.stripWidth);
+		glm::vec4 world = center + glm::vec4(offset, 0.0f);
+		out[k].clip = params.modelViewProjectionMatrix * world;
+		out[k].fragPos = glm::vec3(params.model * world);
+		out[k].texCoords = glm::vec2(along, texY);
+		out[k].weight = lines.weights[j];
+		out[k].T = dir;
+	}
+}
+
+inline ClipVertex lerpClipVertex(const ClipVertex &a, const ClipVertex &b, float t)
+{
+	ClipVertex r;
+	r.clip = a.clip + (b.clip - a.clip) * t;
+	r.texCoords = a.texCoords + (b.texCoords - a.texCoords) * t;
+	r.weight = a.weight + (b.weight - a.weight) * t;
+	r.fragPos = a.fragPos + (b.fragPos - a.fragPos) * t;
+	r.T = a.T + (b.T - a.T) * t;
+	return r;
+}
+#pragma endregion
+
+class CpuRasterizer
+{
+public:
+	//build the lists for all lines; opacity holds segmentNum per-segment opacities
+	void build(const LineSet &lines, const RenderParams &params, const float *opacity, int opacityNum,
+		FragmentLists &lists, GLuint capacity = MAX_FRAGMENT_NUM)
+	{
+		begin(lines, params);
+		lists_ = &lists;
+		lists.reset(params.width, params.height, capacity);
+
+		//the lists start at 1, node 0 terminates them
+		poolCounter_ = 1;
+		vector<NodeAllocator> allocators(threadNum());
+		rasterizeTiles(lines, [&](int t, int pixel, const FragmentInput &in)
+		{
+			NodeAllocator &alloc = allocators[t];
+			GLuint index = allocNode(alloc);
+			if (index == 0)
+			{
+				++alloc.dropped;
+				return;
+			}
+			FragmentNode &node = lists.nodes[index];
+			node.next = lists.heads[pixel];
+			node.depth = fragmentDepth(in, params);
+			node.weight = in.weight;
+			node.color = packUnorm4x8(shadeFragment(in, params, opacity, opacityNum));
+			lists.heads[pixel] = index;
+		});
+
+		lists.nodeNum = std::min<GLuint>(poolCounter_.load(), (GLuint)lists.nodes.size());
+		for (auto &a : allocators)
+		{
+			lists.fragmentNum += a.used;
+			lists.dropped += a.dropped;
+		}
+		lists_ = nullptr;
+	}
+
+	//build the contiguous layout: count fragments per pixel, scan into offsets, rasterize again into the spans
+	//COMPACT_NODES: twice the capacity, every node goes through CompactNode and back, as fill.fs and resolveSpans.fs do
+	void buildSpans(const LineSet &lines, const RenderParams &params, const float *opacity, int opacityNum,
+		FragmentSpans &spans, NodeFormat format = FULL_NODES)
+	{
+		begin(lines, params);
+		int pixelNum = params.width * params.height;
+		GLuint capacity = nodeCapacity(format);
+		spans.reset(params.width, params.height, 0);
+
+		//pass 1: count, every pixel is written by the thread owning its tile
+		vector<GLuint> &counts = spans.offsets;
+		rasterizeTiles(lines, [&](int, int pixel, const FragmentInput &) { ++counts[pixel]; });
+
+		//pass 2: scan, offsets[pixelNum] is the total
+		parallelExclusiveScan(&counts[0], &spans.offsets[0], pixelNum);
+		GLuint total = spans.offsets[pixelNum];
+		spans.fragmentNum = std::min(total, capacity);
+		spans.dropped = total - spans.fragmentNum;
+		spans.nodes.resize(spans.fragmentNum);
+
+		//pass 3: fill, same traversal order as the count pass
+		float depthRange = compactDepthRange(params);
+		vector<GLuint> cursors(spans.offsets.begin(), spans.offsets.end() - 1);
+		rasterizeTiles(lines, [&](int, int pixel, const FragmentInput &in)
+		{
+			GLuint index = cursors[pixel]++;
+			if (index >= capacity) return;
+			FragmentNode &node = spans.nodes[index];
+			if (format == COMPACT_NODES)
+			{
+				node = decodeCompactNode(encodeCompactNode(fragmentDepth(in, params), in.weight, shadingTerms(in, params), depthRange),
+					params, opacity, opacityNum);
+				return;
+			}
+			node.next = 0;
+			node.depth = fragmentDepth(in, params);
+			node.weight = in.weight;
+			node.color = packUnorm4x8(shadeFragment(in, params, opacity, opacityNum));
+		});
+	}
+
+private:
+	const RenderParams *params_ = nullptr;
+	FragmentLists *lists_ = nullptr;
+
+	int tilesX_ = 0, tilesY_ = 0;
+	//bins_[thread][tile]: first vertex of each ribbon quad touching the tile
+	vector< vector< vector<GLuint> > > bins_;
+
+	std::atomic<GLuint> poolCounter_;
+
+	struct NodeAllocator
+	{
+		GLuint next = 0;
+		GLuint end = 0;
+		GLuint used = 0;
+		GLuint dropped = 0;
+		bool full = false;//the pool is exhausted, stop asking so the counter cannot wrap around
+	};
+
+	void begin(const LineSet &lines, const RenderParams &params)
+	{
+		params_ = &params;
+		tilesX_ = (params.width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+		tilesY_ = (params.height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+		binTiles(lines);
+	}
+
+#pragma region binning
+	void binTiles(const LineSet &lines)
+	{
+		int threads = threadNum();
+		bins_.resize(threads);
+		for (auto &b : bins_)
+		{
+			b.resize(tilesX_ * tilesY_);
+			for (auto &tile : b) tile.clear();
+		}
+
+		const RenderParams &params = *params_;
+		parallelBlocks(lines.lineNum, [&](int t, int lineBegin, int lineEnd)
+		{
+			vector< vector<GLuint> > &bins = bins_[t];
+			for (int i = lineBegin; i < lineEnd; ++i)
+			{
+				int begin = lines.lineBegin(i);
+				int end = lines.lineEnd(i);
+				if (end - begin < 2) continue;
+
+				ClipVertex prev[2], cur[2];
+				ribbonVertices(lines, begin, end, begin, params, prev);
+				for (int j = begin; j + 1 < end; ++j)
+				{
+					ribbonVertices(lines, begin, end, j + 1, params, cur);
+					int x0, y0, x1, y1;
+					if (quadBounds(prev, cur, x0, y0, x1, y1))
+					{
+						for (int ty = y0 / RASTER_TILE_SIZE; ty <= y1 / RASTER_TILE_SIZE; ++ty)
+							for (int tx = x0 / RASTER_TILE_SIZE; tx <= x1 / RASTER_TILE_SIZE; ++tx)
+								bins[ty * tilesX_ + tx].push_back((GLuint)j);
+					}
+					prev[0] = cur[0];
+					prev[1] = cur[1];
+				}
+			}
+		});
+	}
+
+	//pixel bounds of a ribbon quad, false if it is entirely off screen
+	bool quadBounds(const ClipVertex *a, const ClipVertex *b, int &x0, int &y0, int &x1, int &y1) const
+	{
+		const ClipVertex *v[4] = { &a[0], &a[1], &b[0], &b[1] };
+		float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+		bool crossesNear = false;
+		int outside[6] = { 0, 0, 0, 0, 0, 0 };
+		for (int k = 0; k < 4; ++k)
+		{
+			const glm::vec4 &c = v[k]->clip;
+			outside[0] += c.x < -c.w; outside[1] += c.x > c.w;
+			outside[2] += c.y < -c.w; outside[3] += c.y > c.w;
+			outside[4] += c.z < -c.w; outside[5] += c.z > c.w;
+			if (c.w <= 1e-6f)
+			{
+				crossesNear = true;
+				continue;
+			}
+			float x = (c.x / c.w * 0.5f + 0.5f) * params_->width;
+			float y = (c.y / c.w * 0.5f + 0.5f) * params_->height;
+			minX = std::min(minX, x); maxX = std::max(maxX, x);
+			minY = std::min(minY, y); maxY = std::max(maxY, y);
+		}
+		for (int k = 0; k < 6; ++k)
+			if (outside[k] == 4) return false;
+		if (crossesNear)
+		{
+			//conservative: the clipped polygon may reach anywhere on screen
+			minX = minY = 0.0f;
+			maxX = (float)params_->width;
+			maxY = (float)params_->height;
+		}
+
+		x0 = std::max(0, (int)std::floor(minX));
+		y0 = std::max(0, (int)std::floor(minY));
+		x1 = std::min(params_->width - 1, (int)std::ceil(maxX));
+		y1 = std::min(params_->height - 1, (int)std::ceil(maxY));
+		return x0 <= x1 && y0 <= y1;
+	}
+#pragma endregion
+
+#pragma region rasterization
+	//emit(threadId, pixel, fragment) for every covered pixel; a tile is owned by one thread at a time
+	template <typename Emit>
+	void rasterizeTiles(const LineSet &lines, Emit emit)
+	{
+		int tileNum = tilesX_ * tilesY_;
+		std::atomic<int> nextTile(0);
+		parallelRun(threadNum(), [&](int t)
+		{
+			for (int tile = nextTile++; tile < tileNum; tile = nextTile++)
+			{
+				int tx = tile % tilesX_, ty = tile / tilesX_;
+				int rect[4] = { tx * RASTER_TILE_SIZE, ty * RASTER_TILE_SIZE,
+					std::min((tx + 1) * RASTER_TILE_SIZE, params_->width), std::min((ty + 1) * RASTER_TILE_SIZE, params_->height) };
+
+				for (int b = 0; b < (int)bins_.size(); ++b)
+				{
+					for (GLuint j : bins_[b][tile])
+						rasterizeQuad(lines, (int)j, rect, t, emit);
+				}
+			}
+		});
+	}
+
+	GLuint allocNode(NodeAllocator &alloc)
+	{
+		if (alloc.next == alloc.end)
+		{
+			if (alloc.full) return 0;
+			GLuint capacity = (GLuint)lists_->nodes.size();
+			GLuint base = poolCounter_.fetch_add(NODE_BLOCK_SIZE);
+			if (base >= capacity)
+			{
+				alloc.full = true;
+				return 0;
+			}
+			alloc.next = base;
+			alloc.end = std::min(base + NODE_BLOCK_SIZE, capacity);
+		}
+		++alloc.used;
+		return alloc.next++;
+	}
+
+	//the line segment [j, j + 1] as the triangle strip build.vs is drawn with
+	template <typename Emit>
+	void rasterizeQuad(const LineSet &lines, int j, const int rect[4], int t, Emit &emit)
+	{
+		int lineId = (int)lines.lineIds[j] - lines.firstLine;
+		int begin = lines.lineBegin(lineId);
+		int end = lines.lineEnd(lineId);
+
+		ClipVertex v[4];
+		ribbonVertices(lines, begin, end, j, *params_, v);
+		ribbonVertices(lines, begin, end, j + 1, *params_, v + 2);
+
+		rasterizeClipped(v[0], v[1], v[2], rect, t, emit);
+		rasterizeClipped(v[1], v[2], v[3], rect, t, emit);
+	}
+
+	//clip against the near plane(z >= -w), then rasterize the resulting fan
+	template <typename Emit>
+	void rasterizeClipped(const ClipVertex &a, const ClipVertex &b, const ClipVertex &c, const int rect[4], int t, Emit &emit)
+	{
+		const ClipVertex *in[3] = { &a, &b, &c };
+		ClipVertex poly[4];
+		int n = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			const ClipVertex &p = *in[k];
+			const ClipVertex &q = *in[(k + 1) % 3];
+			float dp = p.clip.z + p.clip.w;
+			float dq = q.clip.z + q.clip.w;
+			if (dp >= 0.0f) poly[n++] = p;
+			if ((dp >= 0.0f) != (dq >= 0.0f))
+				poly[n++] = lerpClipVertex(p, q, dp / (dp - dq));
+		}
+		for (int k = 1; k + 1 < n; ++k)
+			rasterizeTriangle(poly[0], poly[k], poly[k + 1], rect, t, emit);
+	}
+
+	template <typename Emit>
+	void rasterizeTriangle(const ClipVertex &a, const ClipVertex &b, const ClipVertex &c, const int rect[4], int t, Emit &emit)
+	{
+		const ClipVertex *v[3] = { &a, &b, &c };
+		float sx[3], sy[3], sz[3], iw[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			const glm::vec4 &p = v[k]->clip;
+			if (p.w <= 0.0f) return;
+			iw[k] = 1.0f / p.w;
+			sx[k] = (p.x * iw[k] * 0.5f + 0.5f) * params_->width;
+			sy[k] = (p.y * iw[k] * 0.5f + 0.5f) * params_->height;
+			sz[k] = p.z * iw[k] * 0.5f + 0.5f;
+		}
+
+		float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+		if (area == 0.0f || !std::isfinite(area)) return;
+		//counter-clockwise from here on
+		if (area < 0.0f)
+		{
+			std::swap(sx[1], sx[2]); std::swap(sy[1], sy[2]); std::swap(sz[1], sz[2]); std::swap(iw[1], iw[2]);
+			std::swap(v[1], v[2]);
+			area = -area;
+		}
+
+		int x0 = std::max(rect[0], (int)std::floor(std::min(sx[0], std::min(sx[1], sx[2]))));
+		int x1 = std::min(rect[2] - 1, (int)std::ceil(std::max(sx[0], std::max(sx[1], sx[2]))));
+		int y0 = std::max(rect[1], (int)std::floor(std::min(sy[0], std::min(sy[1], sy[2]))));
+		int y1 = std::min(rect[3] - 1, (int)std::ceil(std::max(sy[0], std::max(sy[1], sy[2]))));
+		if (x0 > x1 || y0 > y1) return;
+
+		//top-left rule: pixels exactly on an edge belong to left and top edges only
+		bool topLeft[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			int k1 = (k + 1) % 3;
+			float dx = sx[k1] - sx[k], dy = sy[k1] - sy[k];
+			topLeft[k] = (dy < 0.0f) || (dy == 0.0f && dx < 0.0f);
+		}
+
+		for (int y = y0; y <= y1; ++y)
+		{
+			float py = y + 0.5f;
+			for (int x = x0; x <= x1; ++x)
+			{
+				float px = x + 0.5f;
+				float e[3];
+				bool inside = true;
+				for (int k = 0; k < 3 && inside; ++k)
+				{
+					int k1 = (k + 1) % 3;
+					e[k] = (sx[k1] - sx[k]) * (py - sy[k]) - (sy[k1] - sy[k]) * (px - sx[k]);
+					inside = e[k] > 0.0f || (e[k] == 0.0f && topLeft[k]);
+				}
+				if (!inside) continue;
+
+				//e[k] is opposite to vertex (k + 2) % 3
+				float b0 = e[1] / area, b1 = e[2] / area, b2 = e[0] / area;
+				float z = b0 * sz[0] + b1 * sz[1] + b2 * sz[2];
+				if (z < 0.0f || z > 1.0f) continue;//far plane
+
+				float w = b0 * iw[0] + b1 * iw[1] + b2 * iw[2];
+				float p0 = b0 * iw[0] / w, p1 = b1 * iw[1] / w, p2 = b2 * iw[2] / w;
+
+				FragmentInput in;
+				in.fragCoordZ = z;
+				in.fragCoordW = w;
+				in.texCoords = v[0]->texCoords * p0 + v[1]->texCoords * p1 + v[2]->texCoords * p2;
+				in.weight = v[0]->weight * p0 + v[1]->weight * p1 + v[2]->weight * p2;
+				in.fragPos = v[0]->fragPos * p0 + v[1]->fragPos * p1 + v[2]->fragPos * p2;
+				in.T = v[0]->T * p0 + v[1]->T * p1 + v[2]->T * p2;
+
+				emit(t, y * params_->width + x, in);
+			}
+		}
+	}
+#pragma endregion
+};
+
+#endif // !CPURASTERIZER_H
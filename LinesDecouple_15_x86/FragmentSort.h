@@ -0,0 +1,343 @@
+#ifndef FRAGMENTSORT_H
+#define FRAGMENTSORT_H
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <type_traits>
+
+#include "commonVars.h"
+
+//per-pixel fragment sorting, farthest first(the order resolve.fs composites in)
+//the strategies match sort.glsl:
+//	insertion: short lists
+//	bitonic:   medium lists, 4-wide blocks sorted in registers, then bitonic merges(AVX2 on the CPU)
+//	merge:     long lists, bottom-up from insertion sorted runs of 8
+//	radix:     long lists, LSD on 8 bit digits, passes where all keys share the digit are skipped
+//	exchange:  the O(n^2) sort resolve.fs used to run, kept as the baseline of bench-sort
+//all but exchange are stable: fragments at the same depth keep the order they were gathered in
+
+//values of the sortStrategy uniform
+enum SortStrategy { SORT_ADAPTIVE, SORT_INSERTION, SORT_BITONIC, SORT_MERGE, SORT_RADIX, SORT_EXCHANGE, SORT_STRATEGY_NUM };
+
+inline const char *sortStrategyName(SortStrategy strategy)
+{
+	switch (strategy)
+	{
+	case SORT_ADAPTIVE: return "adaptive";
+	case SORT_INSERTION: return "insertion";
+	case SORT_BITONIC: return "bitonic";
+	case SORT_MERGE: return "merge";
+	case SORT_RADIX: return "radix";
+	case SORT_EXCHANGE: return "exchange";
+	default: return "unknown";
+	}
+}
+
+//the adaptive choice by list length, measured with bench-sort(sort.glsl has its own thresholds)
+const int SORT_INSERTION_MAX = 8;
+const int SORT_BITONIC_MAX = 128;
+
+inline SortStrategy adaptiveSortStrategy(int cnt)
+{
+	if (cnt <= SORT_INSERTION_MAX) return SORT_INSERTION;
+	if (cnt <= SORT_BITONIC_MAX) return SORT_BITONIC;
+	return SORT_RADIX;
+}
+
+//32 bit key, ascending keys are farthest first
+inline GLuint fragmentSortKey(float depth)
+{
+	GLuint bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+	return ~bits;
+}
+
+#pragma region key kernels
+//the kernels sort 64 bit keys(biased depth key << 32 | position), signed so that AVX2 can compare them;
+//the keys are unique, so every kernel gives the order of a stable sort
+inline int64_t packSortKey(float depth, int position)
+{
+	return (int64_t)(((uint64_t)(fragmentSortKey(depth) ^ 0x80000000u) << 32) | (GLuint)position);
+}
+
+inline GLuint sortKeyDepth(int64_t key)
+{
+	return (GLuint)((uint64_t)key >> 32) ^ 0x80000000u;
+}
+
+inline void compareExchange(int64_t &a, int64_t &b)
+{
+	int64_t lo = std::min(a, b);
+	b = std::max(a, b);
+	a = lo;
+}
+
+inline void insertionSortKeys(int64_t *keys, int begin, int end)
+{
+	for (int i = begin + 1; i < end; ++i)
+	{
+		int64_t key = keys[i];
+		int j = i - 1;
+		while (j >= begin && keys[j] > key)
+		{
+			keys[j + 1] = keys[j];
+			--j;
+		}
+		keys[j + 1] = key;
+	}
+}
+
+//n is a power of two, the network in flip form: the first step of every merge compares i with its mirror
+//in the block, all later steps are half cleaners, every comparator puts the smaller key first
+inline void bitonicSortScalar(int64_t *keys, int n)
+{
+	for (int k = 2; k <= n; k *= 2)
+	{
+		for (int b = 0; b < n; b += k)
+			for (int i = 0; i < k / 2; ++i)
+				compareExchange(keys[b + i], keys[b + k - 1 - i]);
+		for (int j = k / 4; j > 0; j /= 2)
+			for (int i = 0; i < n; ++i)
+				if ((i & j) == 0) compareExchange(keys[i], keys[i + j]);
+	}
+}
+
+#if defined(__AVX2__)
+inline void compareExchangeAvx2(__m256i &lo, __m256i &hi)
+{
+	__m256i gt = _mm256_cmpgt_epi64(lo, hi);
+	__m256i mn = _mm256_blendv_epi8(lo, hi, gt);
+	hi = _mm256_blendv_epi8(hi, lo, gt);
+	lo = mn;
+}
+
+//one step inside a register: every lane against the lane PERM moves to it, 'lower' lanes keep the minimum
+template <int PERM>
+inline __m256i laneStepAvx2(__m256i v, __m256i lower)
+{
+	__m256i p = _mm256_permute4x64_epi64(v, PERM);
+	__m256i gt = _mm256_cmpgt_epi64(v, p);
+	__m256i mn = _mm256_blendv_epi8(v, p, gt);
+	__m256i mx = _mm256_blendv_epi8(p, v, gt);
+	return _mm256_blendv_epi8(mx, mn, lower);
+}
+
+inline __m256i reverseAvx2(__m256i v)
+{
+	return _mm256_permute4x64_epi64(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+//same network as bitonicSortScalar, n is a power of two >= 4
+inline void bitonicSortAvx2(int64_t *keys, int n)
+{
+	const __m256i lanes02 = _mm256_set_epi64x(0, -1, 0, -1);
+	const __m256i lanes01 = _mm256_set_epi64x(0, 0, -1, -1);
+	__m256i *v = (__m256i *)keys;
+
+	//blocks of 4 in registers: k = 2, then k = 4
+	for (int i = 0; i < n; i += 4)
+	{
+		__m256i x = _mm256_loadu_si256(v + i / 4);
+		x = laneStepAvx2<_MM_SHUFFLE(2, 3, 0, 1)>(x, lanes02);
+		x = laneStepAvx2<_MM_SHUFFLE(0, 1, 2, 3)>(x, lanes01);
+		x = laneStepAvx2<_MM_SHUFFLE(2, 3, 0, 1)>(x, lanes02);
+		_mm256_storeu_si256(v + i / 4, x);
+	}
+
+	for (int k = 8; k <= n; k *= 2)
+	{
+		//flip: the mirror of 4 consecutive keys is a reversed vector
+		for (int b = 0; b < n; b += k)
+		{
+			for (int i = 0; i < k / 2; i += 4)
+			{
+				__m256i lo = _mm256_loadu_si256((__m256i *)(keys + b + i));
+				__m256i hi = reverseAvx2(_mm256_loadu_si256((__m256i *)(keys + b + k - 4 - i)));
+				compareExchangeAvx2(lo, hi);
+				_mm256_storeu_si256((__m256i *)(keys + b + i), lo);
+				_mm256_storeu_si256((__m256i *)(keys + b + k - 4 - i), reverseAvx2(hi));
+			}
+		}
+		//half cleaners across registers
+		for (int j = k / 4; j >= 4; j /= 2)
+		{
+			for (int b = 0; b < n; b += 2 * j)
+			{
+				for (int i = b; i < b + j; i += 4)
+				{
+					__m256i lo = _mm256_loadu_si256((__m256i *)(keys + i));
+					__m256i hi = _mm256_loadu_si256((__m256i *)(keys + i + j));
+					compareExchangeAvx2(lo, hi);
+					_mm256_storeu_si256((__m256i *)(keys + i), lo);
+					_mm256_storeu_si256((__m256i *)(keys + i + j), hi);
+				}
+			}
+		}
+		//j = 2 and j = 1 inside the registers
+		for (int i = 0; i < n; i += 4)
+		{
+			__m256i x = _mm256_loadu_si256(v + i / 4);
+			x = laneStepAvx2<_MM_SHUFFLE(1, 0, 3, 2)>(x, lanes01);
+			x = laneStepAvx2<_MM_SHUFFLE(2, 3, 0, 1)>(x, lanes02);
+			_mm256_storeu_si256(v + i / 4, x);
+		}
+	}
+}
+#endif
+
+//the widest kernel this build supports
+inline void bitonicSortKeys(int64_t *keys, int n)
+{
+#if defined(__AVX2__)
+	bitonicSortAvx2(keys, n);
+#else
+	bitonicSortScalar(keys, n);
+#endif
+}
+
+//returns keys or temp, whichever holds the result
+inline int64_t *mergeSortKeys(int64_t *keys, int64_t *temp, int n)
+{
+	const int run = 8;
+	for (int b = 0; b < n; b += run)
+		insertionSortKeys(keys, b, std::min(b + run, n));
+
+	int64_t *src = keys, *dst = temp;
+	for (int width = run; width < n; width *= 2)
+	{
+		for (int b = 0; b < n; b += 2 * width)
+		{
+			int m = std::min(b + width, n), e = std::min(b + 2 * width, n);
+			int i = b, j = m, o = b;
+			while (i < m && j < e) dst[o++] = src[j] < src[i] ? src[j++] : src[i++];
+			while (i < m) dst[o++] = src[i++];
+			while (j < e) dst[o++] = src[j++];
+		}
+		std::swap(src, dst);
+	}
+	return src;
+}
+
+//returns keys or temp, whichever holds the result
+inline int64_t *radixSortKeys(int64_t *keys, int64_t *temp, int n)
+{
+	GLuint counts[4][256] = {};
+	for (int i = 0; i < n; ++i)
+	{
+		GLuint d = sortKeyDepth(keys[i]);
+		for (int p = 0; p < 4; ++p) ++counts[p][(d >> (8 * p)) & 0xFF];
+	}
+
+	int64_t *src = keys, *dst = temp;
+	for (int p = 0; p < 4; ++p)
+	{
+		int shift = 8 * p;
+		if (counts[p][(sortKeyDepth(src[0]) >> shift) & 0xFF] == (GLuint)n) continue;
+		GLuint sum = 0;
+		for (int d = 0; d < 256; ++d)
+		{
+			GLuint c = counts[p][d];
+			counts[p][d] = sum;
+			sum += c;
+		}
+		for (int i = 0; i < n; ++i)
+			dst[counts[p][(sortKeyDepth(src[i]) >> shift) & 0xFF]++] = src[i];
+		std::swap(src, dst);
+	}
+	return src;
+}
+#pragma endregion
+
+#pragma region item sorts
+//T has a float member 'depth'
+template <typename T>
+void insertionSortFragments(T *items, int cnt)
+{
+	for (int i = 1; i < cnt; ++i)
+	{
+		T key = items[i];
+		int j = i - 1;
+		while (j >= 0 && items[j].depth < key.depth)
+		{
+			items[j + 1] = items[j];
+			--j;
+		}
+		items[j + 1] = key;
+	}
+}
+
+//the exchange sort of the old resolve.fs
+template <typename T>
+void exchangeSortFragments(T *items, int cnt)
+{
+	for (int i = 0; i + 1 < cnt; ++i)
+		for (int j = i + 1; j < cnt; ++j)
+			if (items[i].depth < items[j].depth) std::swap(items[i], items[j]);
+}
+
+//sorts with one strategy, keeps its scratch buffers between calls(one sorter per thread)
+class FragmentSorter
+{
+public:
+	SortStrategy strategy = SORT_ADAPTIVE;
+
+	template <typename T>
+	void sort(T *items, int cnt)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "fragments are moved with memcpy");
+		if (cnt < 2) return;
+		SortStrategy s = strategy == SORT_ADAPTIVE ? adaptiveSortStrategy(cnt) : strategy;
+		if (s == SORT_INSERTION)
+		{
+			insertionSortFragments(items, cnt);
+			return;
+		}
+		if (s == SORT_EXCHANGE)
+		{
+			exchangeSortFragments(items, cnt);
+			return;
+		}
+
+		//bitonic pads to a power of two with keys that sort last
+		int n = cnt;
+		if (s == SORT_BITONIC)
+			for (n = 4; n < cnt; n *= 2);
+		if ((int)keys_.size() < n)
+		{
+			keys_.resize(n);
+			temp_.resize(n);
+		}
+		for (int i = 0; i < cnt; ++i) keys_[i] = packSortKey(items[i].depth, i);
+		for (int i = cnt; i < n; ++i) keys_[i] = INT64_MAX;
+
+		const int64_t *sorted = &keys_[0];
+		if (s == SORT_BITONIC)
+			bitonicSortKeys(&keys_[0], n);
+		else if (s == SORT_MERGE)
+			sorted = mergeSortKeys(&keys_[0], &temp_[0], n);
+		else
+			sorted = radixSortKeys(&keys_[0], &temp_[0], n);
+
+		//apply the permutation
+		if (items_.size() < cnt * sizeof(T)) items_.resize(cnt * sizeof(T));
+		T *out = (T *)&items_[0];
+		for (int i = 0; i < cnt; ++i) out[i] = items[(GLuint)sorted[i]];
+		memcpy(items, out, cnt * sizeof(T));
+	}
+
+private:
+	vector<int64_t> keys_;
+	vector<int64_t> temp_;
+	vector<unsigned char> items_;
+};
+#pragma endregion
+
+#endif // !FRAGMENTSORT_H
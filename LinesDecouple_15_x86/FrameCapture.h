@@ -0,0 +1,176 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "commonVars.h"
+#include "ImageIO.h"
+
+//asynchronous capture of the bound framebuffer into image files:
+//	capture() starts glReadPixels into the next of FRAME_CAPTURE_PBOS pixel buffer objects and fences it, the frame
+//	FRAME_CAPTURE_PBOS frames back is mapped(long done by then) and handed to the writer thread
+//	the writer thread encodes and writes the files(writeImage, by extension) while the next frames render; it holds
+//	at most FRAME_CAPTURE_QUEUE frames, capture() waits for it beyond that
+
+const int FRAME_CAPTURE_PBOS = 3;
+const int FRAME_CAPTURE_QUEUE = 8;
+
+class FrameCapture
+{
+public:
+	double waitTime = 0.0;//ms the last capture() spent on fences and the full queue
+
+	FrameCapture(int width, int height) : width_(width), height_(height)
+	{
+		glGenBuffers(FRAME_CAPTURE_PBOS, pbos_);
+		for (int i = 0; i < FRAME_CAPTURE_PBOS; ++i)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos_[i]);
+			glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * sizeof(GLuint), nullptr, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		writer_ = std::thread([this]() { writeLoop(); });
+	}
+
+	~FrameCapture()
+	{
+		finish();
+		glDeleteBuffers(FRAME_CAPTURE_PBOS, pbos_);
+	}
+
+	FrameCapture(const FrameCapture &) = delete;
+	FrameCapture &operator=(const FrameCapture &) = delete;
+
+	//path: the file of this frame, frame: its index in writeTimes()
+	void capture(const string &path, int frame)
+	{
+		auto t0 = chrono::steady_clock::now();
+		int slot = next_ % FRAME_CAPTURE_PBOS;
+		if (pending_[slot].fence != 0) retire(slot);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos_[slot]);
+		glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+		//the other read backs of the passes go to client memory
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		pending_[slot].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		pending_[slot].path = path;
+		pending_[slot].frame = frame;
+		glFlush();
+		++next_;
+		waitTime = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+	}
+
+	//retires the frames still in flight and waits for the writer, false if a file could not be written
+	bool finish()
+	{
+		for (int k = 0; k < FRAME_CAPTURE_PBOS; ++k)
+		{
+			int slot = (next_ + k) % FRAME_CAPTURE_PBOS;
+			if (pending_[slot].fence != 0) retire(slot);
+		}
+		if (writer_.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				done_ = true;
+			}
+			ready_.notify_all();
+			writer_.join();
+		}
+		return failed_ == 0;
+	}
+
+	//ms the writer took per frame, after finish()
+	const vector<double> &writeTimes() const { return writeTimes_; }
+	int failedWrites() const { return failed_; }
+
+private:
+	struct Pending
+	{
+		GLsync fence = 0;
+		string path;
+		int frame = 0;
+	};
+	struct Job
+	{
+		string path;
+		int frame;
+		vector<GLuint> pixels;
+	};
+
+	int width_, height_;
+	GLuint pbos_[FRAME_CAPTURE_PBOS];
+	Pending pending_[FRAME_CAPTURE_PBOS];
+	int next_ = 0;
+
+	std::thread writer_;
+	std::mutex mutex_;
+	std::condition_variable ready_;//a job was queued or done_
+	std::condition_variable room_;//a job was taken
+	std::deque<Job> queue_;
+	bool done_ = false;
+	vector<double> writeTimes_;//written by the writer thread, read after join
+	int failed_ = 0;
+
+	void retire(int slot)
+	{
+		Pending &p = pending_[slot];
+		glClientWaitSync(p.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1e10));
+		glDeleteSync(p.fence);
+		p.fence = 0;
+
+		Job job;
+		job.path = p.path;
+		job.frame = p.frame;
+		job.pixels.resize((size_t)width_ * height_);
+		const void *mapped = glMapNamedBufferRange(pbos_[slot], 0, job.pixels.size() * sizeof(GLuint), GL_MAP_READ_BIT);
+		if (mapped != nullptr)
+		{
+			memcpy(job.pixels.data(), mapped, job.pixels.size() * sizeof(GLuint));
+			glUnmapNamedBuffer(pbos_[slot]);
+		}
+		else
+			glGetNamedBufferSubData(pbos_[slot], 0, job.pixels.size() * sizeof(GLuint), job.pixels.data());
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		room_.wait(lock, [this]() { return (int)queue_.size() < FRAME_CAPTURE_QUEUE; });
+		queue_.push_back(std::move(job));
+		lock.unlock();
+		ready_.notify_one();
+	}
+
+	void writeLoop()
+	{
+		for (;;)
+		{
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				ready_.wait(lock, [this]() { return !queue_.empty() || done_; });
+				if (queue_.empty()) return;
+				job = std::move(queue_.front());
+				queue_.pop_front();
+			}
+			room_.notify_one();
+
+			auto t0 = chrono::steady_clock::now();
+			bool ok = writeImage(job.path, job.pixels.data(), width_, height_);
+			double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+			if (job.frame >= (int)writeTimes_.size()) writeTimes_.resize(job.frame + 1, 0.0);
+			writeTimes_[job.frame] = ms;
+			if (!ok)
+			{
+				cout << "ERROR::FRAME_CAPTURE::CANNOT_WRITE " << job.path << endl;
+				++failed_;
+			}
+		}
+	}
+};
+
+#endif // !FRAMECAPTURE_H
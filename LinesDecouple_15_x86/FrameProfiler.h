@@ -0,0 +1,430 @@
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <sstream>
+
+#include "commonVars.h"
+
+//where the time of a frame goes:
+//	ProfileScope times a block on the CPU and, unless gpu is false, brackets its GL commands with GL_TIMESTAMP queries
+//	countFragments() copies a GPU counter(the listCounter atomic, the last span offset) into a buffer of the frame
+//the queries and the counter of a frame go to one of PROFILE_FRAME_SETS sets behind a fence and are read when the set
+//comes round again, long after the GPU is done: the profiler never waits on the GPU(a frame whose fence has not signaled
+//by then loses its GPU times and fragments instead)
+//the statistics roll over the last PROFILE_WINDOW frames, report() also fits the GPU frame time against the fragments;
+//writeTrace() exports the recorded frames as Chrome trace JSON(chrome://tracing, ui.perfetto.dev)
+
+const int PROFILE_FRAME_SETS = 2;
+const int PROFILE_WINDOW = 120;
+const size_t PROFILE_TRACE_FRAMES = 20000;//frames kept for the trace, the oldest are dropped
+
+struct ProfileEvent
+{
+	int scope;//index into scopeNames()
+	double cpuBegin, cpuEnd;//ms since the profiler was created
+	double gpuBegin = -1.0, gpuEnd = -1.0;//ms on the same clock, negative without GPU times
+	int query = -1;//first of the two timestamp queries in the frame's set, -1 for CPU only scopes
+};
+
+struct ProfiledFrame
+{
+	int index = 0;
+	double cpuBegin = 0.0, cpuEnd = 0.0;
+	vector<ProfileEvent> events;
+	bool hasGpu = false;
+	GLuint fragments = 0;
+	bool hasFragments = false;
+
+	double cpuMs() const { return cpuEnd - cpuBegin; }
+	//first GPU timestamp to the last one
+	double gpuMs() const
+	{
+		double begin = 1e300, end = -1e300;
+		for (const ProfileEvent &e : events)
+			if (e.gpuBegin >= 0.0)
+			{
+				begin = std::min(begin, e.gpuBegin);
+				end = std::max(end, e.gpuEnd);
+			}
+		return end >= begin ? end - begin : 0.0;
+	}
+};
+
+//mean and maximum of the last PROFILE_WINDOW values
+class RollingStat
+{
+public:
+	void add(double v)
+	{
+		if ((int)values_.size() < PROFILE_WINDOW) values_.push_back(v);
+		else values_[next_] = v;
+		next_ = (next_ + 1) % PROFILE_WINDOW;
+	}
+	int size() const { return (int)values_.size(); }
+	double mean() const
+	{
+		double sum = 0.0;
+		for (double v : values_) sum += v;
+		return values_.empty() ? 0.0 : sum / values_.size();
+	}
+	double max() const
+	{
+		double m = 0.0;
+		for (double v : values_) m = std::max(m, v);
+		return m;
+	}
+	const vector<double> &values() const { return values_; }
+private:
+	vector<double> values_;
+	int next_ = 0;
+};
+
+class FrameProfiler
+{
+public:
+	bool gpuTimers = true;//false: CPU scopes only
+	int reportInterval = 0;//frames between report()s on stdout, 0: none
+	int droppedGpuFrames = 0;//frames whose fence had not signaled when their set was reused
+
+	FrameProfiler() : epoch_(chrono::steady_clock::now())
+	{
+		for (FrameSet &set : sets_)
+		{
+			glCreateBuffers(1, &set.counter);
+			glNamedBufferStorage(set.counter, sizeof(GLuint), nullptr, 0);
+		}
+	}
+
+	~FrameProfiler()
+	{
+		for (FrameSet &set : sets_)
+		{
+			if (set.fence != 0) glDeleteSync(set.fence);
+			if (!set.queries.empty()) glDeleteQueries((GLsizei)set.queries.size(), set.queries.data());
+			glDeleteBuffers(1, &set.counter);
+		}
+	}
+
+	FrameProfiler(const FrameProfiler &) = delete;
+	FrameProfiler &operator=(const FrameProfiler &) = delete;
+
+	void beginFrame()
+	{
+		FrameSet &set = sets_[frameIndex_ % PROFILE_FRAME_SETS];
+		if (set.pending) retire(set, false);
+		if (frameIndex_ % PROFILE_WINDOW == 0) calibrate();
+		set.frame = ProfiledFrame();
+		set.frame.index = frameIndex_;
+		set.frame.cpuBegin = now();
+		set.queryNum = 0;
+		set.counterBase = 0;
+		set.counterUsed = false;
+		inFrame_ = true;
+	}
+
+	void endFrame()
+	{
+		if (!inFrame_) return;
+		FrameSet &set = sets_[frameIndex_ % PROFILE_FRAME_SETS];
+		set.frame.cpuEnd = now();
+		set.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		set.pending = true;
+		inFrame_ = false;
+		++frameIndex_;
+		if (reportInterval > 0 && frameIndex_ % reportInterval == 0) cout << report();
+	}
+
+	//waits for the frames in flight, e.g. before the last report() or writeTrace()
+	void flush()
+	{
+		for (int k = 0; k < PROFILE_FRAME_SETS; ++k)
+		{
+			FrameSet &set = sets_[(frameIndex_ + k) % PROFILE_FRAME_SETS];
+			if (set.pending) retire(set, true);
+		}
+	}
+
+	//returns the event for endScope(), -1 outside beginFrame()/endFrame()
+	int beginScope(const char *name, bool gpu = true)
+	{
+		if (!inFrame_) return -1;
+		FrameSet &set = sets_[frameIndex_ % PROFILE_FRAME_SETS];
+		ProfileEvent e;
+		e.scope = scopeIndex(name);
+		if (gpu && gpuTimers)
+		{
+			e.query = set.queryNum;
+			set.queryNum += 2;
+			if ((int)set.queries.size() < set.queryNum)
+			{
+				size_t first = set.queries.size();
+				set.queries.resize(set.queryNum);
+				glGenQueries((GLsizei)(set.queryNum - first), &set.queries[first]);
+			}
+			glQueryCounter(set.queries[e.query], GL_TIMESTAMP);
+		}
+		e.cpuBegin = now();
+		set.frame.events.push_back(e);
+		return (int)set.frame.events.size() - 1;
+	}
+
+	void endScope(int event)
+	{
+		if (!inFrame_ || event < 0) return;
+		FrameSet &set = sets_[frameIndex_ % PROFILE_FRAME_SETS];
+		ProfileEvent &e = set.frame.events[event];
+		if (e.query >= 0) glQueryCounter(set.queries[e.query + 1], GL_TIMESTAMP);
+		e.cpuEnd = now();
+	}
+
+	//the frame's fragments are the GLuint at offset in buffer minus base, copied on the GPU once its writes are visible
+	void countFragments(GLuint buffer, GLintptr offset, GLuint base = 0)
+	{
+		if (!inFrame_) return;
+		FrameSet &set = sets_[frameIndex_ % PROFILE_FRAME_SETS];
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
+		glCopyNamedBufferSubData(buffer, set.counter, offset, 0, sizeof(GLuint));
+		set.counterBase = base;
+		set.counterUsed = true;
+		set.frame.hasFragments = false;
+	}
+
+	//fragments already known on the CPU
+	void setFragments(GLuint fragments)
+	{
+		if (!inFrame_) return;
+		FrameSet &set = sets_[frameIndex_ % PROFILE_FRAME_SETS];
+		set.counterUsed = false;
+		set.frame.fragments = fragments;
+		set.frame.hasFragments = true;
+	}
+
+	const vector<string> &scopeNames() const { return names_; }
+	//per frame totals of scope s over the window, the GPU ones empty for CPU only scopes
+	const RollingStat &scopeCpuMs(int s) const { return scopeCpu_[s]; }
+	const RollingStat &scopeGpuMs(int s) const { return scopeGpu_[s]; }
+	//the retired frames, oldest first
+	const std::deque<ProfiledFrame> &frames() const { return history_; }
+	const RollingStat &frameCpuMs() const { return frameCpu_; }
+	const RollingStat &frameGpuMs() const { return frameGpu_; }
+	const RollingStat &fragments() const { return fragments_; }
+
+	//one line of rolling means, e.g. for a window title
+	string summary() const
+	{
+		ostringstream out;
+		out << fixed << setprecision(2) << frameCpu_.mean() << " ms CPU, " << frameGpu_.mean() << " ms GPU, "
+			<< setprecision(3) << fragments_.mean() / 1e6 << "M fragments";
+		return out.str();
+	}
+
+	//rolling mean and maximum per scope(summed over the scope's calls in a frame), and the least squares fit of the
+	//GPU frame time against the fragments: ns per fragment, fixed ms and the correlation
+	string report() const
+	{
+		ostringstream out;
+		out << fixed << setprecision(3);
+		out << "last " << frameCpu_.size() << " of " << frameIndex_ << " frames";
+		if (droppedGpuFrames > 0) out << ", " << droppedGpuFrames << " without GPU times";
+		out << endl;
+		out << "scope\tCPU mean ms\tCPU max ms\tGPU mean ms\tGPU max ms" << endl;
+		for (size_t s = 0; s < names_.size(); ++s)
+		{
+			out << names_[s] << "\t" << scopeCpu_[s].mean() << "\t" << scopeCpu_[s].max() << "\t";
+			if (scopeGpu_[s].size() > 0) out << scopeGpu_[s].mean() << "\t" << scopeGpu_[s].max() << endl;
+			else out << "-\t-" << endl;
+		}
+		out << "frame\t" << frameCpu_.mean() << "\t" << frameCpu_.max() << "\t" << frameGpu_.mean() << "\t" << frameGpu_.max() << endl;
+
+		//the fit over the frames with GPU times and fragments
+		double n = 0.0, sx = 0.0, sy = 0.0, sxx = 0.0, syy = 0.0, sxy = 0.0;
+		for (size_t i = 0; i < fitFragments_.values().size(); ++i)
+		{
+			double x = fitFragments_.values()[i], y = fitGpuMs_.values()[i];
+			n += 1.0;
+			sx += x;
+			sy += y;
+			sxx += x * x;
+			syy += y * y;
+			sxy += x * y;
+		}
+		double vx = n * sxx - sx * sx, vy = n * syy - sy * sy;
+		out << "fragments\tmean " << setprecision(0) << fragments_.mean() << "\tmax " << fragments_.max();
+		if (n >= 2.0 && vx > 0.0)
+		{
+			double slope = (n * sxy - sx * sy) / vx;
+			double r = vy > 0.0 ? (n * sxy - sx * sy) / std::sqrt(vx * vy) : 0.0;
+			out << setprecision(3) << "\tGPU ms = " << slope * 1e6 << " ns/fragment + " << (sy - slope * sx) / n << " ms, r = " << r;
+		}
+		out << endl;
+		return out.str();
+	}
+
+	//the recorded frames as Chrome trace events: pid 1, CPU scopes on tid 1, GPU scopes on tid 2, a "fragments" counter
+	bool writeTrace(const string &path) const
+	{
+		ofstream out(path);
+		if (!out)
+		{
+			cout << "ERROR::FRAME_PROFILER::CANNOT_WRITE " << path << endl;
+			return false;
+		}
+		out << fixed << setprecision(3);
+		out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << endl;
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}}," << endl;
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+		auto event = [&](const string &name, int tid, double begin, double end)
+		{
+			//ms to us
+			out << "," << endl << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << begin * 1000.0
+				<< ",\"dur\":" << std::max(end - begin, 0.0) * 1000.0 << "}";
+		};
+		for (const ProfiledFrame &frame : history_)
+		{
+			event("frame " + to_string(frame.index), 1, frame.cpuBegin, frame.cpuEnd);
+			for (const ProfileEvent &e : frame.events)
+			{
+				event(names_[e.scope], 1, e.cpuBegin, e.cpuEnd);
+				if (e.gpuBegin >= 0.0) event(names_[e.scope], 2, e.gpuBegin, e.gpuEnd);
+			}
+			if (frame.hasFragments)
+				out << "," << endl << "{\"name\":\"fragments\",\"ph\":\"C\",\"pid\":1,\"ts\":" << frame.cpuBegin * 1000.0
+					<< ",\"args\":{\"fragments\":" << frame.fragments << "}}";
+		}
+		out << endl << "]}" << endl;
+		return (bool)out;
+	}
+
+private:
+	struct FrameSet
+	{
+		ProfiledFrame frame;
+		vector<GLuint> queries;//two per GPU scope, grown on demand
+		int queryNum = 0;
+		GLuint counter = 0;
+		GLuint counterBase = 0;
+		bool counterUsed = false;
+		GLsync fence = 0;
+		bool pending = false;//ended, not yet retired
+	};
+
+	chrono::steady_clock::time_point epoch_;
+	double gpuOffset_ = 0.0;//CPU ms - GPU ms
+	FrameSet sets_[PROFILE_FRAME_SETS];
+	int frameIndex_ = 0;
+	bool inFrame_ = false;
+
+	vector<string> names_;
+	vector<RollingStat> scopeCpu_, scopeGpu_;
+	RollingStat frameCpu_, frameGpu_, fragments_;
+	RollingStat fitFragments_, fitGpuMs_;//pairs of the frames with both
+	std::deque<ProfiledFrame> history_;
+
+	double now() const
+	{
+		return chrono::duration<double, milli>(chrono::steady_clock::now() - epoch_).count();
+	}
+
+	//maps GL_TIMESTAMP onto the CPU clock of the trace
+	void calibrate()
+	{
+		GLint64 gpuNow = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+		gpuOffset_ = now() - gpuNow * 1e-6;
+	}
+
+	int scopeIndex(const char *name)
+	{
+		for (size_t s = 0; s < names_.size(); ++s)
+			if (names_[s] == name) return (int)s;
+		names_.push_back(name);
+		scopeCpu_.emplace_back();
+		scopeGpu_.emplace_back();
+		return (int)names_.size() - 1;
+	}
+
+	//reads the set's queries and counter if its fence has signaled(or after waiting for it), then updates the statistics
+	void retire(FrameSet &set, bool wait)
+	{
+		GLenum status = glClientWaitSync(set.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GLuint64(1e10) : 0);
+		glDeleteSync(set.fence);
+		set.fence = 0;
+		set.pending = false;
+		ProfiledFrame &frame = set.frame;
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+		{
+			for (ProfileEvent &e : frame.events)
+			{
+				if (e.query < 0) continue;
+				GLuint64 begin = 0, end = 0;
+				glGetQueryObjectui64v(set.queries[e.query], GL_QUERY_RESULT, &begin);
+				glGetQueryObjectui64v(set.queries[e.query + 1], GL_QUERY_RESULT, &end);
+				e.gpuBegin = begin * 1e-6 + gpuOffset_;
+				e.gpuEnd = end * 1e-6 + gpuOffset_;
+				frame.hasGpu = true;
+			}
+			if (set.counterUsed)
+			{
+				GLuint counter = 0;
+				glGetNamedBufferSubData(set.counter, 0, sizeof(GLuint), &counter);
+				frame.fragments = counter - std::min(counter, set.counterBase);
+				frame.hasFragments = true;
+			}
+		}
+		else if (set.queryNum > 0 || set.counterUsed)
+			++droppedGpuFrames;
+
+		//per scope totals of the frame
+		vector<double> cpu(names_.size(), -1.0), gpu(names_.size(), -1.0);
+		for (const ProfileEvent &e : frame.events)
+		{
+			cpu[e.scope] = std::max(cpu[e.scope], 0.0) + (e.cpuEnd - e.cpuBegin);
+			if (e.gpuBegin >= 0.0) gpu[e.scope] = std::max(gpu[e.scope], 0.0) + (e.gpuEnd - e.gpuBegin);
+		}
+		for (size_t s = 0; s < names_.size(); ++s)
+		{
+			if (cpu[s] < 0.0) continue;
+			scopeCpu_[s].add(cpu[s]);
+			if (gpu[s] >= 0.0) scopeGpu_[s].add(gpu[s]);
+		}
+		frameCpu_.add(frame.cpuMs());
+		if (frame.hasGpu) frameGpu_.add(frame.gpuMs());
+		if (frame.hasFragments) fragments_.add(frame.fragments);
+		if (frame.hasGpu && frame.hasFragments)
+		{
+			fitFragments_.add(frame.fragments);
+			fitGpuMs_.add(frame.gpuMs());
+		}
+
+		history_.push_back(std::move(frame));
+		if (history_.size() > PROFILE_TRACE_FRAMES) history_.pop_front();
+	}
+};
+
+//times the enclosing block in profiler's current frame, nothing if profiler is null
+class ProfileScope
+{
+public:
+	ProfileScope(FrameProfiler *profiler, const char *name, bool gpu = true) :
+		profiler_(profiler), event_(profiler ? profiler->beginScope(name, gpu) : -1)
+	{
+	}
+	~ProfileScope()
+	{
+		if (profiler_) profiler_->endScope(event_);
+	}
+	ProfileScope(const ProfileScope &) = delete;
+	ProfileScope &operator=(const ProfileScope &) = delete;
+private:
+	FrameProfiler *profiler_;
+	int event_;
+};
+
+#endif // !FRAMEPROFILER_H
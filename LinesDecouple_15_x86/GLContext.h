@@ -0,0 +1,111 @@
+#ifndef GLCONTEXT_H
+#define GLCONTEXT_H
+
+//windowless OpenGL 4.5 core context through EGL, works with Mesa llvmpipe on machines without a GPU
+//(EGL_PLATFORM=surfaceless or LIBGL_ALWAYS_SOFTWARE=1 force the software rasterizer)
+
+#ifndef _WIN32
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <glad/glad.h>
+
+#include "commonVars.h"
+
+class HeadlessContext
+{
+public:
+	HeadlessContext() {}
+	~HeadlessContext() { destroy(); }
+	HeadlessContext(const HeadlessContext &) = delete;
+	HeadlessContext &operator=(const HeadlessContext &) = delete;
+
+	//creates the context, makes it current and loads the GL functions
+	bool create()
+	{
+#ifdef _WIN32
+		cout << "ERROR::HEADLESS::EGL_NOT_AVAILABLE" << endl;
+		return false;
+#else
+		//prefer a surfaceless display, so no X server is needed
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay != nullptr)
+			display_ = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (display_ == EGL_NO_DISPLAY)
+			display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+		EGLint major, minor;
+		if (display_ == EGL_NO_DISPLAY || !eglInitialize(display_, &major, &minor))
+		{
+			cout << "ERROR::HEADLESS::EGL_INITIALIZE" << endl;
+			return false;
+		}
+		eglBindAPI(EGL_OPENGL_API);
+
+		const EGLint configAttribs[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_NONE
+		};
+		EGLConfig config;
+		EGLint configNum = 0;
+		eglChooseConfig(display_, configAttribs, &config, 1, &configNum);
+
+		const EGLint contextAttribs[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 4,
+			EGL_CONTEXT_MINOR_VERSION, 5,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		context_ = eglCreateContext(display_, configNum > 0 ? config : (EGLConfig)0, EGL_NO_CONTEXT, contextAttribs);
+		if (context_ == EGL_NO_CONTEXT)
+		{
+			cout << "ERROR::HEADLESS::EGL_CREATE_CONTEXT 0x" << hex << eglGetError() << dec << endl;
+			return false;
+		}
+
+		//rendering goes to framebuffer objects, the pbuffer only has to exist
+		if (configNum > 0)
+		{
+			const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+			surface_ = eglCreatePbufferSurface(display_, config, pbufferAttribs);
+		}
+		if (!eglMakeCurrent(display_, surface_, surface_, context_))
+		{
+			cout << "ERROR::HEADLESS::EGL_MAKE_CURRENT" << endl;
+			return false;
+		}
+
+		gladLoadGLLoader((GLADloadproc)eglGetProcAddress);
+		cout << "OpenGL Version: " << glGetString(GL_VERSION) << endl;
+		cout << "Renderer: " << glGetString(GL_RENDERER) << endl;
+		return true;
+#endif
+	}
+
+	void destroy()
+	{
+#ifndef _WIN32
+		if (display_ == EGL_NO_DISPLAY) return;
+		eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (surface_ != EGL_NO_SURFACE) eglDestroySurface(display_, surface_);
+		if (context_ != EGL_NO_CONTEXT) eglDestroyContext(display_, context_);
+		eglTerminate(display_);
+		display_ = EGL_NO_DISPLAY;
+		surface_ = EGL_NO_SURFACE;
+		context_ = EGL_NO_CONTEXT;
+#endif
+	}
+
+private:
+#ifndef _WIN32
+	EGLDisplay display_ = EGL_NO_DISPLAY;
+	EGLSurface surface_ = EGL_NO_SURFACE;
+	EGLContext context_ = EGL_NO_CONTEXT;
+#endif
+};
+
+#endif // !GLCONTEXT_H
@@ -0,0 +1,340 @@
+#ifndef IMAGEIO_H
+#define IMAGEIO_H
+
+#include <glad/glad.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "commonVars.h"
+
+//rgba8 pixels with row 0 at the bottom(as glReadPixels) to a binary PPM, alpha is dropped
+inline bool writePPM(const string &path, const GLuint *rgba, int width, int height)
+{
+	ofstream fileOut(path, ios::binary);
+	if (!fileOut) return false;
+	fileOut << "P6\n" << width << " " << height << "\n255\n";
+	vector<unsigned char> row(width * 3);
+	for (int y = height - 1; y >= 0; --y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			GLuint p = rgba[y * width + x];
+			row[x * 3 + 0] = p & 0xFF;
+			row[x * 3 + 1] = (p >> 8) & 0xFF;
+			row[x * 3 + 2] = (p >> 16) & 0xFF;
+		}
+		fileOut.write((const char *)&row[0], row.size());
+	}
+	return fileOut.good();
+}
+
+//largest channel difference of two rgba8 images, 255 if the sizes differ; channels 3 skips alpha
+inline int maxImageDifference(const vector<GLuint> &a, const vector<GLuint> &b, int channels = 4)
+{
+	if (a.size() != b.size()) return 255;
+	int maxError = 0;
+	for (size_t i = 0; i < a.size(); ++i)
+		for (int c = 0; c < 8 * channels; c += 8)
+			maxError = std::max(maxError, std::abs((int)((a[i] >> c) & 0xFF) - (int)((b[i] >> c) & 0xFF)));
+	return maxError;
+}
+
+//peak signal to noise ratio over the rgb channels in dB, 0 if the sizes differ and infinity if equal
+inline double imagePSNR(const vector<GLuint> &a, const vector<GLuint> &b)
+{
+	if (a.size() != b.size() || a.empty()) return 0.0;
+	double sum = 0.0;
+	for (size_t i = 0; i < a.size(); ++i)
+		for (int c = 0; c < 24; c += 8)
+		{
+			double d = (double)((a[i] >> c) & 0xFF) - (double)((b[i] >> c) & 0xFF);
+			sum += d * d;
+		}
+	double mse = sum / (3.0 * a.size());
+	return mse == 0.0 ? std::numeric_limits<double>::infinity() : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+#pragma region PNG
+//CRC-32 of PNG chunks
+inline uint32_t crc32Update(uint32_t crc, const unsigned char *data, size_t size)
+{
+	static const vector<uint32_t> table = []()
+	{
+		vector<uint32_t> t(256);
+		for (uint32_t n = 0; n < 256; ++n)
+		{
+			uint32_t c = n;
+			for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			t[n] = c;
+		}
+		return t;
+	}();
+	for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+//LSB-first bit stream of a deflate block
+class DeflateBits
+{
+public:
+	vector<unsigned char> bytes;
+
+	void put(uint32_t value, int bits)
+	{
+		acc_ |= (uint64_t)value << fill_;
+		fill_ += bits;
+		while (fill_ >= 8)
+		{
+			bytes.push_back((unsigned char)acc_);
+			acc_ >>= 8;
+			fill_ -= 8;
+		}
+	}
+
+	//Huffman codes go in from their most significant bit
+	void putCode(uint32_t code, int bits)
+	{
+		uint32_t reversed = 0;
+		for (int k = 0; k < bits; ++k) reversed |= ((code >> k) & 1) << (bits - 1 - k);
+		put(reversed, bits);
+	}
+
+	void flush()
+	{
+		if (fill_ > 0) put(0, 8 - fill_);
+	}
+
+private:
+	uint64_t acc_ = 0;
+	int fill_ = 0;
+};
+
+//one fixed Huffman deflate block: literals and greedy matches against the previous pixel and the previous row
+//(distances bpp and stride), which is where rendered images repeat; no hash chains
+inline void deflateFixed(const unsigned char *data, size_t size, int bpp, int stride, DeflateBits &out)
+{
+	static const int lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const int lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const int distBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+		4097, 6145, 8193, 12289, 16385, 24577 };
+	static const int distExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	auto literal = [&out](int v)
+	{
+		if (v < 144) out.putCode(0x30 + v, 8);
+		else if (v < 256) out.putCode(0x190 + v - 144, 9);
+		else if (v < 280) out.putCode(v - 256, 7);
+		else out.putCode(0xC0 + v - 280, 8);
+	};
+
+	out.put(1, 1);//final block
+	out.put(1, 2);//fixed Huffman codes
+	const int distances[2] = { bpp, stride };
+	size_t i = 0;
+	while (i < size)
+	{
+		int bestLen = 0, bestDist = 0;
+		for (int d : distances)
+		{
+			if (d > 32768 || (size_t)d > i) continue;
+			size_t maxLen = std::min<size_t>(258, size - i);
+			size_t len = 0;
+			while (len < maxLen && data[i + len] == data[i + len - d]) ++len;
+			if ((int)len > bestLen)
+			{
+				bestLen = (int)len;
+				bestDist = d;
+			}
+		}
+		if (bestLen < 3)
+		{
+			literal(data[i++]);
+			continue;
+		}
+		int lc = 28;
+		while (lengthBase[lc] > bestLen) --lc;
+		literal(257 + lc);
+		out.put(bestLen - lengthBase[lc], lengthExtra[lc]);
+		int dc = 29;
+		while (distBase[dc] > bestDist) --dc;
+		out.putCode(dc, 5);
+		out.put(bestDist - distBase[dc], distExtra[dc]);
+		i += bestLen;
+	}
+	literal(256);
+	out.flush();
+}
+
+//rgba8 pixels with row 0 at the bottom to an 8 bit RGB PNG, alpha is dropped
+inline bool writePNG(const string &path, const GLuint *rgba, int width, int height)
+{
+	size_t stride = (size_t)width * 3 + 1;
+	vector<unsigned char> raw(stride * height);
+	for (int y = 0; y < height; ++y)
+	{
+		unsigned char *row = &raw[stride * y];
+		row[0] = 0;//no filter
+		const GLuint *src = rgba + (size_t)(height - 1 - y) * width;
+		for (int x = 0; x < width; ++x)
+		{
+			row[1 + x * 3 + 0] = src[x] & 0xFF;
+			row[1 + x * 3 + 1] = (src[x] >> 8) & 0xFF;
+			row[1 + x * 3 + 2] = (src[x] >> 16) & 0xFF;
+		}
+	}
+
+	DeflateBits zlib;
+	zlib.bytes.reserve(raw.size() / 4);
+	zlib.put(0x78, 8);
+	zlib.put(0x01, 8);
+	deflateFixed(raw.data(), raw.size(), 3, (int)stride, zlib);
+	uint32_t a = 1, b = 0;
+	for (unsigned char c : raw)
+	{
+		a = (a + c) % 65521;
+		b = (b + a) % 65521;
+	}
+	uint32_t adler = (b << 16) | a;
+	for (int k = 3; k >= 0; --k) zlib.bytes.push_back((unsigned char)(adler >> (8 * k)));
+
+	ofstream fileOut(path, ios::binary);
+	if (!fileOut) return false;
+	auto chunk = [&fileOut](const char *type, const unsigned char *data, size_t size)
+	{
+		unsigned char head[8] = { (unsigned char)(size >> 24), (unsigned char)(size >> 16), (unsigned char)(size >> 8), (unsigned char)size,
+			(unsigned char)type[0], (unsigned char)type[1], (unsigned char)type[2], (unsigned char)type[3] };
+		uint32_t crc = crc32Update(0xFFFFFFFFu, head + 4, 4);
+		crc = crc32Update(crc, data, size) ^ 0xFFFFFFFFu;
+		unsigned char tail[4] = { (unsigned char)(crc >> 24), (unsigned char)(crc >> 16), (unsigned char)(crc >> 8), (unsigned char)crc };
+		fileOut.write((const char *)head, 8);
+		if (size > 0) fileOut.write((const char *)data, size);
+		fileOut.write((const char *)tail, 4);
+	};
+	const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	fileOut.write((const char *)signature, 8);
+	unsigned char ihdr[13] = { (unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8), (unsigned char)width,
+		(unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8), (unsigned char)height,
+		8, 2, 0, 0, 0 };//8 bit RGB, deflate, no filter types beyond 0, no interlace
+	chunk("IHDR", ihdr, sizeof(ihdr));
+	chunk("IDAT", zlib.bytes.data(), zlib.bytes.size());
+	chunk("IEND", nullptr, 0);
+	return fileOut.good();
+}
+#pragma endregion
+
+#pragma region EXR
+//IEEE half of a float, rounded to nearest, values past the half range become infinity
+inline uint16_t floatToHalf(float f)
+{
+	uint32_t x;
+	memcpy(&x, &f, 4);
+	uint32_t sign = (x >> 16) & 0x8000u;
+	int exponent = (int)((x >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = x & 0x7FFFFFu;
+	if (exponent >= 31) return (uint16_t)(sign | 0x7C00u);
+	if (exponent <= 0)
+	{
+		if (exponent < -10) return (uint16_t)sign;
+		mantissa |= 0x800000u;
+		int shift = 14 - exponent;
+		uint32_t half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1) ++half;
+		return (uint16_t)(sign | half);
+	}
+	uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000u) ++half;//may carry into the exponent, which is still the nearest value
+	return (uint16_t)half;
+}
+
+//rgba8 pixels with row 0 at the bottom to an uncompressed scanline OpenEXR of half RGB; the 8 bit values are taken as
+//sRGB and stored linear, as EXR viewers expect
+inline bool writeEXR(const string &path, const GLuint *rgba, int width, int height)
+{
+	float toLinear[256];
+	for (int v = 0; v < 256; ++v)
+	{
+		float c = v / 255.0f;
+		toLinear[v] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	vector<char> header;
+	auto bytes = [&header](const void *data, size_t size) { header.insert(header.end(), (const char *)data, (const char *)data + size); };
+	auto int32 = [&bytes](int32_t v) { bytes(&v, 4); };//EXR is little endian, as the targets of this project
+	auto attribute = [&](const char *name, const char *type, int32_t size)
+	{
+		bytes(name, strlen(name) + 1);
+		bytes(type, strlen(type) + 1);
+		int32(size);
+	};
+	const uint32_t magic = 20000630;
+	int32((int32_t)magic);
+	int32(2);//version 2, single part scanline
+
+	attribute("channels", "chlist", 3 * 18 + 1);
+	for (const char *channel : { "B", "G", "R" })
+	{
+		bytes(channel, 2);
+		int32(1);//HALF
+		const char linear[4] = { 0, 0, 0, 0 };
+		bytes(linear, 4);
+		int32(1);
+		int32(1);
+	}
+	header.push_back(0);
+	attribute("compression", "compression", 1);
+	header.push_back(0);//none
+	attribute("dataWindow", "box2i", 16);
+	int32(0); int32(0); int32(width - 1); int32(height - 1);
+	attribute("displayWindow", "box2i", 16);
+	int32(0); int32(0); int32(width - 1); int32(height - 1);
+	attribute("lineOrder", "lineOrder", 1);
+	header.push_back(0);//increasing y
+	attribute("pixelAspectRatio", "float", 4);
+	float one = 1.0f, zero = 0.0f;
+	bytes(&one, 4);
+	attribute("screenWindowCenter", "v2f", 8);
+	bytes(&zero, 4);
+	bytes(&zero, 4);
+	attribute("screenWindowWidth", "float", 4);
+	bytes(&one, 4);
+	header.push_back(0);
+
+	int32_t lineBytes = width * 3 * (int32_t)sizeof(uint16_t);
+	uint64_t offset = header.size() + (uint64_t)height * 8;
+	for (int y = 0; y < height; ++y)
+	{
+		bytes(&offset, 8);
+		offset += 8 + lineBytes;
+	}
+
+	ofstream fileOut(path, ios::binary);
+	if (!fileOut) return false;
+	fileOut.write(header.data(), header.size());
+	vector<uint16_t> line(width * 3);
+	for (int y = 0; y < height; ++y)
+	{
+		const GLuint *src = rgba + (size_t)(height - 1 - y) * width;
+		for (int x = 0; x < width; ++x)
+			for (int c = 0; c < 3; ++c)//B, G, R
+				line[c * width + x] = floatToHalf(toLinear[(src[x] >> (8 * (2 - c))) & 0xFF]);
+		int32_t lineY = y;
+		fileOut.write((const char *)&lineY, 4);
+		fileOut.write((const char *)&lineBytes, 4);
+		fileOut.write((const char *)line.data(), lineBytes);
+	}
+	return fileOut.good();
+}
+#pragma endregion
+
+//by the extension of path: .png, .exr or .ppm
+inline bool writeImage(const string &path, const GLuint *rgba, int width, int height)
+{
+	string ext = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+	if (ext == ".png") return writePNG(path, rgba, width, height);
+	if (ext == ".exr") return writeEXR(path, rgba, width, height);
+	return writePPM(path, rgba, width, height);
+}
+
+#endif // !IMAGEIO_H
@@ -0,0 +1,295 @@
+#ifndef IMPORTANCE_H
+#define IMPORTANCE_H
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+
+#include "commonVars.h"
+#include "LineStorage.h"
+#include "Parallel.h"
+
+//per-vertex and per-segment importance g in [0, 1] for the opacity optimization
+//	LENGTH:    length of the line relative to the longest one
+//	CURVATURE: discrete(Menger) curvature 4 * area / (|a| |b| |a + b|) of every vertex and its neighbors,
+//	           relative to the 99th percentile so that a few kinks do not flatten everything else
+
+enum ImportanceType { LENGTH, CURVATURE };
+
+#pragma region curvature kernels
+inline float mengerCurvature(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2)
+{
+	glm::vec3 a = p1 - p0;
+	glm::vec3 b = p2 - p1;
+	float denom = glm::length(a) * glm::length(b) * glm::length(a + b);
+	return denom > 0.0f ? 2.0f * glm::length(glm::cross(a, b)) / denom : 0.0f;
+}
+
+//curvature of the vertices [begin, end), every one of them needs both neighbors in the array
+inline void curvatureScalar(const glm::vec3 *positions, float *out, int begin, int end)
+{
+	for (int j = begin; j < end; ++j)
+		out[j] = mengerCurvature(positions[j - 1], positions[j], positions[j + 1]);
+}
+
+#if defined(__AVX2__)
+inline void curvatureAvx2(const glm::vec3 *positions, float *out, int begin, int end)
+{
+	const float *base = (const float *)positions;
+	const __m256i lane = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 two = _mm256_set1_ps(2.0f);
+
+	int j = begin;
+	for (; j + 8 <= end; j += 8)
+	{
+		//x, y, z of the vertices j - 1 .. j + 8 as structure of arrays
+		const float *p = base + 3 * (j - 1);
+		__m256 x0 = _mm256_i32gather_ps(p + 0, lane, 4), y0 = _mm256_i32gather_ps(p + 1, lane, 4), z0 = _mm256_i32gather_ps(p + 2, lane, 4);
+		__m256 x1 = _mm256_i32gather_ps(p + 3, lane, 4), y1 = _mm256_i32gather_ps(p + 4, lane, 4), z1 = _mm256_i32gather_ps(p + 5, lane, 4);
+		__m256 x2 = _mm256_i32gather_ps(p + 6, lane, 4), y2 = _mm256_i32gather_ps(p + 7, lane, 4), z2 = _mm256_i32gather_ps(p + 8, lane, 4);
+
+		__m256 ax = _mm256_sub_ps(x1, x0), ay = _mm256_sub_ps(y1, y0), az = _mm256_sub_ps(z1, z0);
+		__m256 bx = _mm256_sub_ps(x2, x1), by = _mm256_sub_ps(y2, y1), bz = _mm256_sub_ps(z2, z1);
+		__m256 cx = _mm256_add_ps(ax, bx), cy = _mm256_add_ps(ay, by), cz = _mm256_add_ps(az, bz);
+
+		__m256 la = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, ax), _mm256_mul_ps(ay, ay)), _mm256_mul_ps(az, az));
+		__m256 lb = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(bx, bx), _mm256_mul_ps(by, by)), _mm256_mul_ps(bz, bz));
+		__m256 lc = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, cx), _mm256_mul_ps(cy, cy)), _mm256_mul_ps(cz, cz));
+
+		//|a x b|
+		__m256 nx = _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by));
+		__m256 ny = _mm256_sub_ps(_mm256_mul_ps(az, bx), _mm256_mul_ps(ax, bz));
+		__m256 nz = _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(ay, bx));
+		__m256 ln = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz));
+
+		__m256 denom = _mm256_mul_ps(_mm256_mul_ps(_mm256_sqrt_ps(la), _mm256_sqrt_ps(lb)), _mm256_sqrt_ps(lc));
+		__m256 k = _mm256_div_ps(_mm256_mul_ps(two, _mm256_sqrt_ps(ln)), denom);
+		k = _mm256_and_ps(k, _mm256_cmp_ps(denom, zero, _CMP_GT_OQ));
+		_mm256_storeu_ps(out + j, k);
+	}
+	curvatureScalar(positions, out, j, end);
+}
+#endif
+
+inline void curvatureKernel(const glm::vec3 *positions, float *out, int begin, int end)
+{
+#if defined(__AVX2__)
+	curvatureAvx2(positions, out, begin, end);
+#else
+	curvatureScalar(positions, out, begin, end);
+#endif
+}
+#pragma endregion
+
+#pragma region importance
+//value at the given fraction of the sorted values, from at most sampleNum evenly strided entries
+inline float approximatePercentile(const float *values, int n, float fraction, int sampleNum = 1 << 20)
+{
+	if (n == 0) return 0.0f;
+	int stride = std::max(1, n / sampleNum);
+	vector<float> samples;
+	samples.reserve(n / stride + 1);
+	for (int i = 0; i < n; i += stride) samples.push_back(values[i]);
+	size_t k = std::min(samples.size() - 1, (size_t)(fraction * samples.size()));
+	nth_element(samples.begin(), samples.begin() + k, samples.end());
+	return samples[k];
+}
+
+inline void computeVertexImportance(const LineSet &lines, const float *lineLengths, ImportanceType type, float *out)
+{
+	if (type == LENGTH)
+	{
+		float maxLength = 0.0f;
+		for (int i = 0; i < lines.lineNum; ++i) maxLength = std::max(maxLength, lineLengths[i]);
+		float scale = maxLength > 0.0f ? 1.0f / maxLength : 0.0f;
+		parallelFor(0, lines.lineNum, [&](int i)
+		{
+			float g = lineLengths[i] * scale;
+			for (int j = lines.lineBegin(i); j < lines.lineEnd(i); ++j) out[j] = g;
+		}, 1024);
+		return;
+	}
+
+	//the kernel runs across line boundaries, the end vertices are fixed afterwards
+	int n = lines.vertexNum;
+	if (n >= 3)
+	{
+		parallelBlocks(n - 2, [&](int, int begin, int end)
+		{
+			curvatureKernel(lines.positions, out, begin + 1, end + 1);
+		});
+	}
+	if (n > 0) out[0] = 0.0f;
+	if (n > 1) out[n - 1] = 0.0f;
+	parallelFor(0, lines.lineNum, [&](int i)
+	{
+		int begin = lines.lineBegin(i);
+		int end = lines.lineEnd(i);
+		if (end - begin < 3)
+		{
+			for (int j = begin; j < end; ++j) out[j] = 0.0f;
+			return;
+		}
+		out[begin] = out[begin + 1];
+		out[end - 1] = out[end - 2];
+	}, 1024);
+
+	float reference = approximatePercentile(out, n, 0.99f);
+	float scale = reference > 0.0f ? 1.0f / reference : 0.0f;
+	parallelFor(0, n, [&](int j)
+	{
+		out[j] = std::min(out[j] * scale, 1.0f);
+	}, 1 << 16);
+}
+
+//importance of every segment node: the largest vertex importance around the node,
+//nodes without a vertex of their own are interpolated between their neighbors
+inline void computeSegmentImportance(const LineSet &lines, const int *lineSegOffsets, const float *vertexImportance, float *out)
+{
+	parallelFor(0, lines.lineNum, [&](int i)
+	{
+		int segBegin = lineSegOffsets[i];
+		int segEnd = lineSegOffsets[i + 1];
+		for (int k = segBegin; k < segEnd; ++k) out[k] = -1.0f;
+
+		for (int j = lines.lineBegin(i); j < lines.lineEnd(i); ++j)
+		{
+			int k = std::min(std::max((int)std::lround(lines.weights[j]), segBegin), segEnd - 1);
+			out[k] = std::max(out[k], vertexImportance[j]);
+		}
+
+		int last = -1;
+		for (int k = segBegin; k < segEnd; ++k)
+		{
+			if (out[k] < 0.0f) continue;
+			if (last < 0)
+			{
+				for (int m = segBegin; m < k; ++m) out[m] = out[k];
+			}
+			else
+			{
+				for (int m = last + 1; m < k; ++m)
+					out[m] = out[last] + (out[k] - out[last]) * (float)(m - last) / (k - last);
+			}
+			last = k;
+		}
+		if (last < 0) last = segBegin - 1;
+		for (int m = last + 1; m < segEnd; ++m) out[m] = last >= segBegin ? out[last] : 0.0f;
+	}, 256);
+}
+#pragma endregion
+
+#pragma region cache
+//<model>.imp next to the model, valid while size and modification time of the model and the segment count match
+const char IMPORTANCE_CACHE_MAGIC[4] = { 'L', 'I', 'M', 'P' };
+const uint32_t IMPORTANCE_CACHE_VERSION = 1;
+
+struct ImportanceCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t type;
+	uint32_t segmentNum;
+	uint64_t vertexNum;
+	uint64_t modelSize;
+	int64_t modelTime;
+};
+
+inline bool makeImportanceCacheHeader(const string &modelPath, ImportanceType type, int vertexNum, int segmentNum, ImportanceCacheHeader &header)
+{
+	std::error_code ec;
+	uint64_t size = std::filesystem::file_size(modelPath, ec);
+	if (ec) return false;
+	auto time = std::filesystem::last_write_time(modelPath, ec);
+	if (ec) return false;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, IMPORTANCE_CACHE_MAGIC, sizeof(header.magic));
+	header.version = IMPORTANCE_CACHE_VERSION;
+	header.type = (uint32_t)type;
+	header.segmentNum = (uint32_t)segmentNum;
+	header.vertexNum = (uint64_t)vertexNum;
+	header.modelSize = size;
+	header.modelTime = (int64_t)time.time_since_epoch().count();
+	return true;
+}
+
+inline string importanceCachePath(const string &modelPath, ImportanceType type)
+{
+	return modelPath + (type == LENGTH ? ".length.imp" : ".curvature.imp");
+}
+
+inline bool loadImportanceCache(const string &modelPath, ImportanceType type, vector<float> &vertexImportance, vector<float> &segmentImportance)
+{
+	ImportanceCacheHeader expected;
+	if (!makeImportanceCacheHeader(modelPath, type, (int)vertexImportance.size(), (int)segmentImportance.size(), expected))
+		return false;
+
+	ifstream fileIn(importanceCachePath(modelPath, type), ios::binary);
+	if (!fileIn) return false;
+	ImportanceCacheHeader header;
+	fileIn.read((char *)&header, sizeof(header));
+	if (!fileIn || memcmp(&header, &expected, sizeof(header)) != 0) return false;
+
+	fileIn.read((char *)vertexImportance.data(), vertexImportance.size() * sizeof(float));
+	fileIn.read((char *)segmentImportance.data(), segmentImportance.size() * sizeof(float));
+	return fileIn.good();
+}
+
+inline bool saveImportanceCache(const string &modelPath, ImportanceType type, const vector<float> &vertexImportance, const vector<float> &segmentImportance)
+{
+	ImportanceCacheHeader header;
+	if (!makeImportanceCacheHeader(modelPath, type, (int)vertexImportance.size(), (int)segmentImportance.size(), header))
+		return false;
+
+	ofstream fileOut(importanceCachePath(modelPath, type), ios::binary);
+	if (!fileOut) return false;
+	fileOut.write((const char *)&header, sizeof(header));
+	fileOut.write((const char *)vertexImportance.data(), vertexImportance.size() * sizeof(float));
+	fileOut.write((const char *)segmentImportance.data(), segmentImportance.size() * sizeof(float));
+	return fileOut.good();
+}
+#pragma endregion
+
+#pragma region benchmark
+//curvature importance over thread counts, and the largest SIMD/scalar difference
+inline void benchmarkImportance(const LineSet &lines, const float *lineLengths, int repeats)
+{
+	vector<float> out(lines.vertexNum), reference(lines.vertexNum);
+	if (lines.vertexNum >= 3)
+	{
+		curvatureScalar(lines.positions, &reference[0], 1, lines.vertexNum - 1);
+		curvatureKernel(lines.positions, &out[0], 1, lines.vertexNum - 1);
+	}
+	float maxError = 0.0f;
+	for (int j = 1; j + 1 < lines.vertexNum; ++j)
+		maxError = std::max(maxError, std::abs(out[j] - reference[j]) / std::max(reference[j], 1.0f));
+
+	cout << "curvature importance: " << lines.vertexNum << " vertices, max relative kernel error " << maxError << endl;
+	cout << "threads\tMvertices/s\tspeedup" << endl;
+
+	double base = 0.0;
+	forEachThreadCount(threadNum(), [&](int t)
+	{
+		double best = 1e30;
+		for (int r = 0; r < repeats; ++r)
+		{
+			auto t0 = chrono::steady_clock::now();
+			computeVertexImportance(lines, lineLengths, CURVATURE, &out[0]);
+			best = std::min(best, chrono::duration<double>(chrono::steady_clock::now() - t0).count());
+		}
+		double rate = lines.vertexNum / best / 1e6;
+		if (t == 1) base = rate;
+		cout << t << "\t" << rate << "\t" << rate / base << endl;
+	});
+}
+#pragma endregion
+
+#endif // !IMPORTANCE_H
@@ -38,8 +38,8 @@ public:
 			vShaderFile.close();
 			fShaderFile.close();
 			// convert stream into string
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
+			vertexCode = expandIncludes(vShaderStream.str(), vertexPath);
+			fragmentCode = expandIncludes(fShaderStream.str(), fragmentPath);
 		}
 		catch (std::ifstream::failure e)
 		{
@@ -72,6 +72,36 @@ public:
 		glDeleteShader(fragment);
 
 	}
+	// compute shader program
+	// ------------------------------------------------------------------------
+	explicit Shader(const char* computePath)
+	{
+		std::string computeCode;
+		std::ifstream cShaderFile;
+		cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+		try
+		{
+			cShaderFile.open(computePath);
+			std::stringstream cShaderStream;
+			cShaderStream << cShaderFile.rdbuf();
+			cShaderFile.close();
+			computeCode = expandIncludes(cShaderStream.str(), computePath);
+		}
+		catch (std::ifstream::failure e)
+		{
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+		}
+		const char* cShaderCode = computeCode.c_str();
+		unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+		glShaderSource(compute, 1, &cShaderCode, NULL);
+		glCompileShader(compute);
+		checkCompileErrors(compute, "COMPUTE");
+		ID = glCreateProgram();
+		glAttachShader(ID, compute);
+		glLinkProgram(ID);
+		checkCompileErrors(ID, "PROGRAM");
+		glDeleteShader(compute);
+	}
 	// activate the shader
 	// ------------------------------------------------------------------------
 	void use() const
@@ -90,6 +120,11 @@ public:
 		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
 	}
 	// ------------------------------------------------------------------------
+	void setUInt(const std::string &name, unsigned int value) const
+	{
+		glUniform1ui(glGetUniformLocation(ID, name.c_str()), value);
+	}
+	// ------------------------------------------------------------------------
 	void setFloat(const std::string &name, float value) const
 	{
 		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
@@ -148,6 +183,41 @@ public:
 
 
 private:
+	// replaces every line '#include "file"' by that file(relative to the including shader), GLSL has no includes
+	// ------------------------------------------------------------------------
+	static std::string expandIncludes(const std::string &code, const std::string &path, int depth = 0)
+	{
+		std::string dir = path.substr(0, path.find_last_of("/\\") + 1);
+		std::istringstream lines(code);
+		std::stringstream out;
+		std::string line;
+		int lineNum = 0;
+		while (std::getline(lines, line))
+		{
+			++lineNum;
+			size_t start = line.find_first_not_of(" \t");
+			size_t open = line.find('"');
+			size_t close = line.find_last_of('"');
+			if (start == std::string::npos || line.compare(start, 8, "#include") != 0 || open == std::string::npos || close <= open)
+			{
+				out << line << "\n";
+				continue;
+			}
+			std::string includePath = dir + line.substr(open + 1, close - open - 1);
+			std::ifstream includeFile(includePath);
+			if (!includeFile || depth > 8)
+			{
+				std::cout << "ERROR::SHADER::INCLUDE_NOT_SUCCESFULLY_READ " << includePath << std::endl;
+				continue;
+			}
+			std::stringstream includeStream;
+			includeStream << includeFile.rdbuf();
+			out << expandIncludes(includeStream.str(), includePath, depth + 1);
+			// keep the line numbers of compile errors in the including shader
+			out << "#line " << lineNum + 1 << "\n";
+		}
+		return out.str();
+	}
 	// utility function for checking shader compilation/linking errors.
 	// ------------------------------------------------------------------------
 	void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,725 @@
+#ifndef LINEBVH_H
+#define LINEBVH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+
+#include "commonVars.h"
+#include "LineStorage.h"
+#include "Parallel.h"
+#include "RenderParams.h"
+
+//linear BVH(Karras 2012) over chunks of the lines for view-frustum culling and picking:
+//	every line is cut into chunks of at most BVH_CHUNK_VERTS vertices, consecutive chunks of a line share one
+//	vertex so that the strips of the chunks cover the segments of the line exactly once
+//	the chunks are sorted by the Morton codes of their box centers, every internal node of the hierarchy is
+//	emitted independently from the sorted codes and covers a contiguous range of the sorted chunks
+//	culling marks the chunks that touch the view frustum and merges runs of consecutive chunks of a line
+//	into one strip of the multi-draw list; picking walks the tree with the ray through a pixel
+
+const int BVH_CHUNK_VERTS = 32;
+
+struct BVHBox
+{
+	glm::vec3 lo = glm::vec3(1e30f);
+	glm::vec3 hi = glm::vec3(-1e30f);
+
+	void grow(const glm::vec3 &p)
+	{
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+
+	void grow(const BVHBox &b)
+	{
+		lo = glm::min(lo, b.lo);
+		hi = glm::max(hi, b.hi);
+	}
+
+	glm::vec3 center() const { return (lo + hi) * 0.5f; }
+};
+
+//the vertices [first, first + count) of a line
+struct LineChunk
+{
+	int line;
+	int first;
+	int count;
+};
+
+//children >= 0 are internal nodes, a leaf is ~(its position in the sorted chunks)
+struct BVHNode
+{
+	BVHBox box;
+	int children[2];
+	int begin, end;//the sorted chunks [begin, end) below the node
+};
+
+//the ray through a pixel in data space from the near(t = 0) to the far plane(t = 1), a segment is hit if it
+//comes closer than tolerance(t), the pick radius in pixels at that depth
+struct PickRay
+{
+	glm::vec3 origin;
+	glm::vec3 direction;
+	float tolNear, tolFar;
+
+	float tolerance(float t) const { return tolNear + t * (tolFar - tolNear); }
+};
+
+struct PickResult
+{
+	int line = -1;//-1: nothing under the cursor
+	int vertex = -1;//first vertex of the hit segment
+	float t = 1.0f;//along the PickRay
+	float distance = 0.0f;//of the segment from the ray in data units
+};
+
+#pragma region helpers
+inline int leadingZeros64(uint64_t x)
+{
+#if defined(_MSC_VER)
+	//_BitScanReverse64 is missing on Win32
+	unsigned long index;
+	if (_BitScanReverse(&index, (unsigned long)(x >> 32))) return 31 - (int)index;
+	if (_BitScanReverse(&index, (unsigned long)x)) return 63 - (int)index;
+	return 64;
+#else
+	return x != 0 ? __builtin_clzll(x) : 64;
+#endif
+}
+
+//10 bits spread to every third bit
+inline uint32_t expandBits10(uint32_t v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+//30 bit Morton code of p in [0, 1]^3
+inline uint32_t morton3D(const glm::vec3 &p)
+{
+	glm::vec3 q = glm::clamp(p * 1024.0f, glm::vec3(0.0f), glm::vec3(1023.0f));
+	return (expandBits10((uint32_t)q.x) << 2) | (expandBits10((uint32_t)q.y) << 1) | expandBits10((uint32_t)q.z);
+}
+
+//stable LSD radix sort by the upper 32 bits in passes of 8 bits, per-thread histograms, temp is scratch
+inline void radixSortUpper32(vector<uint64_t> &keys, vector<uint64_t> &temp)
+{
+	int n = (int)keys.size();
+	temp.resize(n);
+	int threads = std::max(1, std::min(threadNum(), n / 65536));
+	vector<GLuint> counts((size_t)threads * 256);
+	auto blockRange = [n, threads](int t, int &b, int &e)
+	{
+		b = (int)((long long)n * t / threads);
+		e = (int)((long long)n * (t + 1) / threads);
+	};
+
+	for (int shift = 32; shift < 64; shift += 8)
+	{
+		std::fill(counts.begin(), counts.end(), 0u);
+		parallelRun(threads, [&](int t)
+		{
+			int b, e;
+			blockRange(t, b, e);
+			GLuint *c = &counts[(size_t)t * 256];
+			for (int i = b; i < e; ++i) ++c[(keys[i] >> shift) & 0xFF];
+		});
+
+		//digit-major: digit d of thread t goes after the smaller digits and after digit d of the threads before t
+		GLuint sum = 0;
+		bool single = false;
+		for (int d = 0; d < 256; ++d)
+		{
+			GLuint digitTotal = 0;
+			for (int t = 0; t < threads; ++t)
+			{
+				GLuint c = counts[(size_t)t * 256 + d];
+				counts[(size_t)t * 256 + d] = sum + digitTotal;
+				digitTotal += c;
+			}
+			sum += digitTotal;
+			single = single || digitTotal == (GLuint)n;
+		}
+		if (single) continue;
+
+		parallelRun(threads, [&](int t)
+		{
+			int b, e;
+			blockRange(t, b, e);
+			GLuint *c = &counts[(size_t)t * 256];
+			for (int i = b; i < e; ++i) temp[c[(keys[i] >> shift) & 0xFF]++] = keys[i];
+		});
+		keys.swap(temp);
+	}
+}
+
+//the 6 planes of the clip volume of params in data space, a point p is inside if dot(plane, (p, 1)) >= 0 for all
+//margin: distance in world units(after transform) the planes are pushed out by, e.g. for the strip width
+inline void frustumPlanes(const RenderParams &params, float margin, glm::vec4 *planes)
+{
+	const glm::mat4 &m = params.modelViewProjectionMatrix;
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; ++r) rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+	for (int k = 0; k < 6; ++k)
+	{
+		glm::vec4 plane = (k & 1) ? rows[3] - rows[k / 2] : rows[3] + rows[k / 2];
+		plane = plane * (1.0f / glm::length(glm::vec3(plane)));
+		plane.w += margin;
+		//transform space to data space: dot(plane, transform * p) = dot(transpose(transform) * plane, p)
+		planes[k] = glm::transpose(params.transform) * plane;
+	}
+}
+
+//0 outside, 1 crossing a plane, 2 inside all planes
+inline int classifyBox(const BVHBox &b, const glm::vec4 *planes)
+{
+	glm::vec3 c = b.center(), e = (b.hi - b.lo) * 0.5f;
+	int result = 2;
+	for (int k = 0; k < 6; ++k)
+	{
+		glm::vec3 n(planes[k]);
+		float d = glm::dot(n, c) + planes[k].w;
+		float r = glm::dot(glm::abs(n), e);
+		if (d + r < 0.0f) return 0;
+		if (d - r < 0.0f) result = 1;
+	}
+	return result;
+}
+
+//x, y: window pixel with y down(as the cursor), radius: in pixels
+inline PickRay makePickRay(const RenderParams &params, float x, float y, float radius)
+{
+	glm::mat4 inv = glm::inverse(params.modelViewProjectionMatrix * params.transform);
+	auto unproject = [&](float px, float py, float z)
+	{
+		glm::vec4 p = inv * glm::vec4(2.0f * px / params.width - 1.0f, 1.0f - 2.0f * py / params.height, z, 1.0f);
+		return glm::vec3(p) / p.w;
+	};
+	PickRay ray;
+	glm::vec3 farPoint = unproject(x, y, 1.0f);
+	ray.origin = unproject(x, y, -1.0f);
+	ray.direction = farPoint - ray.origin;
+	ray.tolNear = glm::length(unproject(x + radius, y, -1.0f) - ray.origin);
+	ray.tolFar = glm::length(unproject(x + radius, y, 1.0f) - farPoint);
+	return ray;
+}
+
+//closest points of the segments p1 + s * d1 and p2 + t * d2, s and t in [0, 1], returns the squared distance
+inline float closestSegmentPoints(const glm::vec3 &p1, const glm::vec3 &d1, const glm::vec3 &p2, const glm::vec3 &d2, float &s, float &t)
+{
+	const float EPS = 1e-12f;
+	glm::vec3 r = p1 - p2;
+	float a = glm::dot(d1, d1), e = glm::dot(d2, d2), f = glm::dot(d2, r);
+	if (a <= EPS && e <= EPS)
+	{
+		s = t = 0.0f;
+	}
+	else if (a <= EPS)
+	{
+		s = 0.0f;
+		t = glm::clamp(f / e, 0.0f, 1.0f);
+	}
+	else
+	{
+		float c = glm::dot(d1, r);
+		if (e <= EPS)
+		{
+			t = 0.0f;
+			s = glm::clamp(-c / a, 0.0f, 1.0f);
+		}
+		else
+		{
+			float b = glm::dot(d1, d2);
+			float denom = a * e - b * b;
+			s = denom > 0.0f ? glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+			t = (b * s + f) / e;
+			if (t < 0.0f)
+			{
+				t = 0.0f;
+				s = glm::clamp(-c / a, 0.0f, 1.0f);
+			}
+			else if (t > 1.0f)
+			{
+				t = 1.0f;
+				s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+			}
+		}
+	}
+	glm::vec3 diff = p1 + d1 * s - (p2 + d2 * t);
+	return glm::dot(diff, diff);
+}
+
+//tests the segment from vertex v to v + 1 of line, keeps it in best if it is hit closer to the near plane
+inline void pickSegment(const LineSet &lines, const PickRay &ray, int line, int v, PickResult &best)
+{
+	float s, t;
+	glm::vec3 a = lines.positions[v];
+	float dist2 = closestSegmentPoints(ray.origin, ray.direction, a, lines.positions[v + 1] - a, s, t);
+	float tol = ray.tolerance(s);
+	if (dist2 <= tol * tol && (s < best.t || best.line < 0))
+	{
+		best.line = line;
+		best.vertex = v;
+		best.t = s;
+		best.distance = std::sqrt(dist2);
+	}
+}
+
+//every segment of every line, the reference for LineBVH::pick
+inline PickResult pickBruteForce(const LineSet &lines, const PickRay &ray)
+{
+	PickResult best;
+	for (int l = 0; l < lines.lineNum; ++l)
+		for (int v = lines.lineBegin(l); v + 1 < lines.lineEnd(l); ++v)
+			pickSegment(lines, ray, l, v, best);
+	return best;
+}
+#pragma endregion
+
+class LineBVH
+{
+public:
+	double buildTime = 0.0;//ms of the last build()
+	double cullTime = 0.0;//ms of the last cull()
+	int visibleChunks = 0;//of the last cull()
+	int visibleVertices = 0;//drawn by the last cull()'s list, shared chunk vertices count once
+
+	int chunkNum() const { return (int)chunks_.size(); }
+	int nodeNum() const { return (int)nodes_.size(); }
+	const vector<LineChunk> &chunks() const { return chunks_; }
+	const vector<BVHBox> &lineBoxes() const { return lineBoxes_; }
+	bool chunkVisible(int chunk) const { return visible_[chunk] != 0; }
+
+	void build(const LineSet &lines)
+	{
+		auto t0 = chrono::steady_clock::now();
+		makeChunks(lines);
+		int n = chunkNum();
+		nodes_.clear();
+		sorted_.clear();
+		if (n > 0)
+		{
+			sortChunks();
+			if (n > 1) emitHierarchy();
+		}
+		visible_.assign(n, 1);
+		buildTime = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+	}
+
+	//the strips of the chunks that touch the view frustum of params, runs of consecutive chunks of a line merged
+	void cull(const RenderParams &params, vector<GLint> &firsts, vector<GLsizei> &counts)
+	{
+		auto t0 = chrono::steady_clock::now();
+		int n = chunkNum();
+		visible_.assign(n, 0);
+		if (n > 0)
+		{
+			glm::vec4 planes[6];
+			frustumPlanes(params, 0.5f * params.stripWidth, planes);
+
+			//split the top of the tree into subtrees for the threads
+			vector<int> frontier(1, rootRef()), next;
+			while ((int)frontier.size() < 16 * threadNum())
+			{
+				bool split = false;
+				next.clear();
+				for (int ref : frontier)
+				{
+					if (ref >= 0)
+					{
+						next.push_back(nodes_[ref].children[0]);
+						next.push_back(nodes_[ref].children[1]);
+						split = true;
+					}
+					else next.push_back(ref);
+				}
+				frontier.swap(next);
+				if (!split) break;
+			}
+			parallelFor(0, (int)frontier.size(), [&](int i) { cullSubtree(frontier[i], planes); }, 1);
+		}
+		compactRuns(firsts, counts);
+		cullTime = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+	}
+
+	//the segment nearest to the near plane within ray's tolerance
+	PickResult pick(const LineSet &lines, const PickRay &ray) const
+	{
+		PickResult best;
+		if (chunks_.empty()) return best;
+		float pad = std::max(ray.tolNear, ray.tolFar);
+		glm::vec3 inv;
+		for (int k = 0; k < 3; ++k) inv[k] = ray.direction[k] != 0.0f ? 1.0f / ray.direction[k] : 1e30f;
+
+		int stack[128];
+		int top = 0;
+		stack[top++] = rootRef();
+		while (top > 0)
+		{
+			int ref = stack[--top];
+			float tEntry;
+			if (!rayBox(ray, inv, refBox(ref), pad, best.line >= 0 ? best.t : 1.0f, tEntry)) continue;
+			if (ref < 0)
+			{
+				const LineChunk &chunk = chunks_[sorted_[~ref]];
+				for (int v = chunk.first; v + 1 < chunk.first + chunk.count; ++v)
+					pickSegment(lines, ray, chunk.line, v, best);
+				continue;
+			}
+			stack[top++] = nodes_[ref].children[0];
+			stack[top++] = nodes_[ref].children[1];
+		}
+		return best;
+	}
+
+private:
+	vector<LineChunk> chunks_;//in line order
+	vector<BVHBox> chunkBoxes_;
+	vector<BVHBox> lineBoxes_;
+	vector<int> sorted_;//the chunk at each position of the Morton order
+	vector<uint64_t> keys_;//Morton code << 32 | chunk, sorted
+	vector<BVHNode> nodes_;//chunkNum - 1 internal nodes, 0 is the root
+	vector<unsigned char> visible_;//per chunk
+
+	int rootRef() const { return nodes_.empty() ? ~0 : 0; }
+	const BVHBox &refBox(int ref) const { return ref >= 0 ? nodes_[ref].box : chunkBoxes_[sorted_[~ref]]; }
+
+	void makeChunks(const LineSet &lines)
+	{
+		const int STEP = BVH_CHUNK_VERTS - 1;
+		int lineNum = lines.lineNum;
+		vector<int> offsets(lineNum + 1);
+		parallelFor(0, lineNum, [&](int l)
+		{
+			int size = lines.lineSize(l);
+			offsets[l] = size < 2 ? size : (size - 2) / STEP + 1;
+		});
+		parallelExclusiveScan(offsets.data(), offsets.data(), lineNum);
+
+		chunks_.resize(offsets[lineNum]);
+		chunkBoxes_.assign(offsets[lineNum], BVHBox());
+		lineBoxes_.assign(lineNum, BVHBox());
+		parallelFor(0, lineNum, [&](int l)
+		{
+			int begin = lines.lineBegin(l), size = lines.lineSize(l);
+			for (int c = offsets[l]; c < offsets[l + 1]; ++c)
+			{
+				int first = begin + (c - offsets[l]) * STEP;
+				LineChunk &chunk = chunks_[c];
+				chunk.line = l;
+				chunk.first = first;
+				chunk.count = std::min(BVH_CHUNK_VERTS, begin + size - first);
+				for (int v = first; v < first + chunk.count; ++v) chunkBoxes_[c].grow(lines.positions[v]);
+				lineBoxes_[l].grow(chunkBoxes_[c]);
+			}
+		});
+	}
+
+	void sortChunks()
+	{
+		int n = chunkNum();
+		int threads = threadNum();
+		vector<BVHBox> centers(threads);
+		parallelBlocks(n, [&](int t, int begin, int end)
+		{
+			for (int c = begin; c < end; ++c) centers[t].grow(chunkBoxes_[c].center());
+		});
+		BVHBox bounds;
+		for (const BVHBox &b : centers) bounds.grow(b);
+		glm::vec3 extent = bounds.hi - bounds.lo;
+		glm::vec3 scale;
+		for (int k = 0; k < 3; ++k) scale[k] = extent[k] > 0.0f ? 1.0f / extent[k] : 0.0f;
+
+		keys_.resize(n);
+		parallelFor(0, n, [&](int c)
+		{
+			keys_[c] = ((uint64_t)morton3D((chunkBoxes_[c].center() - bounds.lo) * scale) << 32) | (uint64_t)c;
+		});
+		vector<uint64_t> temp;
+		radixSortUpper32(keys_, temp);
+		sorted_.resize(n);
+		parallelFor(0, n, [&](int i) { sorted_[i] = (int)(keys_[i] & 0xFFFFFFFFu); });
+	}
+
+	//length of the common prefix of the sorted keys i and j, -1 out of range; the chunk index in the low bits makes
+	//all keys distinct
+	int delta(int i, int j) const
+	{
+		if (j < 0 || j >= (int)keys_.size()) return -1;
+		return leadingZeros64(keys_[i] ^ keys_[j]);
+	}
+
+	//Karras: node i spans the sorted keys from i in the direction of the longer common prefix and splits its
+	//range where the common prefix gets longer than the one of the whole range; boxes are merged bottom up,
+	//the second child to arrive at a node computes its box
+	void emitHierarchy()
+	{
+		int n = chunkNum();
+		nodes_.resize(n - 1);
+		vector<int> parents(n - 1 + n, -1);//internal nodes, then leaves
+		parallelFor(0, n - 1, [&](int i)
+		{
+			int d = delta(i, i + 1) > delta(i, i - 1) ? 1 : -1;
+			int minPrefix = delta(i, i - d);
+			int maxLength = 2;
+			while (delta(i, i + maxLength * d) > minPrefix) maxLength *= 2;
+			int length = 0;
+			for (int t = maxLength / 2; t >= 1; t /= 2)
+				if (delta(i, i + (length + t) * d) > minPrefix) length += t;
+			int j = i + length * d;
+
+			int nodePrefix = delta(i, j);
+			int split = 0;
+			for (int t = length; t > 1; )
+			{
+				t = (t + 1) / 2;
+				if (delta(i, i + (split + t) * d) > nodePrefix) split += t;
+			}
+			int gamma = i + split * d + std::min(d, 0);
+
+			BVHNode &node = nodes_[i];
+			node.begin = std::min(i, j);
+			node.end = std::max(i, j) + 1;
+			node.children[0] = node.begin == gamma ? ~gamma : gamma;
+			node.children[1] = node.end - 1 == gamma + 1 ? ~(gamma + 1) : gamma + 1;
+			for (int c = 0; c < 2; ++c)
+			{
+				int child = node.children[c];
+				parents[child >= 0 ? child : n - 1 + ~child] = i;
+			}
+		});
+
+		unique_ptr<std::atomic<int>[]> arrivals(new std::atomic<int>[n - 1]);
+		parallelFor(0, n - 1, [&](int i) { arrivals[i].store(0); });
+		parallelFor(0, n, [&](int leaf)
+		{
+			int p = parents[n - 1 + leaf];
+			while (p >= 0 && arrivals[p].fetch_add(1) == 1)
+			{
+				BVHNode &node = nodes_[p];
+				node.box = refBox(node.children[0]);
+				node.box.grow(refBox(node.children[1]));
+				p = parents[p];
+			}
+		});
+	}
+
+	void markRange(int begin, int end)
+	{
+		for (int i = begin; i < end; ++i) visible_[sorted_[i]] = 1;
+	}
+
+	void cullSubtree(int root, const glm::vec4 *planes)
+	{
+		int stack[128];
+		int top = 0;
+		stack[top++] = root;
+		while (top > 0)
+		{
+			int ref = stack[--top];
+			int side = classifyBox(refBox(ref), planes);
+			if (side == 0) continue;
+			if (ref < 0)
+				visible_[sorted_[~ref]] = 1;
+			else if (side == 2)
+				markRange(nodes_[ref].begin, nodes_[ref].end);
+			else
+			{
+				stack[top++] = nodes_[ref].children[0];
+				stack[top++] = nodes_[ref].children[1];
+			}
+		}
+	}
+
+	bool runStart(int c) const
+	{
+		return visible_[c] && !(c > 0 && visible_[c - 1] && chunks_[c - 1].line == chunks_[c].line);
+	}
+
+	//one strip per run of visible chunks in line order, counted and written per block of chunks
+	void compactRuns(vector<GLint> &firsts, vector<GLsizei> &counts)
+	{
+		int n = chunkNum();
+		int threads = std::max(1, std::min(threadNum(), n));
+		vector<int> blockRuns(threads + 1, 0), blockChunks(threads, 0);
+		parallelBlocks(n, [&](int t, int begin, int end)
+		{
+			int runs = 0, cnt = 0;
+			for (int c = begin; c < end; ++c)
+			{
+				runs += runStart(c) ? 1 : 0;
+				cnt += visible_[c];
+			}
+			blockRuns[t + 1] = runs;
+			blockChunks[t] = cnt;
+		});
+		visibleChunks = 0;
+		for (int t = 0; t < threads; ++t)
+		{
+			blockRuns[t + 1] += blockRuns[t];
+			visibleChunks += blockChunks[t];
+		}
+
+		firsts.resize(blockRuns[threads]);
+		counts.resize(blockRuns[threads]);
+		vector<int> blockVertices(threads, 0);
+		parallelBlocks(n, [&](int t, int begin, int end)
+		{
+			int out = blockRuns[t];
+			for (int c = begin; c < end; ++c)
+			{
+				if (!runStart(c)) continue;
+				int last = c;
+				while (last + 1 < n && visible_[last + 1] && chunks_[last + 1].line == chunks_[c].line) ++last;
+				firsts[out] = (GLint)chunks_[c].first;
+				counts[out] = (GLsizei)(chunks_[last].first + chunks_[last].count - chunks_[c].first);
+				blockVertices[t] += counts[out];
+				++out;
+			}
+		});
+		visibleVertices = 0;
+		for (int v : blockVertices) visibleVertices += v;
+	}
+
+	//slab test against box widened by pad, the entry in [0, tMax]
+	static bool rayBox(const PickRay &ray, const glm::vec3 &inv, const BVHBox &box, float pad, float tMax, float &tEntry)
+	{
+		float t0 = 0.0f, t1 = tMax;
+		for (int k = 0; k < 3; ++k)
+		{
+			float lo = box.lo[k] - pad, hi = box.hi[k] + pad;
+			if (ray.direction[k] == 0.0f)
+			{
+				if (ray.origin[k] < lo || ray.origin[k] > hi) return false;
+				continue;
+			}
+			float a = (lo - ray.origin[k]) * inv[k], b = (hi - ray.origin[k]) * inv[k];
+			t0 = std::max(t0, std::min(a, b));
+			t1 = std::min(t1, std::max(a, b));
+			if (t0 > t1) return false;
+		}
+		tEntry = t0;
+		return true;
+	}
+};
+
+#pragma region benchmark
+//scale and translate the box into [-0.5, 0.5]^3 as Lines::normalization
+inline glm::mat4 boxNormalization(const BVHBox &box)
+{
+	glm::vec3 extent = box.hi - box.lo;
+	float size = std::max(extent.x, std::max(extent.y, extent.z));
+	glm::mat4 m = glm::scale(glm::mat4(1.0f), glm::vec3(size > 0.0f ? 1.0f / size : 1.0f));
+	return glm::translate(m, -box.center());
+}
+
+//build time over thread counts, then per zoom level 'views' cameras looking at random vertices from random
+//directions: the share of chunks and vertices left after culling, the cull time and the picks at the screen
+//centers against the brute force; the first view of each zoom checks that no chunk with a vertex inside the
+//frustum was culled
+inline void benchmarkLineBVH(const LineSet &lines, int views, int repeats)
+{
+	LineBVH bvh;
+	cout << "BVH: " << lines.lineNum << " lines, " << lines.vertexNum << " vertices, chunks of " << BVH_CHUNK_VERTS << " vertices" << endl;
+	cout << "threads	build ms	Mchunks/s" << endl;
+	forEachThreadCount(threadNum(), [&](int t)
+	{
+		double best = 1e30;
+		for (int r = 0; r < repeats; ++r)
+		{
+			bvh.build(lines);
+			best = std::min(best, bvh.buildTime);
+		}
+		cout << t << "\t" << best << "\t" << bvh.chunkNum() / best / 1e3 << endl;
+	});
+	cout << bvh.chunkNum() << " chunks, " << bvh.nodeNum() << " internal nodes" << endl;
+	if (bvh.chunkNum() == 0 || views <= 0) return;
+
+	BVHBox bounds;
+	for (const BVHBox &b : bvh.lineBoxes()) bounds.grow(b);
+	glm::mat4 transform = boxNormalization(bounds);
+
+	mt19937 rng(7);
+	uniform_real_distribution<float> uni(-1.0f, 1.0f);
+	uniform_int_distribution<int> vertexDist(0, lines.vertexNum - 1);
+	vector<GLint> firsts;
+	vector<GLsizei> counts;
+	cout << "zoom	chunks %	vertices %	draws	cull ms	pick ms	brute pick ms	pick hits	pick mismatches	missed chunks" << endl;
+	for (int zoom = 1; zoom <= 16; zoom *= 2)
+	{
+		double chunkShare = 0.0, vertexShare = 0.0, draws = 0.0, cullMs = 0.0, pickMs = 0.0, bruteMs = 0.0;
+		int hits = 0, mismatches = 0, missed = 0;
+		for (int v = 0; v < views; ++v)
+		{
+			glm::vec3 target = glm::vec3(transform * glm::vec4(lines.positions[vertexDist(rng)], 1.0f));
+			glm::vec3 dir(uni(rng), uni(rng), uni(rng));
+			dir = glm::length(dir) > 1e-3f ? glm::normalize(dir) : glm::vec3(0.0f, 0.0f, 1.0f);
+			glm::vec3 up = std::abs(dir.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+
+			RenderParams params;
+			glm::mat4 projection = glm::perspective(glm::radians(45.0f / zoom), (float)params.width / (float)params.height, 0.001f, params.farPlane);
+			params.modelViewProjectionMatrix = projection * glm::lookAt(target + dir * 1.5f, target, up);
+			params.transform = transform;
+			params.viewDirection = -dir;
+
+			bvh.cull(params, firsts, counts);
+			cullMs += bvh.cullTime;
+			chunkShare += (double)bvh.visibleChunks / bvh.chunkNum();
+			vertexShare += (double)bvh.visibleVertices / lines.vertexNum;
+			draws += (double)firsts.size();
+
+			PickRay ray = makePickRay(params, params.width * 0.5f, params.height * 0.5f, 3.0f);
+			auto t0 = chrono::steady_clock::now();
+			PickResult picked = bvh.pick(lines, ray);
+			auto t1 = chrono::steady_clock::now();
+			PickResult reference = pickBruteForce(lines, ray);
+			auto t2 = chrono::steady_clock::now();
+			pickMs += chrono::duration<double, milli>(t1 - t0).count();
+			bruteMs += chrono::duration<double, milli>(t2 - t1).count();
+			hits += picked.line >= 0 ? 1 : 0;
+			if (picked.line != reference.line && (picked.line < 0 || reference.line < 0 || picked.t != reference.t)) ++mismatches;
+
+			if (v == 0)
+			{
+				glm::mat4 m = params.modelViewProjectionMatrix * params.transform;
+				std::atomic<int> missedChunks(0);
+				const vector<LineChunk> &chunks = bvh.chunks();
+				parallelFor(0, bvh.chunkNum(), [&](int c)
+				{
+					if (bvh.chunkVisible(c)) return;
+					for (int i = chunks[c].first; i < chunks[c].first + chunks[c].count; ++i)
+					{
+						glm::vec4 p = m * glm::vec4(lines.positions[i], 1.0f);
+						if (std::abs(p.x) <= p.w && std::abs(p.y) <= p.w && std::abs(p.z) <= p.w)
+						{
+							++missedChunks;
+							return;
+						}
+					}
+				});
+				missed += missedChunks;
+			}
+		}
+		cout << zoom << "\t" << 100.0 * chunkShare / views << "\t" << 100.0 * vertexShare / views << "\t" << draws / views << "\t"
+			<< cullMs / views << "\t" << pickMs / views << "\t" << bruteMs / views << "\t" << hits << "/" << views << "\t"
+			<< mismatches << "\t" << missed << endl;
+	}
+}
+#pragma endregion
+
+#endif // !LINEBVH_H
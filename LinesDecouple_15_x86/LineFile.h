@@ -0,0 +1,221 @@
+#ifndef LINEFILE_H
+#define LINEFILE_H
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+
+#include "commonVars.h"
+#include "SegmentDistribution.h"
+
+//binary polyline container(.lbin)
+//all blocks are stored flat so that the file can be mapped and used as it is:
+//	LineFileHeader
+//	vec3     positions[vertexNum]
+//	uint32_t lineIds[vertexNum]
+//	float    weights[vertexNum]		(blending weights for header.segmentNum)
+//	uint32_t lineOffsets[lineNum + 1]	(first vertex of each line)
+//	float    lineLengths[lineNum]
+//	int32_t  lineSegNums[lineNum]		(segments distributed for header.segmentNum)
+//version 1 stored interleaved 20-byte vertices instead of the three vertex blocks
+
+const char LINE_FILE_MAGIC[4] = { 'L', 'B', 'I', 'N' };
+const uint32_t LINE_FILE_VERSION = 2;
+const uint64_t LINE_FILE_ALIGNMENT = 64;
+
+struct LineFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t lineNum;
+	uint32_t segmentNum;
+	uint64_t vertexNum;
+
+	//byte offsets of the blocks from the beginning of the file
+	uint64_t positionsOffset;
+	uint64_t lineIdsOffset;
+	uint64_t weightsOffset;
+	uint64_t lineOffsetsOffset;
+	uint64_t lineLengthsOffset;
+	uint64_t lineSegNumsOffset;
+	uint64_t fileSize;
+};
+
+inline uint64_t alignLineFileOffset(uint64_t offset)
+{
+	return (offset + LINE_FILE_ALIGNMENT - 1) / LINE_FILE_ALIGNMENT * LINE_FILE_ALIGNMENT;
+}
+
+//fill the block offsets of a header whose counts are already set
+inline void layoutLineFile(LineFileHeader &header)
+{
+	uint64_t offset = alignLineFileOffset(sizeof(LineFileHeader));
+	header.positionsOffset = offset;
+	offset = alignLineFileOffset(offset + header.vertexNum * 3 * sizeof(float));
+	header.lineIdsOffset = offset;
+	offset = alignLineFileOffset(offset + header.vertexNum * sizeof(uint32_t));
+	header.weightsOffset = offset;
+	offset = alignLineFileOffset(offset + header.vertexNum * sizeof(float));
+	header.lineOffsetsOffset = offset;
+	offset = alignLineFileOffset(offset + (uint64_t(header.lineNum) + 1) * sizeof(uint32_t));
+	header.lineLengthsOffset = offset;
+	offset = alignLineFileOffset(offset + uint64_t(header.lineNum) * sizeof(float));
+	header.lineSegNumsOffset = offset;
+	header.fileSize = offset + uint64_t(header.lineNum) * sizeof(int32_t);
+}
+
+inline bool isLineFile(const string &path)
+{
+	ifstream fileIn(path, ios::binary);
+	char magic[4] = { 0 };
+	fileIn.read(magic, sizeof(magic));
+	return fileIn.good() && memcmp(magic, LINE_FILE_MAGIC, sizeof(magic)) == 0;
+}
+
+//read-only file mapping
+//copyOnWrite maps the pages privately, so they can be patched in memory without touching the file
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile() { close(); }
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	bool open(const string &path, bool copyOnWrite = false)
+	{
+		close();
+#ifdef _WIN32
+		file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file_ == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER sz;
+		if (!GetFileSizeEx(file_, &sz)) { close(); return false; }
+		size_ = (size_t)sz.QuadPart;
+		mapping_ = CreateFileMappingA(file_, NULL, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+		if (mapping_ == NULL) { close(); return false; }
+		data_ = (char *)MapViewOfFile(mapping_, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+#else
+		fd_ = ::open(path.c_str(), O_RDONLY);
+		if (fd_ < 0) return false;
+		struct stat st;
+		if (fstat(fd_, &st) != 0) { close(); return false; }
+		size_ = (size_t)st.st_size;
+		void *p = mmap(nullptr, size_, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd_, 0);
+		data_ = p == MAP_FAILED ? nullptr : (char *)p;
+		if (data_ != nullptr) madvise(data_, size_, MADV_WILLNEED);
+#endif
+		if (data_ == nullptr) { close(); return false; }
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (data_ != nullptr) UnmapViewOfFile(data_);
+		if (mapping_ != NULL) CloseHandle(mapping_);
+		if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+		mapping_ = NULL;
+		file_ = INVALID_HANDLE_VALUE;
+#else
+		if (data_ != nullptr) munmap(data_, size_);
+		if (fd_ >= 0) ::close(fd_);
+		fd_ = -1;
+#endif
+		data_ = nullptr;
+		size_ = 0;
+	}
+
+	bool isOpen() const { return data_ != nullptr; }
+	char *data() const { return data_; }
+	size_t size() const { return size_; }
+
+private:
+	char *data_ = nullptr;
+	size_t size_ = 0;
+#ifdef _WIN32
+	HANDLE file_ = INVALID_HANDLE_VALUE;
+	HANDLE mapping_ = NULL;
+#else
+	int fd_ = -1;
+#endif
+};
+
+//check a mapped file against the header it claims to have
+inline bool validateLineFile(const MappedFile &file, string &error)
+{
+	if (file.size() < sizeof(LineFileHeader)) { error = "file too small"; return false; }
+
+	const LineFileHeader &header = *(const LineFileHeader *)file.data();
+	if (memcmp(header.magic, LINE_FILE_MAGIC, sizeof(header.magic)) != 0) { error = "bad magic"; return false; }
+	if (header.version != LINE_FILE_VERSION) { error = "unsupported version " + to_string(header.version) + ", please convert again"; return false; }
+	//the counts are used as int, checked before the layout so that it cannot overflow
+	if (header.vertexNum > INT_MAX || header.lineNum >= INT_MAX || header.segmentNum > INT_MAX)
+	{
+		error = "counts out of range";
+		return false;
+	}
+
+	LineFileHeader expected = header;
+	layoutLineFile(expected);
+	if (memcmp(&expected, &header, sizeof(header)) != 0 || header.fileSize > file.size())
+	{
+		error = "corrupt block table";
+		return false;
+	}
+
+	int lineNum = (int)header.lineNum;
+	int vertexNum = (int)header.vertexNum;
+	if ((long long)header.segmentNum < 2LL * lineNum)
+	{
+		error = "segmentNum " + to_string(header.segmentNum) + " below 2 per line";
+		return false;
+	}
+
+	//the lines are used without further checks, so their offsets and ids have to be consistent
+	const uint32_t *lineOffsets = (const uint32_t *)(file.data() + header.lineOffsetsOffset);
+	if (lineOffsets[0] != 0 || lineOffsets[lineNum] != (uint32_t)vertexNum)
+	{
+		error = "line offsets do not cover the vertices";
+		return false;
+	}
+	for (int i = 0; i < lineNum; ++i)
+	{
+		if (lineOffsets[i] > lineOffsets[i + 1])
+		{
+			error = "line offsets not monotonic at line " + to_string(i);
+			return false;
+		}
+	}
+	const uint32_t *lineIds = (const uint32_t *)(file.data() + header.lineIdsOffset);
+	for (int v = 0; v < vertexNum; ++v)
+	{
+		if (lineIds[v] >= (uint32_t)lineNum)
+		{
+			error = "line id " + to_string(lineIds[v]) + " out of range at vertex " + to_string(v);
+			return false;
+		}
+	}
+
+	const int32_t *segNums = (const int32_t *)(file.data() + header.lineSegNumsOffset);
+	string segError;
+	if (!validateSegmentDistribution(segNums, lineNum, (int)header.segmentNum, segError))
+	{
+		error = "bad segment distribution, " + segError;
+		return false;
+	}
+	return true;
+}
+
+#endif // !LINEFILE_H
@@ -0,0 +1,213 @@
+#ifndef LINELOD_H
+#define LINELOD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cfloat>
+#include <chrono>
+
+#include "commonVars.h"
+#include "LineBVH.h"
+#include "LineStorage.h"
+#include "Parallel.h"
+#include "RenderParams.h"
+
+//level-of-detail hierarchy of the lines by Douglas-Peucker simplification, one line per task:
+//	every vertex gets the tolerance below which Douglas-Peucker keeps it, its distance to the chord of the range
+//	it splits clamped by the tolerance of the vertex that split the range above, so the levels nest
+//	level k > 0 keeps the end points and the vertices above tolerance(k), doubling from level to level
+//	the kept vertices carry their original blending weights: along a simplified segment the weight still runs
+//	between the weights of original vertices, the segment ids along the line stay in order and in place up to
+//	the tolerance
+//select() gives every line the coarsest level whose tolerance covers at most maxPixelError pixels where the
+//line's box comes closest to the camera
+
+const int LOD_LEVELS = 7;//level 0 is the full line
+const float LOD_BASE_TOLERANCE = 1.0f / 8192.0f;//tolerance(1) relative to the largest extent of the data
+
+class LineLOD
+{
+public:
+	double buildTime = 0.0;//ms of the last build()
+	double selectTime = 0.0;//ms of the last select()
+
+	float tolerance(int level) const { return level == 0 ? 0.0f : baseTolerance_ * (float)(1 << (level - 1)); }
+
+	//the vertices of the levels above 0, one block per level in the layout of the VBO
+	int vertexNum() const { return (int)positions_.size(); }
+	const vector<glm::vec3> &positions() const { return positions_; }
+	const vector<GLuint> &lineIds() const { return lineIds_; }
+	const vector<GLfloat> &weights() const { return weights_; }
+
+	//the vertices of line at level > 0 in the arrays above
+	int levelBegin(int level, int line) const { return offsets_[level][line]; }
+	int levelSize(int level, int line) const { return offsets_[level][line + 1] - offsets_[level][line]; }
+	int levelVertexNum(int level) const { return offsets_[level].back() - offsets_[level].front(); }
+	//the levels above 0 as one LineSet over the arrays above, line (level - 1) * lineNum + line
+	const LineSet &levelLines() const { return levelLines_; }
+
+	void build(const LineSet &lines)
+	{
+		auto t0 = chrono::steady_clock::now();
+		int threads = threadNum();
+		vector<glm::vec3> lo(threads, glm::vec3(1e30f)), hi(threads, glm::vec3(-1e30f));
+		parallelBlocks(lines.vertexNum, [&](int t, int begin, int end)
+		{
+			for (int v = begin; v < end; ++v)
+			{
+				lo[t] = glm::min(lo[t], lines.positions[v]);
+				hi[t] = glm::max(hi[t], lines.positions[v]);
+			}
+		});
+		glm::vec3 bmin(1e30f), bmax(-1e30f);
+		for (int t = 0; t < threads; ++t)
+		{
+			bmin = glm::min(bmin, lo[t]);
+			bmax = glm::max(bmax, hi[t]);
+		}
+		glm::vec3 extent = lines.vertexNum > 0 ? bmax - bmin : glm::vec3(0.0f);
+		baseTolerance_ = LOD_BASE_TOLERANCE * std::max(extent.x, std::max(extent.y, extent.z));
+
+		vertexTolerance_.resize(lines.vertexNum);
+		parallelFor(0, lines.lineNum, [&](int l) { simplifyLine(lines, l); }, 64);
+
+		int lineNum = lines.lineNum;
+		int base = 0;
+		for (int level = 1; level < LOD_LEVELS; ++level)
+		{
+			vector<int> &offsets = offsets_[level];
+			offsets.resize(lineNum + 1);
+			float tol = tolerance(level);
+			parallelFor(0, lineNum, [&](int l)
+			{
+				int cnt = 0;
+				for (int v = lines.lineBegin(l); v < lines.lineEnd(l); ++v) cnt += vertexTolerance_[v] > tol ? 1 : 0;
+				offsets[l] = cnt;
+			});
+			parallelExclusiveScan(offsets.data(), offsets.data(), lineNum);
+			parallelFor(0, lineNum + 1, [&](int l) { offsets[l] += base; });
+			base = offsets[lineNum];
+		}
+
+		positions_.resize(base);
+		lineIds_.resize(base);
+		weights_.resize(base);
+		for (int level = 1; level < LOD_LEVELS; ++level)
+		{
+			float tol = tolerance(level);
+			parallelFor(0, lineNum, [&](int l)
+			{
+				int out = offsets_[level][l];
+				for (int v = lines.lineBegin(l); v < lines.lineEnd(l); ++v)
+				{
+					if (vertexTolerance_[v] <= tol) continue;
+					positions_[out] = lines.positions[v];
+					lineIds_[out] = lines.lineIds[v];
+					weights_[out] = lines.weights[v];
+					++out;
+				}
+			});
+		}
+
+		levelOffsets_.resize((size_t)(LOD_LEVELS - 1) * lineNum + 1);
+		for (int level = 1; level < LOD_LEVELS; ++level)
+			std::copy(offsets_[level].begin(), offsets_[level].end() - 1, levelOffsets_.begin() + (size_t)(level - 1) * lineNum);
+		levelOffsets_.back() = base;
+		levelLines_.lineNum = (LOD_LEVELS - 1) * lineNum;
+		levelLines_.vertexNum = base;
+		levelLines_.positions = positions_.data();
+		levelLines_.lineIds = lineIds_.data();
+		levelLines_.weights = weights_.data();
+		levelLines_.lineOffsets = levelOffsets_.data();
+		buildTime = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+	}
+
+	//levels: per line for the view of params; lineBoxes: the data space boxes of the lines(LineBVH::lineBoxes)
+	//a line with a box corner behind the camera keeps level 0
+	void select(const RenderParams &params, const vector<BVHBox> &lineBoxes, float maxPixelError, vector<unsigned char> &levels)
+	{
+		auto t0 = chrono::steady_clock::now();
+		glm::mat4 m = params.modelViewProjectionMatrix * params.transform;
+		//pixels per data unit of x_clip and y_clip, divided by w_clip below
+		float scaleX = 0.5f * params.width * glm::length(glm::vec3(m[0][0], m[1][0], m[2][0]));
+		float scaleY = 0.5f * params.height * glm::length(glm::vec3(m[0][1], m[1][1], m[2][1]));
+		float scaleW = glm::length(glm::vec3(m[0][3], m[1][3], m[2][3]));
+		int lineNum = (int)lineBoxes.size();
+		levels.resize(lineNum);
+		parallelFor(0, lineNum, [&](int l)
+		{
+			const BVHBox &box = lineBoxes[l];
+			float wMin = FLT_MAX, ndcMax = 0.0f;
+			for (int c = 0; c < 8; ++c)
+			{
+				glm::vec3 corner((c & 1) ? box.hi.x : box.lo.x, (c & 2) ? box.hi.y : box.lo.y, (c & 4) ? box.hi.z : box.lo.z);
+				glm::vec4 p = m * glm::vec4(corner, 1.0f);
+				wMin = std::min(wMin, p.w);
+				if (p.w > 0.0f) ndcMax = std::max(ndcMax, std::max(std::abs(p.x), std::abs(p.y)) / p.w);
+			}
+			if (wMin <= 0.0f)
+			{
+				levels[l] = 0;
+				return;
+			}
+			//d(x / w) = dx / w - (x / w) * dw / w, the part on the screen has |x / w| <= 1
+			float pixelsPerUnit = (std::max(scaleX, scaleY) + 0.5f * std::max(params.width, params.height) * std::min(ndcMax, 1.0f) * scaleW) / wMin;
+			int level = 0;
+			while (level + 1 < LOD_LEVELS && tolerance(level + 1) * pixelsPerUnit <= maxPixelError) ++level;
+			levels[l] = (unsigned char)level;
+		}, 4096);
+		selectTime = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+	}
+
+private:
+	float baseTolerance_ = 0.0f;
+	vector<float> vertexTolerance_;//per vertex of the LineSet
+	vector<int> offsets_[LOD_LEVELS];//levels above 0: lineNum + 1 entries into the vertex arrays
+	vector<glm::vec3> positions_;
+	vector<GLuint> lineIds_;
+	vector<GLfloat> weights_;
+	vector<GLuint> levelOffsets_;
+	LineSet levelLines_;
+
+	static float segmentDistance(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b)
+	{
+		glm::vec3 ab = b - a;
+		float len2 = glm::dot(ab, ab);
+		float t = len2 > 0.0f ? glm::clamp(glm::dot(p - a, ab) / len2, 0.0f, 1.0f) : 0.0f;
+		return glm::length(p - (a + ab * t));
+	}
+
+	//Douglas-Peucker with an explicit stack of (first, last, tolerance of the split above)
+	void simplifyLine(const LineSet &lines, int l)
+	{
+		int begin = lines.lineBegin(l), end = lines.lineEnd(l);
+		if (end <= begin) return;
+		vertexTolerance_[begin] = vertexTolerance_[end - 1] = FLT_MAX;
+		struct Range { int first, last; float tol; };
+		vector<Range> stack(1, Range{ begin, end - 1, FLT_MAX });
+		while (!stack.empty())
+		{
+			Range r = stack.back();
+			stack.pop_back();
+			if (r.last - r.first < 2) continue;
+			int split = r.first + 1;
+			float dist = -1.0f;
+			for (int v = r.first + 1; v < r.last; ++v)
+			{
+				float d = segmentDistance(lines.positions[v], lines.positions[r.first], lines.positions[r.last]);
+				if (d > dist)
+				{
+					dist = d;
+					split = v;
+				}
+			}
+			float tol = std::min(dist, r.tol);
+			vertexTolerance_[split] = tol;
+			stack.push_back(Range{ r.first, split, tol });
+			stack.push_back(Range{ split, r.last, tol });
+		}
+	}
+};
+
+#endif // !LINELOD_H
@@ -0,0 +1,255 @@
+#ifndef LINESMOOTHING_H
+#define LINESMOOTHING_H
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+
+#include "commonVars.h"
+#include "Parallel.h"
+
+//smoothing of the solved opacities along every line: the nodes x of a line with solved opacities alpha minimize
+//	sum_i (x_i - alpha_i)^2 + s * sum_i (x_(i+1) - x_i)^2
+//that is (I + s * L) x = alpha with the path Laplacian L of the line, a symmetric tridiagonal system per line:
+//	b_i = 1 + s * (number of neighbours of node i), a_i = c_(i-1) = -s
+//the lines are sorted by node count and packed SMOOTH_LANES to a batch, the Thomas algorithm runs on the whole
+//batch at once with one line per SIMD lane; rows past the end of a shorter line are identity rows(b = 1, a = c = 0)
+
+const int SMOOTH_LANES = 8;
+
+#pragma region kernels
+//Thomas algorithm on one line in place
+inline void smoothLineScalar(float *x, int n, float s, float *cp)
+{
+	if (n < 2) return;
+	float b = 1.0f + s;
+	cp[0] = -s / b;
+	x[0] /= b;
+	for (int i = 1; i < n; ++i)
+	{
+		b = (i < n - 1 ? 1.0f + 2.0f * s : 1.0f + s) + s * cp[i - 1];
+		cp[i] = -s / b;
+		x[i] = (x[i] + s * x[i - 1]) / b;
+	}
+	for (int i = n - 2; i >= 0; --i) x[i] -= cp[i] * x[i + 1];
+}
+
+//Thomas algorithm on an interleaved batch: d[i * SMOOTH_LANES + lane] is node i of the lane's line, solved in place
+inline void smoothBatchScalar(float *d, const int *lens, int m, float s, float *cp)
+{
+	for (int lane = 0; lane < SMOOTH_LANES; ++lane)
+	{
+		float prevC = 0.0f, prevD = 0.0f;
+		for (int i = 0; i < m; ++i)
+		{
+			bool in = i < lens[lane], prev = in && i > 0, next = i + 1 < lens[lane];
+			float a = prev ? -s : 0.0f, c = next ? -s : 0.0f;
+			float b = 1.0f + (prev ? s : 0.0f) + (next ? s : 0.0f) - a * prevC;
+			float &di = d[i * SMOOTH_LANES + lane];
+			prevC = cp[i * SMOOTH_LANES + lane] = c / b;
+			prevD = di = (di - a * prevD) / b;
+		}
+		for (int i = m - 2; i >= 0; --i)
+			d[i * SMOOTH_LANES + lane] -= cp[i * SMOOTH_LANES + lane] * d[(i + 1) * SMOOTH_LANES + lane];
+	}
+}
+
+#if defined(__AVX2__)
+inline void smoothBatchAvx2(float *d, const int *lens, int m, float s, float *cp)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 sv = _mm256_set1_ps(s);
+	const __m256 negS = _mm256_set1_ps(-s);
+	const __m256i len = _mm256_loadu_si256((const __m256i *)lens);
+	__m256 prevC = zero, prevD = zero;
+	for (int i = 0; i < m; ++i)
+	{
+		__m256 in = _mm256_castsi256_ps(_mm256_cmpgt_epi32(len, _mm256_set1_epi32(i)));
+		__m256 next = _mm256_castsi256_ps(_mm256_cmpgt_epi32(len, _mm256_set1_epi32(i + 1)));
+		__m256 prev = i > 0 ? in : zero;
+		__m256 a = _mm256_and_ps(prev, negS);
+		__m256 c = _mm256_and_ps(next, negS);
+		__m256 b = _mm256_add_ps(one, _mm256_add_ps(_mm256_and_ps(prev, sv), _mm256_and_ps(next, sv)));
+		b = _mm256_sub_ps(b, _mm256_mul_ps(a, prevC));
+		__m256 inv = _mm256_div_ps(one, b);
+		prevC = _mm256_mul_ps(c, inv);
+		prevD = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(d + i * SMOOTH_LANES), _mm256_mul_ps(a, prevD)), inv);
+		_mm256_storeu_ps(cp + i * SMOOTH_LANES, prevC);
+		_mm256_storeu_ps(d + i * SMOOTH_LANES, prevD);
+	}
+	__m256 x = m > 0 ? _mm256_loadu_ps(d + (m - 1) * SMOOTH_LANES) : zero;
+	for (int i = m - 2; i >= 0; --i)
+	{
+		x = _mm256_sub_ps(_mm256_loadu_ps(d + i * SMOOTH_LANES), _mm256_mul_ps(_mm256_loadu_ps(cp + i * SMOOTH_LANES), x));
+		_mm256_storeu_ps(d + i * SMOOTH_LANES, x);
+	}
+}
+#endif
+
+inline void smoothBatchKernel(float *d, const int *lens, int m, float s, float *cp)
+{
+#if defined(__AVX2__)
+	smoothBatchAvx2(d, lens, m, s, cp);
+#else
+	smoothBatchScalar(d, lens, m, s, cp);
+#endif
+}
+#pragma endregion
+
+class LineSmoother
+{
+public:
+	bool useSimd = true;//false: one line at a time with smoothLineScalar
+	double smoothTime = 0.0;//ms of the last smooth()
+
+	//lineSegOffsets: the first node of every line, lineNum + 1 entries; the lines are sorted by node count
+	//(counting sort, descending so that the longest batches are handed out first) and packed into batches
+	void setLines(const int *lineSegOffsets, int lineNum)
+	{
+		lineSegOffsets_.assign(lineSegOffsets, lineSegOffsets + lineNum + 1);
+		int maxLen = 0;
+		for (int l = 0; l < lineNum; ++l) maxLen = std::max(maxLen, lineSize(l));
+		vector<int> starts(maxLen + 2, 0);
+		for (int l = 0; l < lineNum; ++l) ++starts[maxLen - lineSize(l) + 1];
+		for (int n = 0; n <= maxLen; ++n) starts[n + 1] += starts[n];
+		order_.assign(lineNum, 0);
+		for (int l = 0; l < lineNum; ++l) order_[starts[maxLen - lineSize(l)]++] = l;
+
+		//lines of one node or none need no smoothing
+		while (!order_.empty() && lineSize(order_.back()) < 2) order_.pop_back();
+		maxNodes_ = maxLen;
+	}
+
+	int lineNum() const { return (int)lineSegOffsets_.size() - 1; }
+	int batchNum() const { return ((int)order_.size() + SMOOTH_LANES - 1) / SMOOTH_LANES; }
+
+	//in place, s <= 0 leaves the opacities as they are
+	void smooth(float *opacity, float s)
+	{
+		auto t0 = chrono::steady_clock::now();
+		if (s > 0.0f && !order_.empty())
+		{
+			if (useSimd) smoothBatches(opacity, s);
+			else smoothLines(opacity, s);
+		}
+		smoothTime = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+	}
+
+private:
+	vector<int> lineSegOffsets_;
+	vector<int> order_;//lines with at least 2 nodes, longest first
+	int maxNodes_ = 0;
+
+	int lineSize(int l) const { return lineSegOffsets_[l + 1] - lineSegOffsets_[l]; }
+
+	void smoothLines(float *opacity, float s)
+	{
+		vector<vector<float>> scratch(threadNum(), vector<float>(maxNodes_));
+		parallelBlocks((int)order_.size(), [&](int t, int begin, int end)
+		{
+			for (int k = begin; k < end; ++k)
+			{
+				int l = order_[k];
+				smoothLineScalar(opacity + lineSegOffsets_[l], lineSize(l), s, &scratch[t][0]);
+			}
+		});
+	}
+
+	//batches on demand(the longest first), gathered into interleaved scratch, solved and scattered back
+	void smoothBatches(float *opacity, float s)
+	{
+		int batches = batchNum();
+		std::atomic<int> next(0);
+		const int GRAIN = 16;
+		parallelRun(std::min(threadNum(), (batches + GRAIN - 1) / GRAIN), [&](int)
+		{
+			vector<float> d(maxNodes_ * SMOOTH_LANES), cp(maxNodes_ * SMOOTH_LANES);
+			for (;;)
+			{
+				int first = next.fetch_add(GRAIN);
+				if (first >= batches) break;
+				for (int batch = first; batch < std::min(first + GRAIN, batches); ++batch)
+				{
+					int lens[SMOOTH_LANES], offsets[SMOOTH_LANES];
+					for (int lane = 0; lane < SMOOTH_LANES; ++lane)
+					{
+						int k = batch * SMOOTH_LANES + lane;
+						int l = k < (int)order_.size() ? order_[k] : -1;
+						lens[lane] = l >= 0 ? lineSize(l) : 0;
+						offsets[lane] = l >= 0 ? lineSegOffsets_[l] : 0;
+					}
+					int m = lens[0];//sorted, the first lane is the longest
+					for (int i = 0; i < m; ++i)
+						for (int lane = 0; lane < SMOOTH_LANES; ++lane)
+							d[i * SMOOTH_LANES + lane] = i < lens[lane] ? opacity[offsets[lane] + i] : 0.0f;
+					smoothBatchKernel(&d[0], lens, m, s, &cp[0]);
+					for (int lane = 0; lane < SMOOTH_LANES; ++lane)
+						for (int i = 0; i < lens[lane]; ++i)
+							opacity[offsets[lane] + i] = d[i * SMOOTH_LANES + lane];
+				}
+			}
+		});
+	}
+};
+
+#pragma region benchmark
+//line-by-line Thomas against the batches over thread counts on 'alpha', with the largest residual of
+//(I + s * L) x = alpha and the largest difference between the two; accumulateMs: the time to compare with
+inline void benchmarkLineSmoothing(const int *lineSegOffsets, int lineNum, const vector<float> &alpha, float s, int repeats, double accumulateMs)
+{
+	LineSmoother smoother;
+	smoother.setLines(lineSegOffsets, lineNum);
+	vector<float> x[2] = { alpha, alpha };
+	for (int k = 0; k < 2; ++k)
+	{
+		smoother.useSimd = k == 1;
+		smoother.smooth(&x[k][0], s);
+	}
+
+	float maxResidual = 0.0f, maxDiff = 0.0f;
+	for (int l = 0; l < lineNum; ++l)
+	{
+		int b = lineSegOffsets[l], e = lineSegOffsets[l + 1];
+		for (int i = b; i < e; ++i)
+		{
+			float ax = x[1][i];
+			if (i > b) ax += s * (x[1][i] - x[1][i - 1]);
+			if (i + 1 < e) ax += s * (x[1][i] - x[1][i + 1]);
+			maxResidual = std::max(maxResidual, std::abs(ax - alpha[i]));
+			maxDiff = std::max(maxDiff, std::abs(x[0][i] - x[1][i]));
+		}
+	}
+
+#if defined(__AVX2__)
+	cout << "line smoothing: " << lineNum << " lines, " << alpha.size() << " nodes, " << smoother.batchNum() << " AVX2 batches of "
+		<< SMOOTH_LANES << ", s " << s << endl;
+#else
+	cout << "line smoothing: " << lineNum << " lines, " << alpha.size() << " nodes, " << smoother.batchNum() << " scalar batches of "
+		<< SMOOTH_LANES << ", s " << s << endl;
+#endif
+	cout << "max residual " << maxResidual << ", max lines/batches difference " << maxDiff << endl;
+	cout << "threads	lines ms	batches ms	batches / accumulate" << endl;
+
+	forEachThreadCount(threadNum(), [&](int t)
+	{
+		double best[2] = { 1e30, 1e30 };
+		for (int k = 0; k < 2; ++k)
+		{
+			smoother.useSimd = k == 1;
+			for (int r = 0; r < repeats; ++r)
+			{
+				x[k] = alpha;
+				smoother.smooth(&x[k][0], s);
+				best[k] = std::min(best[k], smoother.smoothTime);
+			}
+		}
+		cout << t << "\t" << best[0] << "\t" << best[1] << "\t" << best[1] / accumulateMs << endl;
+	});
+}
+#pragma endregion
+
+#endif // !LINESMOOTHING_H
@@ -0,0 +1,138 @@
+#ifndef LINESTORAGE_H
+#define LINESTORAGE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "commonVars.h"
+
+//bump allocator: allocations are never freed one by one, the whole arena is released at once
+class Arena
+{
+public:
+	static const size_t ALIGNMENT = 64;
+
+	explicit Arena(size_t blockSize = size_t(64) << 20) : blockSize_(blockSize) {}
+	~Arena() { clear(); }
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+
+	template <typename T>
+	T *alloc(size_t n)
+	{
+		return (T *)allocBytes(n * sizeof(T));
+	}
+
+	void *allocBytes(size_t bytes)
+	{
+		bytes = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		if (blocks_.empty() || used_ + bytes > blocks_.back().second)
+		{
+			//large requests get a block of their own
+			size_t sz = std::max(bytes, blockSize_);
+			char *block = (char *)alignedAlloc(sz);
+			if (block == nullptr) return nullptr;
+			blocks_.push_back(make_pair(block, sz));
+			used_ = 0;
+		}
+		void *p = blocks_.back().first + used_;
+		used_ += bytes;
+		return p;
+	}
+
+	void clear()
+	{
+		for (auto &b : blocks_) alignedFree(b.first);
+		blocks_.clear();
+		used_ = 0;
+	}
+
+private:
+	size_t blockSize_;
+	size_t used_ = 0;
+	vector< pair<char *, size_t> > blocks_;
+
+	static void *alignedAlloc(size_t bytes)
+	{
+#ifdef _WIN32
+		return _aligned_malloc(bytes, ALIGNMENT);
+#else
+		return aligned_alloc(ALIGNMENT, bytes);
+#endif
+	}
+
+	static void alignedFree(void *p)
+	{
+#ifdef _WIN32
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+};
+
+//structure-of-arrays lines in CSR form: line i owns the vertices [lineOffsets[i], lineOffsets[i + 1])
+//the arrays either live in an Arena or point into a mapped line file
+struct LineSet
+{
+	int lineNum = 0;
+	int vertexNum = 0;
+	int firstLine = 0;//lineIds of a part(linePart()) stay those of the whole set
+
+	glm::vec3 *positions = nullptr;
+	GLuint *lineIds = nullptr;
+	GLfloat *weights = nullptr;//blending weight: segment id + fraction
+	GLuint *lineOffsets = nullptr;//lineNum + 1 entries
+
+	void allocate(Arena &arena, int lines, int vertices)
+	{
+		lineNum = lines;
+		vertexNum = vertices;
+		positions = arena.alloc<glm::vec3>(vertices);
+		lineIds = arena.alloc<GLuint>(vertices);
+		weights = arena.alloc<GLfloat>(vertices);
+		lineOffsets = arena.alloc<GLuint>(lines + 1);
+	}
+
+	int lineBegin(int i) const { return (int)lineOffsets[i]; }
+	int lineEnd(int i) const { return (int)lineOffsets[i + 1]; }
+	int lineSize(int i) const { return (int)(lineOffsets[i + 1] - lineOffsets[i]); }
+
+	//lines [first, first + count) sharing the arrays of this set; their vertices keep their indices
+	LineSet linePart(int first, int count) const
+	{
+		LineSet part = *this;
+		part.lineNum = count;
+		part.firstLine = firstLine + first;
+		part.lineOffsets = lineOffsets + first;
+		return part;
+	}
+};
+
+//random-walk streamlines as makeSyntheticObj, straight into a LineSet(weights zero), for benchmarks too large for OBJ text
+inline void makeSyntheticLineSet(Arena &arena, LineSet &lines, int lineNum, int vertsPerLine, unsigned int seed = 1)
+{
+	lines.allocate(arena, lineNum, lineNum * vertsPerLine);
+	mt19937 rng(seed);
+	uniform_real_distribution<float> uni(-1.0f, 1.0f);
+	for (int i = 0; i < lineNum; ++i)
+	{
+		lines.lineOffsets[i] = (GLuint)(i * vertsPerLine);
+		glm::vec3 p(uni(rng), uni(rng), uni(rng));
+		for (int j = 0; j < vertsPerLine; ++j)
+		{
+			p += glm::vec3(uni(rng), uni(rng), uni(rng)) * 0.01f;
+			int v = i * vertsPerLine + j;
+			lines.positions[v] = p;
+			lines.lineIds[v] = (GLuint)i;
+			lines.weights[v] = 0.0f;
+		}
+	}
+	lines.lineOffsets[lineNum] = (GLuint)(lineNum * vertsPerLine);
+}
+
+#endif // !LINESTORAGE_H
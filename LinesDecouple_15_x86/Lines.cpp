@@ -1,245 +1,326 @@
-#ifndef LINES_H
-#define LINES_H
+#include "Lines.h"
 
-#include <glad/glad.h> 
-
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include "Include/Shader.hpp"
-
-#include "commonVars.h"
-
-using namespace std;
-
-
-struct Vertex
-{
-	glm::vec3 Position_;
-	GLuint LineId_;
-	GLfloat Weight_;
-	Vertex(GLfloat x, GLfloat y, GLfloat z): Position_(glm::vec3(x, y, z)) {}
-};
-
-typedef vector<Vertex> LINE_TYPE;//a set of points
-typedef vector<unsigned int> INDEX_TYPE;//a set of indexes
-
-class Lines
+Lines::Lines(const std::string &path, int segPerLine, bool setupGL, LineGeometry geometry, VertexFormat format):
+	segPerLine_(segPerLine), path_(path), geometry_(geometry), format_(format)
 {
-public:
-	int segmentNum_ = 0;
-	int vertexNum_ = 0;
-
-	vector<LINE_TYPE> lines_;
-	vector<float> lineLengths_;
-	vector<int> lineSegNums_;
-	vector<int> segLineIds_;
-
-	GLuint VAO, VBO;//vertex array object, vertex buffer object
-	GLuint ABO;//atomic buffer object
-
-	GLuint TEX_HEADER;//head pointer texture
-	GLuint PBO_SET_HEAD;//pixel buffer object as a head pointer initializer
-
-	GLuint SBO_LIST;//fragment storage buffer object
-	GLuint TEX_LIST;//linked list texture
-
-	GLuint SBO_OPACITY;
-	GLuint TEX_OPACITY;
-
-	Lines(const std::string &path, int ctrlPntsNum);
-	void Render();
-private:
-	void loadModel(const string &path);
-	void setupModel();
-};
+	//a line is at least distributed into two segments
+	if (segPerLine_ < 2)
+	{
+		cout << "ERROR::LINES::SEGMENTS_PER_LINE " << segPerLine_ << " below 2" << endl;
+		loaded_ = false;
+		return;
+	}
+	loadModel(path);
+	if (setupGL && loaded_) setupModel();
+}
 
-Lines::Lines(const std::string &path, int segNum):
-	segmentNum_(segNum)
+Lines::~Lines()
 {
-	loadModel(path);
-	setupModel();
+	if (vboFence_ != 0) glDeleteSync(vboFence_);
+	if (!glReady_) return;
+
+	//names that were never created are 0 and ignored; deleting VBO also ends its persistent mapping
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteVertexArrays(1, &VAO_LOD);
+	glDeleteBuffers(1, &VBO_LOD);
+	deleteRibbonBuffers(ribbons_);
+	deleteRibbonBuffers(lodRibbons_);
+	glDeleteBuffers(1, &SBO_QUANT_BLOCKS);
+	glDeleteTextures(1, &TEX_QUANT_BLOCKS);
+	glDeleteBuffers(1, &SBO_LOD_QUANT_BLOCKS);
+	glDeleteTextures(1, &TEX_LOD_QUANT_BLOCKS);
+	glDeleteBuffers(1, &ABO);
+
+	glDeleteTextures(1, &TEX_HEADER);
+	glDeleteBuffers(1, &PBO_SET_HEAD);
+	glDeleteTextures(1, &TEX_LIST);
+	glDeleteTextures(1, &TEX_LIST_COMPACT);
+	glDeleteBuffers(1, &SBO_LIST);
+	glDeleteTextures(1, &TEX_OPACITY);
+	glDeleteBuffers(1, &SBO_OPACITY);
+
+	glDeleteBuffers(1, &SBO_COUNTS);
+	glDeleteBuffers(1, &SBO_OFFSETS);
+	glDeleteBuffers(1, &SBO_BLOCK_SUMS);
+
+	glDeleteFramebuffers(1, &FBO_MOMENTS);
+	glDeleteTextures(MOMENT_TEXTURES, TEX_MOMENTS);
+	glDeleteFramebuffers(1, &FBO_MOMENT_ACCUM);
+	glDeleteTextures(1, &TEX_MOMENT_ACCUM);
+	glDeleteBuffers(1, &SBO_IMPORTANCE);
+	glDeleteBuffers(1, &SBO_OCCLUSION);
 }
 
 void Lines::loadModel(const string &path)
 {
+	if (isLineFile(path))
+	{
+		loadBinary(path);
+		computeNormalization();
+		return;
+	}
+
 #pragma region read vertices and lines
-	vector<Vertex> vertices;
-	ifstream fileIn(path);
-	string lineBuf;
-	while (getline(fileIn, lineBuf))
+	ObjData obj;
+	if (!parseObjFile(path, obj))
 	{
-		stringstream ss(lineBuf);
-		string type;//v vt g l
-		getline(ss, type, ' ');
+		cout << "ERROR::LINES::CANNOT_OPEN " << path << endl;
+		loaded_ = false;
+		return;
+	}
 
-		if (type == "v")//a vertex
+	int lineNum = std::max((int)obj.lineStarts.size() - 1, 0);
+	int objVertNum = (int)obj.positions.size();
+
+	//count pass: the number of kept points per line(repeated points are skipped)
+	vector<GLuint> lineSizes(lineNum + 1, 0);
+	parallelFor(0, lineNum, [&](int lineId)
+	{
+		int begin = obj.lineStarts[lineId];
+		int end = obj.lineStarts[lineId + 1];
+		for (int k = begin; k < end; ++k)
+			if (obj.indices[k] < 0 || obj.indices[k] >= objVertNum) return;//broken record, keep the line empty
+		if (begin == end) return;
+
+		GLuint n = 1;
+		int lastId = obj.indices[begin];
+		for (int k = begin + 1; k < end; ++k)
 		{
-			float x[3];
-			ss >> x[0] >> x[1] >> x[2];
-			vertices.push_back(Vertex(x[0], x[1], x[2]));
+			int curId = obj.indices[k];
+			if (glm::length(obj.positions[lastId] - obj.positions[curId]) > EPS)
+			{
+				++n;
+				lastId = curId;
+			}
 		}
-		else if (type == "l")//a line
-		{
-			LINE_TYPE line;
-			int lineId = lines_.size();
-
-			int curId;
-			int lastId;
+		lineSizes[lineId] = n;
+	}, 256);
 
-			ss >> lastId;
-			vertices[lastId].LineId_ = lineId;
-			line.push_back(vertices[lastId]);
+	vector<GLuint> offsets(lineNum + 1);
+	parallelExclusiveScan(lineSizes.data(), offsets.data(), lineNum);
+	lines_.allocate(arena_, lineNum, (int)offsets[lineNum]);
+	memcpy(lines_.lineOffsets, &offsets[0], (lineNum + 1) * sizeof(GLuint));
 
-			float len;
-			while (ss >> curId)
+	//fill pass
+	parallelFor(0, lineNum, [&](int lineId)
+	{
+		if (lineSizes[lineId] == 0) return;
+		int begin = obj.lineStarts[lineId];
+		int end = obj.lineStarts[lineId + 1];
+		int out = lines_.lineBegin(lineId);
+
+		int lastId = obj.indices[begin];
+		lines_.positions[out] = obj.positions[lastId];
+		lines_.lineIds[out++] = lineId;
+		for (int k = begin + 1; k < end; ++k)
+		{
+			int curId = obj.indices[k];
+			if (glm::length(obj.positions[lastId] - obj.positions[curId]) > EPS)
 			{
-				ss >> curId;
-				len = glm::length(vertices[lastId].Position_ - vertices[curId].Position_);
-				if (len > EPS)
-				{
-					line.push_back(vertices[curId]);
-					lastId = curId;
-				}
+				lines_.positions[out] = obj.positions[curId];
+				lines_.lineIds[out++] = lineId;
+				lastId = curId;
 			}
-
-			lines_.push_back(line);
 		}
-
-	}
-	fileIn.close();
+	}, 256);
+	vertexNum_ = lines_.vertexNum;
 #pragma endregion
 
-#pragma region compute vertices number
-	vertexNum_ = 0;
-	for (auto itLines = lines_.begin(); itLines != lines_.end(); ++itLines)
+#pragma region compute line lengths
+	lineLengths_.resize(lineNum, 0.0f);
+	parallelFor(0, lineNum, [&](int i)
 	{
-		vertexNum_ += itLines->size();
-	}
+		float len = 0.0f;
+		for (int j = lines_.lineBegin(i) + 1; j < lines_.lineEnd(i); ++j)
+			len += glm::length(lines_.positions[j] - lines_.positions[j - 1]);
+		lineLengths_[i] = len;
+	}, 1024);
 #pragma endregion
 
-#pragma region compute line lengths, total length and points number
-	float totalLength = 0.0f;
-	int totalPointsNum = 0;
-	lineLengths_.resize(lines_.size(), 0.0f);
-	for (int i = 0; i < (int)lines_.size(); ++i)
-	{
-		LINE_TYPE &line = lines_[i];
-		float &len = lineLengths_[i];
-		len = 0.0f;
-		for (int j = 1; i < (int)line.size(); ++j)
-			len += glm::length(line[j].Position_ - line[j - 1].Position_);
-		totalLength += len;
-		totalPointsNum += line.size();
-	}
+#pragma region distribute segments with approximately equal lengths
+	segmentNum_ = segPerLine_ * lineNum;
+	distributeSegments();
 #pragma endregion
 
-#pragma region distribute segments with approximately equal lengths
-	assert(segmentNum_ * 2 > (int)lines_.size());//because a line is at least distributed into two segments
-	float avgLength = totalLength / totalPointsNum;
+	assignWeights();
+	computeSegLineIds();
+	computeNormalization();
+}
 
-	float leftLength = totalLength;
-	float leftSegmentNum = totalPointsNum;
+void Lines::loadBinary(const string &path)
+{
+	string error;
+	if (!lineFile_.open(path, true) || !validateLineFile(lineFile_, error))
+	{
+		cout << "ERROR::LINES::CANNOT_LOAD_BINARY " << path << " " << error << endl;
+		lineFile_.close();
+		loaded_ = false;
+		return;
+	}
 
-	//2 segments for those lines whose lengths are < avg length
-	set<int> lineIds;
-	for (int i = 0; i < (int)lines_.size(); ++i) lineIds.insert(i);
-	for (int i = 0; i < (int)lines_.size(); ++i)
+	const LineFileHeader &header = *(const LineFileHeader *)lineFile_.data();
+	char *base = lineFile_.data();
+	int lineNum = (int)header.lineNum;
+
+	//the vertex arrays are used straight from the mapping
+	lines_.lineNum = lineNum;
+	lines_.vertexNum = (int)header.vertexNum;
+	lines_.positions = (glm::vec3 *)(base + header.positionsOffset);
+	lines_.lineIds = (GLuint *)(base + header.lineIdsOffset);
+	lines_.weights = (GLfloat *)(base + header.weightsOffset);
+	lines_.lineOffsets = (GLuint *)(base + header.lineOffsetsOffset);
+	vertexNum_ = lines_.vertexNum;
+
+	const float *lengths = (const float *)(base + header.lineLengthsOffset);
+	const int32_t *segNums = (const int32_t *)(base + header.lineSegNumsOffset);
+	lineLengths_.assign(lengths, lengths + lineNum);
+
+	segmentNum_ = segPerLine_ * lineNum;
+	if ((int)header.segmentNum == segmentNum_)
 	{
-		float &len = lineLengths_[i];
-		if (len < avgLength)
-		{
-			lineIds.erase(i);
-			lineSegNums_[i] = 2;
-			leftSegmentNum -= 2;
-			leftLength -= len;
-		}
+		//weights in the file are valid for this segment number
+		lineSegNums_.assign(segNums, segNums + lineNum);
+		lineSegOffsets_.resize(lineNum + 1);
+		parallelExclusiveScan(lineSegNums_.data(), lineSegOffsets_.data(), lineNum);
+	}
+	else
+	{
+		//redistribute and patch the weights in the private mapping
+		distributeSegments();
+		assignWeights();
 	}
 
-	//now distribute the remaining lengths
-	set< pair<float, int> > lineLeftLengths;
-	if (leftSegmentNum > 0)
+	computeSegLineIds();
+}
+
+void Lines::saveBinary(const string &path) const
+{
+	int lineNum = lines_.lineNum;
+
+	LineFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, LINE_FILE_MAGIC, sizeof(header.magic));
+	header.version = LINE_FILE_VERSION;
+	header.lineNum = lineNum;
+	header.vertexNum = lines_.vertexNum;
+	header.segmentNum = segmentNum_;
+	layoutLineFile(header);
+
+	ofstream fileOut(path, ios::binary);
+	auto writeBlock = [&fileOut](uint64_t offset, const void *data, uint64_t bytes)
 	{
-		for (auto it = lineIds.begin(); it != lineIds.end(); ++it)
-		{
-			int i = *it;
+		static const char zeros[LINE_FILE_ALIGNMENT] = { 0 };
+		uint64_t cur = (uint64_t)fileOut.tellp();
+		fileOut.write(zeros, offset - cur);
+		if (bytes > 0) fileOut.write((const char *)data, bytes);
+	};
+
+	uint64_t vertexNum = header.vertexNum;
+	writeBlock(0, &header, sizeof(header));
+	writeBlock(header.positionsOffset, lines_.positions, vertexNum * sizeof(glm::vec3));
+	writeBlock(header.lineIdsOffset, lines_.lineIds, vertexNum * sizeof(GLuint));
+	writeBlock(header.weightsOffset, lines_.weights, vertexNum * sizeof(GLfloat));
+	writeBlock(header.lineOffsetsOffset, lines_.lineOffsets, (lineNum + 1) * sizeof(GLuint));
+	writeBlock(header.lineLengthsOffset, lineLengths_.data(), lineNum * sizeof(float));
+	writeBlock(header.lineSegNumsOffset, lineSegNums_.data(), lineNum * sizeof(int32_t));
+	fileOut.close();
+}
 
-			float &len = lineLengths_[i];
-			float segNum = len / leftLength * leftSegmentNum;
+void Lines::distributeSegments()
+{
+	int lineNum = (int)lineLengths_.size();
+	lineSegNums_.resize(lineNum);
+	distributeSegmentsByLength(lineLengths_.data(), lineNum, segmentNum_, lineSegNums_.data());
 
-			lineSegNums_[i] = (int)segNum;
-			lineLeftLengths.insert(make_pair(segNum - (float)segNum, i));
-		}
-	}
+	string error;
+	if (!validateSegmentDistribution(lineSegNums_.data(), lineNum, segmentNum_, error))
+		cout << "ERROR::LINES::SEGMENT_DISTRIBUTION " << error << endl;
 
-	while (leftSegmentNum > 0)
-	{
-		auto itMax = lineLeftLengths.rbegin();
-		int i = itMax->second;
-		++lineSegNums_[i];
-		--leftSegmentNum;
-		lineLeftLengths.erase(*itMax);
-	}
-#pragma endregion
+	lineSegOffsets_.resize(lineNum + 1);
+	parallelExclusiveScan(lineSegNums_.data(), lineSegOffsets_.data(), lineNum);
+}
 
-#pragma region assign blending weights
-	int segOffset = 0;
-	for (int i = 0; i < (int)lines_.size(); ++i)
+void Lines::assignWeights()
+{
+	parallelFor(0, lines_.lineNum, [&](int i)
 	{
-		LINE_TYPE &line = lines_[i];
-		
+		int begin = lines_.lineBegin(i);
+		int end = lines_.lineEnd(i);
+		if (begin == end) return;
+
+		int segOffset = lineSegOffsets_[i];
 		int segNum = lineSegNums_[i];
 		float curLength = 0.0f;
 		float lineLength = lineLengths_[i];
 
-		line[0].Weight_ = (float)segOffset + EPS;
+		lines_.weights[begin] = (float)segOffset + EPS;
 
-		for (int j = 1; j < (int)line.size(); ++j)
+		for (int j = begin + 1; j < end; ++j)
 		{
-			glm::vec3 &a = line[j - 1].Position_;
-			glm::vec3 &b = line[j].Position_;
-			
+			const glm::vec3 &a = lines_.positions[j - 1];
+			const glm::vec3 &b = lines_.positions[j];
+
 			float l = glm::length(b - a);
 			curLength += l;
 
-			line[j].Weight_ = segOffset + std::min(curLength / lineLength * (segNum - 1) + EPS, segNum - 1 - EPS);
+			lines_.weights[j] = segOffset + std::min(curLength / lineLength * (segNum - 1) + EPS, segNum - 1 - EPS);
 		}
-		segOffset += segNum;
-	}
-#pragma endregion
+	}, 1024);
+}
 
-#pragma region compute segs' line indices
+void Lines::computeSegLineIds()
+{
+	segLineIds_.resize(segmentNum_);
+	parallelFor(0, (int)lineSegNums_.size(), [&](int i)
 	{
-		int segId = 0;
-		for (int i = 0; i < (int)lines_.size(); ++i)
-		{
-			LINE_TYPE &line = lines_[i];
-			for (int j = 0; j < (int)line.size(); ++j)
-			{
-				segLineIds_[segId++] = i;
-			}
-		}
+		for (int j = lineSegOffsets_[i]; j < lineSegOffsets_[i + 1]; ++j)
+			segLineIds_[j] = i;
+	}, 1024);
+}
+
+void Lines::computeImportance(ImportanceType type, bool useCache)
+{
+	vertexImportance_.resize(vertexNum_);
+	importance_.resize(segmentNum_);
+	if (!useCache || !loadImportanceCache(path_, type, vertexImportance_, importance_))
+	{
+		computeVertexImportance(lines_, lineLengths_.data(), type, vertexImportance_.data());
+		computeSegmentImportance(lines_, lineSegOffsets_.data(), vertexImportance_.data(), importance_.data());
+		if (useCache && !saveImportanceCache(path_, type, vertexImportance_, importance_))
+			cout << "WARNING::LINES::CANNOT_WRITE_IMPORTANCE_CACHE " << importanceCachePath(path_, type) << endl;
 	}
-#pragma endregion
+	if (momentsReady_)
+		glNamedBufferSubData(SBO_IMPORTANCE, 0, (GLsizeiptr)segmentNum_ * sizeof(GLfloat), &importance_[0]);
+}
 
+void Lines::setupSolver(OpacitySolver &solver) const
+{
+	solver.resize(segmentNum_);
+	solver.setLines(lineSegOffsets_.data(), lines_.lineNum);
 }
 
 void Lines::setupModel()
 {
-	glGenBuffers(1, &VAO);
+	glReady_ = true;
+	glGenVertexArrays(1, &VAO);
 	glGenBuffers(1, &VBO);
 	glGenBuffers(1, &ABO);
 
-	glGenBuffers(1, &ABO);
-
 	glGenTextures(1, &TEX_HEADER);
 	glGenBuffers(1, &PBO_SET_HEAD);
 
 	glGenBuffers(1, &SBO_LIST);
 	glGenTextures(1, &TEX_LIST);
+	glGenTextures(1, &TEX_LIST_COMPACT);
 
 	glGenBuffers(1, &SBO_OPACITY);
 	glGenTextures(1, &TEX_OPACITY);
 
+	glGenBuffers(1, &SBO_COUNTS);
+	glGenBuffers(1, &SBO_OFFSETS);
+	glGenBuffers(1, &SBO_BLOCK_SUMS);
+
 #pragma region set ABO: atomic counter buffer object
 	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, ABO);
 	glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint) * 2, nullptr, GL_DYNAMIC_COPY);
@@ -283,6 +364,14 @@ void Lines::setupModel()
 	glBindImageTexture(1, TEX_LIST, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);//read only?
 #pragma endregion
 
+#pragma region set TEX_LIST_COMPACT: compact node texture
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_BUFFER, TEX_LIST_COMPACT);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, SBO_LIST);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindImageTexture(3, TEX_LIST_COMPACT, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RG32UI);
+#pragma endregion
+
 #pragma region set SBO_OPACITY: opacity buffer object
 	glBindBuffer(GL_TEXTURE_BUFFER, SBO_OPACITY);
 	glBufferData(GL_TEXTURE_BUFFER, segmentNum_ * sizeof(GLfloat), nullptr, GL_DYNAMIC_DRAW);//GL_DYNAMIC_DRAW?
@@ -297,56 +386,549 @@ void Lines::setupModel()
 	glBindImageTexture(2, TEX_OPACITY, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
 #pragma endregion
 
-#pragma region initialize opacity in shder??? necessary???
-	glBindTexture(GL_TEXTURE_2D, TEX_OPACITY);
-	float *dataOpacity;
-	dataOpacity = (float*)glMapBuffer(GL_TEXTURE_BUFFER, GL_WRITE_ONLY);
-	assert(dataOpacity, != nullptr);
-	for (int i = 0; i < (int)segmentNum_; ++i)
-		dataOpacity[i] = 1.0f;
-	glUnmapBuffer(GL_TEXTURE_BUFFER);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glFlush();
+#pragma region set SBO_COUNTS, SBO_OFFSETS, SBO_BLOCK_SUMS: contiguous A-buffer
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, SBO_COUNTS);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, TOTAL_PIXELS * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, SBO_OFFSETS);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (TOTAL_PIXELS + 1) * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, SBO_BLOCK_SUMS);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (TOTAL_PIXELS / SCAN_BLOCK_SIZE + 1) * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, SBO_COUNTS);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, SBO_OFFSETS);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, SBO_BLOCK_SUMS);
+#pragma endregion
+
+#pragma region initialize opacity: fully opaque until the first solve
+	const GLfloat one = 1.0f;
+	glClearNamedBufferData(SBO_OPACITY, GL_R32F, GL_RED, GL_FLOAT, &one);
+	opacity_.assign(segmentNum_, one);
 #pragma endregion
 
 #pragma region set VAO, VBO
 	//bind VAO
 	glBindVertexArray(VAO);
 
-	//set VBO
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glNamedBufferStorage(VBO, vertexNum_ * sizeof(Vertex), nullptr, GL_DYNAMIC_STORAGE_BIT);
-	//prepare vertex data
+	if (format_ == QUANTIZED_VERTICES)
 	{
-		int offset = 0;
-		for (auto it = lines_.begin(); it != lines_.end(); ++it)
-		{
-			LINE_TYPE &line = *it;
-			int sz = line.size();
-			glNamedBufferSubData(VBO, offset, sz * sizeof(Vertex), &line[0]);
-			offset += sz;
-		}
+		//set VBO: the quantized points, decoded with the block table in TEX_QUANT_BLOCKS
+		quant_.build(lines_);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glNamedBufferStorage(VBO, std::max<size_t>(quant_.vertices().size() * sizeof(QuantVertex), 1), quant_.vertices().data(), 0);
+		setQuantizedStripAttributes();
+		createQuantBlockTexture(quant_, SBO_QUANT_BLOCKS, TEX_QUANT_BLOCKS);
+		cout << "quantized vertices: " << quant_.bytes() / (1024.0 * 1024.0) << " MB against "
+			<< vertexNum_ * (sizeof(glm::vec3) + sizeof(GLuint) + sizeof(GLfloat)) / (1024.0 * 1024.0)
+			<< " MB, max position error " << quant_.maxPositionError << ", max weight error " << quant_.maxWeightError << " in "
+			<< quant_.buildTime << " ms" << endl;
+	}
+	else
+	{
+		//set VBO: the three vertex arrays back to back
+		//immutable storage that stays mapped, so the vertex data is written once and in parallel
+		GLsizeiptr positionsSize = (GLsizeiptr)vertexNum_ * sizeof(glm::vec3);
+		GLsizeiptr lineIdsSize = (GLsizeiptr)vertexNum_ * sizeof(GLuint);
+		GLsizeiptr weightsSize = (GLsizeiptr)vertexNum_ * sizeof(GLfloat);
+		GLsizeiptr vboSize = std::max<GLsizeiptr>(positionsSize + lineIdsSize + weightsSize, 1);
+		GLbitfield mapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glNamedBufferStorage(VBO, vboSize, nullptr, mapFlags | GL_DYNAMIC_STORAGE_BIT);
+		vboMapping_ = (char *)glMapNamedBufferRange(VBO, 0, vboSize, mapFlags);
+
+		double bandwidth = uploadVertices();
+		cout << "VBO upload: " << (positionsSize + lineIdsSize + weightsSize) / (1024.0 * 1024.0) << " MB, "
+			<< bandwidth << " GB/s" << (vboMapping_ != nullptr ? " (persistent mapping)" : " (glNamedBufferSubData)") << endl;
+
+		//locations follow build.vs: 0 aPos, 1 aDirection, 2 aTexCoords, 3 aWeight
+		//vertex Positon
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+		glEnableVertexAttribArray(0);
+		//vertex Weight
+		glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(GLfloat), (void*)(positionsSize + lineIdsSize));
+		glEnableVertexAttribArray(3);
+		//vertex LineId, not read by the shaders yet
+		glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)positionsSize);
+		glEnableVertexAttribArray(4);
 	}
-	//vertex Positon
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-	glEnableVertexAttribArray(0);
-	//vertex LineId
-	glVertexAttribPointer(1, 1, GL_UNSIGNED_INT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, LineId_));
-	glEnableVertexAttribArray(1);
-	//vertex Weight
-	glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Weight_));
-	glEnableVertexAttribArray(2);
 
 	//unbind VAO
 	glBindVertexArray(0);
+
+	drawFirsts_.resize(lines_.lineNum);
+	drawCounts_.resize(lines_.lineNum);
+	for (int i = 0; i < lines_.lineNum; ++i)
+	{
+		drawFirsts_[i] = (GLint)lines_.lineBegin(i);
+		drawCounts_[i] = (GLsizei)lines_.lineSize(i);
+	}
+#pragma endregion
+
+#pragma region set ribbons_: ribbon vertices and indices
+	if (geometry_ == RIBBONS)
+	{
+		if (format_ == QUANTIZED_VERTICES) createQuantizedRibbonBuffers(lines_, quant_, ribbons_);
+		else createRibbonBuffers(lines_, ribbons_);
+		cout << "ribbons: " << ribbons_.bytes / (1024.0 * 1024.0) << " MB in " << ribbons_.generateTime << " ms" << endl;
+	}
 #pragma endregion
 }
 
+void Lines::buildBVH()
+{
+	if (bvhReady_) return;
+	bvhReady_ = true;
+	bvh_.build(lines_);
+	cout << "BVH: " << bvh_.chunkNum() << " chunks in " << bvh_.buildTime << " ms" << endl;
+}
+
+//selectLevels() measures the lines by the boxes of the BVH
+void Lines::buildLevels()
+{
+	if (levelsReady_) return;
+	levelsReady_ = true;
+	buildBVH();
+
+#pragma region set VAO_LOD, VBO_LOD: simplified levels
+	lod_.build(lines_);
+	cout << "LOD: " << lod_.vertexNum() << " vertices in " << LOD_LEVELS - 1 << " levels in " << lod_.buildTime << " ms" << endl;
+
+	glGenVertexArrays(1, &VAO_LOD);
+	glGenBuffers(1, &VBO_LOD);
+	glBindVertexArray(VAO_LOD);
+	if (format_ == QUANTIZED_VERTICES)
+	{
+		lodQuant_.build(lod_.levelLines());
+		glBindBuffer(GL_ARRAY_BUFFER, VBO_LOD);
+		glNamedBufferStorage(VBO_LOD, std::max<size_t>(lodQuant_.vertices().size() * sizeof(QuantVertex), 1), lodQuant_.vertices().data(), 0);
+		setQuantizedStripAttributes();
+		createQuantBlockTexture(lodQuant_, SBO_LOD_QUANT_BLOCKS, TEX_LOD_QUANT_BLOCKS);
+	}
+	else
+	{
+		GLsizeiptr lodPositionsSize = (GLsizeiptr)lod_.vertexNum() * sizeof(glm::vec3);
+		GLsizeiptr lodLineIdsSize = (GLsizeiptr)lod_.vertexNum() * sizeof(GLuint);
+		GLsizeiptr lodWeightsSize = (GLsizeiptr)lod_.vertexNum() * sizeof(GLfloat);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO_LOD);
+		glNamedBufferStorage(VBO_LOD, std::max<GLsizeiptr>(lodPositionsSize + lodLineIdsSize + lodWeightsSize, 1), nullptr, GL_DYNAMIC_STORAGE_BIT);
+		if (lod_.vertexNum() > 0)
+		{
+			glNamedBufferSubData(VBO_LOD, 0, lodPositionsSize, lod_.positions().data());
+			glNamedBufferSubData(VBO_LOD, lodPositionsSize, lodLineIdsSize, lod_.lineIds().data());
+			glNamedBufferSubData(VBO_LOD, lodPositionsSize + lodLineIdsSize, lodWeightsSize, lod_.weights().data());
+		}
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(GLfloat), (void*)(lodPositionsSize + lodLineIdsSize));
+		glEnableVertexAttribArray(3);
+		glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)lodPositionsSize);
+		glEnableVertexAttribArray(4);
+	}
+	glBindVertexArray(0);
+#pragma endregion
+
+#pragma region set lodRibbons_
+	if (geometry_ == RIBBONS)
+	{
+		if (format_ == QUANTIZED_VERTICES) createQuantizedRibbonBuffers(lod_.levelLines(), lodQuant_, lodRibbons_);
+		else createRibbonBuffers(lod_.levelLines(), lodRibbons_);
+		cout << "LOD ribbons: " << lodRibbons_.bytes / (1024.0 * 1024.0) << " MB in " << lodRibbons_.generateTime << " ms" << endl;
+	}
+#pragma endregion
+}
+
+double Lines::uploadVertices()
+{
+	if (format_ == QUANTIZED_VERTICES) return 0.0;
+	auto t0 = chrono::steady_clock::now();
+
+	size_t positionsSize = (size_t)vertexNum_ * sizeof(glm::vec3);
+	size_t lineIdsSize = (size_t)vertexNum_ * sizeof(GLuint);
+	size_t weightsSize = (size_t)vertexNum_ * sizeof(GLfloat);
+	size_t totalSize = positionsSize + lineIdsSize + weightsSize;
+
+	if (vboMapping_ == nullptr)
+	{
+		glNamedBufferSubData(VBO, 0, positionsSize, lines_.positions);
+		glNamedBufferSubData(VBO, positionsSize, lineIdsSize, lines_.lineIds);
+		glNamedBufferSubData(VBO, positionsSize + lineIdsSize, weightsSize, lines_.weights);
+		glFinish();
+	}
+	else
+	{
+		//the draws issued since the last upload may still read the previous contents
+		if (vboFence_ != 0)
+		{
+			glClientWaitSync(vboFence_, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1e10));
+			glDeleteSync(vboFence_);
+			vboFence_ = 0;
+		}
+
+		//copy in 4 MB pieces over all threads, the pieces never straddle two source arrays
+		const size_t PIECE = size_t(4) << 20;
+		const char *srcs[3] = { (const char *)lines_.positions, (const char *)lines_.lineIds, (const char *)lines_.weights };
+		size_t sizes[3] = { positionsSize, lineIdsSize, weightsSize };
+		vector< pair<size_t, size_t> > pieces;//(array, offset in array)
+		for (int a = 0; a < 3; ++a)
+			for (size_t off = 0; off < sizes[a]; off += PIECE)
+				pieces.push_back(make_pair((size_t)a, off));
+
+		parallelFor(0, (int)pieces.size(), [&](int i)
+		{
+			size_t a = pieces[i].first;
+			size_t off = pieces[i].second;
+			size_t dstBase = a == 0 ? 0 : (a == 1 ? positionsSize : positionsSize + lineIdsSize);
+			memcpy(vboMapping_ + dstBase + off, srcs[a] + off, std::min(PIECE, sizes[a] - off));
+		}, 1);
+		//coherent mapping: the writes are visible to the commands issued after the copy, no barrier needed
+	}
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+	return seconds > 0.0 ? totalSize / seconds / 1e9 : 0.0;
+}
+
+void Lines::computeNormalization()
+{
+	int threads = threadNum();
+	vector<glm::vec3> lo(threads, glm::vec3(1e30f)), hi(threads, glm::vec3(-1e30f));
+	parallelBlocks(vertexNum_, [&](int t, int begin, int end)
+	{
+		for (int j = begin; j < end; ++j)
+		{
+			lo[t] = glm::min(lo[t], lines_.positions[j]);
+			hi[t] = glm::max(hi[t], lines_.positions[j]);
+		}
+	});
+	glm::vec3 bmin(1e30f), bmax(-1e30f);
+	for (int t = 0; t < threads; ++t)
+	{
+		bmin = glm::min(bmin, lo[t]);
+		bmax = glm::max(bmax, hi[t]);
+	}
+	normalization_ = glm::mat4(1.0f);
+	if (vertexNum_ == 0) return;
+
+	glm::vec3 extent = bmax - bmin;
+	float size = std::max(extent.x, std::max(extent.y, extent.z));
+	float scale = size > 0.0f ? 1.0f / size : 1.0f;
+	glm::mat4 m = glm::scale(glm::mat4(1.0f), glm::vec3(scale));
+	normalization_ = glm::translate(m, -(bmin + bmax) * 0.5f);
+}
+
 void Lines::Render()
 {
-	glBindVertexArray(VAO);
-	glDrawArrays(GL_LINE_STRIP, 0, vertexNum_);
+	bool quantized = format_ == QUANTIZED_VERTICES;
+	if (quantized)
+	{
+		glActiveTexture(GL_TEXTURE4);
+		glBindTexture(GL_TEXTURE_BUFFER, TEX_QUANT_BLOCKS);
+	}
+	if (geometry_ == RIBBONS)
+	{
+		//every line in one draw, separated by primitive restart
+		if (!culled_ && !leveled_)
+		{
+			glBindVertexArray(ribbons_.VAO);
+			glDrawElements(GL_TRIANGLE_STRIP, ribbons_.indexNum, GL_UNSIGNED_INT, (void*)0);
+			glBindVertexArray(0);
+			return;
+		}
+	}
+	else
+	{
+		//plain line strips: no ribbon direction and every fragment on the center line
+		glVertexAttrib3f(1, 1.0f, 0.0f, 0.0f);
+		glVertexAttrib2f(2, 0.0f, 0.5f);
+	}
+
+	const vector<GLint> &firsts = leveled_ ? fullFirsts_ : (culled_ ? culledFirsts_ : drawFirsts_);
+	const vector<GLsizei> &counts = leveled_ ? fullCounts_ : (culled_ ? culledCounts_ : drawCounts_);
+	drawStrips(geometry_ == RIBBONS ? ribbons_.VAO : VAO, firsts, counts);
+	if (leveled_)
+	{
+		if (quantized) glBindTexture(GL_TEXTURE_BUFFER, TEX_LOD_QUANT_BLOCKS);
+		drawStrips(geometry_ == RIBBONS ? lodRibbons_.VAO : VAO_LOD, lodFirsts_, lodCounts_);
+	}
+
+	//the strips read the mapped VBO, uploadVertices() waits for them before it overwrites it
+	if (geometry_ != RIBBONS && vboMapping_ != nullptr)
+	{
+		if (vboFence_ != 0) glDeleteSync(vboFence_);
+		vboFence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+void Lines::drawStrips(GLuint vao, const vector<GLint> &firsts, const vector<GLsizei> &counts)
+{
+	if (firsts.empty()) return;
+	glBindVertexArray(vao);
+	if (geometry_ == RIBBONS)
+	{
+		//point j of the VBO is ribbon vertices 2j and 2j + 1
+		ribbonFirsts_.resize(firsts.size());
+		ribbonCounts_.resize(counts.size());
+		for (size_t i = 0; i < firsts.size(); ++i)
+		{
+			ribbonFirsts_[i] = 2 * firsts[i];
+			ribbonCounts_[i] = 2 * counts[i];
+		}
+		glMultiDrawArrays(GL_TRIANGLE_STRIP, ribbonFirsts_.data(), ribbonCounts_.data(), (GLsizei)ribbonFirsts_.size());
+	}
+	else
+		glMultiDrawArrays(GL_LINE_STRIP, firsts.data(), counts.data(), (GLsizei)firsts.size());
 	glBindVertexArray(0);
 }
 
-#endif
\ No newline at end of file
+void Lines::cull(const RenderParams &params)
+{
+	buildBVH();
+	bvh_.cull(params, culledFirsts_, culledCounts_);
+	culled_ = true;
+	leveled_ = false;
+}
+
+void Lines::selectLevels(const RenderParams &params, float maxPixelError)
+{
+	buildLevels();
+	lod_.select(params, bvh_.lineBoxes(), maxPixelError, lineLevels_);
+
+	//the strips of the current list are runs of chunks in line order: level 0 lines keep them,
+	//the others are drawn once in full at their level
+	const vector<GLint> &firsts = culled_ ? culledFirsts_ : drawFirsts_;
+	const vector<GLsizei> &counts = culled_ ? culledCounts_ : drawCounts_;
+	fullFirsts_.clear();
+	fullCounts_.clear();
+	lodFirsts_.clear();
+	lodCounts_.clear();
+	int lastLine = -1;
+	for (size_t i = 0; i < firsts.size(); ++i)
+	{
+		if (counts[i] < 2) continue;
+		int line = (int)lines_.lineIds[firsts[i]];
+		int level = lineLevels_[line];
+		if (level == 0)
+		{
+			fullFirsts_.push_back(firsts[i]);
+			fullCounts_.push_back(counts[i]);
+		}
+		else if (line != lastLine)
+		{
+			lodFirsts_.push_back((GLint)lod_.levelBegin(level, line));
+			lodCounts_.push_back((GLsizei)lod_.levelSize(level, line));
+		}
+		lastLine = line;
+	}
+	leveled_ = true;
+}
+
+void Lines::resetLevels()
+{
+	leveled_ = false;
+}
+
+void Lines::resetCulling()
+{
+	culled_ = false;
+	leveled_ = false;
+}
+
+PickResult Lines::pick(const RenderParams &params, float x, float y, float radius)
+{
+	buildBVH();
+	return bvh_.pick(lines_, makePickRay(params, x, y, radius));
+}
+
+void Lines::clearLists()
+{
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO_SET_HEAD);
+	glBindTexture(GL_TEXTURE_2D, TEX_HEADER);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SCR_WIDTH, SCR_HEIGHT, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	//node 0 terminates the lists, so the counter starts at 1
+	const GLuint counters[2] = { 1, 0 };
+	glNamedBufferSubData(ABO, 0, sizeof(counters), counters);
+}
+
+void Lines::readLists(FragmentLists &lists)
+{
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT |
+		GL_TEXTURE_UPDATE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	GLuint counter = 0;
+	glGetNamedBufferSubData(ABO, 0, sizeof(GLuint), &counter);
+
+	lists.reset(SCR_WIDTH, SCR_HEIGHT, MAX_FRAGMENT_NUM);
+	lists.nodeNum = std::min(counter, MAX_FRAGMENT_NUM);
+	lists.fragmentNum = lists.nodeNum - 1;
+	lists.dropped = counter - lists.nodeNum;
+
+	glGetTextureImage(TEX_HEADER, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, (GLsizei)(lists.heads.size() * sizeof(GLuint)), &lists.heads[0]);
+	glGetNamedBufferSubData(SBO_LIST, 0, (GLsizeiptr)lists.nodeNum * sizeof(FragmentNode), &lists.nodes[0]);
+
+	//nodes past the pool were never stored, the shaders read them as 0
+	if (lists.dropped > 0)
+	{
+		GLuint nodeNum = lists.nodeNum;
+		parallelFor(0, (int)lists.heads.size(), [&](int i)
+		{
+			if (lists.heads[i] >= nodeNum) lists.heads[i] = 0;
+		}, 1 << 14);
+		parallelFor(1, (int)nodeNum, [&](int i)
+		{
+			if (lists.nodes[i].next >= nodeNum) lists.nodes[i].next = 0;
+		}, 1 << 14);
+	}
+}
+
+void Lines::uploadOpacity(const float *opacity)
+{
+	glNamedBufferSubData(SBO_OPACITY, 0, (GLsizeiptr)segmentNum_ * sizeof(GLfloat), opacity);
+	opacity_.assign(opacity, opacity + segmentNum_);
+}
+
+void Lines::clearSpans()
+{
+	const GLuint zero = 0;
+	glClearNamedBufferData(SBO_COUNTS, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+}
+
+void Lines::scanSpans(const Shader &scanShader)
+{
+	GLuint blockNum = (TOTAL_PIXELS + SCAN_BLOCK_SIZE - 1) / SCAN_BLOCK_SIZE;
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	scanShader.use();
+	scanShader.setUInt("pixelNum", TOTAL_PIXELS);
+	scanShader.setUInt("blockNum", blockNum);
+	scanShader.setInt("stage", 0);
+	glDispatchCompute(blockNum, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	scanShader.setInt("stage", 1);
+	glDispatchCompute(1, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	scanShader.setInt("stage", 2);
+	glDispatchCompute(blockNum, 1, 1);
+
+	//the counts become the per-pixel cursors of the fill pass
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	clearSpans();
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void Lines::readSpanOffsets(vector<GLuint> &offsets)
+{
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	offsets.resize(TOTAL_PIXELS + 1);
+	glGetNamedBufferSubData(SBO_OFFSETS, 0, (GLsizeiptr)offsets.size() * sizeof(GLuint), &offsets[0]);
+}
+
+//64 bytes per pixel, only for the frames that use them
+void Lines::setupMoments()
+{
+	//created rather than generated, the framebuffers and buffers are only used through their names
+	glCreateFramebuffers(1, &FBO_MOMENTS);
+	glGenTextures(MOMENT_TEXTURES, TEX_MOMENTS);
+	glCreateFramebuffers(1, &FBO_MOMENT_ACCUM);
+	glGenTextures(1, &TEX_MOMENT_ACCUM);
+	glCreateBuffers(1, &SBO_IMPORTANCE);
+	glCreateBuffers(1, &SBO_OCCLUSION);
+
+	//setupModel() leaves PBO_SET_HEAD bound, glTexImage2D would read from it
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	auto floatTexture = [](GLuint texture)
+	{
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+	};
+	const GLenum attachments[MOMENT_TEXTURES] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	for (int i = 0; i < MOMENT_TEXTURES; ++i)
+	{
+		floatTexture(TEX_MOMENTS[i]);
+		glNamedFramebufferTexture(FBO_MOMENTS, attachments[i], TEX_MOMENTS[i], 0);
+	}
+	glNamedFramebufferDrawBuffers(FBO_MOMENTS, MOMENT_TEXTURES, attachments);
+	floatTexture(TEX_MOMENT_ACCUM);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glNamedFramebufferTexture(FBO_MOMENT_ACCUM, GL_COLOR_ATTACHMENT0, TEX_MOMENT_ACCUM, 0);
+	if (glCheckNamedFramebufferStatus(FBO_MOMENTS, GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE ||
+		glCheckNamedFramebufferStatus(FBO_MOMENT_ACCUM, GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		cout << "ERROR::LINES::MOMENT_FRAMEBUFFER_INCOMPLETE" << endl;
+
+	glNamedBufferData(SBO_IMPORTANCE, (GLsizeiptr)std::max(segmentNum_, 1) * sizeof(GLfloat), nullptr, GL_DYNAMIC_DRAW);
+	if (!importance_.empty())
+		glNamedBufferSubData(SBO_IMPORTANCE, 0, (GLsizeiptr)segmentNum_ * sizeof(GLfloat), &importance_[0]);
+	glNamedBufferData(SBO_OCCLUSION, (GLsizeiptr)std::max(segmentNum_, 1) * 2 * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+	momentsReady_ = true;
+}
+
+void Lines::clearMoments(bool occlusion)
+{
+	if (!momentsReady_) setupMoments();
+	const GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < MOMENT_TEXTURES; ++i)
+		glClearNamedFramebufferfv(FBO_MOMENTS, GL_COLOR, i, zero);
+	glClearNamedFramebufferfv(FBO_MOMENT_ACCUM, GL_COLOR, 0, zero);
+	if (occlusion)
+	{
+		const GLuint zeroBits = 0;
+		glClearNamedBufferData(SBO_OCCLUSION, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zeroBits);
+	}
+	const GLuint counters[2] = { 0, 0 };
+	glNamedBufferSubData(ABO, 0, sizeof(counters), counters);
+}
+
+GLuint Lines::readOcclusion(vector<float> &hFront, vector<float> &hBack)
+{
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	hFront.resize(segmentNum_);
+	hBack.resize(segmentNum_);
+	glGetNamedBufferSubData(SBO_OCCLUSION, 0, (GLsizeiptr)segmentNum_ * sizeof(GLfloat), &hFront[0]);
+	glGetNamedBufferSubData(SBO_OCCLUSION, (GLintptr)segmentNum_ * sizeof(GLfloat), (GLsizeiptr)segmentNum_ * sizeof(GLfloat), &hBack[0]);
+	GLuint counter = 0;
+	glGetNamedBufferSubData(ABO, 0, sizeof(GLuint), &counter);
+	return counter;
+}
+
+void Lines::readSpans(FragmentSpans &spans, NodeFormat format, const RenderParams *params, const ScreenTile *tile)
+{
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	GLuint capacity = nodeCapacity(format);
+	spans.reset(SCR_WIDTH, SCR_HEIGHT, 0);
+	glGetNamedBufferSubData(SBO_OFFSETS, 0, (GLsizeiptr)spans.offsets.size() * sizeof(GLuint), &spans.offsets[0]);
+	if (tile)
+	{
+		//pixels before the tile end at 0, pixels after it start at its last fragment
+		GLuint first = tile->firstFragment, last = tile->firstFragment + tile->fragmentNum;
+		parallelFor(0, (int)spans.offsets.size(), [&](int i)
+		{
+			spans.offsets[i] = std::min(std::max(spans.offsets[i], first), last) - first;
+		}, 1 << 14);
+	}
+	GLuint total = spans.offsets[TOTAL_PIXELS];
+	spans.fragmentNum = std::min(total, capacity);
+	spans.dropped = total - spans.fragmentNum;
+	spans.nodes.resize(spans.fragmentNum);
+	if (spans.fragmentNum == 0) return;
+
+	if (format == FULL_NODES)
+	{
+		glGetNamedBufferSubData(SBO_LIST, 0, (GLsizeiptr)spans.fragmentNum * sizeof(FragmentNode), &spans.nodes[0]);
+		return;
+	}
+
+	if (!params)
+	{
+		cout << "ERROR::LINES::READ_SPANS::COMPACT_NODES_NEED_PARAMS" << endl;
+		return;
+	}
+	vector<CompactNode> compact(spans.fragmentNum);
+	glGetNamedBufferSubData(SBO_LIST, 0, (GLsizeiptr)compact.size() * sizeof(CompactNode), &compact[0]);
+	parallelFor(0, (int)compact.size(), [&](int i)
+	{
+		spans.nodes[i] = decodeCompactNode(compact[i], *params, opacity_.data(), (int)opacity_.size());
+	}, 1 << 14);
+}
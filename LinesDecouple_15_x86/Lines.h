@@ -0,0 +1,182 @@
+#ifndef LINES_H
+#define LINES_H
+
+#include <glad/glad.h> 
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "Include/shader.hpp"
+
+#include <chrono>
+
+#include "commonVars.h"
+#include "ABuffer.h"
+#include "Importance.h"
+#include "LineBVH.h"
+#include "LineLOD.h"
+#include "LineFile.h"
+#include "LineStorage.h"
+#include "MomentOIT.h"
+#include "ObjParser.h"
+#include "OpacitySolver.h"
+#include "Parallel.h"
+#include "RibbonGeometry.h"
+#include "SegmentDistribution.h"
+#include "VertexQuantization.h"
+
+using namespace std;
+
+
+class Lines
+{
+public:
+	int segmentNum_ = 0;
+	int vertexNum_ = 0;
+
+	//vertex data in CSR form, backed by arena_ or by the mapped lineFile_
+	LineSet lines_;
+	vector<float> lineLengths_;
+	vector<int> lineSegNums_;
+	vector<int> lineSegOffsets_;//first segment of each line, lineNum + 1 entries
+	vector<int> segLineIds_;
+	vector<float> vertexImportance_;//per vertex in [0, 1]
+	vector<float> importance_;//per segment node in [0, 1]
+	LineBVH bvh_;//over chunks of the lines, built by buildBVH()
+	LineLOD lod_;//simplified levels of the lines, built by buildLevels()
+	QuantizedLines quant_, lodQuant_;//the lines and lod_'s levels as drawn, QUANTIZED_VERTICES only
+
+	GLuint VAO, VBO;//vertex array object, vertex buffer object
+	GLuint VAO_LOD = 0, VBO_LOD = 0;//the vertices of lod_'s levels above 0, same layout
+	RibbonBuffers ribbons_, lodRibbons_;//the ribbons of the lines and of lod_'s levels, RIBBONS only
+	GLuint SBO_QUANT_BLOCKS = 0, TEX_QUANT_BLOCKS = 0;//block tables of quant_ and lodQuant_
+	GLuint SBO_LOD_QUANT_BLOCKS = 0, TEX_LOD_QUANT_BLOCKS = 0;
+	GLuint ABO;//atomic buffer object
+
+	GLuint TEX_HEADER;//head pointer texture
+	GLuint PBO_SET_HEAD;//pixel buffer object as a head pointer initializer
+
+	GLuint SBO_LIST;//fragment storage buffer object
+	GLuint TEX_LIST;//linked list texture
+	GLuint TEX_LIST_COMPACT;//SBO_LIST as 8 byte nodes of the contiguous A-buffer
+
+	GLuint SBO_OPACITY;
+	GLuint TEX_OPACITY;
+
+	//contiguous A-buffer
+	GLuint SBO_COUNTS;//fragments per pixel, then fill cursors
+	GLuint SBO_OFFSETS;//span offsets, pixels + 1
+	GLuint SBO_BLOCK_SUMS;//scan block totals
+
+	//moment-based transparency(MomentOIT.h), created by the first clearMoments()
+	GLuint FBO_MOMENTS = 0;//the MOMENT_TEXTURES moment sums as color attachments 0, 1, 2
+	GLuint TEX_MOMENTS[MOMENT_TEXTURES] = {};
+	GLuint FBO_MOMENT_ACCUM = 0;//TEX_MOMENT_ACCUM as color attachment 0
+	GLuint TEX_MOMENT_ACCUM = 0;//the colors times alpha and the transmittance in front, and their weights
+	GLuint SBO_IMPORTANCE = 0;//importance_, for the moments of the squared importance
+	GLuint SBO_OCCLUSION = 0;//float bits of h- of every segment node, then of h+
+
+	//segPerLine: average number of opacity segments per line, the total is distributed by line lengths
+	//setupGL: false when only the CPU side is needed(e.g. converting files), no GL context required
+	//a model that cannot be read leaves the lines empty and loaded() false, the GL objects are not created then
+	//geometry: what Render() draws, RIBBONS generates the ribbon buffers at setup
+	//format: QUANTIZED_VERTICES keeps only the quantized vertices on the GPU, decoded by the vertex shaders
+	Lines(const std::string &path, int segPerLine, bool setupGL = true, LineGeometry geometry = LINE_STRIPS,
+		VertexFormat format = FLOAT_VERTICES);
+	~Lines();
+	bool loaded() const { return loaded_; }
+	LineGeometry geometry() const { return geometry_; }
+	VertexFormat vertexFormat() const { return format_; }
+	void Render();
+	void saveBinary(const string &path) const;
+	//fill vertexImportance_ and importance_, read from/written to the cache next to the model when possible
+	void computeImportance(ImportanceType type, bool useCache = true);
+	//size solver for the segments and let it smooth along the lines
+	void setupSolver(OpacitySolver &solver) const;
+	//scale and translate the bounding box into [-0.5, 0.5]^3, keeping the aspect ratio
+	const glm::mat4 &normalization() const { return normalization_; }
+	//RenderParams::quantShift of the drawn vertices
+	int quantShift() const { return format_ == QUANTIZED_VERTICES ? (geometry_ == RIBBONS ? QUANT_BLOCK_SHIFT + 1 : QUANT_BLOCK_SHIFT) : 0; }
+	//copy the vertex arrays into the persistently mapped VBO, returns the achieved bandwidth in GB/s(0 for quantized vertices)
+	double uploadVertices();
+
+	//per-frame A-buffer traffic: reset heads and counter before the build pass,
+	//read the lists back after it, and upload solved opacities for the next frame
+	void clearLists();
+	void readLists(FragmentLists &lists);
+	void uploadOpacity(const float *opacity);
+
+	//contiguous A-buffer: zero the counts before the count pass, scan them into offsets
+	//(and reset the counts as fill cursors) before the fill pass, read the spans back after it
+	void clearSpans();
+	void scanSpans(const Shader &scanShader);
+	//COMPACT_NODES are decoded into FragmentNode with params and the last uploaded opacities
+	//tile: the spans of a tiled pass, the fill wrote the tile's fragments from 0 and the other pixels come back empty
+	void readSpans(FragmentSpans &spans, NodeFormat format = FULL_NODES, const RenderParams *params = nullptr,
+		const ScreenTile *tile = nullptr);
+	//the offsets of the last scan, pixels + 1 entries
+	void readSpanOffsets(vector<GLuint> &offsets);
+
+	//moment-based transparency: zero the moments, the accumulated colors, the fragment counter and(occlusion) the h terms
+	//before the moment pass, read the h terms and the fragments back after the resolve pass
+	void clearMoments(bool occlusion);
+	GLuint readOcclusion(vector<float> &hFront, vector<float> &hBack);
+
+	//the BVH of cull()/pick() and the LOD levels(and their GL buffers) of selectLevels() are built on first use,
+	//or ahead of it by these; once each
+	void buildBVH();
+	void buildLevels();
+
+	//draw only the chunks of the lines in the view frustum of params until the next cull() or resetCulling()
+	void cull(const RenderParams &params);
+	void resetCulling();
+	//draw every line at the level lod_ selects for params, after cull() and until the next cull() or resetLevels()
+	void selectLevels(const RenderParams &params, float maxPixelError);
+	void resetLevels();
+	//the line under window pixel(x, y), y down as the cursor; radius in pixels
+	PickResult pick(const RenderParams &params, float x, float y, float radius = 3.0f);
+private:
+	int segPerLine_;
+	string path_;
+	LineGeometry geometry_;
+	VertexFormat format_;
+	Arena arena_;
+	MappedFile lineFile_;
+
+	bool loaded_ = true;
+	bool glReady_ = false;//setupModel() created the GL objects
+	bool bvhReady_ = false;
+	bool levelsReady_ = false;
+	char *vboMapping_ = nullptr;//persistent mapping of VBO, null if the driver refused it
+	GLsync vboFence_ = 0;//signaled once the GPU is done with the draws of the last Render() that read VBO
+	vector<GLint> drawFirsts_;//one line strip per line
+	vector<GLsizei> drawCounts_;
+	vector<GLint> culledFirsts_;//strips of the visible chunks, used by Render() while culled_
+	vector<GLsizei> culledCounts_;
+	bool culled_ = false;
+	vector<unsigned char> lineLevels_;//of the last selectLevels()
+	vector<GLint> fullFirsts_;//the strips of level 0 lines, used by Render() while leveled_
+	vector<GLsizei> fullCounts_;
+	vector<GLint> lodFirsts_;//strips in VBO_LOD
+	vector<GLsizei> lodCounts_;
+	bool leveled_ = false;
+	vector<GLint> ribbonFirsts_;//drawStrips() scratch
+	vector<GLsizei> ribbonCounts_;
+	vector<float> opacity_;//copy of SBO_OPACITY for decoding compact nodes
+	bool momentsReady_ = false;//the moment textures, framebuffers and buffers exist
+	glm::mat4 normalization_ = glm::mat4(1.0f);//of the bounding box at load
+
+	void setupMoments();
+
+	void loadModel(const string &path);
+	void loadBinary(const string &path);
+	void computeNormalization();
+	void setupModel();
+	//line strips of vertex ranges of the VAO, as ribbon ranges in RIBBONS
+	void drawStrips(GLuint vao, const vector<GLint> &firsts, const vector<GLsizei> &counts);
+
+	void distributeSegments();
+	void assignWeights();
+	void computeSegLineIds();
+};
+
+#endif // !LINES_H
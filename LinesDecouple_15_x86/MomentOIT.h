@@ -0,0 +1,89 @@
+#ifndef MOMENTOIT_H
+#define MOMENTOIT_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+#include "commonVars.h"
+#include "RenderParams.h"
+
+//moment-based order independent transparency(Muenstermann et al. 2018), the MOMENT_OIT mode of RenderPasses:
+//instead of its fragment list every pixel keeps the sums of w, w z, w z^2, w z^3 and w z^4 of two weights w
+//	absorbance -ln(1 - alpha): the transmittance in front of a fragment, for compositing
+//	importance squared g^2:    h- and h+ of the opacity optimization(OpacitySolver.h)
+//z is the depth of build.fs warped linearly into [-1, 1] over the depth range of the data(momentDepthRange())
+//how much of a distribution lies in front of a depth is bounded from its 4 moments(Hamburger moment problem), the
+//estimate takes MOMENT_OVERESTIMATION of the weight at the depth itself; moments.glsl is the GLSL twin of these functions
+
+const int MOMENT_TEXTURES = 3;//rgba32f: (a, a z, a z^2, a z^3), (a z^4, g^2, g^2 z, g^2 z^2), (g^2 z^3, g^2 z^4, -, -)
+const float MOMENT_BIAS = 5e-7f;//towards the moments of a spread distribution, for 32 bit float moments
+const float MOMENT_OVERESTIMATION = 0.25f;
+const float MOMENT_MAX_ALPHA = 0.9999f;//keeps the absorbance finite
+
+//range of the depths build.fs computes over the data: z_window * w_clip = (z_clip + w_clip) / 2 is affine in the position
+//and after params.transform the data lies in the sphere of radius sqrt(3) / 2 around the origin; the ribbon borders lie
+//up to half the strip width further
+inline glm::vec2 momentDepthRange(const RenderParams &params)
+{
+	const glm::mat4 &m = params.modelViewProjectionMatrix;
+	glm::vec3 gradient = 0.5f * glm::vec3(m[0][2] + m[0][3], m[1][2] + m[1][3], m[2][2] + m[2][3]);
+	float center = 0.5f * (m[3][2] + m[3][3]);
+	float radius = 0.8660254f * glm::length(gradient);
+	float nearDepth = std::max(center - radius, 0.0f);
+	float farDepth = (center + radius) * (1.0f + 0.5f * params.stripWidth);
+	return glm::vec2(nearDepth, std::max(farDepth, nearDepth + 1e-6f));
+}
+
+inline float warpMomentDepth(float depth, const glm::vec2 &range)
+{
+	return glm::clamp(2.0f * (depth - range.x) / (range.y - range.x) - 1.0f, -1.0f, 1.0f);
+}
+
+//the part of the total weight b0 in front of z, in [0, 1]; b: the sums of w z^k, k = 1..4
+inline float momentFractionInFront(float b0, const glm::vec4 &moments, float z)
+{
+	if (b0 <= 0.0f) return 0.0f;
+	glm::vec4 b = glm::mix(moments / b0, glm::vec4(0.0f, 0.375f, 0.0f, 0.375f), MOMENT_BIAS);
+
+	//Cholesky factorization of the Hankel matrix of (1, b1, b2, b3, b4)
+	float L21D11 = b[2] - b[0] * b[1];
+	float D11 = b[1] - b[0] * b[0];
+	float L21 = L21D11 / D11;
+	float D22 = (b[3] - b[1] * b[1]) - L21D11 * L21;
+
+	//c = B^-1 (1, z, z^2), the polynomial c0 + c1 x + c2 x^2 vanishes at the other support points
+	glm::vec3 c(1.0f, z, z * z);
+	c[1] -= b[0];
+	c[2] -= b[1] + L21 * c[1];
+	c[1] /= D11;
+	c[2] /= D22;
+	c[1] -= L21 * c[2];
+	c[0] -= c[1] * b[0] + c[2] * b[1];
+
+	//its roots: the distribution with these moments and a point at z has its other two points there
+	float p = c[1] / c[2], q = c[0] / c[2];
+	float r = std::sqrt(std::max(0.25f * p * p - q, 0.0f));
+	float z1 = -0.5f * p - r, z2 = -0.5f * p + r;
+
+	//sum over the support points of their weight times f: 1 in front of z, MOMENT_OVERESTIMATION at z, 0 behind,
+	//through the quadratic interpolating f at the three points(its expectation only needs b1 and b2)
+	float f0 = MOMENT_OVERESTIMATION, f1 = z1 < z ? 1.0f : 0.0f, f2 = z2 < z ? 1.0f : 0.0f;
+	float f01 = (f1 - f0) / (z1 - z);
+	float f12 = (f2 - f1) / (z2 - z1);
+	float f012 = (f12 - f01) / (z2 - z);
+	float poly2 = f012;
+	float poly1 = f01 - f012 * (z + z1);
+	float poly0 = f0 - f01 * z + f012 * z * z1;
+	return glm::clamp(poly0 + poly1 * b[0] + poly2 * b[1], 0.0f, 1.0f);
+}
+
+//squared importance in front of and behind a fragment of squared importance g2 at z, from the moments of its pixel;
+//the fragment's own share of the estimate at z is taken out again
+inline void momentOcclusion(float b0, const glm::vec4 &moments, float z, float g2, float &front, float &behind)
+{
+	front = std::max(b0 * momentFractionInFront(b0, moments, z) - MOMENT_OVERESTIMATION * g2, 0.0f);
+	behind = std::max(b0 - front - g2, 0.0f);
+}
+
+#endif // !MOMENTOIT_H
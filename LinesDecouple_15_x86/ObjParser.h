@@ -0,0 +1,202 @@
+#ifndef OBJPARSER_H
+#define OBJPARSER_H
+
+#include <charconv>
+#include <chrono>
+#include <random>
+
+#include <glm/glm.hpp>
+
+#include "commonVars.h"
+#include "LineFile.h"
+#include "Parallel.h"
+
+//'v' and 'l' records of an OBJ file, in file order
+//line i references indices[lineStarts[i], lineStarts[i + 1]), already resolved to 0-based vertex ids
+struct ObjData
+{
+	vector<glm::vec3> positions;
+	vector<int> lineStarts;
+	vector<int> indices;
+};
+
+#pragma region chunk parsing
+struct ObjChunk
+{
+	vector<glm::vec3> positions;
+	vector<int> lineStarts;
+	vector<int> indices;
+	//negative(relative) indices can only be resolved once the vertex offset of the chunk is known:
+	//(position in indices, index relative to the chunk's first vertex)
+	vector<pair<int, int> > relativeIndices;
+};
+
+inline const char *skipObjSpaces(const char *p, const char *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t')) ++p;
+	return p;
+}
+
+inline const char *nextObjLine(const char *p, const char *end)
+{
+	const char *nl = (const char *)memchr(p, '\n', end - p);
+	return nl == nullptr ? end : nl + 1;
+}
+
+inline void parseObjChunk(const char *p, const char *end, ObjChunk &chunk)
+{
+	while (p < end)
+	{
+		const char *lineEnd = nextObjLine(p, end);
+		const char *q = skipObjSpaces(p, lineEnd);
+
+		if (lineEnd - q > 1 && q[0] == 'v' && (q[1] == ' ' || q[1] == '\t'))//a vertex
+		{
+			float x[3] = { 0.0f, 0.0f, 0.0f };
+			q += 2;
+			for (int k = 0; k < 3; ++k)
+			{
+				q = skipObjSpaces(q, lineEnd);
+				if (q < lineEnd && *q == '+') ++q;
+				q = from_chars(q, lineEnd, x[k]).ptr;
+			}
+			chunk.positions.push_back(glm::vec3(x[0], x[1], x[2]));
+		}
+		else if (lineEnd - q > 1 && q[0] == 'l' && (q[1] == ' ' || q[1] == '\t'))//a line
+		{
+			chunk.lineStarts.push_back((int)chunk.indices.size());
+			q += 2;
+			for (;;)
+			{
+				q = skipObjSpaces(q, lineEnd);
+				int id;
+				auto res = from_chars(q, lineEnd, id);
+				if (res.ec != errc()) break;
+				q = res.ptr;
+				//'v/vt' pairs: only the vertex index matters
+				while (q < lineEnd && *q != ' ' && *q != '\t' && *q != '\r' && *q != '\n') ++q;
+
+				if (id < 0)
+				{
+					chunk.relativeIndices.push_back(make_pair((int)chunk.indices.size(), (int)chunk.positions.size() + id));
+					chunk.indices.push_back(0);
+				}
+				else
+				{
+					chunk.indices.push_back(id - 1);//OBJ indices are 1-based
+				}
+			}
+		}
+		p = lineEnd;
+	}
+}
+#pragma endregion
+
+//split [data, data + size) into newline-aligned chunks, parse them on all threads and stitch the results in file order
+inline void parseObj(const char *data, size_t size, ObjData &out)
+{
+	const char *end = data + size;
+
+	//a few chunks per thread, so that uneven record mixes still balance
+	int chunkNum = (int)std::max<size_t>(1, std::min<size_t>(threadNum() * 4, size / (1 << 20)));
+	vector<const char *> bounds(chunkNum + 1);
+	bounds[0] = data;
+	bounds[chunkNum] = end;
+	for (int i = 1; i < chunkNum; ++i)
+		bounds[i] = nextObjLine(data + size * i / chunkNum, end);
+	for (int i = 1; i < chunkNum; ++i)//tiny files: keep bounds monotonic
+		bounds[i] = std::max(bounds[i], bounds[i - 1]);
+
+	vector<ObjChunk> chunks(chunkNum);
+	parallelFor(0, chunkNum, [&](int i) { parseObjChunk(bounds[i], bounds[i + 1], chunks[i]); }, 1);
+
+#pragma region stitch chunks
+	vector<int> vertexOffsets(chunkNum + 1), lineOffsets(chunkNum + 1), indexOffsets(chunkNum + 1);
+	vertexOffsets[0] = lineOffsets[0] = indexOffsets[0] = 0;
+	for (int i = 0; i < chunkNum; ++i)
+	{
+		vertexOffsets[i + 1] = vertexOffsets[i] + (int)chunks[i].positions.size();
+		lineOffsets[i + 1] = lineOffsets[i] + (int)chunks[i].lineStarts.size();
+		indexOffsets[i + 1] = indexOffsets[i] + (int)chunks[i].indices.size();
+	}
+
+	out.positions.resize(vertexOffsets[chunkNum], glm::vec3(0.0f));
+	out.lineStarts.resize(lineOffsets[chunkNum] + 1);
+	out.indices.resize(indexOffsets[chunkNum]);
+	out.lineStarts[lineOffsets[chunkNum]] = indexOffsets[chunkNum];
+
+	parallelFor(0, chunkNum, [&](int i)
+	{
+		ObjChunk &chunk = chunks[i];
+		if (!chunk.positions.empty())
+			memcpy(&out.positions[vertexOffsets[i]], &chunk.positions[0], chunk.positions.size() * sizeof(glm::vec3));
+		for (size_t j = 0; j < chunk.lineStarts.size(); ++j)
+			out.lineStarts[lineOffsets[i] + j] = indexOffsets[i] + chunk.lineStarts[j];
+		if (!chunk.indices.empty())
+			memcpy(&out.indices[indexOffsets[i]], &chunk.indices[0], chunk.indices.size() * sizeof(int));
+		for (auto &rel : chunk.relativeIndices)
+			out.indices[indexOffsets[i] + rel.first] = vertexOffsets[i] + rel.second;
+
+		vector<glm::vec3>().swap(chunk.positions);//release early, chunks can be as large as the output
+	}, 1);
+#pragma endregion
+}
+
+inline bool parseObjFile(const string &path, ObjData &out)
+{
+	MappedFile file;
+	if (!file.open(path)) return false;
+	parseObj(file.data(), file.size(), out);
+	return true;
+}
+
+#pragma region benchmark
+//synthetic OBJ text: random-walk streamlines
+inline string makeSyntheticObj(int lineNum, int vertsPerLine, unsigned int seed = 1)
+{
+	mt19937 rng(seed);
+	uniform_real_distribution<float> uni(-1.0f, 1.0f);
+	ostringstream ss;
+	ss << setprecision(7);
+	for (int i = 0; i < lineNum; ++i)
+	{
+		glm::vec3 p(uni(rng), uni(rng), uni(rng));
+		for (int j = 0; j < vertsPerLine; ++j)
+		{
+			p += glm::vec3(uni(rng), uni(rng), uni(rng)) * 0.01f;
+			ss << "v " << p.x << ' ' << p.y << ' ' << p.z << '\n';
+		}
+		ss << 'l';
+		for (int j = 0; j < vertsPerLine; ++j)
+			ss << ' ' << (i * vertsPerLine + j + 1);
+		ss << '\n';
+	}
+	return ss.str();
+}
+
+//parse throughput(MB/s) for 1, 2, 4, ... threads up to the hardware thread count
+inline void benchmarkObjParser(const string &text, int repeats)
+{
+	double mb = text.size() / (1024.0 * 1024.0);
+	cout << "OBJ parser: " << fixed << setprecision(1) << mb << " MB" << endl;
+	cout << "threads\tMB/s\tspeedup" << endl;
+
+	double base = 0.0;
+	forEachThreadCount(threadNum(), [&](int t)
+	{
+		double best = 1e30;
+		for (int r = 0; r < repeats; ++r)
+		{
+			ObjData data;
+			auto t0 = chrono::steady_clock::now();
+			parseObj(text.data(), text.size(), data);
+			best = std::min(best, chrono::duration<double>(chrono::steady_clock::now() - t0).count());
+		}
+		double rate = mb / best;
+		if (t == 1) base = rate;
+		cout << t << "\t" << rate << "\t" << rate / base << endl;
+	});
+}
+#pragma endregion
+
+#endif // !OBJPARSER_H
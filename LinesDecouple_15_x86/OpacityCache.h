@@ -0,0 +1,269 @@
+#ifndef OPACITYCACHE_H
+#define OPACITYCACHE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "commonVars.h"
+#include "ABuffer.h"
+#include "Importance.h"
+#include "LineStorage.h"
+#include "OpacitySolver.h"
+#include "Parallel.h"
+#include "RenderParams.h"
+#include "RibbonGeometry.h"
+#include "VertexQuantization.h"
+
+//opacities precomputed for a set of view directions(precompute-opacity), blended from the nearest ones at runtime
+//the direction of a view is the direction from the data to the camera in data space, the roll of the camera and
+//the perspective are ignored; the solve of a view does not depend on the opacities, one build per view is exact
+
+#pragma region view directions
+//n nearly uniform directions on the unit sphere
+inline vector<glm::vec3> fibonacciSphere(int n)
+{
+	vector<glm::vec3> dirs(n);
+	const float golden = 3.14159265f * (3.0f - std::sqrt(5.0f));
+	for (int i = 0; i < n; ++i)
+	{
+		float y = 1.0f - 2.0f * (i + 0.5f) / n;
+		float r = std::sqrt(std::max(1.0f - y * y, 0.0f));
+		float phi = golden * i;
+		dirs[i] = glm::vec3(std::cos(phi) * r, y, std::sin(phi) * r);
+	}
+	return dirs;
+}
+
+//the view direction of params in data space(the camera looks along viewDirection)
+inline glm::vec3 dataViewDirection(const RenderParams &params)
+{
+	glm::vec4 d = glm::inverse(params.transform) * glm::vec4(-params.viewDirection, 0.0f);
+	return glm::normalize(glm::vec3(d.x, d.y, d.z));
+}
+
+//a rotation that turns data direction d towards +z, i.e. towards the default camera
+inline glm::mat4 rotationTowardsCamera(const glm::vec3 &d)
+{
+	glm::vec3 up = std::abs(d.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+	glm::vec3 x = glm::normalize(glm::cross(up, d));
+	glm::vec3 y = glm::cross(d, x);
+	glm::mat4 rot(1.0f);
+	for (int c = 0; c < 3; ++c)
+	{
+		rot[c][0] = x[c];
+		rot[c][1] = y[c];
+		rot[c][2] = d[c];
+	}
+	return rot;
+}
+#pragma endregion
+
+#pragma region key
+//FNV-1a over 64 bit words
+inline uint64_t hashWords(const void *data, size_t bytes, uint64_t h = 14695981039346656037ull)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	for (size_t i = 0; i < bytes; i += 8)
+	{
+		uint64_t word = 0;
+		memcpy(&word, p + i, std::min<size_t>(8, bytes - i));
+		h = (h ^ word) * 1099511628211ull;
+	}
+	return h;
+}
+
+//positions, segment weights and line offsets, hashed in fixed chunks so the result does not depend on the threads
+inline uint64_t hashLineSet(const LineSet &lines)
+{
+	const int CHUNK = 1 << 16;
+	int chunkNum = (lines.vertexNum + CHUNK - 1) / CHUNK;
+	vector<uint64_t> chunks(chunkNum);
+	parallelFor(0, chunkNum, [&](int c)
+	{
+		int begin = c * CHUNK, cnt = std::min(CHUNK, lines.vertexNum - begin);
+		uint64_t h = hashWords(lines.positions + begin, cnt * sizeof(glm::vec3));
+		chunks[c] = hashWords(lines.weights + begin, cnt * sizeof(GLfloat), h);
+	});
+	uint64_t h = hashWords(lines.lineOffsets, (lines.lineNum + 1) * sizeof(GLuint));
+	return hashWords(chunks.data(), chunks.size() * sizeof(uint64_t), h);
+}
+
+//everything a cached opacity depends on: the data and the solver parameters, and how the fragments the solve
+//accumulates were rasterized(geometry, vertex format, strip width, resolution, node format)
+struct OpacityCacheKey
+{
+	uint64_t datasetHash;
+	float coff[5];
+	uint32_t importanceType;
+	uint32_t segmentNum;
+	uint32_t lineGeometry;
+	uint32_t vertexFormat;
+	uint32_t nodeFormat;
+	int32_t width, height;
+	float stripWidth;
+};
+
+inline OpacityCacheKey makeOpacityCacheKey(const LineSet &lines, int segmentNum, ImportanceType type, const double *coff,
+	const RenderParams &params, LineGeometry geometry, VertexFormat vertexFormat, NodeFormat format)
+{
+	OpacityCacheKey key;
+	memset(&key, 0, sizeof(key));
+	key.datasetHash = hashLineSet(lines);
+	for (int i = 0; i < 5; ++i) key.coff[i] = (float)coff[i];
+	key.importanceType = (uint32_t)type;
+	key.segmentNum = (uint32_t)segmentNum;
+	key.lineGeometry = (uint32_t)geometry;
+	key.vertexFormat = (uint32_t)vertexFormat;
+	key.nodeFormat = (uint32_t)format;
+	key.width = params.width;
+	key.height = params.height;
+	key.stripWidth = params.stripWidth;
+	return key;
+}
+
+//<model>.<key hash>.opc next to the model, one file per parameter set
+inline string opacityCachePath(const string &modelPath, const OpacityCacheKey &key)
+{
+	std::ostringstream name;
+	name << modelPath << "." << std::hex << std::setw(16) << std::setfill('0') << hashWords(&key, sizeof(key)) << ".opc";
+	return name.str();
+}
+#pragma endregion
+
+#pragma region cache
+const char OPACITY_CACHE_MAGIC[4] = { 'L', 'O', 'P', 'C' };
+const uint32_t OPACITY_CACHE_VERSION = 3;
+
+//the file: header, viewNum directions, then viewNum * segmentNum opacities as 16 bit unorm
+struct OpacityCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	OpacityCacheKey key;
+	uint32_t viewNum;
+	uint32_t reserved;
+};
+
+class OpacityCache
+{
+public:
+	OpacityCacheKey key;
+	vector<glm::vec3> directions;
+	vector<uint16_t> opacity;//per view, segmentNum each
+
+	int viewNum() const { return (int)directions.size(); }
+	bool empty() const { return directions.empty(); }
+
+	void setView(int view, const float *viewOpacity)
+	{
+		uint16_t *out = &opacity[(size_t)view * key.segmentNum];
+		parallelFor(0, (int)key.segmentNum, [&](int i)
+		{
+			out[i] = (uint16_t)std::lround(std::min(std::max(viewOpacity[i], 0.0f), 1.0f) * 65535.0f);
+		}, 1 << 16);
+	}
+
+	void reset(const OpacityCacheKey &cacheKey, const vector<glm::vec3> &dirs)
+	{
+		key = cacheKey;
+		directions = dirs;
+		opacity.assign(dirs.size() * key.segmentNum, 0);
+	}
+
+	//blend of the 3 nearest views, weighted by how much closer they are than the 4th so that a view
+	//fades out before it leaves the set and the opacities change continuously with the direction
+	void lookup(const glm::vec3 &direction, float *out) const
+	{
+		const int K = 3;
+		int nearest[K + 1];
+		float dots[K + 1];
+		int found = 0;
+		for (int v = 0; v < viewNum(); ++v)
+		{
+			float d = glm::dot(direction, directions[v]);
+			int k = std::min(found, K);
+			if (found > K && d <= dots[K]) continue;
+			while (k > 0 && dots[k - 1] < d)
+			{
+				dots[k] = dots[k - 1];
+				nearest[k] = nearest[k - 1];
+				--k;
+			}
+			dots[k] = d;
+			nearest[k] = v;
+			found = std::min(found + 1, K + 1);
+		}
+
+		int cnt = std::min(found, K);
+		float floor = found > K ? dots[K] : -1.0f;
+		float weights[K], total = 0.0f;
+		for (int k = 0; k < cnt; ++k)
+		{
+			weights[k] = std::max(dots[k] - floor, 0.0f);
+			total += weights[k];
+		}
+		for (int k = 0; k < cnt; ++k)
+			weights[k] = total > 0.0f ? weights[k] / total : 1.0f / cnt;
+
+		const uint16_t *views[K];
+		for (int k = 0; k < cnt; ++k) views[k] = &opacity[(size_t)nearest[k] * key.segmentNum];
+		parallelFor(0, (int)key.segmentNum, [&](int i)
+		{
+			float o = 0.0f;
+			for (int k = 0; k < cnt; ++k) o += weights[k] * views[k][i];
+			out[i] = o * (1.0f / 65535.0f);
+		}, 1 << 16);
+	}
+
+	bool save(const string &path) const
+	{
+		OpacityCacheHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, OPACITY_CACHE_MAGIC, sizeof(header.magic));
+		header.version = OPACITY_CACHE_VERSION;
+		header.key = key;
+		header.viewNum = (uint32_t)directions.size();
+
+		ofstream fileOut(path, ios::binary);
+		if (!fileOut) return false;
+		fileOut.write((const char *)&header, sizeof(header));
+		fileOut.write((const char *)directions.data(), directions.size() * sizeof(glm::vec3));
+		fileOut.write((const char *)opacity.data(), opacity.size() * sizeof(uint16_t));
+		return fileOut.good();
+	}
+
+	//false if the file is missing or was made for another key
+	bool load(const string &path, const OpacityCacheKey &expected)
+	{
+		ifstream fileIn(path, ios::binary);
+		if (!fileIn) return false;
+		OpacityCacheHeader header;
+		fileIn.read((char *)&header, sizeof(header));
+		if (!fileIn || memcmp(header.magic, OPACITY_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != OPACITY_CACHE_VERSION
+			|| memcmp(&header.key, &expected, sizeof(expected)) != 0 || header.viewNum == 0)
+			return false;
+
+		key = header.key;
+		directions.resize(header.viewNum);
+		opacity.resize((size_t)header.viewNum * key.segmentNum);
+		fileIn.read((char *)directions.data(), directions.size() * sizeof(glm::vec3));
+		fileIn.read((char *)opacity.data(), opacity.size() * sizeof(uint16_t));
+		if (!fileIn.good())
+		{
+			directions.clear();
+			opacity.clear();
+			return false;
+		}
+		return true;
+	}
+};
+#pragma endregion
+
+#endif // !OPACITYCACHE_H
@@ -0,0 +1,398 @@
+#ifndef OPACITYSOLVER_H
+#define OPACITYSOLVER_H
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+
+#include "commonVars.h"
+#include "ABuffer.h"
+#include "LineSmoothing.h"
+#include "MomentOIT.h"
+#include "Parallel.h"
+
+//decoupled opacity optimization on the CPU
+//for every segment node i with importance g_i:
+//	h-_i: the largest sum of squared importances in front of one of its fragments(what occludes it)
+//	h+_i: the largest sum of squared importances behind one of its fragments(what it occludes)
+//	alpha_i = p / (p + (1 - g_i)^lambda * (q * h+_i + r * h-_i))
+//then smoothed along every line with strength s(LineSmoothing.h), if the solver knows the lines
+
+struct OpacityParams
+{
+	float p = 1.0f;//overall opacity
+	float q = 2.0f;//weight of the clearance of important segments behind
+	float r = 0.2f;//weight of the occlusion from the segments in front
+	float lambda = 5.0f;//importance exponent
+	float s = 0.3f;//smoothing along the lines, 0 turns it off
+};
+
+#pragma region closed form kernels
+inline void solveOpacityScalar(const float *importance, const float *hFront, const float *hBack,
+	const OpacityParams &params, float *opacity, int begin, int end)
+{
+	for (int i = begin; i < end; ++i)
+	{
+		float w = std::pow(std::max(1.0f - importance[i], 0.0f), params.lambda);
+		opacity[i] = params.p / (params.p + w * (params.q * hBack[i] + params.r * hFront[i]));
+	}
+}
+
+#if defined(__AVX2__)
+//natural logarithm and exponential for positive finite inputs(Cephes polynomials, about 1e-7 relative error)
+inline __m256 logAvx2(__m256 x)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	x = _mm256_max_ps(x, _mm256_set1_ps(1.17549435e-38f));
+
+	__m256i bits = _mm256_castps_si256(x);
+	__m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+	//mantissa in [0.5, 1)
+	__m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F000000)));
+
+	//shift to [sqrt(0.5), sqrt(2)) for accuracy
+	__m256 small = _mm256_cmp_ps(m, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OQ);
+	e = _mm256_sub_ps(e, _mm256_and_ps(one, small));
+	m = _mm256_sub_ps(_mm256_add_ps(m, _mm256_and_ps(m, small)), one);
+
+	__m256 z = _mm256_mul_ps(m, m);
+	__m256 y = _mm256_set1_ps(7.0376836292E-2f);
+	y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(-1.1514610310E-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.1676998740E-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(-1.2420140846E-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.4249322787E-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(-1.6668057665E-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(2.0000714765E-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(-2.4999993993E-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(3.3333331174E-1f));
+	y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+
+	y = _mm256_add_ps(y, _mm256_mul_ps(e, _mm256_set1_ps(-2.12194440e-4f)));
+	y = _mm256_sub_ps(y, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+	return _mm256_add_ps(_mm256_add_ps(m, y), _mm256_mul_ps(e, _mm256_set1_ps(0.693359375f)));
+}
+
+inline __m256 expAvx2(__m256 x)
+{
+	x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.3f)), _mm256_set1_ps(88.3f));
+
+	__m256 fx = _mm256_floor_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)), _mm256_set1_ps(0.5f)));
+	x = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(0.693359375f)));
+	x = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(-2.12194440e-4f)));
+
+	__m256 z = _mm256_mul_ps(x, x);
+	__m256 y = _mm256_set1_ps(1.9875691500E-4f);
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.3981999507E-3f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(8.3334519073E-3f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(4.1665795894E-2f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.6666665459E-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(5.0000001201E-1f));
+	y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(y, z), x), _mm256_set1_ps(1.0f));
+
+	//2^fx through the exponent bits
+	__m256i pow2 = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(127)), 23);
+	return _mm256_mul_ps(y, _mm256_castsi256_ps(pow2));
+}
+
+inline void solveOpacityAvx2(const float *importance, const float *hFront, const float *hBack,
+	const OpacityParams &params, float *opacity, int begin, int end)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 p = _mm256_set1_ps(params.p);
+	const __m256 q = _mm256_set1_ps(params.q);
+	const __m256 r = _mm256_set1_ps(params.r);
+	const __m256 lambda = _mm256_set1_ps(params.lambda);
+
+	int i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 g = _mm256_loadu_ps(importance + i);
+		__m256 base = _mm256_max_ps(_mm256_sub_ps(one, g), zero);
+		//(1 - g)^lambda, exactly 0 for g = 1
+		__m256 w = expAvx2(_mm256_mul_ps(lambda, logAvx2(base)));
+		w = _mm256_and_ps(w, _mm256_cmp_ps(base, zero, _CMP_GT_OQ));
+
+		__m256 h = _mm256_add_ps(_mm256_mul_ps(q, _mm256_loadu_ps(hBack + i)), _mm256_mul_ps(r, _mm256_loadu_ps(hFront + i)));
+		__m256 alpha = _mm256_div_ps(p, _mm256_add_ps(p, _mm256_mul_ps(w, h)));
+		_mm256_storeu_ps(opacity + i, alpha);
+	}
+	solveOpacityScalar(importance, hFront, hBack, params, opacity, i, end);
+}
+#endif
+
+//the widest kernel this build supports
+inline void solveOpacityKernel(const float *importance, const float *hFront, const float *hBack,
+	const OpacityParams &params, float *opacity, int begin, int end)
+{
+#if defined(__AVX2__)
+	solveOpacityAvx2(importance, hFront, hBack, params, opacity, begin, end);
+#else
+	solveOpacityScalar(importance, hFront, hBack, params, opacity, begin, end);
+#endif
+}
+#pragma endregion
+
+class OpacitySolver
+{
+public:
+	double accumulateTime = 0.0;//ms of the last accumulate()
+	double solveTime = 0.0;//ms of the last solve(), smoothing included
+	bool useSimd = true;//false forces the scalar kernel
+	LineSmoother smoother;//lines of setLines()
+
+	void resize(int segmentNum)
+	{
+		segmentNum_ = segmentNum;
+		hFrontBits_.reset(new std::atomic<GLuint>[segmentNum]);
+		hBackBits_.reset(new std::atomic<GLuint>[segmentNum]);
+		hFront_.assign(segmentNum, 0.0f);
+		hBack_.assign(segmentNum, 0.0f);
+	}
+
+	//the segment nodes of line l are [lineSegOffsets[l], lineSegOffsets[l + 1]), without lines solve() does not smooth
+	void setLines(const int *lineSegOffsets, int lineNum)
+	{
+		smoother.setLines(lineSegOffsets, lineNum);
+	}
+
+	int segmentNum() const { return segmentNum_; }
+	const vector<float> &hFront() const { return hFront_; }
+	const vector<float> &hBack() const { return hBack_; }
+
+	//walk the sorted fragment list of every pixel and keep the per-segment maxima of h- and h+
+	//importance: one value per segment node, a fragment interpolates between its two nodes like build.fs does
+	//works on FragmentLists and FragmentSpans
+	//clear: false keeps the maxima of the previous calls, for frames built in several passes(every pixel in one pass)
+	template <typename Fragments>
+	void accumulate(const Fragments &lists, const float *importance, bool clear = true)
+	{
+		assert(segmentNum_ > 0);
+		auto t0 = chrono::steady_clock::now();
+
+		if (clear) clearBits();
+
+		parallelFor(0, lists.height, [&](int y)
+		{
+			vector<FragmentNode> nodes(MAX_RESOLVE_NODES);
+			vector<float> g2(MAX_RESOLVE_NODES);
+			FragmentSorter sorter;
+			for (int x = 0; x < lists.width; ++x)
+			{
+				int cnt = gatherFragments(lists, y * lists.width + x, &nodes[0], MAX_RESOLVE_NODES);
+				if (cnt == 0) continue;
+				sorter.sort(&nodes[0], cnt);
+
+				//farthest first
+				float total = 0.0f;
+				for (int k = 0; k < cnt; ++k)
+				{
+					float g = fragmentImportance(nodes[k].weight, importance);
+					g2[k] = g * g;
+					total += g2[k];
+				}
+
+				float behind = 0.0f;
+				for (int k = 0; k < cnt; ++k)
+				{
+					float front = std::max(total - behind - g2[k], 0.0f);
+					int segId = (int)nodes[k].weight;
+					if (segId >= 0 && segId < segmentNum_)
+					{
+						atomicMax(hFrontBits_[segId], front);
+						atomicMax(hBackBits_[segId], behind);
+					}
+					if (segId + 1 >= 0 && segId + 1 < segmentNum_)
+					{
+						atomicMax(hFrontBits_[segId + 1], front);
+						atomicMax(hBackBits_[segId + 1], behind);
+					}
+					behind += g2[k];
+				}
+			}
+		}, 4);
+
+		publishBits();
+		accumulateTime = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+	}
+
+	//h- and h+ as the moment passes estimate them(resolveMoments.fs), from the same fragments: every pixel only sums the
+	//moments of the squared importance over the warped depths(MomentOIT.h), nothing is sorted
+	template <typename Fragments>
+	void accumulateMoments(const Fragments &lists, const float *importance, const glm::vec2 &depthRange, bool clear = true)
+	{
+		assert(segmentNum_ > 0);
+		auto t0 = chrono::steady_clock::now();
+		if (clear) clearBits();
+
+		parallelFor(0, lists.height, [&](int y)
+		{
+			vector<FragmentNode> nodes(MAX_RESOLVE_NODES);
+			for (int x = 0; x < lists.width; ++x)
+			{
+				int cnt = gatherFragments(lists, y * lists.width + x, &nodes[0], MAX_RESOLVE_NODES);
+				if (cnt == 0) continue;
+
+				float total = 0.0f;
+				glm::vec4 moments(0.0f);
+				for (int k = 0; k < cnt; ++k)
+				{
+					float g = fragmentImportance(nodes[k].weight, importance);
+					float z = warpMomentDepth(nodes[k].depth, depthRange);
+					float w = g * g;
+					total += w;
+					moments += w * glm::vec4(z, z * z, z * z * z, z * z * z * z);
+				}
+				for (int k = 0; k < cnt; ++k)
+				{
+					float g = fragmentImportance(nodes[k].weight, importance);
+					float front, behind;
+					momentOcclusion(total, moments, warpMomentDepth(nodes[k].depth, depthRange), g * g, front, behind);
+					int segId = (int)nodes[k].weight;
+					if (segId >= 0 && segId < segmentNum_)
+					{
+						atomicMax(hFrontBits_[segId], front);
+						atomicMax(hBackBits_[segId], behind);
+					}
+					if (segId + 1 >= 0 && segId + 1 < segmentNum_)
+					{
+						atomicMax(hFrontBits_[segId + 1], front);
+						atomicMax(hBackBits_[segId + 1], behind);
+					}
+				}
+			}
+		}, 4);
+
+		publishBits();
+		accumulateTime = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+	}
+
+	//h- and h+ accumulated elsewhere(the moment passes on the GPU) for the next solve()
+	void setOcclusion(const vector<float> &hFront, const vector<float> &hBack)
+	{
+		assert((int)hFront.size() == segmentNum_ && (int)hBack.size() == segmentNum_);
+		hFront_ = hFront;
+		hBack_ = hBack;
+	}
+
+	//closed-form opacities of all segments from the last accumulate()
+	void solve(const float *importance, const OpacityParams &params, float *opacity)
+	{
+		auto t0 = chrono::steady_clock::now();
+		bool simd = useSimd;
+		parallelBlocks(segmentNum_, [&](int, int begin, int end)
+		{
+			if (simd)
+				solveOpacityKernel(importance, &hFront_[0], &hBack_[0], params, opacity, begin, end);
+			else
+				solveOpacityScalar(importance, &hFront_[0], &hBack_[0], params, opacity, begin, end);
+		});
+		smoother.smooth(opacity, params.s);
+		solveTime = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+	}
+
+private:
+	int segmentNum_ = 0;
+	//float bits of non-negative values order like unsigned integers, so a max needs no float atomics
+	std::unique_ptr<std::atomic<GLuint>[]> hFrontBits_, hBackBits_;
+	vector<float> hFront_, hBack_;
+
+	void clearBits()
+	{
+		parallelFor(0, segmentNum_, [&](int i)
+		{
+			hFrontBits_[i].store(0, std::memory_order_relaxed);
+			hBackBits_[i].store(0, std::memory_order_relaxed);
+		}, 1 << 16);
+	}
+
+	//the maxima into hFront_ and hBack_
+	void publishBits()
+	{
+		parallelFor(0, segmentNum_, [&](int i)
+		{
+			GLuint f = hFrontBits_[i].load(std::memory_order_relaxed);
+			GLuint b = hBackBits_[i].load(std::memory_order_relaxed);
+			memcpy(&hFront_[i], &f, sizeof(float));
+			memcpy(&hBack_[i], &b, sizeof(float));
+		}, 1 << 16);
+	}
+
+	float fragmentImportance(float weight, const float *importance) const
+	{
+		int segId = (int)weight;
+		float g1 = segId < segmentNum_ ? importance[segId] : 0.0f;
+		float g2 = segId + 1 < segmentNum_ ? importance[segId + 1] : 0.0f;
+		return glslMix(g1, g2, weight - std::floor(weight));
+	}
+
+	static void atomicMax(std::atomic<GLuint> &target, float value)
+	{
+		GLuint bits;
+		memcpy(&bits, &value, sizeof(float));
+		GLuint cur = target.load(std::memory_order_relaxed);
+		while (cur < bits && !target.compare_exchange_weak(cur, bits, std::memory_order_relaxed));
+	}
+};
+
+#pragma region benchmark
+//closed-form solve time over thread counts on random terms, and the largest SIMD/scalar difference
+inline void benchmarkOpacitySolver(int segmentNum, int repeats)
+{
+	vector<float> importance(segmentNum), hFront(segmentNum), hBack(segmentNum);
+	vector<float> opacity(segmentNum), reference(segmentNum);
+	mt19937 rng(7);
+	uniform_real_distribution<float> unit(0.0f, 1.0f), occlusion(0.0f, 20.0f);
+	for (int i = 0; i < segmentNum; ++i)
+	{
+		importance[i] = unit(rng);
+		hFront[i] = occlusion(rng);
+		hBack[i] = occlusion(rng);
+	}
+	importance[0] = 1.0f;
+	importance[segmentNum - 1] = 0.0f;
+	OpacityParams params;
+
+	solveOpacityScalar(&importance[0], &hFront[0], &hBack[0], params, &reference[0], 0, segmentNum);
+	solveOpacityKernel(&importance[0], &hFront[0], &hBack[0], params, &opacity[0], 0, segmentNum);
+	float maxError = 0.0f;
+	for (int i = 0; i < segmentNum; ++i)
+		maxError = std::max(maxError, std::abs(opacity[i] - reference[i]));
+
+#if defined(__AVX2__)
+	cout << "opacity solve: " << segmentNum << " segments, AVX2 kernel, max error " << maxError << endl;
+#else
+	cout << "opacity solve: " << segmentNum << " segments, scalar kernel" << endl;
+#endif
+	cout << "threads	scalar ms	kernel ms" << endl;
+
+	forEachThreadCount(threadNum(), [&](int t)
+	{
+		double best[2] = { 1e30, 1e30 };
+		for (int k = 0; k < 2; ++k)
+		{
+			for (int r = 0; r < repeats; ++r)
+			{
+				auto t0 = chrono::steady_clock::now();
+				parallelBlocks(segmentNum, [&](int, int begin, int end)
+				{
+					if (k == 0)
+						solveOpacityScalar(&importance[0], &hFront[0], &hBack[0], params, &opacity[0], begin, end);
+					else
+						solveOpacityKernel(&importance[0], &hFront[0], &hBack[0], params, &opacity[0], begin, end);
+				});
+				best[k] = std::min(best[k], chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+			}
+		}
+		cout << t << "\t" << best[0] << "\t" << best[1] << endl;
+	});
+}
+#pragma endregion
+
+#endif // !OPACITYSOLVER_H
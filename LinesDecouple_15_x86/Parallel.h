@@ -0,0 +1,238 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+//number of worker threads used by the CPU passes, 0 means all hardware threads
+inline int &threadNumSetting()
+{
+	static int num = 0;
+	return num;
+}
+
+inline int threadNum()
+{
+	int num = threadNumSetting();
+	if (num > 0) return num;
+	unsigned int hw = std::thread::hardware_concurrency();
+	return hw > 0 ? (int)hw : 1;
+}
+
+inline void setThreadNum(int num)
+{
+	threadNumSetting() = num;
+}
+
+//f(t) with setThreadNum(t) for t = 1, 2, 4, ... and maxThreads last, the benchmarks' thread sweep;
+//the previous setting is restored afterwards
+template <typename F>
+inline void forEachThreadCount(int maxThreads, F f)
+{
+	int previous = threadNumSetting();
+	for (int t = 1; ; t = std::min(t * 2, maxThreads))
+	{
+		setThreadNum(t);
+		f(t);
+		if (t >= maxThreads) break;
+	}
+	setThreadNum(previous);
+}
+
+//persistent workers behind parallelRun(): worker t runs job(context, t) of every job of more than t threads, the
+//caller runs id 0 and waits for the others; one job at a time
+class ThreadPool
+{
+public:
+	typedef void (*Job)(void *context, int threadId);
+
+	//false if the pool is busy or the caller is one of its workers or already runs id 0 of a job(a nested run),
+	//the caller runs the job itself then
+	bool run(int n, Job job, void *context)
+	{
+		if (isWorker() || isRunning()) return false;
+		std::unique_lock<std::mutex> busy(busy_, std::try_to_lock);
+		if (!busy.owns_lock()) return false;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			while ((int)workers_.size() < n - 1)
+			{
+				int id = (int)workers_.size() + 1;
+				workers_.emplace_back([this, id]() { work(id); });
+			}
+			job_ = job;
+			context_ = context;
+			jobThreads_ = n;
+			pending_ = n - 1;
+			++generation_;
+		}
+		start_.notify_all();
+		isRunning() = true;
+		job(context, 0);
+		isRunning() = false;
+		std::unique_lock<std::mutex> lock(mutex_);
+		done_.wait(lock, [this]() { return pending_ == 0; });
+		return true;
+	}
+
+	//the pool of this process: a forked child only has the thread that forked, it gets a pool of its own
+	//(the parent's is left behind, its threads do not exist there)
+	static ThreadPool &instance()
+	{
+		static std::mutex guard;
+		std::lock_guard<std::mutex> lock(guard);
+		static ThreadPool *pool = nullptr;
+#ifndef _WIN32
+		static pid_t owner = 0;
+		if (pool != nullptr && owner != getpid()) pool = nullptr;
+		if (pool == nullptr) owner = getpid();
+#endif
+		//never destroyed: the workers block until the process ends
+		if (pool == nullptr) pool = new ThreadPool();
+		return *pool;
+	}
+
+private:
+	std::mutex busy_;
+	std::mutex mutex_;
+	std::condition_variable start_, done_;
+	std::vector<std::thread> workers_;
+	unsigned long long generation_ = 0;
+	Job job_ = nullptr;
+	void *context_ = nullptr;
+	int jobThreads_ = 0;
+	int pending_ = 0;
+
+	static bool &isWorker()
+	{
+		thread_local bool worker = false;
+		return worker;
+	}
+
+	//the calling thread is inside job(context, 0) and owns busy_
+	static bool &isRunning()
+	{
+		thread_local bool running = false;
+		return running;
+	}
+
+	void work(int id)
+	{
+		isWorker() = true;
+		unsigned long long seen = 0;
+		std::unique_lock<std::mutex> lock(mutex_);
+		for (;;)
+		{
+			start_.wait(lock, [&]() { return generation_ != seen; });
+			seen = generation_;
+			if (id >= jobThreads_) continue;
+			Job job = job_;
+			void *context = context_;
+			lock.unlock();
+			job(context, id);
+			lock.lock();
+			if (--pending_ == 0) done_.notify_one();
+		}
+	}
+};
+
+//run f(threadId) on n threads, the calling thread takes id 0; the others come from ThreadPool, or are started for this
+//call if the pool is busy(a nested call or one from another thread)
+template <typename F>
+void parallelRun(int n, F f)
+{
+	if (n <= 1)
+	{
+		f(0);
+		return;
+	}
+	auto job = [](void *context, int t) { (*(F *)context)(t); };
+	if (ThreadPool::instance().run(n, job, &f)) return;
+
+	std::vector<std::thread> workers;
+	workers.reserve(n - 1);
+	for (int t = 1; t < n; ++t)
+		workers.emplace_back([&f, t]() { f(t); });
+	f(0);
+	for (auto &w : workers) w.join();
+}
+
+//run f(i) for i in [begin, end), handing out chunks of 'grain' indices on demand
+template <typename F>
+void parallelFor(int begin, int end, F f, int grain = 1024)
+{
+	if (end <= begin) return;
+	int n = std::min(threadNum(), (end - begin + grain - 1) / grain);
+	std::atomic<int> next(begin);
+	parallelRun(n, [&](int)
+	{
+		for (;;)
+		{
+			int b = next.fetch_add(grain);
+			if (b >= end) break;
+			int e = std::min(b + grain, end);
+			for (int i = b; i < e; ++i) f(i);
+		}
+	});
+}
+
+//split [0, n) into one contiguous block per thread: f(threadId, begin, end)
+template <typename F>
+void parallelBlocks(int n, F f)
+{
+	int threads = std::max(1, std::min(threadNum(), n));
+	parallelRun(threads, [&](int t)
+	{
+		int b = (int)((long long)n * t / threads);
+		int e = (int)((long long)n * (t + 1) / threads);
+		f(t, b, e);
+	});
+}
+
+//exclusive prefix sum of in[0, n) into out[0, n], out[n] is the total
+//in and out may alias
+template <typename T, typename U>
+void parallelExclusiveScan(const T *in, U *out, int n)
+{
+	int threads = std::max(1, std::min(threadNum(), n / 4096));
+	std::vector<U> blockSums(threads + 1, U(0));
+	auto blockRange = [n, threads](int t, int &b, int &e)
+	{
+		b = (int)((long long)n * t / threads);
+		e = (int)((long long)n * (t + 1) / threads);
+	};
+
+	parallelRun(threads, [&](int t)
+	{
+		int b, e;
+		blockRange(t, b, e);
+		U sum = U(0);
+		for (int i = b; i < e; ++i) sum += (U)in[i];
+		blockSums[t + 1] = sum;
+	});
+	for (int t = 0; t < threads; ++t) blockSums[t + 1] += blockSums[t];
+
+	parallelRun(threads, [&](int t)
+	{
+		int b, e;
+		blockRange(t, b, e);
+		U sum = blockSums[t];
+		for (int i = b; i < e; ++i)
+		{
+			U v = (U)in[i];
+			out[i] = sum;
+			sum += v;
+		}
+	});
+	out[n] = blockSums[threads];
+}
+
+#endif // !PARALLEL_H
@@ -0,0 +1,45 @@
+#ifndef RENDERPARAMS_H
+#define RENDERPARAMS_H
+
+#include <glm/glm.hpp>
+
+#include "Include/shader.hpp"
+#include "commonVars.h"
+
+//the uniforms of build/resolve shaders, shared by the GL passes and the CPU reference
+struct RenderParams
+{
+	int width = SCR_WIDTH;
+	int height = SCR_HEIGHT;
+
+	glm::mat4 modelViewProjectionMatrix = glm::mat4(1.0f);
+	glm::mat4 model = glm::mat4(1.0f);
+	glm::mat4 transform = glm::mat4(1.0f);//rotation and normalization of the data
+	glm::vec3 viewDirection = glm::vec3(0.0f, 0.0f, -1.0f);
+	float stripWidth = 0.005f;
+	float farPlane = 5.0f;//of the projection, bounds the depths of compact nodes
+
+	glm::vec3 lightPos = glm::vec3(0.0f, 0.0f, 2.0f);
+	glm::vec3 lightColor = glm::vec3(1.0f, 1.0f, 1.0f);
+	glm::vec3 lineColor = glm::vec3(0.9f, 0.5f, 0.1f);
+
+	int segmentNum = 0;
+	int quantShift = 0;//of the mesh: log2 of the GL vertices per block of quantized vertices, 0 for float vertices
+};
+
+inline void setRenderUniforms(const Shader &shader, const RenderParams &params)
+{
+	shader.setMat4("modelViewProjectionMatrix", params.modelViewProjectionMatrix);
+	shader.setMat4("model", params.model);
+	shader.setMat4("transform", params.transform);
+	shader.setVec3("viewDirection", params.viewDirection);
+	shader.setFloat("stripWidth", params.stripWidth);
+	shader.setFloat("farPlane", params.farPlane);
+	shader.setVec3("lightPos", params.lightPos);
+	shader.setVec3("lightColor", params.lightColor);
+	shader.setVec3("lineColor", params.lineColor);
+	shader.setInt("segmentNum", params.segmentNum);
+	shader.setInt("quantShift", params.quantShift);
+}
+
+#endif // !RENDERPARAMS_H
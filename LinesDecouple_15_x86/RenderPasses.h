@@ -0,0 +1,397 @@
+#ifndef RENDERPASSES_H
+#define RENDERPASSES_H
+
+#include <glad/glad.h>
+
+#include "Include/shader.hpp"
+#include "commonVars.h"
+#include "ABuffer.h"
+#include "FrameProfiler.h"
+#include "Lines.h"
+#include "MomentOIT.h"
+#include "OpacitySolver.h"
+#include "RenderParams.h"
+#include "TemporalOpacity.h"
+
+//the GL passes of one frame:
+//	LINKED_LISTS:     build.fs links the fragments of a pixel through SBO_LIST, resolve.fs walks the list
+//	CONTIGUOUS_SPANS: count.fs counts per pixel, scan.cs turns the counts into offsets,
+//	                  fill.fs writes every pixel's fragments into one span, resolveSpans.fs reads it in order;
+//	                  with COMPACT_NODES the spans hold 8 byte nodes(compactNode.glsl), twice as many fit
+//	MOMENT_OIT:       no A-buffer, moments.fs sums depth moments per pixel(MomentOIT.h), resolveMoments.fs weights every
+//	                  fragment by the transmittance they estimate in front of it and keeps the per-segment maxima of the
+//	                  h terms they estimate, compositeMoments.fs puts the sum over the background; any depth complexity
+//	                  fits, the colors and opacities are approximations(oit-error measures them against LINKED_LISTS)
+//frame() renders a frame of an A-buffer layout that does not fit into one pass in screen tiles(ScreenTile in ABuffer.h)
+enum ABufferMode { LINKED_LISTS, CONTIGUOUS_SPANS, MOMENT_OIT };
+
+class RenderPasses
+{
+public:
+	ABufferMode mode = LINKED_LISTS;
+	NodeFormat format = FULL_NODES;//CONTIGUOUS_SPANS only, the lists always use full nodes
+
+	//frame(): a frame with more fragments than a pass may hold is rendered again in screen tiles
+	bool tiling = true;
+	GLuint fragmentBudget = 0;//fragments per pass, 0 or more than the node buffer holds: the node buffer
+
+	//fragments of the last readBack(), depending on the mode
+	FragmentLists lists;
+	FragmentSpans spans;
+	//MOMENT_OIT: the h terms of the segment nodes and the fragments of the last readBack()
+	vector<float> hFront, hBack;
+	GLuint momentFragments = 0;
+
+	//the last frame(): passes, fragments(dropped ones included) and fragments that did not fit into their pass
+	int tileNum = 0;
+	GLuint frameFragments = 0;
+	GLuint frameDropped = 0;
+
+	//times the passes inside its beginFrame()/endFrame() and counts their fragments, null: no timing
+	FrameProfiler *profiler = nullptr;
+
+	RenderPasses() :
+		buildShader_("build.vs", "build.fs"),
+		resolveShader_("resolve.vs", "resolve.fs"),
+		countShader_("build.vs", "count.fs"),
+		scanShader_("scan.cs"),
+		fillShader_("build.vs", "fill.fs"),
+		resolveSpansShader_("resolve.vs", "resolveSpans.fs"),
+		momentShader_("build.vs", "moments.fs"),
+		resolveMomentsShader_("build.vs", "resolveMoments.fs"),
+		compositeMomentsShader_("screen.vs", "compositeMoments.fs")
+	{
+		//the screen triangle has no attributes, the core profile still needs a vertex array
+		glGenVertexArrays(1, &screenVAO_);
+	}
+
+	~RenderPasses()
+	{
+		glDeleteVertexArrays(1, &screenVAO_);
+	}
+
+	GLuint passBudget() const
+	{
+		//node 0 of the lists is never used
+		GLuint capacity = mode == LINKED_LISTS ? MAX_FRAGMENT_NUM - 1 : nodeCapacity(format);
+		return fragmentBudget == 0 ? capacity : std::min(fragmentBudget, capacity);
+	}
+
+	//build, read back and resolve with the current opacities, then solve and upload the ones of the next frame;
+	//the overflow of a single pass shows in the list counter or the span offsets, the frame is then rendered in
+	//screen tiles of at most passBudget() fragments(the next frames start tiled until the frame fits again)
+	//temporal: smooths the solutions over frames and skips the read back and solve of frames it deems still
+	//(their overflow goes unnoticed, build.fs and fill.fs drop what does not fit)
+	//MOMENT_OIT is never tiled, its read back is the h terms the resolve pass estimated
+	void frame(Lines &mesh, OpacitySolver &solver, const OpacityParams &opacityParams, const RenderParams &params, vector<float> &opacity,
+		TemporalOpacity *temporal = nullptr)
+	{
+		bool solveFrame = !temporal || temporal->needsSolve(params);
+		if (mode == MOMENT_OIT)
+		{
+			buildMoments(mesh, params, solveFrame);
+			resolveMoments(mesh, params, solveFrame);
+			tileNum = 1;
+			frameDropped = 0;
+			tiledLastFrame_ = false;
+			if (!solveFrame) return;
+			readBack(mesh, params);
+			frameFragments = momentFragments;
+			solve(mesh, solver, opacityParams, opacity, temporal);
+			return;
+		}
+		if (!tiling || !tiledLastFrame_)
+		{
+			build(mesh, params);
+			if (!solveFrame)
+			{
+				resolve(mesh, params);
+				return;
+			}
+			readBack(mesh, params);
+			frameFragments = mode == LINKED_LISTS ? lists.fragmentNum + lists.dropped : spans.fragmentNum + spans.dropped;
+			if (!tiling || frameFragments <= passBudget())
+			{
+				resolve(mesh, params);
+				solve(mesh, solver, opacityParams, opacity, temporal);
+				tileNum = 1;
+				frameDropped = mode == LINKED_LISTS ? lists.dropped : spans.dropped;
+				tiledLastFrame_ = false;
+				return;
+			}
+		}
+		renderTiles(mesh, solveFrame ? &solver : nullptr, params);
+		if (solveFrame) solveAndUpload(mesh, solver, opacityParams, opacity, temporal);
+	}
+
+	//build and resolve with the uploaded opacities(e.g. looked up in an OpacityCache), tiled like the last frame()
+	void draw(Lines &mesh, const RenderParams &params)
+	{
+		if (mode == MOMENT_OIT)
+		{
+			buildMoments(mesh, params, false);
+			resolveMoments(mesh, params, false);
+		}
+		else if (tiling && tiledLastFrame_)
+			renderTiles(mesh, nullptr, params);
+		else
+		{
+			build(mesh, params);
+			resolve(mesh, params);
+		}
+	}
+
+	//fill the A-buffer(MOMENT_OIT: the moments), nothing is written to the color buffer
+	void build(Lines &mesh, const RenderParams &params)
+	{
+		if (mode == MOMENT_OIT)
+		{
+			buildMoments(mesh, params, true);
+			return;
+		}
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		if (mode == LINKED_LISTS)
+			buildLists(mesh, params);
+		else
+		{
+			countSpans(mesh, params);
+			fillSpans(mesh, params, 0);
+		}
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		//listCounter starts at 1, the last span offset is the total
+		if (profiler)
+		{
+			if (mode == LINKED_LISTS) profiler->countFragments(mesh.ABO, 0, 1);
+			else profiler->countFragments(mesh.SBO_OFFSETS, (GLintptr)TOTAL_PIXELS * sizeof(GLuint));
+		}
+	}
+
+	void readBack(Lines &mesh, const RenderParams &params, const ScreenTile *tile = nullptr)
+	{
+		ProfileScope scope(profiler, "read back");
+		if (mode == LINKED_LISTS)
+			mesh.readLists(lists);
+		else if (mode == CONTIGUOUS_SPANS)
+			mesh.readSpans(spans, format, &params, tile);
+		else
+			momentFragments = mesh.readOcclusion(hFront, hBack);
+	}
+
+	//the opacities used by the next build()
+	void solve(Lines &mesh, OpacitySolver &solver, const OpacityParams &opacityParams, vector<float> &opacity,
+		TemporalOpacity *temporal = nullptr)
+	{
+		if (mode == MOMENT_OIT)
+			solver.setOcclusion(hFront, hBack);
+		else
+		{
+			ProfileScope scope(profiler, "accumulate", false);
+			if (mode == LINKED_LISTS)
+				solver.accumulate(lists, &mesh.importance_[0]);
+			else
+				solver.accumulate(spans, &mesh.importance_[0]);
+		}
+		solveAndUpload(mesh, solver, opacityParams, opacity, temporal);
+	}
+
+	//composite the A-buffer over a white background, spanBase: first fragment of the tile in the spans
+	void resolve(Lines &mesh, const RenderParams &params, GLuint spanBase = 0)
+	{
+		if (mode == MOMENT_OIT)
+		{
+			resolveMoments(mesh, params, true);
+			return;
+		}
+		ProfileScope scope(profiler, "resolve");
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		const Shader &shader = mode == LINKED_LISTS ? resolveShader_ : resolveSpansShader_;
+		shader.use();
+		setRenderUniforms(shader, params);
+		if (mode == CONTIGUOUS_SPANS)
+		{
+			shader.setInt("screenWidth", params.width);
+			shader.setUInt("listCapacity", nodeCapacity(format));
+			shader.setUInt("spanBase", spanBase);
+			shader.setBool("compactNodes", format == COMPACT_NODES);
+		}
+		mesh.Render();
+	}
+
+private:
+	Shader buildShader_;
+	Shader resolveShader_;
+	Shader countShader_;
+	Shader scanShader_;
+	Shader fillShader_;
+	Shader resolveSpansShader_;
+	Shader momentShader_;
+	Shader resolveMomentsShader_;
+	Shader compositeMomentsShader_;
+	GLuint screenVAO_ = 0;
+
+	bool tiledLastFrame_ = false;
+	vector<GLuint> offsets_;
+	vector<ScreenTile> tiles_;
+
+	void solveAndUpload(Lines &mesh, OpacitySolver &solver, const OpacityParams &opacityParams, vector<float> &opacity,
+		TemporalOpacity *temporal)
+	{
+		ProfileScope scope(profiler, "solve", false);
+		solver.solve(&mesh.importance_[0], opacityParams, &opacity[0]);
+		if (temporal) temporal->blend(opacity);
+		mesh.uploadOpacity(&opacity[0]);
+	}
+
+	void buildLists(Lines &mesh, const RenderParams &params)
+	{
+		{
+			ProfileScope scope(profiler, "clear heads");
+			mesh.clearLists();
+		}
+		ProfileScope scope(profiler, "build");
+		buildShader_.use();
+		setRenderUniforms(buildShader_, params);
+		buildShader_.setUInt("listCapacity", MAX_FRAGMENT_NUM);
+		mesh.Render();
+	}
+
+	//moments.fs into the float targets of FBO_MOMENTS, occlusion: also clear the h terms for resolveMoments()
+	void buildMoments(Lines &mesh, const RenderParams &params, bool occlusion)
+	{
+		{
+			ProfileScope scope(profiler, "clear moments");
+			mesh.clearMoments(occlusion);
+		}
+		{
+			ProfileScope scope(profiler, "moments");
+			GLint target = 0;
+			glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mesh.FBO_MOMENTS);
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_ONE, GL_ONE);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, mesh.SBO_IMPORTANCE);
+			momentShader_.use();
+			setRenderUniforms(momentShader_, params);
+			momentShader_.setVec2("depthRange", momentDepthRange(params));
+			mesh.Render();
+			glDisable(GL_BLEND);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+		}
+		if (profiler) profiler->countFragments(mesh.ABO, 0);
+	}
+
+	//the weighted colors into FBO_MOMENT_ACCUM, then composited into the bound framebuffer
+	//occlusion: also keep the maxima of the estimated h terms in SBO_OCCLUSION
+	void resolveMoments(Lines &mesh, const RenderParams &params, bool occlusion)
+	{
+		ProfileScope scope(profiler, "resolve");
+		GLint target = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mesh.FBO_MOMENT_ACCUM);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+		for (int i = 0; i < MOMENT_TEXTURES; ++i)
+			glBindTextureUnit(5 + i, mesh.TEX_MOMENTS[i]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, mesh.SBO_IMPORTANCE);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, mesh.SBO_OCCLUSION);
+		resolveMomentsShader_.use();
+		setRenderUniforms(resolveMomentsShader_, params);
+		resolveMomentsShader_.setVec2("depthRange", momentDepthRange(params));
+		resolveMomentsShader_.setBool("accumulateOcclusion", occlusion);
+		mesh.Render();
+		glDisable(GL_BLEND);
+
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+		glBindTextureUnit(8, mesh.TEX_MOMENT_ACCUM);
+		compositeMomentsShader_.use();
+		glBindVertexArray(screenVAO_);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glBindVertexArray(0);
+	}
+
+	//count pass and scan: SBO_OFFSETS holds the span offsets, SBO_COUNTS the zeroed fill cursors
+	void countSpans(Lines &mesh, const RenderParams &params)
+	{
+		{
+			ProfileScope scope(profiler, "clear counts");
+			mesh.clearSpans();
+		}
+		{
+			ProfileScope scope(profiler, "count");
+			countShader_.use();
+			setRenderUniforms(countShader_, params);
+			countShader_.setInt("screenWidth", params.width);
+			mesh.Render();
+		}
+		ProfileScope scope(profiler, "scan");
+		mesh.scanSpans(scanShader_);
+	}
+
+	void fillSpans(Lines &mesh, const RenderParams &params, GLuint spanBase)
+	{
+		ProfileScope scope(profiler, "fill");
+		fillShader_.use();
+		setRenderUniforms(fillShader_, params);
+		fillShader_.setInt("screenWidth", params.width);
+		fillShader_.setUInt("listCapacity", nodeCapacity(format));
+		fillShader_.setUInt("spanBase", spanBase);
+		fillShader_.setBool("compactNodes", format == COMPACT_NODES);
+		mesh.Render();
+	}
+
+	//one build/read back/accumulate/resolve per tile, the scissor keeps every pass to its tile; the tiles are planned from
+	//a count pass, so each pixel is built in exactly one pass and the solver sees its whole sorted fragment list
+	//solver: null skips the read backs, for frames that keep their opacities
+	void renderTiles(Lines &mesh, OpacitySolver *solver, const RenderParams &params)
+	{
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		countSpans(mesh, params);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		{
+			ProfileScope scope(profiler, "read offsets");
+			mesh.readSpanOffsets(offsets_);
+		}
+		GLuint budget = passBudget();
+		tiles_ = planScreenTiles(offsets_, params.width, params.height, budget);
+
+		tileNum = (int)tiles_.size();
+		frameFragments = offsets_.back();
+		frameDropped = 0;
+		if (profiler) profiler->setFragments(frameFragments);
+		glEnable(GL_SCISSOR_TEST);
+		for (size_t t = 0; t < tiles_.size(); ++t)
+		{
+			const ScreenTile &tile = tiles_[t];
+			glScissor(tile.x, tile.y, tile.width, tile.height);
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			if (mode == LINKED_LISTS)
+				buildLists(mesh, params);
+			else
+				fillSpans(mesh, params, tile.firstFragment);
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+			if (solver)
+			{
+				readBack(mesh, params, &tile);
+				ProfileScope scope(profiler, "accumulate", false);
+				if (mode == LINKED_LISTS)
+				{
+					solver->accumulate(lists, &mesh.importance_[0], t == 0);
+					frameDropped += lists.dropped;
+				}
+				else
+				{
+					solver->accumulate(spans, &mesh.importance_[0], t == 0);
+					frameDropped += spans.dropped;
+				}
+			}
+			resolve(mesh, params, tile.firstFragment);
+		}
+		glDisable(GL_SCISSOR_TEST);
+		tiledLastFrame_ = frameFragments > budget;
+	}
+};
+
+#endif // !RENDERPASSES_H
@@ -0,0 +1,319 @@
+#ifndef RIBBONGEOMETRY_H
+#define RIBBONGEOMETRY_H
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <chrono>
+
+#include "commonVars.h"
+#include "CpuRasterizer.h"
+#include "LineStorage.h"
+#include "Parallel.h"
+
+//the screen-facing ribbons build.vs and resolve.vs are written for, generated on the CPU one line per task:
+//	line point j becomes the ribbon vertices 2j and 2j + 1 with the tangent of the point as aDirection and
+//	aTexCoords (along the line, 0 or 1), the vertex shader pushes them apart across the view by the strip width
+//	the tangents are central differences as ribbonDirection() of the CPU rasterizer, one-sided at the ends
+//	the index buffer runs every line as one triangle strip and separates the lines by RESTART_NUM
+
+//LINE_STRIPS: the plain VBO as 1 pixel line strips, without directions(the shading sees a constant tangent)
+enum LineGeometry { LINE_STRIPS, RIBBONS };
+
+//byte offsets of the attribute blocks of a ribbon vertex buffer, 2 vertices per line point
+struct RibbonLayout
+{
+	size_t positions;//vec3, location 0 aPos
+	size_t directions;//vec3, location 1 aDirection
+	size_t texCoords;//vec2, location 2 aTexCoords
+	size_t weights;//float, location 3 aWeight
+	size_t lineIds;//GLuint, location 4
+	size_t size;
+};
+
+inline RibbonLayout ribbonLayout(int pointNum)
+{
+	size_t n = 2 * (size_t)pointNum;
+	RibbonLayout layout;
+	layout.positions = 0;
+	layout.directions = layout.positions + n * sizeof(glm::vec3);
+	layout.texCoords = layout.directions + n * sizeof(glm::vec3);
+	layout.weights = layout.texCoords + n * sizeof(glm::vec2);
+	layout.lineIds = layout.weights + n * sizeof(GLfloat);
+	layout.size = layout.lineIds + n * sizeof(GLuint);
+	return layout;
+}
+
+//2 indices per point and a restart after every line
+inline size_t ribbonIndexNum(const LineSet &lines)
+{
+	return 2 * (size_t)lines.vertexNum + lines.lineNum;
+}
+
+#pragma region tangent kernels
+//tangents of the points [begin, end) of a line, every one of them needs both neighbors in the array
+inline void tangentsScalar(const glm::vec3 *positions, glm::vec3 *out, int begin, int end)
+{
+	for (int j = begin; j < end; ++j)
+	{
+		glm::vec3 d = positions[j + 1] - positions[j - 1];
+		float len = glm::length(d);
+		out[j] = len > 0.0f ? d / len : glm::vec3(1.0f, 0.0f, 0.0f);
+	}
+}
+
+#if defined(__AVX2__)
+inline void tangentsAvx2(const glm::vec3 *positions, glm::vec3 *out, int begin, int end)
+{
+	const float *base = (const float *)positions;
+	const __m256i lane = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	int j = begin;
+	for (; j + 8 <= end; j += 8)
+	{
+		//x, y, z of the vertices j - 1 .. j + 6 and j + 1 .. j + 8 as structure of arrays
+		const float *p = base + 3 * (j - 1);
+		__m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(p + 6, lane, 4), _mm256_i32gather_ps(p + 0, lane, 4));
+		__m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(p + 7, lane, 4), _mm256_i32gather_ps(p + 1, lane, 4));
+		__m256 dz = _mm256_sub_ps(_mm256_i32gather_ps(p + 8, lane, 4), _mm256_i32gather_ps(p + 2, lane, 4));
+
+		__m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+		__m256 valid = _mm256_cmp_ps(len, zero, _CMP_GT_OQ);
+		__m256 inv = _mm256_and_ps(_mm256_div_ps(one, len), valid);
+		//degenerate points get (1, 0, 0)
+		dx = _mm256_blendv_ps(one, _mm256_mul_ps(dx, inv), valid);
+		dy = _mm256_mul_ps(dy, inv);
+		dz = _mm256_mul_ps(dz, inv);
+
+		float tx[8], ty[8], tz[8];
+		_mm256_storeu_ps(tx, dx);
+		_mm256_storeu_ps(ty, dy);
+		_mm256_storeu_ps(tz, dz);
+		for (int k = 0; k < 8; ++k) out[j + k] = glm::vec3(tx[k], ty[k], tz[k]);
+	}
+	tangentsScalar(positions, out, j, end);
+}
+#endif
+
+inline void tangentKernel(const glm::vec3 *positions, glm::vec3 *out, int begin, int end, bool useSimd)
+{
+#if defined(__AVX2__)
+	if (useSimd)
+	{
+		tangentsAvx2(positions, out, begin, end);
+		return;
+	}
+#endif
+	tangentsScalar(positions, out, begin, end);
+}
+
+//tangents of the points of line l into out[0, lineSize(l))
+inline void lineTangents(const LineSet &lines, int l, glm::vec3 *out, bool useSimd)
+{
+	int begin = lines.lineBegin(l), end = lines.lineEnd(l);
+	if (end - begin < 2)
+	{
+		if (end > begin) out[0] = glm::vec3(1.0f, 0.0f, 0.0f);
+		return;
+	}
+	tangentKernel(lines.positions + begin, out, 1, end - begin - 1, useSimd);
+	out[0] = ribbonDirection(lines, begin, end, begin);
+	out[end - begin - 1] = ribbonDirection(lines, begin, end, end - 1);
+}
+#pragma endregion
+
+#pragma region generation
+//the indices of line l: its ribbon vertices as one strip and a restart
+inline void ribbonLineIndices(const LineSet &lines, int l, GLuint *indices)
+{
+	int begin = lines.lineBegin(l), end = lines.lineEnd(l);
+	GLuint *out = indices + 2 * (size_t)begin + l;
+	for (GLuint v = 2 * (GLuint)begin; v < 2 * (GLuint)end; ++v) *out++ = v;
+	*out = RESTART_NUM;
+}
+
+//the ribbon vertices of all lines into vertices(RibbonLayout of lines.vertexNum) and, if not null, ribbonIndexNum
+//indices; every thread keeps the tangents of its current line in a scratch array
+inline void generateRibbons(const LineSet &lines, char *vertices, GLuint *indices, bool useSimd = true)
+{
+	RibbonLayout layout = ribbonLayout(lines.vertexNum);
+	glm::vec3 *positions = (glm::vec3 *)(vertices + layout.positions);
+	glm::vec3 *directions = (glm::vec3 *)(vertices + layout.directions);
+	glm::vec2 *texCoords = (glm::vec2 *)(vertices + layout.texCoords);
+	GLfloat *weights = (GLfloat *)(vertices + layout.weights);
+	GLuint *lineIds = (GLuint *)(vertices + layout.lineIds);
+
+	vector< vector<glm::vec3> > scratch(threadNum());
+	parallelBlocks(lines.lineNum, [&](int t, int lineBegin, int lineEnd)
+	{
+		vector<glm::vec3> &tangents = scratch[t];
+		for (int l = lineBegin; l < lineEnd; ++l)
+		{
+			int begin = lines.lineBegin(l), end = lines.lineEnd(l);
+			tangents.resize(std::max<size_t>(tangents.size(), end - begin));
+			lineTangents(lines, l, tangents.data(), useSimd);
+
+			float invLen = end - begin > 1 ? 1.0f / (end - begin - 1) : 0.0f;
+			for (int j = begin; j < end; ++j)
+			{
+				size_t v = 2 * (size_t)j;
+				positions[v] = positions[v + 1] = lines.positions[j];
+				directions[v] = directions[v + 1] = tangents[j - begin];
+				float along = (j - begin) * invLen;
+				texCoords[v] = glm::vec2(along, 0.0f);
+				texCoords[v + 1] = glm::vec2(along, 1.0f);
+				weights[v] = weights[v + 1] = lines.weights[j];
+				lineIds[v] = lineIds[v + 1] = lines.lineIds[j];
+			}
+
+			if (indices) ribbonLineIndices(lines, l, indices);
+		}
+	});
+}
+
+//GL objects of the ribbons of a LineSet, drawn with glDrawElements(GL_TRIANGLE_STRIP) and primitive restart or as
+//glMultiDrawArrays ranges of 2 vertices per line point
+struct RibbonBuffers
+{
+	GLuint VAO = 0;
+	GLuint VBO = 0;
+	GLuint EBO = 0;
+	GLsizei indexNum = 0;
+	double generateTime = 0.0;//ms, the generation straight into the mapped buffers
+	size_t bytes = 0;//vertices and indices
+};
+
+//the VAO, VBO and EBO of buffers for a vertex stream of vertexBytes: write(vertices, indices) fills the buffers through
+//mappings(or staging memory if the driver refuses them), setAttributes() describes the stream to the bound VAO
+template <typename Write, typename Attributes>
+inline void createRibbonBuffers(const LineSet &lines, size_t vertexBytes, RibbonBuffers &buffers, Write write, Attributes setAttributes)
+{
+	size_t indexBytes = ribbonIndexNum(lines) * sizeof(GLuint);
+	buffers.indexNum = (GLsizei)ribbonIndexNum(lines);
+	buffers.bytes = vertexBytes + indexBytes;
+
+	glGenVertexArrays(1, &buffers.VAO);
+	glGenBuffers(1, &buffers.VBO);
+	glGenBuffers(1, &buffers.EBO);
+	glBindVertexArray(buffers.VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.VBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.EBO);
+	glNamedBufferStorage(buffers.VBO, std::max<size_t>(vertexBytes, 1), nullptr, GL_MAP_WRITE_BIT | GL_DYNAMIC_STORAGE_BIT);
+	glNamedBufferStorage(buffers.EBO, std::max<size_t>(indexBytes, 1), nullptr, GL_MAP_WRITE_BIT | GL_DYNAMIC_STORAGE_BIT);
+
+	auto t0 = chrono::steady_clock::now();
+	if (lines.vertexNum > 0)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+		char *vertices = (char *)glMapNamedBufferRange(buffers.VBO, 0, vertexBytes, flags);
+		GLuint *indices = (GLuint *)glMapNamedBufferRange(buffers.EBO, 0, indexBytes, flags);
+		if (vertices != nullptr && indices != nullptr)
+			write(vertices, indices);
+		else
+		{
+			//the driver refused the mappings
+			if (vertices != nullptr) glUnmapNamedBuffer(buffers.VBO);
+			if (indices != nullptr) glUnmapNamedBuffer(buffers.EBO);
+			vertices = nullptr;
+			indices = nullptr;
+			vector<char> vertexData(vertexBytes);
+			vector<GLuint> indexData(ribbonIndexNum(lines));
+			write(vertexData.data(), indexData.data());
+			glNamedBufferSubData(buffers.VBO, 0, vertexBytes, vertexData.data());
+			glNamedBufferSubData(buffers.EBO, 0, indexBytes, indexData.data());
+		}
+		if (vertices != nullptr) glUnmapNamedBuffer(buffers.VBO);
+		if (indices != nullptr) glUnmapNamedBuffer(buffers.EBO);
+	}
+	buffers.generateTime = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+
+	setAttributes();
+	//the element buffer binding stays with the VAO
+	glBindVertexArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+//no-op for buffers that were never created
+inline void deleteRibbonBuffers(RibbonBuffers &buffers)
+{
+	glDeleteVertexArrays(1, &buffers.VAO);
+	glDeleteBuffers(1, &buffers.VBO);
+	glDeleteBuffers(1, &buffers.EBO);
+	buffers = RibbonBuffers();
+}
+
+inline void createRibbonBuffers(const LineSet &lines, RibbonBuffers &buffers)
+{
+	RibbonLayout layout = ribbonLayout(lines.vertexNum);
+	createRibbonBuffers(lines, layout.size, buffers, [&](char *vertices, GLuint *indices)
+	{
+		generateRibbons(lines, vertices, indices);
+	}, [&]()
+	{
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)layout.positions);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)layout.directions);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)layout.texCoords);
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(GLfloat), (void*)layout.weights);
+		glEnableVertexAttribArray(3);
+		glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)layout.lineIds);
+		glEnableVertexAttribArray(4);
+	});
+}
+#pragma endregion
+
+#pragma region benchmark
+//ribbon generation into memory over thread counts, scalar against AVX2 tangents, next to the time it took to load the
+//model(loadMs, 0 if unknown); the largest tangent difference from ribbonDirection() of the CPU rasterizer
+inline void benchmarkRibbons(const LineSet &lines, double loadMs, int repeats)
+{
+	RibbonLayout layout = ribbonLayout(lines.vertexNum);
+	vector<char> vertices(layout.size);
+	vector<GLuint> indices(ribbonIndexNum(lines));
+
+	generateRibbons(lines, vertices.data(), indices.data(), true);
+	const glm::vec3 *directions = (const glm::vec3 *)(vertices.data() + layout.directions);
+	vector<float> lineError(lines.lineNum, 0.0f);
+	parallelFor(0, lines.lineNum, [&](int l)
+	{
+		for (int j = lines.lineBegin(l); j < lines.lineEnd(l); ++j)
+		{
+			glm::vec3 d = ribbonDirection(lines, lines.lineBegin(l), lines.lineEnd(l), j) - directions[2 * (size_t)j];
+			lineError[l] = std::max(lineError[l], std::max(std::abs(d.x), std::max(std::abs(d.y), std::abs(d.z))));
+		}
+	});
+	float maxError = 0.0f;
+	for (float e : lineError) maxError = std::max(maxError, e);
+
+	cout << "ribbons: " << lines.lineNum << " lines, " << lines.vertexNum << " points, " << (layout.size + indices.size() * sizeof(GLuint)) / (1024.0 * 1024.0)
+		<< " MB of vertices and indices, max tangent difference from the rasterizer " << maxError << endl;
+	if (loadMs > 0.0) cout << "model load " << loadMs << " ms" << endl;
+	cout << "threads	scalar ms	simd ms	simd / load" << endl;
+	forEachThreadCount(threadNum(), [&](int t)
+	{
+		double best[2] = { 1e30, 1e30 };
+		for (int k = 0; k < 2; ++k)
+		{
+			for (int r = 0; r < repeats; ++r)
+			{
+				auto t0 = chrono::steady_clock::now();
+				generateRibbons(lines, vertices.data(), indices.data(), k == 1);
+				best[k] = std::min(best[k], chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+			}
+		}
+		cout << t << "\t" << best[0] << "\t" << best[1] << "\t";
+		if (loadMs > 0.0) cout << best[1] / loadMs;
+		cout << endl;
+	});
+}
+#pragma endregion
+
+#endif // !RIBBONGEOMETRY_H
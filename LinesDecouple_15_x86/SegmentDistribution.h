@@ -0,0 +1,130 @@
+#ifndef SEGMENTDISTRIBUTION_H
+#define SEGMENTDISTRIBUTION_H
+
+#include <chrono>
+#include <random>
+
+#include "commonVars.h"
+#include "Parallel.h"
+
+//opacity segments per line with approximately equal lengths
+//every line gets 2 segments, the remaining segmentNum - 2 * lineNum are shared by the largest remainder method:
+//line i gets floor(quota_i) with quota_i = length_i / totalLength * remaining, the leftover segments go to
+//the largest fractional parts(found with nth_element, ties to the lower line id)
+//O(lineNum) work, all passes except the selection run in parallel
+
+inline void distributeSegmentsByLength(const float *lengths, int lineNum, int segmentNum, int *segNums)
+{
+	assert(segmentNum >= lineNum * 2);//because a line is at least distributed into two segments
+	if (lineNum == 0) return;
+
+	vector<double> blockLengths(threadNum(), 0.0);
+	parallelBlocks(lineNum, [&](int t, int begin, int end)
+	{
+		double sum = 0.0;
+		for (int i = begin; i < end; ++i) sum += lengths[i];
+		blockLengths[t] = sum;
+	});
+	double totalLength = 0.0;
+	for (double l : blockLengths) totalLength += l;
+
+	long long remaining = (long long)segmentNum - 2LL * lineNum;
+	//degenerate data: share evenly
+	bool even = !(totalLength > 0.0);
+	double scale = even ? (double)remaining / lineNum : remaining / totalLength;
+
+	vector<float> fractions(lineNum);
+	vector<long long> blockFloors(threadNum(), 0);
+	parallelBlocks(lineNum, [&](int t, int begin, int end)
+	{
+		long long sum = 0;
+		for (int i = begin; i < end; ++i)
+		{
+			double quota = even ? scale : lengths[i] * scale;
+			double whole = std::floor(quota);
+			segNums[i] = 2 + (int)whole;
+			fractions[i] = (float)(quota - whole);
+			sum += (long long)whole;
+		}
+		blockFloors[t] = sum;
+	});
+	long long distributed = 0;
+	for (long long f : blockFloors) distributed += f;
+
+	//the floors leave fewer than lineNum segments
+	long long leftover = std::min<long long>(std::max<long long>(remaining - distributed, 0), lineNum);
+	if (leftover == 0) return;
+
+	vector<int> order(lineNum);
+	parallelFor(0, lineNum, [&](int i) { order[i] = i; }, 1 << 16);
+	auto larger = [&fractions](int a, int b) { return fractions[a] > fractions[b] || (fractions[a] == fractions[b] && a < b); };
+	if (leftover < lineNum)
+		nth_element(order.begin(), order.begin() + (leftover - 1), order.end(), larger);
+	parallelFor(0, (int)leftover, [&](int k) { ++segNums[order[k]]; }, 1 << 16);
+}
+
+//the distribution covers exactly segmentNum segments and no line gets fewer than 2
+inline bool validateSegmentDistribution(const int *segNums, int lineNum, int segmentNum, string &error)
+{
+	long long sum = 0;
+	for (int i = 0; i < lineNum; ++i)
+	{
+		if (segNums[i] < 2)
+		{
+			error = "line " + to_string(i) + " has " + to_string(segNums[i]) + " segments";
+			return false;
+		}
+		sum += segNums[i];
+	}
+	if (sum != segmentNum)
+	{
+		error = "segments sum to " + to_string(sum) + " instead of " + to_string(segmentNum);
+		return false;
+	}
+	return true;
+}
+
+#pragma region benchmark
+//random log-normal line lengths: distribution time over thread counts, every run is validated
+inline bool benchmarkSegmentDistribution(int lineNum, int segPerLine, int repeats)
+{
+	vector<float> lengths(lineNum);
+	mt19937 rng(11);
+	lognormal_distribution<float> length(0.0f, 1.0f);
+	for (auto &l : lengths) l = length(rng);
+	//a few degenerate lines
+	for (int i = 0; i < lineNum; i += 1000) lengths[i] = 0.0f;
+
+	int segmentNum = segPerLine * lineNum;
+	vector<int> segNums(lineNum);
+	vector<int> offsets(lineNum + 1);
+	cout << "segment distribution: " << lineNum << " lines, " << segmentNum << " segments" << endl;
+	cout << "threads\tms\tspeedup" << endl;
+
+	bool valid = true;
+	double base = 0.0;
+	forEachThreadCount(threadNum(), [&](int t)
+	{
+		double best = 1e30;
+		for (int r = 0; r < repeats; ++r)
+		{
+			auto t0 = chrono::steady_clock::now();
+			distributeSegmentsByLength(&lengths[0], lineNum, segmentNum, &segNums[0]);
+			parallelExclusiveScan(&segNums[0], &offsets[0], lineNum);
+			best = std::min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+
+			string error;
+			if (!validateSegmentDistribution(&segNums[0], lineNum, segmentNum, error) || offsets[lineNum] != segmentNum)
+			{
+				cout << "ERROR::SEGMENTS::INVALID_DISTRIBUTION " << error << endl;
+				valid = false;
+			}
+		}
+		if (t == 1) base = best;
+		cout << t << "\t" << best << "\t" << base / best << endl;
+	});
+	return valid;
+}
+#pragma endregion
+
+#endif // !SEGMENTDISTRIBUTION_H
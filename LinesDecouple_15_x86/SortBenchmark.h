@@ -0,0 +1,275 @@
+#ifndef SORTBENCHMARK_H
+#define SORTBENCHMARK_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <fstream>
+#include <random>
+
+#include "Include/shader.hpp"
+#include "commonVars.h"
+#include "ABuffer.h"
+#include "FragmentSort.h"
+#include "Parallel.h"
+
+//bench-sort: replays the depth complexity of a captured frame against every sort strategy
+
+//pixels[n] is the number of pixels with n fragments, clamped to MAX_RESOLVE_NODES as the resolve passes do
+struct DepthHistogram
+{
+	vector<long long> pixels;
+
+	long long fragmentNum() const
+	{
+		long long sum = 0;
+		for (size_t n = 0; n < pixels.size(); ++n) sum += (long long)n * pixels[n];
+		return sum;
+	}
+
+	//text: "DHIST 1", then one "fragments pixels" line per non-empty bin
+	bool save(const string &path) const
+	{
+		ofstream file(path);
+		if (!file) return false;
+		file << "DHIST 1\n";
+		for (size_t n = 0; n < pixels.size(); ++n)
+			if (pixels[n] > 0) file << n << " " << pixels[n] << "\n";
+		return (bool)file;
+	}
+
+	bool load(const string &path)
+	{
+		ifstream file(path);
+		string magic;
+		int version = 0;
+		if (!(file >> magic >> version) || magic != "DHIST" || version != 1) return false;
+		pixels.assign(MAX_RESOLVE_NODES + 1, 0);
+		long long n, count;
+		while (file >> n >> count)
+			if (n >= 0) pixels[std::min<long long>(n, MAX_RESOLVE_NODES)] += count;
+		return true;
+	}
+};
+
+template <typename Fragments>
+DepthHistogram captureDepthHistogram(const Fragments &lists)
+{
+	int pixelNum = lists.width * lists.height;
+	vector<vector<long long>> perThread(threadNum(), vector<long long>(MAX_RESOLVE_NODES + 1, 0));
+	parallelBlocks(pixelNum, [&](int t, int begin, int end)
+	{
+		vector<FragmentNode> nodes(MAX_RESOLVE_NODES);
+		for (int p = begin; p < end; ++p)
+			++perThread[t][gatherFragments(lists, p, &nodes[0], MAX_RESOLVE_NODES)];
+	});
+
+	DepthHistogram hist;
+	hist.pixels.assign(MAX_RESOLVE_NODES + 1, 0);
+	for (auto &h : perThread)
+		for (int n = 0; n <= MAX_RESOLVE_NODES; ++n) hist.pixels[n] += h[n];
+	return hist;
+}
+
+//the pixels of a histogram scaled to about 'budget' fragments(error diffusion keeps the proportions),
+//ordered by fragment count; depths are random and the color holds the position in the pixel
+struct SortWorkload
+{
+	vector<GLuint> offsets;//pixels + 1
+	vector<FragmentNode> nodes;
+
+	int pixelNum() const { return (int)offsets.size() - 1; }
+
+	//first pixel with at least cnt fragments
+	int firstPixel(int cnt) const
+	{
+		int lo = 0, hi = pixelNum();
+		while (lo < hi)
+		{
+			int mid = (lo + hi) / 2;
+			if ((int)(offsets[mid + 1] - offsets[mid]) < cnt) lo = mid + 1;
+			else hi = mid;
+		}
+		return lo;
+	}
+};
+
+inline SortWorkload makeSortWorkload(const DepthHistogram &hist, long long budget)
+{
+	//pixels with fewer than 2 fragments need no sorting
+	long long total = 0;
+	for (size_t n = 2; n < hist.pixels.size(); ++n) total += (long long)n * hist.pixels[n];
+	double scale = total > budget ? (double)budget / total : 1.0;
+
+	SortWorkload work;
+	work.offsets.push_back(0);
+	mt19937 rng(5);
+	uniform_real_distribution<float> depth(0.5f, 1.5f);
+	double carry = 0.0;
+	for (size_t n = 2; n < hist.pixels.size(); ++n)
+	{
+		double exact = hist.pixels[n] * scale + carry;
+		long long pixels = (long long)exact;
+		carry = exact - pixels;
+		for (long long p = 0; p < pixels; ++p)
+		{
+			for (size_t i = 0; i < n; ++i)
+				work.nodes.push_back({ 0, depth(rng), 0.0f, (GLuint)i });
+			work.offsets.push_back((GLuint)work.nodes.size());
+		}
+	}
+	return work;
+}
+
+//bands of the per-strategy report, by fragments per pixel
+const int SORT_BAND_NUM = 4;
+const int SORT_BANDS[SORT_BAND_NUM + 1] = { 2, SORT_INSERTION_MAX + 1, 33, SORT_BITONIC_MAX + 1, MAX_RESOLVE_NODES + 1 };
+
+inline void printSortBandHeader(const string &title)
+{
+	cout << title;
+	for (int b = 0; b < SORT_BAND_NUM; ++b)
+		cout << "\t" << SORT_BANDS[b] << "-" << SORT_BANDS[b + 1] - 1;
+	cout << "\tall" << endl;
+}
+
+//ns per fragment of every band and of the whole workload, '-' for empty bands
+inline void printSortBandRow(const string &name, const SortWorkload &work, const double *bandMs)
+{
+	cout << name;
+	double totalMs = 0.0;
+	for (int b = 0; b < SORT_BAND_NUM; ++b)
+	{
+		long long fragments = (long long)work.offsets[work.firstPixel(SORT_BANDS[b + 1])] - work.offsets[work.firstPixel(SORT_BANDS[b])];
+		totalMs += bandMs[b];
+		if (fragments == 0) cout << "\t-";
+		else cout << "\t" << bandMs[b] * 1e6 / fragments;
+	}
+	cout << "\t" << totalMs * 1e6 / std::max<size_t>(work.nodes.size(), 1) << endl;
+}
+
+//the sorted depths must match the reference; stable strategies must also keep the order of equal depths
+inline bool checkSortedNodes(const vector<FragmentNode> &nodes, const vector<FragmentNode> &reference, bool stable, const string &name)
+{
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		if (nodes[i].depth != reference[i].depth || (stable && nodes[i].color != reference[i].color))
+		{
+			cout << "ERROR::SORT::WRONG_ORDER " << name << " at fragment " << i << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+inline vector<FragmentNode> referenceSort(const SortWorkload &work)
+{
+	vector<FragmentNode> reference = work.nodes;
+	for (int p = 0; p < work.pixelNum(); ++p)
+		insertionSortFragments(&reference[work.offsets[p]], (int)(work.offsets[p + 1] - work.offsets[p]));
+	return reference;
+}
+
+#pragma region benchmark
+//one thread, every strategy on every band of the workload
+inline bool benchmarkFragmentSort(const SortWorkload &work, int repeats)
+{
+	vector<FragmentNode> reference = referenceSort(work);
+	vector<FragmentNode> nodes;
+	bool valid = true;
+
+	cout << "CPU sort: " << work.pixelNum() << " pixels, " << work.nodes.size() << " fragments, ns per fragment" << endl;
+	printSortBandHeader("strategy");
+	for (int s = 0; s < SORT_STRATEGY_NUM; ++s)
+	{
+		FragmentSorter sorter;
+		sorter.strategy = (SortStrategy)s;
+		double best[SORT_BAND_NUM];
+		for (int b = 0; b < SORT_BAND_NUM; ++b) best[b] = 1e30;
+		for (int r = 0; r < repeats; ++r)
+		{
+			nodes = work.nodes;
+			for (int b = 0; b < SORT_BAND_NUM; ++b)
+			{
+				int begin = work.firstPixel(SORT_BANDS[b]), end = work.firstPixel(SORT_BANDS[b + 1]);
+				auto t0 = chrono::steady_clock::now();
+				for (int p = begin; p < end; ++p)
+					sorter.sort(&nodes[work.offsets[p]], (int)(work.offsets[p + 1] - work.offsets[p]));
+				best[b] = std::min(best[b], chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+			}
+		}
+		valid = checkSortedNodes(nodes, reference, s != SORT_EXCHANGE, sortStrategyName((SortStrategy)s)) && valid;
+		printSortBandRow(sortStrategyName((SortStrategy)s), work, best);
+	}
+	return valid;
+}
+
+//sortBench.cs in the current context, one dispatch per band
+inline bool benchmarkFragmentSortGL(const SortWorkload &work, int repeats)
+{
+	if (work.nodes.empty()) return true;
+	vector<FragmentNode> reference = referenceSort(work);
+	vector<FragmentNode> nodes(work.nodes.size());
+	bool valid = true;
+	GLsizeiptr nodeBytes = work.nodes.size() * sizeof(FragmentNode);
+
+	Shader shader("sortBench.cs");
+	GLuint SBO_NODES, SBO_SOURCE, SBO_OFFSETS;
+	glGenBuffers(1, &SBO_NODES);
+	glGenBuffers(1, &SBO_SOURCE);
+	glGenBuffers(1, &SBO_OFFSETS);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, SBO_SOURCE);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, nodeBytes, &work.nodes[0], GL_STATIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, SBO_NODES);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, nodeBytes, NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, SBO_OFFSETS);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, work.offsets.size() * sizeof(GLuint), &work.offsets[0], GL_STATIC_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, SBO_NODES);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, SBO_OFFSETS);
+
+	cout << "GL sort: " << work.pixelNum() << " pixels, " << work.nodes.size() << " fragments, ns per fragment" << endl;
+	printSortBandHeader("strategy");
+	shader.use();
+	for (int s = 0; s < SORT_STRATEGY_NUM; ++s)
+	{
+		shader.setInt("sortStrategy", s);
+		double best[SORT_BAND_NUM];
+		for (int b = 0; b < SORT_BAND_NUM; ++b) best[b] = 1e30;
+		for (int r = 0; r < repeats; ++r)
+		{
+			glBindBuffer(GL_COPY_READ_BUFFER, SBO_SOURCE);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, SBO_NODES);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, nodeBytes);
+			glFinish();
+			for (int b = 0; b < SORT_BAND_NUM; ++b)
+			{
+				int begin = work.firstPixel(SORT_BANDS[b]), end = work.firstPixel(SORT_BANDS[b + 1]);
+				if (begin == end)
+				{
+					best[b] = 0.0;
+					continue;
+				}
+				shader.setUInt("pixelBegin", begin);
+				shader.setUInt("pixelEnd", end);
+				auto t0 = chrono::steady_clock::now();
+				glDispatchCompute((end - begin + 63) / 64, 1, 1);
+				glFinish();
+				best[b] = std::min(best[b], chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+			}
+		}
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, SBO_NODES);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, nodeBytes, &nodes[0]);
+		//the GL bitonic network compares the depths only
+		valid = checkSortedNodes(nodes, reference, s != SORT_EXCHANGE && s != SORT_BITONIC, sortStrategyName((SortStrategy)s)) && valid;
+		printSortBandRow(sortStrategyName((SortStrategy)s), work, best);
+	}
+
+	glDeleteBuffers(1, &SBO_NODES);
+	glDeleteBuffers(1, &SBO_SOURCE);
+	glDeleteBuffers(1, &SBO_OFFSETS);
+	return valid;
+}
+#pragma endregion
+
+#endif // !SORTBENCHMARK_H
@@ -0,0 +1,594 @@
+#ifndef SORTLAST_H
+#define SORTLAST_H
+
+#include <glad/glad.h>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#include "commonVars.h"
+#include "ABuffer.h"
+#include "CpuRasterizer.h"
+#include "FragmentSort.h"
+#include "OpacitySolver.h"
+#include "Parallel.h"
+#include "RenderParams.h"
+#include "TileResolver.h"
+
+//sort-last rendering of one frame over several processes of one machine(fork, Unix domain sockets):
+//	every rank rasterizes a contiguous share of the lines(balanced by vertices) into full-screen spans and sorts
+//	each pixel farthest first
+//	compositing hands every rank a band of rows with the fragments of all ranks, merged per pixel in depth order:
+//		direct send:  the ranks sum their fragments per row and cut the frame into n bands of the same cost, every
+//		              rank sends each other rank its rows of that rank's band at once
+//		binary swap:  log2(n) rounds, partners split their current rows at half the cost and swap halves(n a power
+//		              of two)
+//	each rank resolves its rows and accumulates h- and h+ over them; rank 0 gathers the rows of the image and the
+//	per-segment maxima, solves the opacities and sends them back for the next frame
+//fragments of equal depth are merged in rank order, so both composites give the same image
+
+enum CompositeMode { COMPOSITE_DIRECT_SEND, COMPOSITE_BINARY_SWAP };
+
+inline const char *compositeModeName(CompositeMode mode)
+{
+	return mode == COMPOSITE_DIRECT_SEND ? "direct" : "swap";
+}
+
+#pragma region spans
+//share of rank of ranks: lines [first, first + count), about the same number of vertices each
+inline void sortLastLineRange(const LineSet &lines, int rank, int ranks, int &first, int &count)
+{
+	auto boundary = [&](int r)
+	{
+		if (r >= ranks) return lines.lineNum;
+		GLuint target = (GLuint)((long long)lines.lineOffsets[lines.lineNum] * r / ranks);
+		return (int)(std::lower_bound(lines.lineOffsets, lines.lineOffsets + lines.lineNum, target) - lines.lineOffsets);
+	};
+	first = boundary(rank);
+	count = boundary(rank + 1) - first;
+}
+
+const float SORT_LAST_PIXEL_COST = 0.0625f;//in fragments: merging and resolving visit every pixel of a band
+
+//fragments of every row of spans
+inline vector<GLuint> spanRowFragments(const FragmentSpans &spans)
+{
+	GLuint capacity = (GLuint)spans.nodes.size();
+	vector<GLuint> rows(spans.height);
+	for (int y = 0; y < spans.height; ++y)
+		rows[y] = std::min(spans.offsets[(y + 1) * spans.width], capacity) - std::min(spans.offsets[y * spans.width], capacity);
+	return rows;
+}
+
+//bands of about the same cost over the rows, band k is [bands[k], bands[k + 1]); the rows are rarely equally deep
+inline vector<int> splitRows(const vector<GLuint> &rowFragments, int width, int parts)
+{
+	int rows = (int)rowFragments.size();
+	vector<double> prefix(rows + 1, 0.0);
+	for (int y = 0; y < rows; ++y) prefix[y + 1] = prefix[y] + rowFragments[y] + SORT_LAST_PIXEL_COST * width;
+	vector<int> bands(parts + 1, rows);
+	for (int k = 0; k < parts; ++k)
+		bands[k] = (int)(std::lower_bound(prefix.begin(), prefix.end(), prefix[rows] * k / parts) - prefix.begin());
+	return bands;
+}
+
+//every pixel farthest first, as the resolve passes sort it
+inline void sortSpans(FragmentSpans &spans)
+{
+	GLuint capacity = (GLuint)spans.nodes.size();
+	parallelFor(0, spans.height, [&](int y)
+	{
+		FragmentSorter sorter;
+		for (int p = y * spans.width; p < (y + 1) * spans.width; ++p)
+		{
+			GLuint begin = std::min(spans.offsets[p], capacity);
+			GLuint end = std::min(spans.offsets[p + 1], capacity);
+			if (end - begin > 1) sorter.sort(&spans.nodes[begin], (int)(end - begin));
+		}
+	}, 4);
+}
+
+//the rows [row0, row0 + rows) of spans as spans of their own
+inline void copySpanRows(const FragmentSpans &spans, int row0, int rows, FragmentSpans &out)
+{
+	GLuint capacity = (GLuint)spans.nodes.size();
+	int pixel0 = row0 * spans.width, pixelNum = rows * spans.width;
+	GLuint first = std::min(spans.offsets[pixel0], capacity);
+	GLuint last = std::min(spans.offsets[pixel0 + pixelNum], capacity);
+	out.width = spans.width;
+	out.height = rows;
+	out.offsets.resize(pixelNum + 1);
+	for (int p = 0; p <= pixelNum; ++p) out.offsets[p] = std::min(spans.offsets[pixel0 + p], capacity) - first;
+	out.nodes.assign(spans.nodes.begin() + first, spans.nodes.begin() + last);
+	out.fragmentNum = last - first;
+	out.dropped = 0;
+}
+
+//merges the depth ordered pixels of parts(same size) into out, ties in the order of parts
+inline void mergeSpans(const vector<const FragmentSpans *> &parts, FragmentSpans &out)
+{
+	int width = parts[0]->width, height = parts[0]->height, pixelNum = width * height;
+	out.width = width;
+	out.height = height;
+	out.offsets.resize(pixelNum + 1);
+	parallelFor(0, pixelNum, [&](int p)
+	{
+		GLuint cnt = 0;
+		for (const FragmentSpans *part : parts) cnt += part->offsets[p + 1] - part->offsets[p];
+		out.offsets[p] = cnt;
+	}, 4096);
+	parallelExclusiveScan(&out.offsets[0], &out.offsets[0], pixelNum);
+	out.fragmentNum = out.offsets[pixelNum];
+	out.dropped = 0;
+	out.nodes.resize(out.fragmentNum);
+
+	auto farther = [](const FragmentNode &a, const FragmentNode &b) { return fragmentSortKey(a.depth) < fragmentSortKey(b.depth); };
+	parallelFor(0, height, [&](int y)
+	{
+		for (int p = y * width; p < (y + 1) * width; ++p)
+		{
+			FragmentNode *dst = out.nodes.data() + out.offsets[p];
+			GLuint merged = 0;
+			for (const FragmentSpans *part : parts)
+			{
+				GLuint cnt = part->offsets[p + 1] - part->offsets[p];
+				if (cnt == 0) continue;
+				memcpy(dst + merged, &part->nodes[part->offsets[p]], cnt * sizeof(FragmentNode));
+				std::inplace_merge(dst, dst + merged, dst + merged + cnt, farther);
+				merged += cnt;
+			}
+		}
+	}, 4);
+}
+#pragma endregion
+
+#pragma region processes
+#ifndef _WIN32
+//n processes connected pairwise by Unix domain sockets; rank 0 is the calling process
+class ProcessGroup
+{
+public:
+	double bytesSent = 0.0;
+
+	ProcessGroup() {}
+	~ProcessGroup() { closeSockets(); }
+	ProcessGroup(const ProcessGroup &) = delete;
+	ProcessGroup &operator=(const ProcessGroup &) = delete;
+
+	int rank() const { return rank_; }
+	int size() const { return size_; }
+
+	//returns in every process, false(in rank 0) if the sockets or processes could not be created
+	bool start(int n)
+	{
+		size_ = std::max(n, 1);
+		rank_ = 0;
+		sockets_.assign((size_t)size_ * size_, -1);
+		for (int a = 0; a < size_; ++a)
+			for (int b = a + 1; b < size_; ++b)
+			{
+				int fds[2];
+				if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+				{
+					cout << "ERROR::PROCESS_GROUP::SOCKETPAIR " << strerror(errno) << endl;
+					closeSockets();
+					return false;
+				}
+				int buffer = 1 << 22;
+				for (int fd : fds)
+				{
+					setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+					setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+				}
+				sockets_[(size_t)a * size_ + b] = fds[0];
+				sockets_[(size_t)b * size_ + a] = fds[1];
+			}
+
+		//buffered output would be written once per process
+		cout.flush();
+		fflush(stdout);
+		for (int r = 1; r < size_; ++r)
+		{
+			pid_t pid = fork();
+			if (pid < 0)
+			{
+				cout << "ERROR::PROCESS_GROUP::FORK " << strerror(errno) << endl;
+				break;
+			}
+			if (pid == 0)
+			{
+				rank_ = r;
+				children_.clear();
+				break;
+			}
+			children_.push_back(pid);
+		}
+
+		//keep only the ends of this rank
+		for (int a = 0; a < size_; ++a)
+			for (int b = 0; b < size_; ++b)
+			{
+				int &fd = sockets_[(size_t)a * size_ + b];
+				if (a != rank_ && fd >= 0)
+				{
+					close(fd);
+					fd = -1;
+				}
+			}
+		if (rank_ == 0 && (int)children_.size() != size_ - 1)
+		{
+			closeSockets();
+			finish();
+			return false;
+		}
+		return true;
+	}
+
+	//rank 0: waits for the other ranks, false if one of them failed; other ranks: exits the process
+	bool finish(bool ok = true)
+	{
+		closeSockets();
+		if (rank_ != 0)
+		{
+			cout.flush();
+			_exit(ok ? 0 : 1);
+		}
+		for (pid_t pid : children_)
+		{
+			int status = 0;
+			if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+		}
+		children_.clear();
+		return ok;
+	}
+
+	bool send(int peer, const void *data, size_t bytes)
+	{
+		int fd = sockets_[(size_t)rank_ * size_ + peer];
+		const char *p = (const char *)data;
+		while (bytes > 0)
+		{
+			ssize_t n = ::send(fd, p, std::min(bytes, (size_t)1 << 30), MSG_NOSIGNAL);
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) return false;
+			p += n;
+			bytes -= (size_t)n;
+			bytesSent += (double)n;
+		}
+		return true;
+	}
+
+	bool receive(int peer, void *data, size_t bytes)
+	{
+		int fd = sockets_[(size_t)rank_ * size_ + peer];
+		char *p = (char *)data;
+		while (bytes > 0)
+		{
+			ssize_t n = ::recv(fd, p, std::min(bytes, (size_t)1 << 30), MSG_WAITALL);
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) return false;
+			p += n;
+			bytes -= (size_t)n;
+		}
+		return true;
+	}
+
+	//rows [row0, row0 + rows) of spans as: y0, rows, width, covered pixels, node count, a bit per pixel set if it is
+	//covered, the fragment count of every covered pixel, the nodes; most pixels of a share are empty
+	bool sendSpanRows(int peer, const FragmentSpans &spans, int row0, int rows, int y0)
+	{
+		GLuint capacity = (GLuint)spans.nodes.size();
+		int pixel0 = row0 * spans.width, pixelNum = rows * spans.width;
+		vector<GLuint> mask((pixelNum + 31) / 32, 0);
+		vector<GLuint> counts;
+		for (int p = 0; p < pixelNum; ++p)
+		{
+			GLuint cnt = std::min(spans.offsets[pixel0 + p + 1], capacity) - std::min(spans.offsets[pixel0 + p], capacity);
+			if (cnt == 0) continue;
+			mask[p / 32] |= 1u << (p % 32);
+			counts.push_back(cnt);
+		}
+		GLuint first = std::min(spans.offsets[pixel0], capacity);
+		GLuint last = std::min(spans.offsets[pixel0 + pixelNum], capacity);
+		int32_t header[5] = { y0, rows, spans.width, (int32_t)counts.size(), (int32_t)(last - first) };
+		return send(peer, header, sizeof(header)) && send(peer, mask.data(), mask.size() * sizeof(GLuint))
+			&& send(peer, counts.data(), counts.size() * sizeof(GLuint))
+			&& send(peer, spans.nodes.data() + first, (size_t)(last - first) * sizeof(FragmentNode));
+	}
+
+	bool receiveSpanRows(int peer, FragmentSpans &spans, int &y0)
+	{
+		int32_t header[5];
+		if (!receive(peer, header, sizeof(header))) return false;
+		y0 = header[0];
+		spans.width = header[2];
+		spans.height = header[1];
+		int pixelNum = spans.width * spans.height;
+		vector<GLuint> mask((pixelNum + 31) / 32);
+		vector<GLuint> counts(header[3]);
+		if (!receive(peer, mask.data(), mask.size() * sizeof(GLuint)) || !receive(peer, counts.data(), counts.size() * sizeof(GLuint)))
+			return false;
+		spans.offsets.resize(pixelNum + 1);
+		GLuint sum = 0;
+		size_t next = 0;
+		for (int p = 0; p < pixelNum; ++p)
+		{
+			spans.offsets[p] = sum;
+			if ((mask[p / 32] >> (p % 32)) & 1u)
+			{
+				if (next == counts.size()) return false;
+				sum += counts[next++];
+			}
+		}
+		spans.offsets[pixelNum] = sum;
+		spans.fragmentNum = (GLuint)header[4];
+		spans.dropped = 0;
+		spans.nodes.resize(spans.fragmentNum);
+		return sum == spans.fragmentNum && receive(peer, spans.nodes.data(), spans.nodes.size() * sizeof(FragmentNode));
+	}
+
+private:
+	int rank_ = 0, size_ = 1;
+	vector<int> sockets_;//sockets_[a * size_ + b]: the end of rank a towards rank b
+	vector<pid_t> children_;
+
+	void closeSockets()
+	{
+		for (int &fd : sockets_)
+			if (fd >= 0)
+			{
+				close(fd);
+				fd = -1;
+			}
+	}
+};
+#endif
+#pragma endregion
+
+#pragma region frames
+//ms and bytes of one rank in the last frame
+struct SortLastStats
+{
+	double buildMs = 0.0;//rasterize the share into full-screen spans
+	double sortMs = 0.0;//depth order per pixel
+	double compositeMs = 0.0;//exchange and merge of the rows
+	double resolveMs = 0.0;//resolve and accumulate the own rows
+	double gatherMs = 0.0;//image rows and h- h+ to rank 0, opacities back
+	double solveMs = 0.0;//rank 0 only
+	double frameMs = 0.0;
+	double compositeBytes = 0.0;//rows sent while compositing
+	double gatherBytes = 0.0;
+	double shareFragments = 0.0;//fragments of the lines of this rank
+	double rowFragments = 0.0;//fragments of the rows of this rank after compositing
+	double dropped = 0.0;
+};
+
+#ifndef _WIN32
+class SortLastRenderer
+{
+public:
+	CompositeMode mode = COMPOSITE_DIRECT_SEND;
+	SortLastStats stats;
+	vector<SortLastStats> rankStats;//rank 0: stats of every rank
+
+	explicit SortLastRenderer(ProcessGroup &group) : group_(group) {}
+
+	//one frame: lines is the whole set(each rank draws its share), opacity the opacities of every segment; rank 0 gets
+	//the image and, with a solver, the opacities solved with opacityParams, which every rank receives for the next frame
+	bool frame(const LineSet &lines, const RenderParams &params, const float *importance, int segmentNum,
+		vector<float> &opacity, OpacitySolver *solver, const OpacityParams &opacityParams, vector<GLuint> &image)
+	{
+		int rank = group_.rank(), ranks = group_.size();
+		auto t0 = chrono::steady_clock::now();
+		auto msSince = [](chrono::steady_clock::time_point t)
+		{
+			return chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+		};
+		stats = SortLastStats();
+		double sentBefore = group_.bytesSent;
+
+		//local share
+		int first, count;
+		sortLastLineRange(lines, rank, ranks, first, count);
+		auto t = chrono::steady_clock::now();
+		rasterizer_.buildSpans(lines.linePart(first, count), params, opacity.data(), segmentNum, spans_);
+		stats.buildMs = msSince(t);
+		stats.shareFragments = spans_.fragmentNum;
+		stats.dropped = spans_.dropped;
+		t = chrono::steady_clock::now();
+		sortSpans(spans_);
+		stats.sortMs = msSince(t);
+
+		//own rows with the fragments of every rank
+		t = chrono::steady_clock::now();
+		int y0 = 0;
+		bool ok = true;
+		if (ranks == 1)
+			std::swap(rows_, spans_);
+		else
+			ok = mode == COMPOSITE_DIRECT_SEND ? directSend(y0) : binarySwap(y0);
+		stats.compositeMs = msSince(t);
+		stats.compositeBytes = group_.bytesSent - sentBefore;
+		stats.rowFragments = rows_.fragmentNum;
+
+		t = chrono::steady_clock::now();
+		vector<GLuint> rowImage;
+		resolver_.strategy = SORT_INSERTION;//already in depth order
+		resolver_.resolve(rows_, rowImage);
+		vector<float> h(2 * (size_t)segmentNum);
+		if (solver != nullptr && rows_.height > 0)
+		{
+			if (rowSolver_.segmentNum() != segmentNum) rowSolver_.resize(segmentNum);
+			rowSolver_.accumulate(rows_, importance);
+			std::copy(rowSolver_.hFront().begin(), rowSolver_.hFront().end(), h.begin());
+			std::copy(rowSolver_.hBack().begin(), rowSolver_.hBack().end(), h.begin() + segmentNum);
+		}
+		stats.resolveMs = msSince(t);
+
+		//rows of the image and the maxima of h- h+ to rank 0, the solved opacities back
+		t = chrono::steady_clock::now();
+		sentBefore = group_.bytesSent;
+		if (rank != 0)
+		{
+			int32_t header[2] = { y0, rows_.height };
+			ok = ok && group_.send(0, header, sizeof(header)) && group_.send(0, rowImage.data(), rowImage.size() * sizeof(GLuint));
+			if (solver != nullptr)
+			{
+				ok = ok && group_.send(0, h.data(), h.size() * sizeof(float));
+				ok = ok && group_.receive(0, opacity.data(), opacity.size() * sizeof(float));
+			}
+			stats.gatherMs = msSince(t);
+			stats.gatherBytes = group_.bytesSent - sentBefore;
+			stats.frameMs = msSince(t0);
+			ok = ok && group_.send(0, &stats, sizeof(stats));
+			return ok;
+		}
+
+		image.assign((size_t)params.width * params.height, 0);
+		std::copy(rowImage.begin(), rowImage.end(), image.begin() + (size_t)y0 * params.width);
+		vector<float> peerH(h.size());
+		for (int peer = 1; peer < ranks && ok; ++peer)
+		{
+			int32_t header[2];
+			ok = group_.receive(peer, header, sizeof(header))
+				&& group_.receive(peer, image.data() + (size_t)header[0] * params.width, (size_t)header[1] * params.width * sizeof(GLuint));
+			if (ok && solver != nullptr)
+			{
+				ok = group_.receive(peer, peerH.data(), peerH.size() * sizeof(float));
+				for (size_t i = 0; i < h.size(); ++i) h[i] = std::max(h[i], peerH[i]);
+			}
+		}
+		if (solver != nullptr && ok)
+		{
+			auto ts = chrono::steady_clock::now();
+			solver->setOcclusion(vector<float>(h.begin(), h.begin() + segmentNum), vector<float>(h.begin() + segmentNum, h.end()));
+			solver->solve(importance, opacityParams, opacity.data());
+			stats.solveMs = msSince(ts);
+			for (int peer = 1; peer < ranks && ok; ++peer)
+				ok = group_.send(peer, opacity.data(), opacity.size() * sizeof(float));
+		}
+		stats.gatherMs = msSince(t) - stats.solveMs;
+		stats.gatherBytes = group_.bytesSent - sentBefore;
+		stats.frameMs = msSince(t0);
+
+		rankStats.assign(ranks, SortLastStats());
+		rankStats[0] = stats;
+		for (int peer = 1; peer < ranks && ok; ++peer)
+			ok = group_.receive(peer, &rankStats[peer], sizeof(SortLastStats));
+		return ok;
+	}
+
+private:
+	ProcessGroup &group_;
+	CpuRasterizer rasterizer_;
+	FragmentSpans spans_;//the share, full screen
+	FragmentSpans rows_;//the own rows after compositing
+	vector<FragmentSpans> parts_;
+	TileResolver resolver_;
+	OpacitySolver rowSolver_;
+
+	//fragments per row of all ranks; the row counts are small enough for the socket buffers, every rank sends
+	//before it receives
+	bool sumRowFragments(vector<GLuint> &total)
+	{
+		int rank = group_.rank(), ranks = group_.size();
+		vector<GLuint> rowFragments = spanRowFragments(spans_), peerRows(rowFragments.size());
+		total = rowFragments;
+		for (int peer = 0; peer < ranks; ++peer)
+			if (peer != rank && !group_.send(peer, rowFragments.data(), rowFragments.size() * sizeof(GLuint))) return false;
+		for (int peer = 0; peer < ranks; ++peer)
+		{
+			if (peer == rank) continue;
+			if (!group_.receive(peer, peerRows.data(), peerRows.size() * sizeof(GLuint))) return false;
+			for (size_t y = 0; y < total.size(); ++y) total[y] += peerRows[y];
+		}
+		return true;
+	}
+
+	//rank k gets band k from everyone; the receives run on threads of their own, so that no two ranks wait for each
+	//other to read
+	bool directSend(int &y0)
+	{
+		int rank = group_.rank(), ranks = group_.size();
+		vector<GLuint> total;
+		if (!sumRowFragments(total)) return false;
+		vector<int> bands = splitRows(total, spans_.width, ranks);
+		auto band = [&](int k) { return bands[k]; };
+		y0 = band(rank);
+		parts_.resize(ranks);
+		std::atomic<bool> ok(true);
+		vector<std::thread> receivers;
+		for (int peer = 0; peer < ranks; ++peer)
+			if (peer != rank)
+				receivers.emplace_back([&, peer]()
+				{
+					int peerY0;
+					if (!group_.receiveSpanRows(peer, parts_[peer], peerY0) || peerY0 != y0) ok = false;
+				});
+		copySpanRows(spans_, y0, band(rank + 1) - y0, parts_[rank]);
+		//staggered, so that not every rank sends to rank 0 first
+		for (int k = 1; k < ranks; ++k)
+		{
+			int peer = (rank + k) % ranks;
+			if (!group_.sendSpanRows(peer, spans_, band(peer), band(peer + 1) - band(peer), band(peer))) ok = false;
+		}
+		for (auto &r : receivers) r.join();
+		if (!ok) return false;
+
+		vector<const FragmentSpans *> parts;
+		for (const FragmentSpans &part : parts_) parts.push_back(&part);
+		mergeSpans(parts, rows_);
+		return true;
+	}
+
+	//in round k the partners differ in bit k; the lower part of the rows goes to the one without the bit
+	//the ranks holding the same rows split them alike, from the fragments of all ranks per row
+	bool binarySwap(int &y0)
+	{
+		int rank = group_.rank(), ranks = group_.size();
+		vector<GLuint> total;
+		if (!sumRowFragments(total)) return false;
+		y0 = 0;
+		const FragmentSpans *current = &spans_;
+		parts_.resize(2);
+		for (int bit = 1; bit < ranks; bit <<= 1)
+		{
+			int partner = rank ^ bit;
+			vector<GLuint> rows(total.begin() + y0, total.begin() + y0 + current->height);
+			int half = splitRows(rows, current->width, 2)[1];
+			bool lower = (rank & bit) == 0;
+			int keep0 = lower ? 0 : half, keepRows = lower ? half : current->height - half;
+			int send0 = lower ? half : 0, sendRows = current->height - keepRows;
+
+			std::atomic<bool> ok(true);
+			int lowerIndex = rank < partner ? 0 : 1;
+			int partnerY0 = 0;
+			std::thread receiver([&]()
+			{
+				if (!group_.receiveSpanRows(partner, parts_[1 - lowerIndex], partnerY0)) ok = false;
+			});
+			if (!group_.sendSpanRows(partner, *current, send0, sendRows, y0 + send0)) ok = false;
+			copySpanRows(*current, keep0, keepRows, parts_[lowerIndex]);
+			receiver.join();
+			y0 += keep0;
+			if (!ok || partnerY0 != y0) return false;
+			mergeSpans({ &parts_[0], &parts_[1] }, rows_);
+			current = &rows_;
+		}
+		return true;
+	}
+};
+#endif
+#pragma endregion
+
+#endif // !SORTLAST_H
@@ -0,0 +1,290 @@
+#ifndef SYNTHETICLINES_H
+#define SYNTHETICLINES_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "commonVars.h"
+#include "LineFile.h"
+#include "Parallel.h"
+
+//reproducible synthetic line sets for benchmarks, every line a polyline of vertsPerLine points one unit apart:
+//	helices:  helices around random axes, 16 points per turn
+//	walks:    random-walk streamlines, the direction turns a little at every point
+//	tangles:  streamlines of the ABC flow, a chaotic steady flow whose lines wind through each other like turbulence
+//line count, line length and depth complexity are independent: the lines start in a cube sized so that they, drawn
+//as 1 pixel strips from the default camera, make about depth fragments per screen pixel, and are folded into it
+//(mirrored at its faces), so the cube stays their bounding box however long they are
+//line i depends only on the spec and i, so the lines are generated in parallel and streamed to the file in blocks
+
+enum SyntheticKind { SYNTHETIC_HELICES, SYNTHETIC_WALKS, SYNTHETIC_TANGLES };
+
+struct SyntheticSpec
+{
+	SyntheticKind kind = SYNTHETIC_WALKS;
+	int lineNum = 1000;
+	int vertsPerLine = 32;
+	float depth = 4.0f;//mean fragments per screen pixel from the default camera
+	unsigned int seed = 1;
+};
+
+inline const char *syntheticKindName(SyntheticKind kind)
+{
+	switch (kind)
+	{
+	case SYNTHETIC_HELICES: return "helices";
+	case SYNTHETIC_WALKS: return "walks";
+	default: return "tangles";
+	}
+}
+
+inline bool parseSyntheticKind(const string &name, SyntheticKind &kind)
+{
+	for (SyntheticKind k : { SYNTHETIC_HELICES, SYNTHETIC_WALKS, SYNTHETIC_TANGLES })
+		if (name == syntheticKindName(k))
+		{
+			kind = k;
+			return true;
+		}
+	return false;
+}
+
+//e.g. walks-10000x32-d4-s1
+inline string syntheticName(const SyntheticSpec &spec)
+{
+	ostringstream ss;
+	ss << syntheticKindName(spec.kind) << "-" << spec.lineNum << "x" << spec.vertsPerLine << "-d" << spec.depth << "-s" << spec.seed;
+	return ss.str();
+}
+
+//edge of the cube: the default camera shows the normalized data about 725 pixels wide, a unit segment in random
+//orientation projects to pi / 4 of its length and a 1 pixel strip makes 2 sqrt(2) / pi fragments per pixel of that,
+//so lineNum * (vertsPerLine - 1) * sqrt(2) / 2 * 725 / size fragments make depth per pixel of the screen
+inline float syntheticDomainSize(const SyntheticSpec &spec)
+{
+	const double screenExtent = 725.0;
+	double fragments = (double)spec.lineNum * std::max(spec.vertsPerLine - 1, 1) * 0.7071068 * screenExtent;
+	return (float)std::max(fragments / ((double)TOTAL_PIXELS * std::max(spec.depth, 1e-3f)), 1.0);
+}
+
+//x mirrored at the faces of [-size / 2, size / 2] until it lies inside
+inline float foldIntoDomain(float x, float size)
+{
+	float t = x / size + 0.5f;
+	t -= 2.0f * std::floor(0.5f * t);
+	if (t > 1.0f) t = 2.0f - t;
+	return (t - 0.5f) * size;
+}
+
+//independent generator per line
+inline unsigned int syntheticLineSeed(unsigned int seed, int line)
+{
+	uint64_t x = ((uint64_t)seed << 32) ^ (uint64_t)(unsigned int)line;
+	x += 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return (unsigned int)(x ^ (x >> 31));
+}
+
+//the vertsPerLine points of line i
+inline void makeSyntheticLine(const SyntheticSpec &spec, float domain, int i, glm::vec3 *out)
+{
+	mt19937 rng(syntheticLineSeed(spec.seed, i));
+	uniform_real_distribution<float> uni(-0.5f, 0.5f);
+	normal_distribution<float> gauss(0.0f, 1.0f);
+	auto randomDirection = [&]()
+	{
+		glm::vec3 d(gauss(rng), gauss(rng), gauss(rng));
+		float l = glm::length(d);
+		return l > 1e-6f ? d / l : glm::vec3(0.0f, 1.0f, 0.0f);
+	};
+	glm::vec3 p = glm::vec3(uni(rng), uni(rng), uni(rng)) * domain;
+	int n = spec.vertsPerLine;
+
+	if (spec.kind == SYNTHETIC_HELICES)
+	{
+		glm::vec3 axis = randomDirection();
+		glm::vec3 u = glm::normalize(glm::cross(axis, std::abs(axis.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f)));
+		glm::vec3 v = glm::cross(axis, u);
+		//unit steps: the chord of 1/16 turn and the rise per point make a unit vector
+		const float turn = 6.2831853f / 16.0f;
+		float radius = 1.2f + (uni(rng) + 0.5f) * 1.2f;
+		float chord = 2.0f * radius * std::sin(0.5f * turn);
+		float rise = std::sqrt(std::max(1.0f - chord * chord, 0.05f));
+		float phase = (uni(rng) + 0.5f) * 6.2831853f;
+		for (int j = 0; j < n; ++j)
+		{
+			float a = phase + j * turn;
+			out[j] = p + radius * (std::cos(a) * u + std::sin(a) * v) + (j * rise) * axis;
+		}
+	}
+	else if (spec.kind == SYNTHETIC_WALKS)
+	{
+		glm::vec3 d = randomDirection();
+		for (int j = 0; j < n; ++j)
+		{
+			out[j] = p;
+			d = glm::normalize(d + 0.25f * glm::vec3(gauss(rng), gauss(rng), gauss(rng)));
+			p += d;
+		}
+	}
+	else
+	{
+		//ABC flow, two periods across the domain, unit steps of the midpoint method
+		const float A = 1.7320508f, B = 1.4142136f, C = 1.0f;
+		float toFlow = 2.0f * 6.2831853f / domain;
+		auto velocity = [&](const glm::vec3 &x)
+		{
+			glm::vec3 q = x * toFlow;
+			glm::vec3 w(A * std::sin(q.z) + C * std::cos(q.y), B * std::sin(q.x) + A * std::cos(q.z), C * std::sin(q.y) + B * std::cos(q.x));
+			float l = glm::length(w);
+			return l > 1e-6f ? w / l : glm::vec3(0.0f, 0.0f, 1.0f);
+		};
+		for (int j = 0; j < n; ++j)
+		{
+			out[j] = p;
+			glm::vec3 mid = p + 0.5f * velocity(p);
+			p += velocity(mid);
+		}
+	}
+	for (int j = 0; j < n; ++j)
+		out[j] = glm::vec3(foldIntoDomain(out[j].x, domain), foldIntoDomain(out[j].y, domain), foldIntoDomain(out[j].z, domain));
+}
+
+//streams the line set of spec into path: .obj as OBJ text, anything else as a line file(LineFile.h) with the weights
+//left to the loader(segmentNum 0, Lines distributes the segments for its segPerLine and patches them in)
+inline bool writeSyntheticLines(const SyntheticSpec &spec, const string &path, string &error)
+{
+	int lineNum = spec.lineNum, perLine = spec.vertsPerLine;
+	if (lineNum < 1 || perLine < 2)
+	{
+		error = "BAD_SPEC " + syntheticName(spec);
+		return false;
+	}
+	//Lines counts vertices in ints
+	if ((uint64_t)lineNum * perLine > (uint64_t)INT32_MAX)
+	{
+		error = "TOO_MANY_VERTICES " + syntheticName(spec);
+		return false;
+	}
+	ofstream fileOut(path, ios::binary);
+	if (!fileOut)
+	{
+		error = "CANNOT_WRITE " + path;
+		return false;
+	}
+	float domain = syntheticDomainSize(spec);
+	bool obj = path.size() >= 4 && path.compare(path.size() - 4, 4, ".obj") == 0;
+
+	LineFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, LINE_FILE_MAGIC, sizeof(header.magic));
+	header.version = LINE_FILE_VERSION;
+	header.lineNum = lineNum;
+	header.vertexNum = (uint64_t)lineNum * perLine;
+	header.segmentNum = 0;
+	layoutLineFile(header);
+	vector<float> lengths;
+	if (!obj)
+	{
+		lengths.resize(lineNum);
+		//the blocks are written out of order, size the file first
+		fileOut.seekp(header.fileSize - 1);
+		fileOut.put(0);
+		fileOut.seekp(0);
+		fileOut.write((const char *)&header, sizeof(header));
+	}
+
+	//blocks of lines generated in parallel
+	const int blockLines = std::max(1, (1 << 22) / perLine);
+	vector<glm::vec3> positions;
+	vector<GLuint> lineIds;
+	vector<string> objText(threadNum());
+	for (int first = 0; first < lineNum; first += blockLines)
+	{
+		int count = std::min(blockLines, lineNum - first);
+		positions.resize((size_t)count * perLine);
+		parallelFor(0, count, [&](int k)
+		{
+			glm::vec3 *p = &positions[(size_t)k * perLine];
+			makeSyntheticLine(spec, domain, first + k, p);
+			if (!obj)
+			{
+				float len = 0.0f;
+				for (int j = 1; j < perLine; ++j) len += glm::length(p[j] - p[j - 1]);
+				lengths[first + k] = len;
+			}
+		}, 64);
+
+		if (obj)
+		{
+			//vertices, then the line records, both formatted per thread block
+			parallelBlocks(count, [&](int t, int begin, int end)
+			{
+				string &text = objText[t];
+				text.clear();
+				char buf[96];
+				for (size_t v = (size_t)begin * perLine; v < (size_t)end * perLine; ++v)
+				{
+					int len = snprintf(buf, sizeof(buf), "v %.7g %.7g %.7g\n", positions[v].x, positions[v].y, positions[v].z);
+					text.append(buf, len);
+				}
+			});
+			for (const string &text : objText) fileOut.write(text.data(), text.size());
+			parallelBlocks(count, [&](int t, int begin, int end)
+			{
+				string &text = objText[t];
+				text.clear();
+				char buf[16];
+				for (int k = begin; k < end; ++k)
+				{
+					text += 'l';
+					size_t base = (size_t)(first + k) * perLine + 1;
+					for (int j = 0; j < perLine; ++j)
+					{
+						int len = snprintf(buf, sizeof(buf), " %zu", base + j);
+						text.append(buf, len);
+					}
+					text += '\n';
+				}
+			});
+			for (const string &text : objText) fileOut.write(text.data(), text.size());
+		}
+		else
+		{
+			size_t firstVertex = (size_t)first * perLine;
+			fileOut.seekp(header.positionsOffset + firstVertex * sizeof(glm::vec3));
+			fileOut.write((const char *)positions.data(), positions.size() * sizeof(glm::vec3));
+			lineIds.resize(positions.size());
+			parallelFor(0, count, [&](int k)
+			{
+				std::fill(lineIds.begin() + (size_t)k * perLine, lineIds.begin() + (size_t)(k + 1) * perLine, (GLuint)(first + k));
+			}, 1024);
+			fileOut.seekp(header.lineIdsOffset + firstVertex * sizeof(GLuint));
+			fileOut.write((const char *)lineIds.data(), lineIds.size() * sizeof(GLuint));
+		}
+	}
+
+	if (!obj)
+	{
+		//weights stay zero(the gap is already zero filled), then the offsets and lengths; the segment counts stay zero
+		vector<GLuint> offsets(lineNum + 1);
+		for (int i = 0; i <= lineNum; ++i) offsets[i] = (GLuint)((size_t)i * perLine);
+		fileOut.seekp(header.lineOffsetsOffset);
+		fileOut.write((const char *)offsets.data(), offsets.size() * sizeof(GLuint));
+		fileOut.seekp(header.lineLengthsOffset);
+		fileOut.write((const char *)lengths.data(), lengths.size() * sizeof(float));
+	}
+	if (!fileOut)
+	{
+		error = "CANNOT_WRITE " + path;
+		return false;
+	}
+	return true;
+}
+
+#endif // !SYNTHETICLINES_H
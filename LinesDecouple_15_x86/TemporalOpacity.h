@@ -0,0 +1,101 @@
+#ifndef TEMPORALOPACITY_H
+#define TEMPORALOPACITY_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+#include "commonVars.h"
+#include "Parallel.h"
+#include "RenderParams.h"
+
+//temporal coherence of the opacity solve during interaction:
+//	every solve starts from the opacities of the last frame(the copy uploaded to SBO_OPACITY) and moves them
+//	by 'smoothing' towards the new solution, an exponential moving average that removes the flicker of
+//	fragments popping in and out of a pixel between frames
+//	a frame whose view moved less than 'viewThreshold' since the last solve skips the read back and solve
+//	once the average has settled, it is built and resolved with the current opacities only
+
+//largest element difference of the two model to clip transforms
+inline float viewChange(const RenderParams &a, const RenderParams &b)
+{
+	glm::mat4 ma = a.modelViewProjectionMatrix * a.transform;
+	glm::mat4 mb = b.modelViewProjectionMatrix * b.transform;
+	float change = 0.0f;
+	for (int c = 0; c < 4; ++c)
+		for (int r = 0; r < 4; ++r)
+			change = std::max(change, std::abs(ma[c][r] - mb[c][r]));
+	return change;
+}
+
+class TemporalOpacity
+{
+public:
+	bool enabled = true;
+	float smoothing = 0.5f;//weight of the new solution, 1 keeps no history
+	float viewThreshold = 1e-3f;//viewChange() below which a frame may skip the solve
+	float settleThreshold = 1e-3f;//largest opacity step of a blend below which the average counts as settled
+
+	int solvedFrames = 0;
+	int skippedFrames = 0;
+	float lastStep = 0.0f;//largest opacity change of the last blend()
+
+	//false if the frame can reuse the current opacities
+	bool needsSolve(const RenderParams &params)
+	{
+		bool skip = enabled && hasView_ && lastStep < settleThreshold && viewChange(params, solvedView_) < viewThreshold;
+		if (skip)
+		{
+			++skippedFrames;
+			return false;
+		}
+		++solvedFrames;
+		solvedView_ = params;
+		hasView_ = true;
+		return true;
+	}
+
+	//opacity: the new solution in, the blended opacities out; the first frame after reset() is taken as is
+	void blend(vector<float> &opacity)
+	{
+		if (!enabled || previous_.size() != opacity.size())
+		{
+			previous_ = opacity;
+			lastStep = 1.0f;
+			return;
+		}
+
+		vector<float> steps(threadNum(), 0.0f);
+		float s = smoothing;
+		parallelBlocks((int)opacity.size(), [&](int t, int begin, int end)
+		{
+			float step = 0.0f;
+			for (int i = begin; i < end; ++i)
+			{
+				float prev = previous_[i];
+				float next = prev + s * (opacity[i] - prev);
+				step = std::max(step, std::abs(next - prev));
+				opacity[i] = next;
+				previous_[i] = next;
+			}
+			steps[t] = step;
+		});
+		lastStep = 0.0f;
+		for (float step : steps) lastStep = std::max(lastStep, step);
+	}
+
+	//forget the history, e.g. after the data or the opacity parameters changed
+	void reset()
+	{
+		previous_.clear();
+		hasView_ = false;
+		lastStep = 0.0f;
+	}
+
+private:
+	vector<float> previous_;
+	RenderParams solvedView_;
+	bool hasView_ = false;
+};
+
+#endif // !TEMPORALOPACITY_H
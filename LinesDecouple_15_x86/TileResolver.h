@@ -0,0 +1,303 @@
+#ifndef TILERESOLVER_H
+#define TILERESOLVER_H
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include "commonVars.h"
+#include "ABuffer.h"
+#include "FragmentSort.h"
+#include "Parallel.h"
+
+//CPU resolve of FragmentLists or FragmentSpans(gather, sort, composite per pixel as resolve.fs) over screen tiles
+//scheduled by work stealing, for frames whose depth complexity is very uneven:
+//	the frame is cut into RESOLVE_TILE_SIZE squares, a tile the fragment counts of the previous frame rate above
+//	1 / RESOLVE_TILE_SHARE of a thread's share is halved along its longer side until it is not(or is one pixel)
+//	the tiles are dealt to the threads by estimated cost, largest first to the least loaded thread, into one deque per
+//	thread; the owner takes the most expensive tile from the back of its deque, an idle thread steals the cheapest
+//	one from the front of another's
+//	every pixel writes its fragment count into the map the next frame is split with
+//the image is the same as resolveFragments() gives
+
+const int RESOLVE_TILE_SIZE = 32;
+const int RESOLVE_TILE_SHARE = 8;
+
+//estimated time of a pixel of n fragments: gather and composite are linear, the sorts of deep pixels n log n
+inline float resolvePixelCost(GLuint n)
+{
+	return 2.0f + n * (1.0f + 0.25f * std::log2(1.0f + n));
+}
+
+struct ResolveTile
+{
+	int x, y, width, height;
+	float cost;
+};
+
+//Chase-Lev deque of tile indices, filled before the workers start: the owner pops at the bottom, thieves take
+//from the top; only the last tile is contended between the owner and a thief
+class TileDeque
+{
+public:
+	void reset()
+	{
+		tiles_.clear();
+		top_.store(0, std::memory_order_relaxed);
+		bottom_.store(0, std::memory_order_relaxed);
+	}
+
+	void push(int tile)
+	{
+		tiles_.push_back(tile);
+		bottom_.store((long long)tiles_.size(), std::memory_order_relaxed);
+	}
+
+	//owner only
+	bool pop(int &tile)
+	{
+		long long b = bottom_.load(std::memory_order_relaxed) - 1;
+		bottom_.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long t = top_.load(std::memory_order_relaxed);
+		if (t > b)
+		{
+			bottom_.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+		tile = tiles_[b];
+		if (t < b) return true;
+		bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		bottom_.store(b + 1, std::memory_order_relaxed);
+		return won;
+	}
+
+	//any other thread, false if empty or lost to the owner or another thief
+	bool steal(int &tile)
+	{
+		long long t = top_.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long b = bottom_.load(std::memory_order_acquire);
+		if (t >= b) return false;
+		tile = tiles_[t];
+		return top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+private:
+	vector<int> tiles_;
+	//on their own cache lines, the owner writes bottom_ on every pop
+	alignas(64) std::atomic<long long> top_{ 0 };
+	alignas(64) std::atomic<long long> bottom_{ 0 };
+};
+
+//what the last resolve() did, per thread and in total
+struct ResolveStats
+{
+	int tiles = 0;
+	int splitTiles = 0;//tiles cut from larger ones by the cost map
+	int steals = 0;
+	double ms = 0.0;
+	vector<double> busyMs;//per thread, time spent on tiles
+	vector<int> threadTiles;
+
+	//slowest thread over the mean, 1 is a perfect balance
+	double imbalance() const
+	{
+		double sum = 0.0, worst = 0.0;
+		for (double b : busyMs)
+		{
+			sum += b;
+			worst = std::max(worst, b);
+		}
+		return sum > 0.0 ? worst * busyMs.size() / sum : 1.0;
+	}
+};
+
+class TileResolver
+{
+public:
+	int tileSize = RESOLVE_TILE_SIZE;
+	int tileShare = RESOLVE_TILE_SHARE;
+	bool useCostMap = true;//false: fixed tiles, every pixel the same cost
+	SortStrategy strategy = SORT_ADAPTIVE;
+	ResolveStats stats;
+
+	//forget the fragment counts, e.g. after a jump of the camera
+	void reset()
+	{
+		counts_.clear();
+	}
+
+	//fragment count per pixel of the last resolve, row 0 at the bottom
+	const vector<GLuint> &fragmentCounts() const { return counts_; }
+
+	template <typename Fragments>
+	void resolve(const Fragments &fragments, vector<GLuint> &image)
+	{
+		auto t0 = chrono::steady_clock::now();
+		int width = fragments.width, height = fragments.height;
+		image.assign((size_t)width * height, 0);
+		int threads = std::max(1, threadNum());
+		planTiles(width, height, threads);
+		if (counts_.size() != image.size()) counts_.assign(image.size(), 0);
+		dealTiles(threads);
+
+		stats.steals = 0;
+		stats.busyMs.assign(threads, 0.0);
+		stats.threadTiles.assign(threads, 0);
+		std::atomic<int> remaining((int)tiles_.size());
+		std::atomic<int> steals(0);
+		parallelRun(threads, [&](int t)
+		{
+			vector<FragmentNode> nodeList(MAX_RESOLVE_NODES);
+			FragmentSorter sorter;
+			sorter.strategy = strategy;
+			unsigned int victim = (unsigned int)t * 2654435761u;
+			double busy = 0.0;
+			int done = 0, stolen = 0;
+			while (remaining.load(std::memory_order_acquire) > 0)
+			{
+				int tile;
+				bool found = deques_[t].pop(tile);
+				for (int k = 1; !found && k < threads; ++k)
+				{
+					victim = victim * 1664525u + 1013904223u;
+					int v = (int)((t + 1 + (victim >> 8) % (threads - 1)) % threads);
+					if (deques_[v].steal(tile))
+					{
+						found = true;
+						++stolen;
+					}
+				}
+				if (!found)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+				auto start = chrono::steady_clock::now();
+				resolveTile(fragments, tiles_[tile], &nodeList[0], sorter, image);
+				busy += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+				++done;
+				remaining.fetch_sub(1, std::memory_order_release);
+			}
+			stats.busyMs[t] = busy;
+			stats.threadTiles[t] = done;
+			steals.fetch_add(stolen);
+		});
+		stats.steals = steals.load();
+		stats.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+	}
+
+private:
+	vector<ResolveTile> tiles_;
+	vector<GLuint> counts_;
+	vector<TileDeque> deques_;
+	int width_ = 0, height_ = 0;
+
+	vector<float> pixelCosts_;//resolvePixelCost() of 0..MAX_RESOLVE_NODES fragments
+
+	float tileCost(const ResolveTile &tile) const
+	{
+		float cost = 0.0f;
+		for (int y = tile.y; y < tile.y + tile.height; ++y)
+		{
+			const GLuint *row = &counts_[(size_t)y * width_];
+			for (int x = tile.x; x < tile.x + tile.width; ++x) cost += pixelCosts_[row[x]];
+		}
+		return cost;
+	}
+
+	void planTiles(int width, int height, int threads)
+	{
+		bool mapped = useCostMap && width == width_ && height == height_ && counts_.size() == (size_t)width * height;
+		if (width != width_ || height != height_) counts_.clear();
+		width_ = width;
+		height_ = height;
+		if (pixelCosts_.empty())
+			for (int n = 0; n <= MAX_RESOLVE_NODES; ++n) pixelCosts_.push_back(resolvePixelCost(n));
+
+		tiles_.clear();
+		for (int y = 0; y < height; y += tileSize)
+			for (int x = 0; x < width; x += tileSize)
+			{
+				ResolveTile tile = { x, y, std::min(tileSize, width - x), std::min(tileSize, height - y), 0.0f };
+				tile.cost = mapped ? tileCost(tile) : (float)(tile.width * tile.height);
+				tiles_.push_back(tile);
+			}
+		stats.splitTiles = 0;
+		if (mapped)
+		{
+			float total = 0.0f;
+			for (const ResolveTile &tile : tiles_) total += tile.cost;
+			float limit = total / ((float)threads * tileShare);
+			//halve along the longer side, the halves go to the end and are checked again
+			for (size_t i = 0; i < tiles_.size(); ++i)
+			{
+				while (tiles_[i].cost > limit && tiles_[i].width * tiles_[i].height > 1)
+				{
+					ResolveTile &tile = tiles_[i];
+					ResolveTile half = tile;
+					if (tile.width >= tile.height)
+					{
+						tile.width /= 2;
+						half.x += tile.width;
+						half.width -= tile.width;
+					}
+					else
+					{
+						tile.height /= 2;
+						half.y += tile.height;
+						half.height -= tile.height;
+					}
+					tile.cost = tileCost(tile);
+					half.cost = tileCost(half);
+					tiles_.push_back(half);
+					++stats.splitTiles;
+				}
+			}
+		}
+		stats.tiles = (int)tiles_.size();
+	}
+
+	//largest first to the least loaded thread; each deque gets its tiles cheapest first, so the owner pops the
+	//most expensive one
+	void dealTiles(int threads)
+	{
+		vector<int> order(tiles_.size());
+		for (size_t i = 0; i < order.size(); ++i) order[i] = (int)i;
+		std::sort(order.begin(), order.end(), [this](int a, int b) { return tiles_[a].cost > tiles_[b].cost; });
+		vector<vector<int>> assigned(threads);
+		vector<float> load(threads, 0.0f);
+		for (int i : order)
+		{
+			int t = (int)(std::min_element(load.begin(), load.end()) - load.begin());
+			assigned[t].push_back(i);
+			load[t] += tiles_[i].cost;
+		}
+		if ((int)deques_.size() != threads) deques_ = vector<TileDeque>(threads);
+		for (int t = 0; t < threads; ++t)
+		{
+			deques_[t].reset();
+			for (auto it = assigned[t].rbegin(); it != assigned[t].rend(); ++it) deques_[t].push(*it);
+		}
+	}
+
+	template <typename Fragments>
+	void resolveTile(const Fragments &fragments, const ResolveTile &tile, FragmentNode *nodeList, FragmentSorter &sorter, vector<GLuint> &image)
+	{
+		for (int y = tile.y; y < tile.y + tile.height; ++y)
+			for (int x = tile.x; x < tile.x + tile.width; ++x)
+			{
+				int pixel = y * width_ + x;
+				int cnt = gatherFragments(fragments, pixel, nodeList, MAX_RESOLVE_NODES);
+				sorter.sort(nodeList, cnt);
+				image[pixel] = packUnorm4x8(compositeFragments(nodeList, cnt));
+				counts_[pixel] = (GLuint)cnt;
+			}
+	}
+};
+
+#endif // !TILERESOLVER_H
@@ -0,0 +1,1825 @@
+#include "commonVars.h"
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Include/shader.hpp"
+#include "Lines.h"
+#include "GLContext.h"
+#include "RenderParams.h"
+#include "ABuffer.h"
+#include "CpuRasterizer.h"
+#include "ImageIO.h"
+#include "OpacitySolver.h"
+#include "RenderPasses.h"
+#include "SortBenchmark.h"
+#include "OpacityCache.h"
+#include "CameraPath.h"
+#include "FrameCapture.h"
+#include "FrameProfiler.h"
+#include "SyntheticLines.h"
+#include "TileResolver.h"
+#include "SortLast.h"
+#include "Tools.h"
+#include "Viewer.h"
+
+using namespace std;
+
+int convertTool(int argc, char **argv);
+int benchObjTool(int argc, char **argv);
+int uploadTool(int argc, char **argv);
+int renderCpuTool(int argc, char **argv);
+int benchSolverTool(int argc, char **argv);
+int benchImportanceTool(int argc, char **argv);
+int benchSegmentsTool(int argc, char **argv);
+int benchABufferTool(int argc, char **argv);
+int benchSortTool(int argc, char **argv);
+int nodeErrorTool(int argc, char **argv);
+int benchTilesTool(int argc, char **argv);
+int benchTemporalTool(int argc, char **argv);
+int precomputeOpacityTool(int argc, char **argv);
+int benchSmoothingTool(int argc, char **argv);
+int benchBvhTool(int argc, char **argv);
+int benchLodTool(int argc, char **argv);
+int benchRibbonsTool(int argc, char **argv);
+int benchQuantizeTool(int argc, char **argv);
+int renderPathTool(int argc, char **argv);
+int profileFramesTool(int argc, char **argv);
+int generateLinesTool(int argc, char **argv);
+int benchSuiteTool(int argc, char **argv);
+int oitErrorTool(int argc, char **argv);
+int benchResolveTool(int argc, char **argv);
+int sortLastTool(int argc, char **argv);
+
+//a SCR_WIDTH x SCR_HEIGHT rgba8 framebuffer for the tools without a window, read with glReadPixels
+static void offscreenConfig()
+{
+	GLuint FBO, RBO_COLOR;
+	glGenFramebuffers(1, &FBO);
+	glGenRenderbuffers(1, &RBO_COLOR);
+	glBindRenderbuffer(GL_RENDERBUFFER, RBO_COLOR);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SCR_WIDTH, SCR_HEIGHT);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, RBO_COLOR);
+	glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+}
+
+//the GL state and offscreen framebuffer of the viewer in a headless context, current until exit
+//tool: prints ERROR::<tool>::NO_CONTEXT if there is none
+static bool headlessGL(const char *tool = nullptr)
+{
+	static HeadlessContext context;
+	if (!context.create())
+	{
+		if (tool != nullptr) cout << "ERROR::" << tool << "::NO_CONTEXT" << endl;
+		return false;
+	}
+	openglConfig();
+	offscreenConfig();
+	return true;
+}
+
+#pragma region command line tools
+bool isTool(const string &name)
+{
+	return name == "convert" || name == "bench-obj" || name == "upload" || name == "render-cpu" || name == "bench-solver" || name == "bench-importance" || name == "bench-segments"
+		|| name == "bench-abuffer" || name == "bench-sort" || name == "node-error" || name == "bench-tiles" || name == "bench-temporal" || name == "precompute-opacity" || name == "bench-smoothing"
+		|| name == "bench-bvh" || name == "bench-lod" || name == "bench-ribbons" || name == "bench-quantize"
+		|| name == "render-path" || name == "profile-frames"
+		|| name == "generate-lines" || name == "bench-suite" || name == "oit-error" || name == "bench-resolve" || name == "sort-last";
+}
+
+int runTool(int argc, char **argv)
+{
+	string name = argv[1];
+	if (name == "convert") return convertTool(argc, argv);
+	if (name == "bench-obj") return benchObjTool(argc, argv);
+	if (name == "upload") return uploadTool(argc, argv);
+	if (name == "render-cpu") return renderCpuTool(argc, argv);
+	if (name == "bench-solver") return benchSolverTool(argc, argv);
+	if (name == "bench-importance") return benchImportanceTool(argc, argv);
+	if (name == "bench-segments") return benchSegmentsTool(argc, argv);
+	if (name == "bench-abuffer") return benchABufferTool(argc, argv);
+	if (name == "bench-sort") return benchSortTool(argc, argv);
+	if (name == "node-error") return nodeErrorTool(argc, argv);
+	if (name == "bench-tiles") return benchTilesTool(argc, argv);
+	if (name == "bench-temporal") return benchTemporalTool(argc, argv);
+	if (name == "precompute-opacity") return precomputeOpacityTool(argc, argv);
+	if (name == "bench-smoothing") return benchSmoothingTool(argc, argv);
+	if (name == "bench-bvh") return benchBvhTool(argc, argv);
+	if (name == "bench-lod") return benchLodTool(argc, argv);
+	if (name == "bench-ribbons") return benchRibbonsTool(argc, argv);
+	if (name == "bench-quantize") return benchQuantizeTool(argc, argv);
+	if (name == "render-path") return renderPathTool(argc, argv);
+	if (name == "profile-frames") return profileFramesTool(argc, argv);
+	if (name == "generate-lines") return generateLinesTool(argc, argv);
+	if (name == "bench-suite") return benchSuiteTool(argc, argv);
+	if (name == "oit-error") return oitErrorTool(argc, argv);
+	if (name == "bench-resolve") return benchResolveTool(argc, argv);
+	if (name == "sort-last") return sortLastTool(argc, argv);
+	return 1;
+}
+
+//convert <in.obj> <out.lbin> [segPerLine]
+//the segment distribution and blending weights are baked for segPerLine, loading with another value recomputes them
+int convertTool(int argc, char **argv)
+{
+	if (argc < 4)
+	{
+		cout << "usage: " << argv[0] << " convert <in.obj> <out.lbin> [segPerLine]" << endl;
+		return 1;
+	}
+	int perLine = argc > 4 ? atoi(argv[4]) : segPerLine;
+	if (perLine < 2)
+	{
+		cout << "ERROR::CONVERT::SEGMENTS_PER_LINE " << perLine << " below 2" << endl;
+		return 1;
+	}
+
+	Lines lines(argv[2], perLine, false);
+	if (!lines.loaded()) return 1;
+	lines.saveBinary(argv[3]);
+	cout << "Converted " << lines.lines_.lineNum << " lines, " << lines.vertexNum_ << " vertices to " << argv[3] << endl;
+	return 0;
+}
+
+//bench-obj [lineNum] [vertsPerLine]
+//OBJ parse throughput over thread counts on a synthetic random-walk file
+int benchObjTool(int argc, char **argv)
+{
+	int lineNum = argc > 2 ? atoi(argv[2]) : 100000;
+	int vertsPerLine = argc > 3 ? atoi(argv[3]) : 50;
+	string text = makeSyntheticObj(lineNum, vertsPerLine);
+	benchmarkObjParser(text, 3);
+	return 0;
+}
+
+//upload <model> [repeats]
+//loads a model into a headless context and reports the VBO upload bandwidth(runs on llvmpipe)
+int uploadTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " upload <model> [repeats]" << endl;
+		return 1;
+	}
+	int repeats = argc > 3 ? atoi(argv[3]) : 5;
+
+	if (!headlessGL()) return 1;
+
+	Lines lines(argv[2], segPerLine);
+	if (!lines.loaded()) return 1;
+	double best = 0.0;
+	for (int i = 0; i < repeats; ++i)
+		best = std::max(best, lines.uploadVertices());
+	cout << "best of " << repeats << " uploads: " << best << " GB/s" << endl;
+	return 0;
+}
+
+//render-cpu <model> <out.ppm> [stripWidth]
+//builds the A-buffer, solves the opacities and rebuilds/resolves with them on the CPU only, a reference for the GL passes
+int renderCpuTool(int argc, char **argv)
+{
+	if (argc < 4)
+	{
+		cout << "usage: " << argv[0] << " render-cpu <model> <out.ppm> [stripWidth]" << endl;
+		return 1;
+	}
+
+	Lines lines(argv[2], segPerLine, false);
+	if (!lines.loaded()) return 1;
+	lines.computeImportance(importMode);
+	resetRotation();
+	RenderParams params = makeRenderParams(lines);
+	if (argc > 4) params.stripWidth = (float)atof(argv[4]);
+	vector<float> opacity(lines.segmentNum_, 1.0f);
+
+	FragmentLists lists;
+	CpuRasterizer rasterizer;
+	OpacitySolver solver;
+	lines.setupSolver(solver);
+	vector<GLuint> image;
+	//the first build runs fully opaque, the second one with the solved opacities
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		auto t0 = chrono::steady_clock::now();
+		rasterizer.build(lines.lines_, params, &opacity[0], (int)opacity.size(), lists);
+		auto t1 = chrono::steady_clock::now();
+		cout << "pass " << pass << ": fragments: " << lists.fragmentNum << ", dropped: " << lists.dropped
+			<< ", build: " << chrono::duration<double, milli>(t1 - t0).count() << " ms" << endl;
+		if (pass == 1) break;
+
+		solver.accumulate(lists, &lines.importance_[0]);
+		solver.solve(&lines.importance_[0], makeOpacityParams(), &opacity[0]);
+		cout << "accumulate: " << solver.accumulateTime << " ms, solve: " << solver.solveTime << " ms" << endl;
+	}
+	auto t2 = chrono::steady_clock::now();
+	resolveFragments(lists, image);
+	cout << "resolve: " << chrono::duration<double, milli>(chrono::steady_clock::now() - t2).count() << " ms" << endl;
+	if (!writePPM(argv[3], &image[0], params.width, params.height))
+	{
+		cout << "ERROR::RENDER_CPU::WRITE_FAILED " << argv[3] << endl;
+		return 1;
+	}
+	return 0;
+}
+
+//bench-solver [segmentNum]
+//closed-form opacity solve over thread counts, scalar against the SIMD kernel
+int benchSolverTool(int argc, char **argv)
+{
+	int segmentNum = argc > 2 ? atoi(argv[2]) : 1000000;
+	benchmarkOpacitySolver(std::max(segmentNum, 1), 10);
+	return 0;
+}
+
+//bench-smoothing <model>
+//the line smoothing of the solved opacities of one CPU frame, line by line against the SIMD batches over thread counts,
+//relative to the occlusion accumulation of the frame
+int benchSmoothingTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " bench-smoothing <model>" << endl;
+		return 1;
+	}
+	Lines lines(argv[2], segPerLine, false);
+	if (!lines.loaded()) return 1;
+	lines.computeImportance(importMode);
+	resetRotation();
+	RenderParams params = makeRenderParams(lines);
+	vector<float> alpha(lines.segmentNum_, 1.0f);
+	CpuRasterizer rasterizer;
+	FragmentSpans spans;
+	rasterizer.buildSpans(lines.lines_, params, &alpha[0], (int)alpha.size(), spans);
+
+	OpacitySolver solver;
+	solver.resize(lines.segmentNum_);
+	solver.accumulate(spans, &lines.importance_[0]);
+	OpacityParams opacityParams = makeOpacityParams();
+	opacityParams.s = 0.0f;
+	solver.solve(&lines.importance_[0], opacityParams, &alpha[0]);
+	cout << "fragments: " << spans.fragmentNum << ", accumulate: " << solver.accumulateTime << " ms, closed form: " << solver.solveTime << " ms" << endl;
+	benchmarkLineSmoothing(lines.lineSegOffsets_.data(), lines.lines_.lineNum, alpha, (float)coff[3], 5, solver.accumulateTime);
+	return 0;
+}
+
+//bench-importance <model>
+//curvature importance over thread counts
+int benchImportanceTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " bench-importance <model>" << endl;
+		return 1;
+	}
+	Lines lines(argv[2], segPerLine, false);
+	if (!lines.loaded()) return 1;
+	benchmarkImportance(lines.lines_, &lines.lineLengths_[0], 5);
+	return 0;
+}
+
+//bench-segments [lineNum] [segPerLine]
+//segment distribution over thread counts, exits with 1 if a distribution is invalid
+int benchSegmentsTool(int argc, char **argv)
+{
+	int lineNum = argc > 2 ? atoi(argv[2]) : 1000000;
+	int perLine = argc > 3 ? atoi(argv[3]) : segPerLine;
+	return benchmarkSegmentDistribution(std::max(lineNum, 1), std::max(perLine, 2), 5) ? 0 : 1;
+}
+
+//bench-abuffer <model> [stripWidth]
+//linked lists against contiguous spans: CPU build/resolve times, image difference and estimated memory traffic,
+//then the GL passes in a headless context if one can be created
+int benchABufferTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " bench-abuffer <model> [stripWidth]" << endl;
+		return 1;
+	}
+	const int repeats = 3;
+
+	Lines cpuLines(argv[2], segPerLine, false);
+	if (!cpuLines.loaded()) return 1;
+	resetRotation();
+	RenderParams params = makeRenderParams(cpuLines);
+	if (argc > 3) params.stripWidth = (float)atof(argv[3]);
+	vector<float> opacity(cpuLines.segmentNum_, 0.5f);
+
+	CpuRasterizer rasterizer;
+	FragmentLists lists;
+	FragmentSpans spans;
+	vector<GLuint> listImage, spanImage;
+	double best[4] = { 1e30, 1e30, 1e30, 1e30 };//list build, list resolve, span build, span resolve
+	for (int r = 0; r < repeats; ++r)
+	{
+		auto t0 = chrono::steady_clock::now();
+		rasterizer.build(cpuLines.lines_, params, &opacity[0], (int)opacity.size(), lists);
+		auto t1 = chrono::steady_clock::now();
+		resolveFragments(lists, listImage);
+		auto t2 = chrono::steady_clock::now();
+		rasterizer.buildSpans(cpuLines.lines_, params, &opacity[0], (int)opacity.size(), spans);
+		auto t3 = chrono::steady_clock::now();
+		resolveFragments(spans, spanImage);
+		auto t4 = chrono::steady_clock::now();
+		best[0] = std::min(best[0], chrono::duration<double, milli>(t1 - t0).count());
+		best[1] = std::min(best[1], chrono::duration<double, milli>(t2 - t1).count());
+		best[2] = std::min(best[2], chrono::duration<double, milli>(t3 - t2).count());
+		best[3] = std::min(best[3], chrono::duration<double, milli>(t4 - t3).count());
+	}
+
+	int maxError = maxImageDifference(listImage, spanImage);
+
+	long long pixelNum = (long long)params.width * params.height;
+	ABufferTraffic listTraffic = linkedListTraffic(pixelNum, lists.fragmentNum);
+	ABufferTraffic spanTraffic = contiguousSpanTraffic(pixelNum, spans.fragmentNum);
+	cout << "fragments: " << lists.fragmentNum << " (lists), " << spans.fragmentNum << " (spans), max image difference " << maxError << endl;
+	cout << "CPU	build ms	resolve ms	build MB	resolve MB" << endl;
+	cout << "lists	" << best[0] << "	" << best[1] << "	" << listTraffic.buildBytes / 1e6 << "	" << listTraffic.resolveBytes / 1e6 << endl;
+	cout << "spans	" << best[2] << "	" << best[3] << "	" << spanTraffic.buildBytes / 1e6 << "	" << spanTraffic.resolveBytes / 1e6 << endl;
+
+	if (!headlessGL()) return 0;
+
+	Lines glLines(argv[2], segPerLine);
+	glLines.uploadOpacity(&opacity[0]);
+	RenderPasses passes;
+	cout << "GL	build ms	resolve ms	fragments" << endl;
+	for (ABufferMode mode : { LINKED_LISTS, CONTIGUOUS_SPANS })
+	{
+		passes.mode = mode;
+		double glBest[2] = { 1e30, 1e30 };
+		for (int r = 0; r < repeats; ++r)
+		{
+			glFinish();
+			auto t0 = chrono::steady_clock::now();
+			passes.build(glLines, params);
+			glFinish();
+			auto t1 = chrono::steady_clock::now();
+			passes.resolve(glLines, params);
+			glFinish();
+			auto t2 = chrono::steady_clock::now();
+			glBest[0] = std::min(glBest[0], chrono::duration<double, milli>(t1 - t0).count());
+			glBest[1] = std::min(glBest[1], chrono::duration<double, milli>(t2 - t1).count());
+		}
+		passes.readBack(glLines, params);
+		GLuint fragments = mode == LINKED_LISTS ? passes.lists.fragmentNum : passes.spans.fragmentNum;
+		cout << (mode == LINKED_LISTS ? "lists\t" : "spans\t") << glBest[0] << "\t" << glBest[1] << "\t" << fragments << endl;
+	}
+
+	//both GL layouts must hold the same fragments
+	resolveFragments(passes.lists, listImage);
+	resolveFragments(passes.spans, spanImage);
+	maxError = maxImageDifference(listImage, spanImage);
+	cout << "GL lists/spans max image difference " << maxError << endl;
+	return 0;
+}
+
+//bench-sort <model|in.hist> [out.hist] [fragmentBudget]
+//replays the fragments-per-pixel histogram of a frame(captured from the CPU A-buffer of a model, or loaded)
+//against every sort strategy on the CPU and, if a headless context can be created, on GL; exits with 1 on a wrong order
+int benchSortTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " bench-sort <model|in.hist> [out.hist] [fragmentBudget]" << endl;
+		return 1;
+	}
+	long long budget = argc > 4 ? atoll(argv[4]) : 2000000;
+	const int repeats = 3;
+
+	string path = argv[2];
+	DepthHistogram hist;
+	if (path.size() > 5 && path.compare(path.size() - 5, 5, ".hist") == 0)
+	{
+		if (!hist.load(path))
+		{
+			cout << "ERROR::BENCH_SORT::READ_FAILED " << path << endl;
+			return 1;
+		}
+	}
+	else
+	{
+		Lines lines(argv[2], segPerLine, false);
+		if (!lines.loaded()) return 1;
+		resetRotation();
+		RenderParams params = makeRenderParams(lines);
+		vector<float> opacity(lines.segmentNum_, 1.0f);
+		CpuRasterizer rasterizer;
+		FragmentSpans spans;
+		rasterizer.buildSpans(lines.lines_, params, &opacity[0], (int)opacity.size(), spans);
+		hist = captureDepthHistogram(spans);
+	}
+	if (argc > 3 && !hist.save(argv[3]))
+	{
+		cout << "ERROR::BENCH_SORT::WRITE_FAILED " << argv[3] << endl;
+		return 1;
+	}
+
+	long long covered = 0;
+	int deepest = 0;
+	for (int n = 1; n < (int)hist.pixels.size(); ++n)
+	{
+		covered += hist.pixels[n];
+		if (hist.pixels[n] > 0) deepest = n;
+	}
+	cout << "histogram: " << covered << " covered pixels, " << hist.fragmentNum() << " fragments, "
+		<< (double)hist.fragmentNum() / std::max(covered, 1LL) << " per covered pixel, deepest " << deepest << endl;
+
+	bool valid = benchmarkFragmentSort(makeSortWorkload(hist, budget), repeats);
+
+	if (headlessGL())
+		valid = benchmarkFragmentSortGL(makeSortWorkload(hist, budget / 10), 2) && valid;
+	return valid ? 0 : 1;
+}
+
+//largest and mean absolute difference of two opacity arrays
+static void printOpacityDifference(const vector<float> &a, const vector<float> &b)
+{
+	double maxDiff = 0.0, sum = 0.0;
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		double d = std::abs((double)a[i] - b[i]);
+		maxDiff = std::max(maxDiff, d);
+		sum += d;
+	}
+	cout << "opacity difference: max " << maxDiff << ", mean " << sum / std::max<size_t>(a.size(), 1) << endl;
+}
+
+//node-error <model> [stripWidth]
+//the two-pass frame of render-cpu with full and with compact span nodes: fragments per capacity,
+//solved opacities and resolved colors against each other(alpha is not displayed and depends on the order of
+//fragments whose depths the compact nodes quantize to the same value), then the same on GL in a headless context
+int nodeErrorTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " node-error <model> [stripWidth]" << endl;
+		return 1;
+	}
+
+	Lines cpuLines(argv[2], segPerLine, false);
+	if (!cpuLines.loaded()) return 1;
+	cpuLines.computeImportance(importMode);
+	resetRotation();
+	RenderParams params = makeRenderParams(cpuLines);
+	if (argc > 3) params.stripWidth = (float)atof(argv[3]);
+
+	const NodeFormat formats[2] = { FULL_NODES, COMPACT_NODES };
+	const char *formatNames[2] = { "full", "compact" };
+	vector<float> opacity[2];
+	vector<GLuint> image[2];
+	CpuRasterizer rasterizer;
+	OpacitySolver solver;
+	cpuLines.setupSolver(solver);
+	FragmentSpans spans;
+	cout << "CPU	node bytes	fragments	capacity	dropped" << endl;
+	for (int f = 0; f < 2; ++f)
+	{
+		opacity[f].assign(cpuLines.segmentNum_, 1.0f);
+		rasterizer.buildSpans(cpuLines.lines_, params, &opacity[f][0], (int)opacity[f].size(), spans, formats[f]);
+		solver.accumulate(spans, &cpuLines.importance_[0]);
+		solver.solve(&cpuLines.importance_[0], makeOpacityParams(), &opacity[f][0]);
+		rasterizer.buildSpans(cpuLines.lines_, params, &opacity[f][0], (int)opacity[f].size(), spans, formats[f]);
+		resolveFragments(spans, image[f]);
+		cout << formatNames[f] << "	" << (f == 0 ? sizeof(FragmentNode) : sizeof(CompactNode)) << "	" << spans.fragmentNum
+			<< "	" << nodeCapacity(formats[f]) << "	" << spans.dropped << endl;
+	}
+	printOpacityDifference(opacity[0], opacity[1]);
+	cout << "rgb difference: max " << maxImageDifference(image[0], image[1], 3) << ", PSNR " << imagePSNR(image[0], image[1]) << " dB" << endl;
+
+	if (!headlessGL()) return 0;
+
+	Lines glLines(argv[2], segPerLine);
+	glLines.computeImportance(importMode);
+	RenderPasses passes;
+	passes.mode = CONTIGUOUS_SPANS;
+	cout << "GL	fragments	dropped	resolve ms" << endl;
+	for (int f = 0; f < 2; ++f)
+	{
+		passes.format = formats[f];
+		opacity[f].assign(glLines.segmentNum_, 1.0f);
+		glLines.uploadOpacity(&opacity[f][0]);
+		passes.build(glLines, params);
+		passes.readBack(glLines, params);
+		passes.solve(glLines, solver, makeOpacityParams(), opacity[f]);
+		passes.build(glLines, params);
+		glFinish();
+		auto t0 = chrono::steady_clock::now();
+		passes.resolve(glLines, params);
+		glFinish();
+		double resolveMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+		passes.readBack(glLines, params);
+		image[f].resize(TOTAL_PIXELS);
+		glReadPixels(0, 0, SCR_WIDTH, SCR_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, &image[f][0]);
+		cout << formatNames[f] << "	" << passes.spans.fragmentNum << "	" << passes.spans.dropped << "	" << resolveMs << endl;
+	}
+	printOpacityDifference(opacity[0], opacity[1]);
+	cout << "rgb difference: max " << maxImageDifference(image[0], image[1], 3) << ", PSNR " << imagePSNR(image[0], image[1]) << " dB" << endl;
+	return 0;
+}
+
+//bench-tiles <model> [fragmentBudget]
+//one frame per A-buffer layout in a single pass and in screen tiles of at most fragmentBudget fragments(default: a quarter
+//of the frame) in a headless context; the images and solved opacities must be identical, exits with 1 otherwise
+int benchTilesTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " bench-tiles <model> [fragmentBudget]" << endl;
+		return 1;
+	}
+
+	if (!headlessGL("BENCH_TILES")) return 1;
+
+	Lines glLines(argv[2], segPerLine);
+	if (!glLines.loaded()) return 1;
+	glLines.computeImportance(importMode);
+	resetRotation();
+	RenderParams params = makeRenderParams(glLines);
+	RenderPasses passes;
+	OpacitySolver solver;
+	glLines.setupSolver(solver);
+
+	const ABufferMode modes[3] = { LINKED_LISTS, CONTIGUOUS_SPANS, CONTIGUOUS_SPANS };
+	const NodeFormat formats[3] = { FULL_NODES, FULL_NODES, COMPACT_NODES };
+	const char *names[3] = { "lists", "spans", "compact" };
+	bool identical = true;
+	cout << "layout\tfragments\tbudget\ttiles\tdropped\tsingle ms\ttiled ms\timage difference\topacity difference" << endl;
+	for (int m = 0; m < 3; ++m)
+	{
+		passes.mode = modes[m];
+		passes.format = formats[m];
+		vector<float> opacity[2];
+		vector<GLuint> image[2];
+		double ms[2];
+		GLuint budget = 0;
+		//run 0 in a single pass, run 1 tiled, both from fully opaque
+		for (int run = 0; run < 2; ++run)
+		{
+			passes.tiling = run == 1;
+			passes.fragmentBudget = budget;
+			opacity[run].assign(glLines.segmentNum_, 1.0f);
+			glLines.uploadOpacity(&opacity[run][0]);
+			glFinish();
+			auto t0 = chrono::steady_clock::now();
+			passes.frame(glLines, solver, makeOpacityParams(), params, opacity[run]);
+			glFinish();
+			ms[run] = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+			image[run].resize(TOTAL_PIXELS);
+			glReadPixels(0, 0, SCR_WIDTH, SCR_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, &image[run][0]);
+			if (run == 0)
+				budget = argc > 3 ? (GLuint)atoll(argv[3]) : passes.frameFragments / 4 + 1;
+		}
+
+		float opacityError = 0.0f;
+		for (size_t i = 0; i < opacity[0].size(); ++i)
+			opacityError = std::max(opacityError, std::abs(opacity[0][i] - opacity[1][i]));
+		int imageError = maxImageDifference(image[0], image[1]);
+		identical = identical && imageError == 0 && opacityError == 0.0f;
+		cout << names[m] << "\t" << passes.frameFragments << "\t" << budget << "\t" << passes.tileNum << "\t" << passes.frameDropped
+			<< "\t" << ms[0] << "\t" << ms[1] << "\t" << imageError << "\t" << opacityError << endl;
+	}
+	if (!identical) cout << "ERROR::BENCH_TILES::TILED_FRAME_DIFFERS" << endl;
+	return identical ? 0 : 1;
+}
+
+//bench-temporal <model> [frames] [degreesPerFrame]
+//an alt-drag on the CPU: 'frames' frames rotating by degreesPerFrame, then as many still ones; every frame solved on
+//its own against the temporal mode, reporting solve time, solved frames, flicker(mean opacity change between frames)
+//and the distance to the independent solution
+int benchTemporalTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " bench-temporal <model> [frames] [degreesPerFrame]" << endl;
+		return 1;
+	}
+	int frames = argc > 3 ? std::max(atoi(argv[3]), 1) : 20;
+	float degrees = argc > 4 ? (float)atof(argv[4]) : 0.5f;
+
+	Lines lines(argv[2], segPerLine, false);
+	if (!lines.loaded()) return 1;
+	lines.computeImportance(importMode);
+	int segmentNum = lines.segmentNum_;
+	CpuRasterizer rasterizer;
+	FragmentSpans spans;
+	OpacitySolver solver;
+	lines.setupSolver(solver);
+	TemporalOpacity temporal;
+	//0: independent frames, 1: temporal
+	vector<float> opacity[2] = { vector<float>(segmentNum, 1.0f), vector<float>(segmentNum, 1.0f) };
+	vector<float> last[2];
+	double solveMs[2] = { 0.0, 0.0 }, flicker[2] = { 0.0, 0.0 };
+	int solved[2] = { 0, 0 };
+
+	for (int f = 0; f < 2 * frames; ++f)
+	{
+		resetRotation(degrees * std::min(f, frames));
+		RenderParams params = makeRenderParams(lines);
+		for (int m = 0; m < 2; ++m)
+		{
+			last[m] = opacity[m];
+			if (m == 1 && !temporal.needsSolve(params)) continue;
+			auto t0 = chrono::steady_clock::now();
+			rasterizer.buildSpans(lines.lines_, params, &opacity[m][0], segmentNum, spans);
+			solver.accumulate(spans, &lines.importance_[0]);
+			solver.solve(&lines.importance_[0], makeOpacityParams(), &opacity[m][0]);
+			if (m == 1) temporal.blend(opacity[m]);
+			solveMs[m] += chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+			++solved[m];
+		}
+		if (f == 0) continue;
+		for (int m = 0; m < 2; ++m)
+		{
+			double change = 0.0;
+			for (int i = 0; i < segmentNum; ++i) change += std::abs(opacity[m][i] - last[m][i]);
+			flicker[m] += change / segmentNum / (2 * frames - 1);
+		}
+	}
+
+	double distance = 0.0;
+	for (int i = 0; i < segmentNum; ++i) distance += std::abs(opacity[0][i] - opacity[1][i]);
+	cout << 2 * frames << " frames, " << frames << " rotating by " << degrees << " degrees" << endl;
+	cout << "mode\tsolved\tbuild+solve ms\tflicker" << endl;
+	cout << "frames\t" << solved[0] << "\t" << solveMs[0] << "\t" << flicker[0] << endl;
+	cout << "temporal\t" << solved[1] << "\t" << solveMs[1] << "\t" << flicker[1] << endl;
+	cout << "final mean distance to the independent solution: " << distance / segmentNum << endl;
+	return 0;
+}
+
+//precompute-opacity <model> [viewNum]
+//solves the opacities of viewNum Fibonacci sphere directions(default 64) for the current coff and importance and writes
+//them next to the model, where main picks them up; GL in a headless context if one can be created, the CPU otherwise.
+//the lookup is then checked against live solves of a few random directions
+int precomputeOpacityTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " precompute-opacity <model> [viewNum]" << endl;
+		return 1;
+	}
+	int viewNum = argc > 3 ? std::max(atoi(argv[3]), 1) : 64;
+
+	Lines lines(argv[2], segPerLine, false);
+	if (!lines.loaded()) return 1;
+	lines.computeImportance(importMode);
+	int segmentNum = lines.segmentNum_;
+
+	std::unique_ptr<Lines> glLines;
+	std::unique_ptr<RenderPasses> passes;
+	if (headlessGL())
+	{
+		glLines.reset(new Lines(argv[2], segPerLine, true, lineGeometry, vertexFormat));
+		glLines->computeImportance(importMode);
+		passes = viewerPasses();
+	}
+	//the CPU rasterizes ribbons of float vertices
+	OpacityCacheKey key = makeOpacityCacheKey(lines.lines_, segmentNum, importMode, coff, makeRenderParams(lines),
+		glLines ? glLines->geometry() : RIBBONS, glLines ? glLines->vertexFormat() : FLOAT_VERTICES, nodeFormat);
+	OpacityCache cache;
+	cache.reset(key, fibonacciSphere(viewNum));
+	CpuRasterizer rasterizer;
+	FragmentSpans spans;
+	OpacitySolver solver;
+	lines.setupSolver(solver);
+	vector<float> opacity(segmentNum, 1.0f);
+	//one build per view, the fragments do not depend on the opacities
+	auto solveView = [&](const glm::vec3 &d, vector<float> &out)
+	{
+		rotMat = rotationTowardsCamera(d);
+		RenderParams params = makeRenderParams(lines);
+		if (passes)
+		{
+			passes->build(*glLines, params);
+			passes->readBack(*glLines, params);
+			passes->solve(*glLines, solver, makeOpacityParams(), out);
+		}
+		else
+		{
+			rasterizer.buildSpans(lines.lines_, params, &out[0], segmentNum, spans, nodeFormat);
+			solver.accumulate(spans, &lines.importance_[0]);
+			solver.solve(&lines.importance_[0], makeOpacityParams(), &out[0]);
+		}
+	};
+
+	auto t0 = chrono::steady_clock::now();
+	for (int v = 0; v < viewNum; ++v)
+	{
+		solveView(cache.directions[v], opacity);
+		cache.setView(v, &opacity[0]);
+	}
+	double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+	string path = opacityCachePath(argv[2], key);
+	if (!cache.save(path))
+	{
+		cout << "ERROR::PRECOMPUTE_OPACITY::WRITE_FAILED " << path << endl;
+		return 1;
+	}
+	cout << viewNum << " views on the " << (passes ? "GPU" : "CPU") << " in " << ms << " ms, "
+		<< (double)cache.opacity.size() * sizeof(uint16_t) / 1e6 << " MB: " << path << endl;
+
+	//random directions: cached lookup against a live solve
+	mt19937 rng(7);
+	normal_distribution<float> gauss;
+	vector<float> looked(segmentNum);
+	double maxError = 0.0, sumError = 0.0;
+	const int checks = 4;
+	t0 = chrono::steady_clock::now();
+	for (int c = 0; c < checks; ++c)
+	{
+		glm::vec3 d = glm::normalize(glm::vec3(gauss(rng), gauss(rng), gauss(rng)));
+		cache.lookup(d, &looked[0]);
+		solveView(d, opacity);
+		for (int i = 0; i < segmentNum; ++i)
+		{
+			double e = std::abs(looked[i] - opacity[i]);
+			maxError = std::max(maxError, e);
+			sumError += e;
+		}
+	}
+	double solveMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() / checks;
+	t0 = chrono::steady_clock::now();
+	cache.lookup(glm::vec3(0.0f, 0.0f, 1.0f), &looked[0]);
+	double lookupMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+	cout << "lookup against live solve over " << checks << " random views: max error " << maxError << ", mean error "
+		<< sumError / ((double)checks * segmentNum) << "; lookup " << lookupMs << " ms, build + solve " << solveMs << " ms" << endl;
+	return 0;
+}
+
+//bench-bvh [model | lineNum] [vertsPerLine] [views]
+//BVH build time and culling rate on a model or on lineNum synthetic random-walk lines(default 1M of 48 vertices)
+int benchBvhTool(int argc, char **argv)
+{
+	string source = argc > 2 ? argv[2] : "1000000";
+	int views = argc > 4 ? atoi(argv[4]) : 8;
+	if (source.find_first_not_of("0123456789") == string::npos)
+	{
+		int vertsPerLine = argc > 3 ? atoi(argv[3]) : 48;
+		Arena arena;
+		LineSet lines;
+		makeSyntheticLineSet(arena, lines, atoi(source.c_str()), vertsPerLine);
+		benchmarkLineBVH(lines, views, 3);
+	}
+	else
+	{
+		Lines lines(source, segPerLine, false);
+		if (!lines.loaded()) return 1;
+		benchmarkLineBVH(lines.lines_, views, 3);
+	}
+	return 0;
+}
+
+//bench-lod <model> [maxPixelError]
+//the camera backs off from the data in 4 steps of sqrt(2), before the far plane clips it; per distance one frame is solved at full detail, then built and
+//resolved with those opacities at full detail and with the selected levels(both culled), reporting the fragments,
+//the build and resolve times and the image difference
+int benchLodTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " bench-lod <model> [maxPixelError]" << endl;
+		return 1;
+	}
+	float pixelError = argc > 3 ? (float)atof(argv[3]) : lodPixelError;
+
+	if (!headlessGL("BENCH_LOD")) return 1;
+
+	Lines glLines(argv[2], segPerLine);
+	if (!glLines.loaded()) return 1;
+	glLines.computeImportance(importMode);
+	resetRotation();
+	RenderPasses passes;
+	passes.tiling = false;
+	OpacitySolver solver;
+	glLines.setupSolver(solver);
+
+	glLines.buildLevels();
+	cout << "max pixel error " << pixelError << ", level vertices:";
+	for (int level = 1; level < LOD_LEVELS; ++level) cout << " " << glLines.lod_.levelVertexNum(level);
+	cout << " (full " << glLines.vertexNum_ << ")" << endl;
+	cout << "distance	full fragments	lod fragments	full build ms	lod build ms	full resolve ms	lod resolve ms	select ms	rgb max	PSNR dB" << endl;
+	glm::vec3 start = camera.Position;
+	for (int step = 0; step < 4; ++step)
+	{
+		float distance = std::pow(std::sqrt(2.0f), (float)step);
+		camera.Position = start * distance;
+		RenderParams params = makeRenderParams(glLines);
+		vector<float> opacity(glLines.segmentNum_, 1.0f);
+		glLines.uploadOpacity(&opacity[0]);
+		glLines.cull(params);
+		passes.frame(glLines, solver, makeOpacityParams(), params, opacity);
+
+		GLuint fragments[2];
+		double buildMs[2], resolveMs[2];
+		vector<GLuint> image[2];
+		for (int run = 0; run < 2; ++run)
+		{
+			glLines.cull(params);
+			if (run == 1) glLines.selectLevels(params, pixelError);
+			glFinish();
+			auto t0 = chrono::steady_clock::now();
+			passes.build(glLines, params);
+			glFinish();
+			auto t1 = chrono::steady_clock::now();
+			passes.resolve(glLines, params);
+			glFinish();
+			auto t2 = chrono::steady_clock::now();
+			buildMs[run] = chrono::duration<double, milli>(t1 - t0).count();
+			resolveMs[run] = chrono::duration<double, milli>(t2 - t1).count();
+			image[run].resize(TOTAL_PIXELS);
+			glReadPixels(0, 0, SCR_WIDTH, SCR_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, &image[run][0]);
+			passes.readBack(glLines, params);
+			fragments[run] = passes.lists.fragmentNum + passes.lists.dropped;
+		}
+		cout << distance << "	" << fragments[0] << "	" << fragments[1] << "	" << buildMs[0] << "	" << buildMs[1] << "	"
+			<< resolveMs[0] << "	" << resolveMs[1] << "	" << glLines.lod_.selectTime << "	" << maxImageDifference(image[0], image[1], 3)
+			<< "	" << imagePSNR(image[0], image[1]) << endl;
+	}
+	return 0;
+}
+
+//bench-ribbons <model>
+//ribbon generation against the model load(scalar and AVX2 tangents over thread counts), then one frame of ribbons with the
+//opacities of a CPU solve in a headless context: drawn with the index buffer, as culled strips and by the CPU rasterizer,
+//and by the CPU rasterizer for a copy of the model moved off-center, which the normalization must undo(exits with 1 otherwise)
+int benchRibbonsTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " bench-ribbons <model>" << endl;
+		return 1;
+	}
+
+	double loadMs = 1e30;
+	for (int r = 0; r < 3; ++r)
+	{
+		auto t0 = chrono::steady_clock::now();
+		if (isLineFile(argv[2]))
+		{
+			Lines lines(argv[2], segPerLine, false);
+		}
+		else
+		{
+			ObjData obj;
+			parseObjFile(argv[2], obj);
+		}
+		loadMs = std::min(loadMs, chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+	}
+	Lines cpuLines(argv[2], segPerLine, false);
+	if (!cpuLines.loaded()) return 1;
+	cpuLines.computeImportance(importMode);
+	benchmarkRibbons(cpuLines.lines_, loadMs, 3);
+
+	if (!headlessGL()) return 0;
+
+	resetRotation();
+	RenderParams params = makeRenderParams(cpuLines);
+	CpuRasterizer rasterizer;
+	OpacitySolver solver;
+	cpuLines.setupSolver(solver);
+	FragmentSpans spans;
+	vector<float> opacity(cpuLines.segmentNum_, 1.0f);
+	rasterizer.buildSpans(cpuLines.lines_, params, &opacity[0], (int)opacity.size(), spans);
+	solver.accumulate(spans, &cpuLines.importance_[0]);
+	solver.solve(&cpuLines.importance_[0], makeOpacityParams(), &opacity[0]);
+	rasterizer.buildSpans(cpuLines.lines_, params, &opacity[0], (int)opacity.size(), spans);
+	vector<GLuint> image[3];
+	resolveFragments(spans, image[2]);
+	GLuint fragments[3];
+	fragments[2] = spans.fragmentNum + spans.dropped;
+
+	//a copy moved by a few extents: the normalization takes the move back, the ribbons must not change
+	const LineSet &lines = cpuLines.lines_;
+	glm::vec3 shift = glm::vec3(4.0f, -3.0f, 5.0f) / cpuLines.normalization()[0][0];
+	Arena arena;
+	LineSet shifted;
+	shifted.allocate(arena, lines.lineNum, lines.vertexNum);
+	memcpy(shifted.lineIds, lines.lineIds, lines.vertexNum * sizeof(GLuint));
+	memcpy(shifted.weights, lines.weights, lines.vertexNum * sizeof(GLfloat));
+	memcpy(shifted.lineOffsets, lines.lineOffsets, (lines.lineNum + 1) * sizeof(GLuint));
+	parallelFor(0, lines.vertexNum, [&](int j) { shifted.positions[j] = lines.positions[j] + shift; }, 1 << 14);
+	RenderParams shiftedParams = params;
+	shiftedParams.transform = params.transform * glm::translate(glm::mat4(1.0f), -shift);
+	rasterizer.buildSpans(shifted, shiftedParams, &opacity[0], (int)opacity.size(), spans);
+	vector<GLuint> shiftedImage;
+	resolveFragments(spans, shiftedImage);
+	double shiftedPSNR = imagePSNR(image[2], shiftedImage);
+	cout << "off-center copy against the cpu frame: rgb max " << maxImageDifference(image[2], shiftedImage, 3)
+		<< ", PSNR " << shiftedPSNR << " dB" << endl;
+	//only rounding at the ribbon edges may differ
+	bool centered = shiftedPSNR >= 40.0;
+	if (!centered) cout << "ERROR::BENCH_RIBBONS::OFF_CENTER_COPY_DIFFERS" << endl;
+
+	Lines glLines(argv[2], segPerLine, true, RIBBONS);
+	glLines.uploadOpacity(&opacity[0]);
+	RenderPasses passes;
+	passes.mode = CONTIGUOUS_SPANS;
+	passes.tiling = false;
+	double resolveMs[2];
+	for (int run = 0; run < 2; ++run)
+	{
+		if (run == 0) glLines.resetCulling();
+		else glLines.cull(params);
+		passes.build(glLines, params);
+		glFinish();
+		auto t0 = chrono::steady_clock::now();
+		passes.resolve(glLines, params);
+		glFinish();
+		resolveMs[run] = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+		image[run].resize(TOTAL_PIXELS);
+		glReadPixels(0, 0, SCR_WIDTH, SCR_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, &image[run][0]);
+		passes.readBack(glLines, params);
+		fragments[run] = passes.spans.fragmentNum + passes.spans.dropped;
+	}
+	cout << "frame	fragments	resolve ms	rgb max	PSNR dB(against the indexed draw)" << endl;
+	const char *names[3] = { "indexed", "culled", "cpu" };
+	for (int run = 0; run < 3; ++run)
+	{
+		cout << names[run] << "	" << fragments[run] << "	";
+		if (run < 2) cout << resolveMs[run];
+		cout << "	" << maxImageDifference(image[0], image[run], 3) << "	" << imagePSNR(image[0], image[run]) << endl;
+	}
+	return centered ? 0 : 1;
+}
+
+//bench-quantize <model>
+//memory and errors of the quantized vertices, then one frame of ribbons with the opacities of a CPU solve in a headless
+//context: float and quantized vertices on GL and the CPU rasterizer on the decoded vertices
+int benchQuantizeTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " bench-quantize <model>" << endl;
+		return 1;
+	}
+
+	Lines cpuLines(argv[2], segPerLine, false);
+	if (!cpuLines.loaded()) return 1;
+	cpuLines.computeImportance(importMode);
+	const LineSet &lines = cpuLines.lines_;
+	QuantizedLines quant;
+	quant.build(lines);
+	Arena arena;
+	LineSet decoded;
+	auto t0 = chrono::steady_clock::now();
+	quant.decode(arena, decoded);
+	double decodeMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+	int lineErrors = 0;
+	for (int v = 0; v < lines.vertexNum; ++v) lineErrors += decoded.lineIds[v] != lines.lineIds[v] ? 1 : 0;
+
+	double mb = 1.0 / (1024.0 * 1024.0);
+	double floatStrips = lines.vertexNum * (sizeof(glm::vec3) + sizeof(GLuint) + sizeof(GLfloat)) * mb;
+	double floatRibbons = ribbonLayout(lines.vertexNum).size * mb;
+	double quantRibbons = (quantRibbonLayout(lines.vertexNum).size + quant.bytes() - quant.vertices().size() * sizeof(QuantVertex)) * mb;
+	float extent = 1.0f / cpuLines.normalization()[0][0];
+	cout << lines.vertexNum << " points in " << quant.blockNum() << " blocks of " << QUANT_BLOCK_POINTS << ", quantized in " << quant.buildTime
+		<< " ms, decoded in " << decodeMs << " ms" << endl;
+	cout << "strips: " << floatStrips << " MB float, " << quant.bytes() * mb << " MB quantized, saved " << floatStrips - quant.bytes() * mb << " MB" << endl;
+	cout << "ribbons: " << floatRibbons << " MB float, " << quantRibbons << " MB quantized, saved " << floatRibbons - quantRibbons << " MB" << endl;
+	cout << "max position error " << quant.maxPositionError << " (" << quant.maxPositionError / extent << " of the extent), max weight error "
+		<< quant.maxWeightError << ", segment changes " << quant.segmentChanges << ", line id errors " << lineErrors << endl;
+
+	if (!headlessGL()) return 0;
+
+	resetRotation();
+	RenderParams params = makeRenderParams(cpuLines);
+	CpuRasterizer rasterizer;
+	OpacitySolver solver;
+	cpuLines.setupSolver(solver);
+	FragmentSpans spans;
+	vector<float> opacity(cpuLines.segmentNum_, 1.0f);
+	rasterizer.buildSpans(lines, params, &opacity[0], (int)opacity.size(), spans);
+	solver.accumulate(spans, &cpuLines.importance_[0]);
+	solver.solve(&cpuLines.importance_[0], makeOpacityParams(), &opacity[0]);
+	rasterizer.buildSpans(decoded, params, &opacity[0], (int)opacity.size(), spans);
+	vector<GLuint> image[3];
+	resolveFragments(spans, image[2]);
+	GLuint fragments[3];
+	fragments[2] = spans.fragmentNum + spans.dropped;
+
+	const VertexFormat formats[2] = { FLOAT_VERTICES, QUANTIZED_VERTICES };
+	double resolveMs[2];
+	RenderPasses passes;
+	passes.mode = CONTIGUOUS_SPANS;
+	passes.tiling = false;
+	for (int run = 0; run < 2; ++run)
+	{
+		Lines glLines(argv[2], segPerLine, true, RIBBONS, formats[run]);
+		RenderParams glParams = makeRenderParams(glLines);
+		glLines.uploadOpacity(&opacity[0]);
+		passes.build(glLines, glParams);
+		glFinish();
+		auto t1 = chrono::steady_clock::now();
+		passes.resolve(glLines, glParams);
+		glFinish();
+		resolveMs[run] = chrono::duration<double, milli>(chrono::steady_clock::now() - t1).count();
+		image[run].resize(TOTAL_PIXELS);
+		glReadPixels(0, 0, SCR_WIDTH, SCR_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, &image[run][0]);
+		passes.readBack(glLines, glParams);
+		fragments[run] = passes.spans.fragmentNum + passes.spans.dropped;
+	}
+	cout << "frame	fragments	resolve ms	rgb max	PSNR dB(against the quantized GL frame)" << endl;
+	const char *names[3] = { "float", "quantized", "cpu decoded" };
+	for (int run = 0; run < 3; ++run)
+	{
+		cout << names[run] << "	" << fragments[run] << "	";
+		if (run < 2) cout << resolveMs[run];
+		cout << "	" << maxImageDifference(image[1], image[run], 3) << "	" << imagePSNR(image[1], image[run]) << endl;
+	}
+	return 0;
+}
+
+//render-path <model> <camera path> <output prefix> [png|exr|ppm]
+//renders every frame of the camera path(CameraPath.h) in a headless context with the viewer's settings into
+//<prefix>00000.png ..., the color read backs go through PBOs and the files are written on a separate thread;
+//per-frame times go to <prefix>timing.csv
+int renderPathTool(int argc, char **argv)
+{
+	if (argc < 5)
+	{
+		cout << "usage: " << argv[0] << " render-path <model> <camera path> <output prefix> [png|exr|ppm]" << endl;
+		return 1;
+	}
+	string prefix = argv[4];
+	string extension = argc > 5 ? argv[5] : "png";
+	if (extension != "png" && extension != "exr" && extension != "ppm")
+	{
+		cout << "ERROR::RENDER_PATH::UNKNOWN_FORMAT " << extension << endl;
+		return 1;
+	}
+	CameraPath path;
+	string error;
+	if (!path.load(argv[3], error))
+	{
+		cout << "ERROR::RENDER_PATH::" << error << endl;
+		return 1;
+	}
+
+	if (!headlessGL("RENDER_PATH")) return 1;
+
+	Lines glLines(argv[2], segPerLine, true, lineGeometry, vertexFormat);
+	if (!glLines.loaded()) return 1;
+	glLines.computeImportance(importMode);
+	std::unique_ptr<RenderPasses> passes = viewerPasses();
+	OpacitySolver solver;
+	glLines.setupSolver(solver);
+	vector<float> opacity(glLines.segmentNum_, 1.0f);
+	TemporalOpacity temporal;
+	temporal.enabled = temporalOpacity;
+	OpacityCache opacityCache;
+	if (useOpacityCache)
+	{
+		OpacityCacheKey key = makeOpacityCacheKey(glLines.lines_, glLines.segmentNum_, importMode, coff, makeRenderParams(glLines),
+			glLines.geometry(), glLines.vertexFormat(), nodeFormat);
+		if (opacityCache.load(opacityCachePath(argv[2], key), key))
+			cout << "Loaded opacity cache: " << opacityCache.viewNum() << " views" << endl;
+	}
+
+	struct FrameTiming { float time; double setupMs, renderMs, captureMs; GLuint fragments; };
+	int frameNum = path.frameNum();
+	vector<FrameTiming> timings(frameNum);
+	FrameCapture capture(SCR_WIDTH, SCR_HEIGHT);
+	auto start = chrono::steady_clock::now();
+	for (int f = 0; f < frameNum; ++f)
+	{
+		auto t0 = chrono::steady_clock::now();
+		applyCameraKey(path.frame(f));
+		RenderParams params = makeRenderParams(glLines);
+		if (frustumCulling) glLines.cull(params);
+		if (lineLod) glLines.selectLevels(params, lodPixelError);
+		auto t1 = chrono::steady_clock::now();
+		if (!opacityCache.empty())
+		{
+			opacityCache.lookup(dataViewDirection(params), &opacity[0]);
+			glLines.uploadOpacity(&opacity[0]);
+			passes->draw(glLines, params);
+		}
+		else
+			passes->frame(glLines, solver, makeOpacityParams(), params, opacity, &temporal);
+		auto t2 = chrono::steady_clock::now();
+
+		ostringstream name;
+		name << prefix << setw(5) << setfill('0') << f << "." << extension;
+		capture.capture(name.str(), f);
+		timings[f].time = path.frameTime(f);
+		timings[f].setupMs = chrono::duration<double, milli>(t1 - t0).count();
+		timings[f].renderMs = chrono::duration<double, milli>(t2 - t1).count();
+		timings[f].captureMs = capture.waitTime;
+		timings[f].fragments = passes->frameFragments;
+		if ((f + 1) % 100 == 0) cout << "frame " << f + 1 << " / " << frameNum << endl;
+	}
+	bool written = capture.finish();
+	double totalSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	ofstream timingOut(prefix + "timing.csv");
+	timingOut << "frame,time,setup ms,render ms,capture ms,write ms,fragments" << endl;
+	double sums[4] = { 0.0, 0.0, 0.0, 0.0 };
+	for (int f = 0; f < frameNum; ++f)
+	{
+		double writeMs = f < (int)capture.writeTimes().size() ? capture.writeTimes()[f] : 0.0;
+		const FrameTiming &t = timings[f];
+		timingOut << f << "," << t.time << "," << t.setupMs << "," << t.renderMs << "," << t.captureMs << "," << writeMs << "," << t.fragments << endl;
+		sums[0] += t.setupMs;
+		sums[1] += t.renderMs;
+		sums[2] += t.captureMs;
+		sums[3] += writeMs;
+	}
+	double n = std::max(frameNum, 1);
+	cout << frameNum << " frames in " << totalSeconds << " s (" << frameNum / std::max(totalSeconds, 1e-9) << " fps), mean ms: setup "
+		<< sums[0] / n << ", render " << sums[1] / n << ", capture " << sums[2] / n << ", write(on the writer thread) " << sums[3] / n << endl;
+	return written ? 0 : 1;
+}
+
+//profile-frames <model> [frames] [trace]
+//renders frames of a rotation by one degree per frame headless with the viewer's settings, once plain and once under
+//the FrameProfiler: the per-pass report, the cost of the profiling and a check of the fragments it counted on the GPU
+//against the read backs(every frame is solved for this); trace: writes the Chrome trace of the profiled run
+int profileFramesTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " profile-frames <model> [frames] [trace]" << endl;
+		return 1;
+	}
+	int frames = argc > 3 ? std::max(atoi(argv[3]), 1) : 120;
+
+	if (!headlessGL("PROFILE_FRAMES")) return 1;
+
+	Lines glLines(argv[2], segPerLine, true, lineGeometry, vertexFormat);
+	if (!glLines.loaded()) return 1;
+	glLines.computeImportance(importMode);
+	std::unique_ptr<RenderPasses> passes = viewerPasses();
+	OpacitySolver solver;
+	glLines.setupSolver(solver);
+	FrameProfiler profiler;
+
+	//run 0 plain, run 1 profiled
+	double runMs[2];
+	vector<GLuint> readFragments(frames);
+	for (int run = 0; run < 2; ++run)
+	{
+		passes->profiler = run == 1 ? &profiler : nullptr;
+		vector<float> opacity(glLines.segmentNum_, 1.0f);
+		glLines.uploadOpacity(&opacity[0]);
+		glFinish();
+		auto t0 = chrono::steady_clock::now();
+		for (int f = 0; f < frames; ++f)
+		{
+			if (run == 1) profiler.beginFrame();
+			resetRotation((float)f);
+			RenderParams params = makeRenderParams(glLines);
+			{
+				ProfileScope scope(passes->profiler, "cull", false);
+				if (frustumCulling) glLines.cull(params);
+				if (lineLod) glLines.selectLevels(params, lodPixelError);
+			}
+			passes->frame(glLines, solver, makeOpacityParams(), params, opacity);
+			readFragments[f] = passes->frameFragments;
+			if (run == 1) profiler.endFrame();
+		}
+		glFinish();
+		runMs[run] = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() / frames;
+	}
+	profiler.flush();
+
+	cout << profiler.report();
+	int mismatches = 0;
+	for (const ProfiledFrame &frame : profiler.frames())
+		if (!frame.hasFragments || frame.fragments != readFragments[frame.index]) ++mismatches;
+	cout << frames << " frames, mean ms: plain " << runMs[0] << ", profiled " << runMs[1] << " (" << profiler.droppedGpuFrames
+		<< " frames without GPU times), GPU fragment counts differing from the read backs: " << mismatches << endl;
+	if (argc > 4 && profiler.writeTrace(argv[4])) cout << "Wrote " << argv[4] << endl;
+	if (mismatches > 0) cout << "ERROR::PROFILE_FRAMES::FRAGMENT_COUNT_DIFFERS" << endl;
+	return mismatches > 0 ? 1 : 0;
+}
+
+//generate-lines <out.lbin|out.obj> <helices|walks|tangles> [lineNum] [vertsPerLine] [depth] [seed]
+//writes a synthetic line set(SyntheticLines.h), default 10^4 lines of 32 points at depth 4
+int generateLinesTool(int argc, char **argv)
+{
+	if (argc < 4)
+	{
+		cout << "usage: " << argv[0] << " generate-lines <out.lbin|out.obj> <helices|walks|tangles> [lineNum] [vertsPerLine] [depth] [seed]" << endl;
+		return 1;
+	}
+	SyntheticSpec spec;
+	if (!parseSyntheticKind(argv[3], spec.kind))
+	{
+		cout << "ERROR::GENERATE_LINES::UNKNOWN_KIND " << argv[3] << endl;
+		return 1;
+	}
+	spec.lineNum = argc > 4 ? atoi(argv[4]) : 10000;
+	spec.vertsPerLine = argc > 5 ? atoi(argv[5]) : 32;
+	spec.depth = argc > 6 ? (float)atof(argv[6]) : 4.0f;
+	spec.seed = argc > 7 ? (unsigned int)atoi(argv[7]) : 1;
+
+	auto t0 = chrono::steady_clock::now();
+	string error;
+	if (!writeSyntheticLines(spec, argv[2], error))
+	{
+		cout << "ERROR::GENERATE_LINES::" << error << endl;
+		return 1;
+	}
+	cout << "Wrote " << syntheticName(spec) << " to " << argv[2] << " in "
+		<< chrono::duration<double>(chrono::steady_clock::now() - t0).count() << " s" << endl;
+	return 0;
+}
+
+//resident memory of the process in MB, 0 where it is not known(read from /proc on Linux only)
+static double residentMB()
+{
+#ifdef _WIN32
+	return 0.0;
+#else
+	ifstream status("/proc/self/status");
+	string line;
+	while (getline(status, line))
+		if (line.compare(0, 6, "VmRSS:") == 0) return atof(line.c_str() + 6) / 1024.0;
+	return 0.0;
+#endif
+}
+
+//bench-suite <results.json> [maxLines] [frames] [work dir]
+//end-to-end timings on synthetic line sets, written as JSON to track them across versions:
+//	every kind at 10^3, 10^4, ... lines up to maxLines(default 10^5) with 32 points at depth 4, and at
+//	min(10^4, maxLines) lines with 8 and 128 points and at depth 1 and 16
+//per set: generating the file, loading it(with the segment distribution and weights), the distribution alone, the
+//importance, the vertex upload, and 'frames' frames(default 3) of the passes under the FrameProfiler(1 pixel strips,
+//no culling or LOD); without a GL context the CPU rasterizer builds and resolves instead
+//the files go to the work dir(default .) and are deleted after their set; one Lines per set, with the GL buffers
+//if there is a context, freed before the next set: the resident memory before every set and after the last one
+//shows that nothing accumulates over the sets
+int benchSuiteTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " bench-suite <results.json> [maxLines] [frames] [work dir]" << endl;
+		return 1;
+	}
+	int maxLines = argc > 3 ? std::max(atoi(argv[3]), 1000) : 100000;
+	int frames = argc > 4 ? std::max(atoi(argv[4]), 1) : 3;
+	string dir = argc > 5 ? argv[5] : ".";
+
+	vector<SyntheticSpec> specs;
+	for (SyntheticKind kind : { SYNTHETIC_HELICES, SYNTHETIC_WALKS, SYNTHETIC_TANGLES })
+	{
+		SyntheticSpec spec;
+		spec.kind = kind;
+		for (long long n = 1000; n <= maxLines; n *= 10)
+		{
+			spec.lineNum = (int)n;
+			specs.push_back(spec);
+		}
+		spec.lineNum = std::min(10000, maxLines);
+		for (int perLine : { 8, 128 })
+		{
+			spec.vertsPerLine = perLine;
+			specs.push_back(spec);
+		}
+		spec.vertsPerLine = 32;
+		for (float depth : { 1.0f, 16.0f })
+		{
+			spec.depth = depth;
+			specs.push_back(spec);
+		}
+	}
+
+	bool gl = headlessGL();
+	std::unique_ptr<RenderPasses> passes;
+	string renderer = "CPU";
+	if (gl)
+	{
+		passes = viewerPasses();
+		renderer = (const char *)glGetString(GL_RENDERER);
+	}
+	else
+		cout << "WARNING::BENCH_SUITE::NO_CONTEXT the CPU rasterizer renders instead" << endl;
+	auto jsonString = [](const string &text)
+	{
+		string out = "\"";
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\') out += '\\';
+			if ((unsigned char)c >= 0x20) out += c;
+		}
+		return out + "\"";
+	};
+	auto msSince = [](chrono::steady_clock::time_point t0)
+	{
+		return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+	};
+
+	ostringstream json;
+	json << setprecision(6);
+	json << "{" << endl << "\"suite\": \"lines\", \"format\": 1, \"built\": " << jsonString(string(__DATE__) + " " + __TIME__)
+		<< ", \"renderer\": " << jsonString(renderer) << ", \"threads\": " << threadNum() << "," << endl;
+	json << "\"settings\": {\"segPerLine\": " << segPerLine << ", \"layout\": " << jsonString(abufferMode == LINKED_LISTS ? "lists" :
+		abufferMode == MOMENT_OIT ? "moments" : (nodeFormat == COMPACT_NODES ? "compact" : "spans")) << ", \"fragmentBudget\": " << fragmentBudget << ", \"importance\": " << (int)importMode
+		<< ", \"width\": " << SCR_WIDTH << ", \"height\": " << SCR_HEIGHT << ", \"frames\": " << frames << "}," << endl;
+	json << "\"cases\": [";
+
+	cout << "set\tvertices\tgenerate ms\tload ms\tdistribute ms\timportance ms\tupload GB/s\tfragments/pixel\tframe ms\tresident MB before" << endl;
+	bool ok = true;
+	for (size_t c = 0; c < specs.size(); ++c)
+	{
+		const SyntheticSpec &spec = specs[c];
+		string name = syntheticName(spec);
+		string path = dir + "/" + name + ".lbin";
+		double residentBeforeMB = residentMB();
+		json << (c == 0 ? "" : ",") << endl << "{\"name\": " << jsonString(name) << ", \"kind\": " << jsonString(syntheticKindName(spec.kind))
+			<< ", \"lines\": " << spec.lineNum << ", \"vertsPerLine\": " << spec.vertsPerLine << ", \"depth\": " << spec.depth
+			<< ", \"seed\": " << spec.seed << ", \"vertices\": " << (long long)spec.lineNum * spec.vertsPerLine
+			<< ", \"residentBeforeMB\": " << residentBeforeMB;
+
+		auto t0 = chrono::steady_clock::now();
+		string error;
+		if (!writeSyntheticLines(spec, path, error))
+		{
+			cout << "ERROR::BENCH_SUITE::" << error << endl;
+			json << ", \"error\": " << jsonString(error) << "}";
+			ok = false;
+			continue;
+		}
+		double generateMs = msSince(t0);
+		double fileMB = 0.0;
+		{
+			ifstream fileIn(path, ios::binary | ios::ate);
+			fileMB = (double)fileIn.tellg() / 1e6;
+		}
+
+		//load, distribution and importance on the CPU side; the same set is drawn by the GL passes
+		double loadMs, distributeMs = 1e30, importanceMs;
+		Lines lines(path, segPerLine, gl, LINE_STRIPS, FLOAT_VERTICES);
+		if (!lines.loaded())
+		{
+			json << ", \"error\": " << jsonString("cannot load " + path) << "}";
+			std::remove(path.c_str());
+			ok = false;
+			continue;
+		}
+		{
+			//the constructor above warmed the page cache, time a second load(without GL buffers)
+			t0 = chrono::steady_clock::now();
+			Lines timed(path, segPerLine, false);
+			loadMs = msSince(t0);
+		}
+		vector<int> segNums(lines.lines_.lineNum);
+		for (int r = 0; r < 3; ++r)
+		{
+			t0 = chrono::steady_clock::now();
+			distributeSegmentsByLength(lines.lineLengths_.data(), lines.lines_.lineNum, lines.segmentNum_, segNums.data());
+			distributeMs = std::min(distributeMs, msSince(t0));
+		}
+		t0 = chrono::steady_clock::now();
+		lines.computeImportance(importMode, false);
+		importanceMs = msSince(t0);
+		json << ", \"fileMB\": " << fileMB << ", \"generateMs\": " << generateMs << ", \"loadMs\": " << loadMs
+			<< ", \"distributeMs\": " << distributeMs << ", \"importanceMs\": " << importanceMs;
+
+		resetRotation();
+		OpacitySolver solver;
+		lines.setupSolver(solver);
+		vector<float> opacity(lines.segmentNum_, 1.0f);
+		double uploadGBs = 0.0, frameMs = 0.0, fragments = 0.0;
+		int tiles = 1;
+		//scope, CPU ms, GPU ms(negative: none)
+		vector<pair<string, pair<double, double> > > passMs;
+		if (gl)
+		{
+			for (int r = 0; r < 3; ++r) uploadGBs = std::max(uploadGBs, lines.uploadVertices());
+
+			FrameProfiler profiler;
+			passes->profiler = &profiler;
+			glFinish();
+			t0 = chrono::steady_clock::now();
+			for (int f = 0; f < frames; ++f)
+			{
+				profiler.beginFrame();
+				resetRotation((float)f);
+				passes->frame(lines, solver, makeOpacityParams(), makeRenderParams(lines), opacity);
+				profiler.endFrame();
+			}
+			glFinish();
+			frameMs = msSince(t0) / frames;
+			profiler.flush();
+			passes->profiler = nullptr;
+			fragments = profiler.fragments().mean();
+			tiles = passes->tileNum;
+			for (int sc = 0; sc < (int)profiler.scopeNames().size(); ++sc)
+				passMs.push_back(make_pair(profiler.scopeNames()[sc], make_pair(profiler.scopeCpuMs(sc).mean(),
+					profiler.scopeGpuMs(sc).size() > 0 ? profiler.scopeGpuMs(sc).mean() : -1.0)));
+		}
+		else
+		{
+			CpuRasterizer rasterizer;
+			FragmentLists lists;
+			TileResolver resolver;
+			vector<GLuint> image;
+			double ms[4] = { 0.0, 0.0, 0.0, 0.0 };
+			for (int f = 0; f < frames; ++f)
+			{
+				resetRotation((float)f);
+				RenderParams params = makeRenderParams(lines);
+				t0 = chrono::steady_clock::now();
+				rasterizer.build(lines.lines_, params, &opacity[0], lines.segmentNum_, lists);
+				ms[0] += msSince(t0);
+				t0 = chrono::steady_clock::now();
+				resolver.resolve(lists, image);
+				ms[1] += msSince(t0);
+				t0 = chrono::steady_clock::now();
+				solver.accumulate(lists, &lines.importance_[0]);
+				ms[2] += msSince(t0);
+				t0 = chrono::steady_clock::now();
+				solver.solve(&lines.importance_[0], makeOpacityParams(), &opacity[0]);
+				ms[3] += msSince(t0);
+				fragments += (double)(lists.fragmentNum + lists.dropped) / frames;
+			}
+			const char *names[4] = { "build", "resolve", "accumulate", "solve" };
+			for (int k = 0; k < 4; ++k)
+			{
+				passMs.push_back(make_pair(string(names[k]), make_pair(ms[k] / frames, -1.0)));
+				frameMs += ms[k] / frames;
+			}
+		}
+		std::remove(path.c_str());
+
+		json << ", \"uploadGBs\": " << uploadGBs << ", \"fragments\": " << fragments << ", \"fragmentsPerPixel\": " << fragments / TOTAL_PIXELS
+			<< ", \"tiles\": " << tiles << ", \"frameMs\": " << frameMs << ", \"passes\": {";
+		for (size_t k = 0; k < passMs.size(); ++k)
+		{
+			json << (k == 0 ? "" : ", ") << jsonString(passMs[k].first) << ": {\"cpuMs\": " << passMs[k].second.first;
+			if (passMs[k].second.second >= 0.0) json << ", \"gpuMs\": " << passMs[k].second.second;
+			json << "}";
+		}
+		json << "}}";
+		cout << name << "\t" << lines.vertexNum_ << "\t" << generateMs << "\t" << loadMs << "\t" << distributeMs << "\t" << importanceMs
+			<< "\t" << uploadGBs << "\t" << fragments / TOTAL_PIXELS << "\t" << frameMs << "\t" << residentBeforeMB << endl;
+	}
+	double residentEndMB = residentMB();
+	cout << "resident MB after the last set: " << residentEndMB << endl;
+	json << endl << "]," << endl << "\"residentEndMB\": " << residentEndMB << endl << "}" << endl;
+
+	ofstream out(argv[2]);
+	out << json.str();
+	if (!out)
+	{
+		cout << "ERROR::BENCH_SUITE::CANNOT_WRITE " << argv[2] << endl;
+		return 1;
+	}
+	cout << "Wrote " << specs.size() << " sets to " << argv[2] << endl;
+	return ok ? 0 : 1;
+}
+
+//sum of |a - b| over the sum of |reference|, 0 for an all zero reference
+static double relativeDifference(const vector<float> &a, const vector<float> &reference)
+{
+	double diff = 0.0, sum = 0.0;
+	for (size_t i = 0; i < reference.size(); ++i)
+	{
+		diff += std::abs((double)a[i] - reference[i]);
+		sum += std::abs((double)reference[i]);
+	}
+	return sum > 0.0 ? diff / sum : 0.0;
+}
+
+//oit-error <model> [views]
+//moment-based transparency(MOMENT_OIT) against the exact linked lists in a headless context, for views turning around
+//the data in 360 / views degree steps; each mode renders two frames, the first solves the opacities the second uses:
+//	h-, h+:      relative error of the terms the moment pass estimates against the exact ones of the sorted lists
+//	GL/CPU:      the GL estimate against OpacitySolver::accumulateMoments on the listed fragments(checks the shaders)
+//	opacity:     largest and mean difference of the solved opacities
+//	compositing: the moment image with the exact opacities against the exact image
+//	image:       the moment image with its own opacities against the exact image
+//exits with 1 if the GL estimate deviates from the CPU one by more than 1e-3 relative
+int oitErrorTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " oit-error <model> [views]" << endl;
+		return 1;
+	}
+	int views = argc > 3 ? std::max(atoi(argv[3]), 1) : 4;
+
+	if (!headlessGL("OIT_ERROR")) return 1;
+
+	Lines glLines(argv[2], segPerLine, true, lineGeometry, vertexFormat);
+	if (!glLines.loaded()) return 1;
+	glLines.computeImportance(importMode);
+	int segmentNum = glLines.segmentNum_;
+	RenderPasses passes;
+	OpacitySolver solver, cpuSolver;
+	glLines.setupSolver(solver);
+	cpuSolver.resize(segmentNum);
+
+	//two frames from fully opaque lines, the image of the second and its time
+	auto render = [&](ABufferMode mode, const RenderParams &params, vector<float> &opacity, vector<GLuint> &image)
+	{
+		passes.mode = mode;
+		opacity.assign(segmentNum, 1.0f);
+		glLines.uploadOpacity(&opacity[0]);
+		passes.frame(glLines, solver, makeOpacityParams(), params, opacity);
+		glFinish();
+		auto t0 = chrono::steady_clock::now();
+		passes.frame(glLines, solver, makeOpacityParams(), params, opacity);
+		glFinish();
+		double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+		image.resize(TOTAL_PIXELS);
+		glReadPixels(0, 0, SCR_WIDTH, SCR_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, &image[0]);
+		return ms;
+	};
+
+	bool consistent = true;
+	double maxFragments = 0.0;
+	cout << "view\tfragments\texact ms\tmoment ms\th- error\th+ error\tGL/CPU h\topacity max\topacity mean"
+		"\tcompositing max\tcompositing PSNR\timage max\timage PSNR" << endl;
+	for (int v = 0; v < views; ++v)
+	{
+		float angle = rotateHorizontal + 6.2831853f * v / views;
+		rotMat = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f));
+		RenderParams params = makeRenderParams(glLines);
+
+		vector<float> exactOpacity, momentOpacity;
+		vector<GLuint> exactImage, momentImage, compositeImage;
+		double exactMs = render(LINKED_LISTS, params, exactOpacity, exactImage);
+		GLuint fragments = passes.frameFragments;
+		maxFragments = std::max(maxFragments, (double)fragments);
+		vector<float> exactFront = solver.hFront(), exactBack = solver.hBack();
+		//the lists hold the whole frame unless it was tiled
+		bool listed = passes.tileNum == 1;
+		if (listed) cpuSolver.accumulateMoments(passes.lists, &glLines.importance_[0], momentDepthRange(params));
+
+		double momentMs = render(MOMENT_OIT, params, momentOpacity, momentImage);
+		glLines.uploadOpacity(&exactOpacity[0]);
+		passes.draw(glLines, params);
+		compositeImage.resize(TOTAL_PIXELS);
+		glReadPixels(0, 0, SCR_WIDTH, SCR_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, &compositeImage[0]);
+
+		double glCpu = -1.0;
+		if (listed)
+		{
+			glCpu = std::max(relativeDifference(passes.hFront, cpuSolver.hFront()), relativeDifference(passes.hBack, cpuSolver.hBack()));
+			consistent = consistent && glCpu <= 1e-3;
+		}
+		double opacityMax = 0.0, opacitySum = 0.0;
+		for (int i = 0; i < segmentNum; ++i)
+		{
+			double d = std::abs((double)momentOpacity[i] - exactOpacity[i]);
+			opacityMax = std::max(opacityMax, d);
+			opacitySum += d;
+		}
+
+		cout << v << "\t" << fragments << "\t" << exactMs << "\t" << momentMs << "\t" << relativeDifference(passes.hFront, exactFront)
+			<< "\t" << relativeDifference(passes.hBack, exactBack) << "\t";
+		if (listed) cout << glCpu;
+		else cout << "-";
+		cout << "\t" << opacityMax << "\t" << opacitySum / std::max(segmentNum, 1)
+			<< "\t" << maxImageDifference(compositeImage, exactImage, 3) << "\t" << imagePSNR(compositeImage, exactImage)
+			<< "\t" << maxImageDifference(momentImage, exactImage, 3) << "\t" << imagePSNR(momentImage, exactImage) << endl;
+	}
+
+	//the lists allocate their node pool up front, the moments a fixed amount per pixel
+	cout << "memory: lists " << (TOTAL_PIXELS * sizeof(GLuint) + (double)MAX_FRAGMENT_NUM * sizeof(FragmentNode)) / (1 << 20)
+		<< " MB(" << (TOTAL_PIXELS * sizeof(GLuint) + maxFragments * sizeof(FragmentNode)) / (1 << 20) << " MB used), moments "
+		<< (double)TOTAL_PIXELS * (MOMENT_TEXTURES + 1) * 4 * sizeof(GLfloat) / (1 << 20) << " MB" << endl;
+	if (!consistent) cout << "ERROR::OIT_ERROR::GL_CPU_MISMATCH" << endl;
+	return consistent ? 0 : 1;
+}
+
+//bench-resolve <model> [maxThreads] [stripWidth]
+//CPU resolve of a frame following another one rotated by a degree, over 1, 2, 4, ... maxThreads threads:
+//	static:   one block of rows per thread
+//	rows:     resolveFragments(), chunks of rows on demand
+//	tiles:    TileResolver with fixed tiles
+//	stealing: TileResolver with the tiles split by the fragment counts of the previous frame
+//reports ms, speedup over 1 thread, steals and the busy time of the slowest thread over the mean;
+//exits with 1 if an image differs from resolveFragments()
+int benchResolveTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " bench-resolve <model> [maxThreads] [stripWidth]" << endl;
+		return 1;
+	}
+	int maxThreads = argc > 3 ? std::max(atoi(argv[3]), 1) : 64;
+	const int repeats = 3;
+
+	Lines lines(argv[2], segPerLine, false);
+	if (!lines.loaded()) return 1;
+	vector<float> opacity(lines.segmentNum_, 0.5f);
+	CpuRasterizer rasterizer;
+	FragmentSpans spans[2];
+	for (int f = 0; f < 2; ++f)
+	{
+		resetRotation((float)f - 1.0f);
+		RenderParams params = makeRenderParams(lines);
+		if (argc > 4) params.stripWidth = (float)atof(argv[4]);
+		rasterizer.buildSpans(lines.lines_, params, &opacity[0], (int)opacity.size(), spans[f]);
+	}
+	const FragmentSpans &frame = spans[1];
+	int width = frame.width, height = frame.height;
+
+	//depth complexity of the timed frame
+	vector<GLuint> counts((size_t)width * height);
+	long long covered = 0;
+	for (size_t p = 0; p < counts.size(); ++p)
+	{
+		counts[p] = std::min(frame.offsets[p + 1] - frame.offsets[p], (GLuint)MAX_RESOLVE_NODES);
+		if (counts[p] > 0) ++covered;
+	}
+	vector<GLuint> sorted = counts;
+	std::sort(sorted.begin(), sorted.end(), std::greater<GLuint>());
+	double total = 0.0, deepest = 0.0;
+	for (size_t p = 0; p < sorted.size(); ++p)
+	{
+		total += sorted[p];
+		if (p < sorted.size() / 100) deepest += sorted[p];
+	}
+	cout << "fragments: " << (long long)total << ", covered pixels: " << covered << ", deepest pixel: " << sorted[0]
+		<< ", in the deepest 1% of the pixels: " << 100.0 * deepest / std::max(total, 1.0) << "%" << endl;
+	cout << "hardware threads: " << std::thread::hardware_concurrency() << endl;
+
+	vector<GLuint> reference, image;
+	resolveFragments(frame, reference);
+
+	auto resolveStatic = [&](vector<GLuint> &out)
+	{
+		out.assign((size_t)width * height, 0);
+		parallelBlocks(height, [&](int, int begin, int end)
+		{
+			vector<FragmentNode> nodeList(MAX_RESOLVE_NODES);
+			FragmentSorter sorter;
+			for (int pixel = begin * width; pixel < end * width; ++pixel)
+			{
+				int cnt = gatherFragments(frame, pixel, &nodeList[0], MAX_RESOLVE_NODES);
+				sorter.sort(&nodeList[0], cnt);
+				out[pixel] = packUnorm4x8(compositeFragments(&nodeList[0], cnt));
+			}
+		});
+	};
+
+	TileResolver fixed, stealing;
+	fixed.useCostMap = false;
+	const char *names[4] = { "static", "rows", "tiles", "stealing" };
+	double single[4] = { 0.0, 0.0, 0.0, 0.0 };
+	bool identical = true;
+	cout << "threads";
+	for (int m = 0; m < 4; ++m) cout << "\t" << names[m] << " ms\tspeedup";
+	cout << "\ttiles\tsplit\tsteals\timbalance(tiles)\timbalance(stealing)" << endl;
+	forEachThreadCount(maxThreads, [&](int threads)
+	{
+		double best[4] = { 1e30, 1e30, 1e30, 1e30 };
+		double imbalance[2] = { 1e30, 1e30 };
+		for (int r = 0; r < repeats; ++r)
+		{
+			//the cost map of the previous frame, the same for every repeat
+			stealing.resolve(spans[0], image);
+			for (int m = 0; m < 4; ++m)
+			{
+				auto t0 = chrono::steady_clock::now();
+				if (m == 0) resolveStatic(image);
+				else if (m == 1) resolveFragments(frame, image);
+				else (m == 2 ? fixed : stealing).resolve(frame, image);
+				best[m] = std::min(best[m], chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+				if (m >= 2) imbalance[m - 2] = std::min(imbalance[m - 2], (m == 2 ? fixed : stealing).stats.imbalance());
+				int error = maxImageDifference(reference, image);
+				if (error != 0)
+				{
+					cout << "ERROR::BENCH_RESOLVE::IMAGE_DIFFERS " << names[m] << " " << threads << " threads, max difference " << error << endl;
+					identical = false;
+				}
+			}
+		}
+		if (threads == 1)
+			for (int m = 0; m < 4; ++m) single[m] = best[m];
+		cout << threads;
+		for (int m = 0; m < 4; ++m) cout << "\t" << best[m] << "\t" << single[m] / best[m];
+		cout << "\t" << stealing.stats.tiles << "\t" << stealing.stats.splitTiles << "\t" << stealing.stats.steals
+			<< "\t" << imbalance[0] << "\t" << imbalance[1] << endl;
+	});
+	return identical ? 0 : 1;
+}
+
+//sort-last <model> [maxProcesses] [direct|swap] [frames] [out.ppm]
+//sort-last rendering over 1, 2, 4, ... maxProcesses processes(SortLast.h), each composite unless one is given; 'frames'
+//frames from fully opaque, every one solving the opacities of the next. Per run the slowest rank's ms of every phase,
+//the compositing bandwidth(bytes all ranks sent over the slowest exchange) and the rows' fragments, slowest over mean;
+//the last frame is compared with the single process one(and written to out.ppm by every run, the last one stays),
+//exits with 1 on a failed run or a different image
+int sortLastTool(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		cout << "usage: " << argv[0] << " sort-last <model> [maxProcesses] [direct|swap] [frames] [out.ppm]" << endl;
+		return 1;
+	}
+#ifdef _WIN32
+	cout << "ERROR::SORT_LAST::NEEDS_FORK" << endl;
+	return 1;
+#else
+	int maxProcesses = argc > 3 ? std::max(atoi(argv[3]), 1) : 8;
+	string only = argc > 4 ? argv[4] : "";
+	int frames = argc > 5 ? std::max(atoi(argv[5]), 1) : 3;
+	if (only != "" && only != "direct" && only != "swap")
+	{
+		cout << "ERROR::SORT_LAST::UNKNOWN_COMPOSITE " << only << endl;
+		return 1;
+	}
+
+	Lines lines(argv[2], segPerLine, false);
+	if (!lines.loaded()) return 1;
+	lines.computeImportance(importMode);
+	resetRotation();
+	RenderParams params = makeRenderParams(lines);
+	int segmentNum = lines.segmentNum_;
+	int hardware = std::max((int)std::thread::hardware_concurrency(), 1);
+	cout << "lines: " << lines.lines_.lineNum << ", vertices: " << lines.lines_.vertexNum << ", hardware threads: " << hardware << endl;
+
+	vector<GLuint> reference;
+	vector<float> referenceOpacity;
+	double singleMs = 0.0;
+	bool valid = true;
+	cout << "processes\tcomposite\tframe ms\tspeedup\tbuild\tsort\tcomposite\tresolve\tgather\tsolve\tcomposite MB\tGB/s\trow imbalance\timage difference\topacity difference" << endl;
+	for (int processes = 1; processes <= maxProcesses; processes = processes < maxProcesses ? std::min(processes * 2, maxProcesses) : processes * 2)
+	{
+		for (CompositeMode mode : { COMPOSITE_DIRECT_SEND, COMPOSITE_BINARY_SWAP })
+		{
+			if (only != "" && only != compositeModeName(mode)) continue;
+			if (processes == 1 && mode == COMPOSITE_BINARY_SWAP && only == "") continue;
+			//binary swap halves the process count every round
+			if (mode == COMPOSITE_BINARY_SWAP && (processes & (processes - 1)) != 0) continue;
+
+			ProcessGroup group;
+			if (!group.start(processes))
+			{
+				valid = false;
+				continue;
+			}
+			//every rank gets its part of the cores
+			setThreadNum(std::max(1, hardware / processes));
+			SortLastRenderer renderer(group);
+			renderer.mode = mode;
+			OpacitySolver solver;
+			if (group.rank() == 0) lines.setupSolver(solver);
+			vector<float> opacity(segmentNum, 1.0f);
+			vector<GLuint> image;
+			bool ok = true;
+			for (int f = 0; f < frames && ok; ++f)
+				ok = renderer.frame(lines.lines_, params, &lines.importance_[0], segmentNum, opacity, &solver, makeOpacityParams(), image);
+			if (!ok) cout << "ERROR::SORT_LAST::RANK_FAILED " << group.rank() << " of " << processes << endl;
+			ok = group.finish(ok);
+			setThreadNum(0);
+			if (!ok)
+			{
+				valid = false;
+				continue;
+			}
+
+			SortLastStats worst;
+			double bytes = 0.0, rowSum = 0.0, dropped = 0.0;
+			for (const SortLastStats &s : renderer.rankStats)
+			{
+				worst.frameMs = std::max(worst.frameMs, s.frameMs);
+				worst.buildMs = std::max(worst.buildMs, s.buildMs);
+				worst.sortMs = std::max(worst.sortMs, s.sortMs);
+				worst.compositeMs = std::max(worst.compositeMs, s.compositeMs);
+				worst.resolveMs = std::max(worst.resolveMs, s.resolveMs);
+				worst.gatherMs = std::max(worst.gatherMs, s.gatherMs);
+				worst.solveMs = std::max(worst.solveMs, s.solveMs);
+				worst.rowFragments = std::max(worst.rowFragments, s.rowFragments);
+				bytes += s.compositeBytes;
+				rowSum += s.rowFragments;
+				dropped += s.dropped;
+			}
+			if (processes == 1)
+			{
+				reference = image;
+				referenceOpacity = opacity;
+				singleMs = worst.frameMs;
+			}
+			float opacityError = 0.0f;
+			for (int i = 0; i < segmentNum && !referenceOpacity.empty(); ++i)
+				opacityError = std::max(opacityError, std::abs(opacity[i] - referenceOpacity[i]));
+			int imageError = reference.empty() ? 0 : maxImageDifference(reference, image);
+			cout << processes << "\t" << compositeModeName(mode) << "\t" << worst.frameMs << "\t" << singleMs / worst.frameMs
+				<< "\t" << worst.buildMs << "\t" << worst.sortMs << "\t" << worst.compositeMs << "\t" << worst.resolveMs
+				<< "\t" << worst.gatherMs << "\t" << worst.solveMs << "\t" << bytes / 1e6
+				<< "\t" << (worst.compositeMs > 0.0 ? bytes / 1e6 / worst.compositeMs : 0.0)
+				<< "\t" << (rowSum > 0.0 ? worst.rowFragments * processes / rowSum : 1.0)
+				<< "\t" << imageError << "\t" << opacityError << endl;
+			if (dropped > 0.0) cout << "warning: " << dropped << " fragments dropped" << endl;
+			if (imageError > 0) valid = false;
+			if (argc > 6 && !writeImage(argv[6], image.data(), params.width, params.height))
+			{
+				cout << "ERROR::SORT_LAST::WRITE_FAILED " << argv[6] << endl;
+				valid = false;
+			}
+		}
+	}
+	return valid ? 0 : 1;
+#endif
+}
+
+#pragma endregion
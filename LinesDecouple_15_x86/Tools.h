@@ -0,0 +1,12 @@
+#ifndef TOOLS_H
+#define TOOLS_H
+
+#include "commonVars.h"
+
+//the command line tools(Tools.cpp): main <tool> [arguments...] runs one instead of the viewer
+//and exits with what it returns
+
+bool isTool(const string &name);
+int runTool(int argc, char **argv);
+
+#endif // !TOOLS_H
@@ -0,0 +1,295 @@
+#ifndef VERTEXQUANTIZATION_H
+#define VERTEXQUANTIZATION_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+#include "commonVars.h"
+#include "LineStorage.h"
+#include "Parallel.h"
+#include "RibbonGeometry.h"
+
+//compressed vertices: the points are cut into blocks of QUANT_BLOCK_POINTS in VBO order(a block may span lines) and
+//every point is 4 unsigned shorts relative to its block:
+//	position = lo.xyz + q.xyz * step.xyz, step = box extent / 65535, rounded to the nearest step
+//	weight = lo.w + q.w * step.w, lo.w = floor of the smallest weight and step.w a power of two, rounded down:
+//	the integers are on the grid, so the segment id floor(weight) never changes
+//the line of a point is not stored, the block table keeps the first line of every block and the line offsets do
+//the rest; the shaders never read it
+//the order of the points is the order of the float VBO, so the draw lists and ribbon indices stay the same
+
+const int QUANT_BLOCK_POINTS = 32;
+const int QUANT_BLOCK_SHIFT = 5;
+
+enum VertexFormat { FLOAT_VERTICES, QUANTIZED_VERTICES };
+
+struct QuantVertex
+{
+	uint16_t x, y, z, weight;
+};
+
+//2 texels of the RGBA32F block texture
+struct QuantBlock
+{
+	glm::vec4 lo;//position and weight origin
+	glm::vec4 step;//position and weight step
+};
+
+class QuantizedLines
+{
+public:
+	double buildTime = 0.0;//ms of the last build()
+	float maxPositionError = 0.0f;//largest error of a coordinate
+	float maxWeightError = 0.0f;
+	int segmentChanges = 0;//points whose floor(weight) differs, 0 by construction
+
+	int blockNum() const { return (int)blocks_.size(); }
+	const vector<QuantVertex> &vertices() const { return vertices_; }
+	const vector<QuantBlock> &blocks() const { return blocks_; }
+	//vertices, block table and first lines
+	size_t bytes() const { return vertices_.size() * sizeof(QuantVertex) + blocks_.size() * (sizeof(QuantBlock) + sizeof(GLuint)); }
+
+	void build(const LineSet &lines)
+	{
+		auto t0 = chrono::steady_clock::now();
+		int n = lines.vertexNum;
+		int blockNum = (n + QUANT_BLOCK_POINTS - 1) / QUANT_BLOCK_POINTS;
+		vertices_.resize(n);
+		blocks_.resize(blockNum);
+		blockLines_.resize(blockNum);
+		lineOffsets_.assign(lines.lineOffsets, lines.lineOffsets + lines.lineNum + 1);
+
+		//the first line of every block
+		parallelFor(0, lines.lineNum, [&](int l)
+		{
+			int begin = lines.lineBegin(l), end = lines.lineEnd(l);
+			for (int b = (begin + QUANT_BLOCK_POINTS - 1) >> QUANT_BLOCK_SHIFT; b < blockNum && (b << QUANT_BLOCK_SHIFT) < end; ++b)
+				blockLines_[b] = (GLuint)l;
+		}, 1024);
+
+		int threads = threadNum();
+		vector<float> positionError(threads, 0.0f), weightError(threads, 0.0f);
+		vector<int> changes(threads, 0);
+		parallelBlocks(blockNum, [&](int t, int blockBegin, int blockEnd)
+		{
+			for (int b = blockBegin; b < blockEnd; ++b)
+			{
+				int first = b << QUANT_BLOCK_SHIFT, last = std::min(first + QUANT_BLOCK_POINTS, n);
+				glm::vec3 lo(1e30f), hi(-1e30f);
+				float wMin = 1e30f, wMax = -1e30f;
+				for (int v = first; v < last; ++v)
+				{
+					lo = glm::min(lo, lines.positions[v]);
+					hi = glm::max(hi, lines.positions[v]);
+					wMin = std::min(wMin, lines.weights[v]);
+					wMax = std::max(wMax, lines.weights[v]);
+				}
+
+				QuantBlock &block = blocks_[b];
+				block.lo = glm::vec4(lo, std::floor(wMin));
+				block.step = glm::vec4((hi - lo) * (1.0f / 65535.0f), 0.0f);
+				double range = (double)wMax - block.lo.w;
+				block.step.w = (float)std::ldexp(1.0, range > 0.0 ? (int)std::ceil(std::log2(range / 65535.0)) : -16);
+				while ((range / block.step.w) > 65535.0) block.step.w *= 2.0f;
+
+				for (int v = first; v < last; ++v)
+				{
+					QuantVertex &q = vertices_[v];
+					uint16_t *coord = &q.x;
+					for (int k = 0; k < 3; ++k)
+					{
+						float rel = block.step[k] > 0.0f ? (lines.positions[v][k] - block.lo[k]) / block.step[k] : 0.0f;
+						coord[k] = (uint16_t)std::min(std::max(std::lround(rel), 0L), 65535L);
+					}
+					double w = std::floor(((double)lines.weights[v] - block.lo.w) / block.step.w);
+					q.weight = (uint16_t)std::min(std::max(w, 0.0), 65535.0);
+
+					glm::vec3 d = position(v) - lines.positions[v];
+					positionError[t] = std::max(positionError[t], std::max(std::abs(d.x), std::max(std::abs(d.y), std::abs(d.z))));
+					float decoded = weight(v);
+					weightError[t] = std::max(weightError[t], std::abs(decoded - lines.weights[v]));
+					changes[t] += std::floor(decoded) != std::floor(lines.weights[v]) ? 1 : 0;
+				}
+			}
+		});
+
+		maxPositionError = maxWeightError = 0.0f;
+		segmentChanges = 0;
+		for (int t = 0; t < threads; ++t)
+		{
+			maxPositionError = std::max(maxPositionError, positionError[t]);
+			maxWeightError = std::max(maxWeightError, weightError[t]);
+			segmentChanges += changes[t];
+		}
+		buildTime = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+	}
+
+	//the decode of the vertex shaders
+	glm::vec3 position(int v) const
+	{
+		const QuantBlock &block = blocks_[v >> QUANT_BLOCK_SHIFT];
+		const QuantVertex &q = vertices_[v];
+		return glm::vec3(block.lo) + glm::vec3((float)q.x, (float)q.y, (float)q.z) * glm::vec3(block.step);
+	}
+
+	float weight(int v) const
+	{
+		const QuantBlock &block = blocks_[v >> QUANT_BLOCK_SHIFT];
+		return block.lo.w + (float)vertices_[v].weight * block.step.w;
+	}
+
+	//from the first line of the block on
+	int line(int v) const
+	{
+		int l = (int)blockLines_[v >> QUANT_BLOCK_SHIFT];
+		while ((int)lineOffsets_[l + 1] <= v) ++l;
+		return l;
+	}
+
+	//the decoded points as a LineSet with the line offsets of the source, for the CPU reference
+	void decode(Arena &arena, LineSet &out) const
+	{
+		int lineNum = (int)lineOffsets_.size() - 1;
+		out.allocate(arena, lineNum, (int)vertices_.size());
+		memcpy(out.lineOffsets, lineOffsets_.data(), lineOffsets_.size() * sizeof(GLuint));
+		parallelFor(0, (int)vertices_.size(), [&](int v)
+		{
+			out.positions[v] = position(v);
+			out.weights[v] = weight(v);
+			out.lineIds[v] = (GLuint)line(v);
+		}, 1 << 14);
+	}
+
+private:
+	vector<QuantVertex> vertices_;
+	vector<QuantBlock> blocks_;
+	vector<GLuint> blockLines_;//the line of the first point of every block
+	vector<GLuint> lineOffsets_;
+};
+
+#pragma region GL streams
+//the strips as the VAO of the float VBO would draw them: vbo holds the QuantVertex array
+inline void setQuantizedStripAttributes()
+{
+	glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(QuantVertex), (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(3, 1, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(QuantVertex), (void*)(3 * sizeof(uint16_t)));
+	glEnableVertexAttribArray(3);
+}
+
+//the block table as a RGBA32F texture buffer, bound to texture unit 4 while the stream is drawn
+inline void createQuantBlockTexture(const QuantizedLines &quant, GLuint &buffer, GLuint &texture)
+{
+	glGenBuffers(1, &buffer);
+	glGenTextures(1, &texture);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(quant.blocks().size() * sizeof(QuantBlock), sizeof(QuantBlock)), quant.blocks().data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+//signed normalized 10 bit components of GL_INT_2_10_10_10_REV
+inline GLuint packSnorm10(const glm::vec3 &v)
+{
+	GLuint packed = 0;
+	for (int k = 0; k < 3; ++k)
+	{
+		int c = (int)std::lround(std::min(std::max(v[k], -1.0f), 1.0f) * 511.0f);
+		packed |= ((GLuint)c & 0x3FFu) << (10 * k);
+	}
+	return packed;
+}
+
+inline glm::vec3 unpackSnorm10(GLuint packed)
+{
+	glm::vec3 v;
+	for (int k = 0; k < 3; ++k)
+	{
+		int c = (int)((packed >> (10 * k)) & 0x3FFu);
+		if (c >= 512) c -= 1024;
+		v[k] = std::max((float)c / 511.0f, -1.0f);
+	}
+	return v;
+}
+
+//ribbon vertices of the quantized points: 16 bytes against 40 of RibbonLayout
+struct QuantRibbonLayout
+{
+	size_t vertices;//QuantVertex, locations 0 and 3
+	size_t directions;//GL_INT_2_10_10_10_REV, location 1
+	size_t texCoords;//2 normalized unsigned shorts, location 2
+	size_t size;
+};
+
+inline QuantRibbonLayout quantRibbonLayout(int pointNum)
+{
+	size_t n = 2 * (size_t)pointNum;
+	QuantRibbonLayout layout;
+	layout.vertices = 0;
+	layout.directions = layout.vertices + n * sizeof(QuantVertex);
+	layout.texCoords = layout.directions + n * sizeof(GLuint);
+	layout.size = layout.texCoords + n * 2 * sizeof(uint16_t);
+	return layout;
+}
+
+//as generateRibbons() from the quantized points, the tangents come from the float positions
+inline void generateQuantizedRibbons(const LineSet &lines, const QuantizedLines &quant, char *vertices, GLuint *indices, bool useSimd = true)
+{
+	QuantRibbonLayout layout = quantRibbonLayout(lines.vertexNum);
+	QuantVertex *points = (QuantVertex *)(vertices + layout.vertices);
+	GLuint *directions = (GLuint *)(vertices + layout.directions);
+	uint16_t *texCoords = (uint16_t *)(vertices + layout.texCoords);
+
+	vector< vector<glm::vec3> > scratch(threadNum());
+	parallelBlocks(lines.lineNum, [&](int t, int lineBegin, int lineEnd)
+	{
+		vector<glm::vec3> &tangents = scratch[t];
+		for (int l = lineBegin; l < lineEnd; ++l)
+		{
+			int begin = lines.lineBegin(l), end = lines.lineEnd(l);
+			tangents.resize(std::max<size_t>(tangents.size(), end - begin));
+			lineTangents(lines, l, tangents.data(), useSimd);
+
+			float invLen = end - begin > 1 ? 1.0f / (end - begin - 1) : 0.0f;
+			for (int j = begin; j < end; ++j)
+			{
+				size_t v = 2 * (size_t)j;
+				points[v] = points[v + 1] = quant.vertices()[j];
+				directions[v] = directions[v + 1] = packSnorm10(tangents[j - begin]);
+				uint16_t along = (uint16_t)std::lround((j - begin) * invLen * 65535.0f);
+				texCoords[2 * v] = texCoords[2 * v + 2] = along;
+				texCoords[2 * v + 1] = 0;
+				texCoords[2 * v + 3] = 65535;
+			}
+			if (indices) ribbonLineIndices(lines, l, indices);
+		}
+	});
+}
+
+inline void createQuantizedRibbonBuffers(const LineSet &lines, const QuantizedLines &quant, RibbonBuffers &buffers)
+{
+	QuantRibbonLayout layout = quantRibbonLayout(lines.vertexNum);
+	createRibbonBuffers(lines, layout.size, buffers, [&](char *vertices, GLuint *indices)
+	{
+		generateQuantizedRibbons(lines, quant, vertices, indices);
+	}, [&]()
+	{
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(QuantVertex), (void*)layout.vertices);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(GLuint), (void*)layout.directions);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, 2 * sizeof(uint16_t), (void*)layout.texCoords);
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(3, 1, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(QuantVertex), (void*)(layout.vertices + 3 * sizeof(uint16_t)));
+		glEnableVertexAttribArray(3);
+	});
+}
+#pragma endregion
+
+#endif // !VERTEXQUANTIZATION_H
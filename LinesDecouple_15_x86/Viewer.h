@@ -0,0 +1,53 @@
+#ifndef VIEWER_H
+#define VIEWER_H
+
+#include <glm/glm.hpp>
+
+#include <memory>
+
+#include "Include/camera.hpp"
+#include "commonVars.h"
+#include "ABuffer.h"
+#include "CameraPath.h"
+#include "Importance.h"
+#include "Lines.h"
+#include "OpacitySolver.h"
+#include "RenderParams.h"
+#include "RenderPasses.h"
+#include "RibbonGeometry.h"
+#include "VertexQuantization.h"
+
+//the settings and the camera of the viewer(main.cpp), which the command line tools(Tools.cpp) render with too
+
+//parameters
+extern ImportanceType importMode;
+extern ABufferMode abufferMode;
+extern NodeFormat nodeFormat;
+extern GLuint fragmentBudget;
+extern bool temporalOpacity;
+extern bool useOpacityCache;
+extern bool frustumCulling;
+extern bool lineLod;
+extern float lodPixelError;
+extern LineGeometry lineGeometry;
+extern VertexFormat vertexFormat;
+extern double coff[5];
+extern float rotateHorizontal;
+extern int segPerLine;
+
+//camera
+extern Camera camera;
+extern glm::mat4 rotMat;
+
+//uniforms of the current camera and rotation
+RenderParams makeRenderParams(const Lines &lines);
+//camera and data rotation of a camera path key
+void applyCameraKey(const CameraKey &key);
+OpacityParams makeOpacityParams();
+//the data rotation the viewer starts with, turned by degrees more around the vertical axis
+void resetRotation(float degrees = 0.0f);
+//render passes with the layout, node format and fragment budget of the viewer
+std::unique_ptr<RenderPasses> viewerPasses();
+void openglConfig();
+
+#endif // !VIEWER_H
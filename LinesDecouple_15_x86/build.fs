@@ -1,4 +1,4 @@
-#version 460 core
+#version 450 core
 
 layout (binding = 0, r32ui) uniform uimage2D headPointers;
 layout (binding = 1, rgba32ui) uniform uimageBuffer listBuffer;
@@ -12,6 +12,7 @@ uniform vec3 lightPos;
 uniform vec3 lightColor;
 uniform vec3 lineColor;
 uniform float stripWidth;
+uniform uint listCapacity;//nodes in listBuffer, the counter keeps counting past it so the overflow can be detected
 
 //layout (location = 0) out vec4 FragColor;
 
@@ -20,58 +21,15 @@ in float weight;
 in vec3 FragPos;
 in vec3 T;
 
-bool isCenter()
-{
-	return (abs(TexCoords.y - 0.5f) < 0.35f);
-}
-
-vec4 setColor()
-{
-	//---------------------
-	//opacity
-	int segId = int(weight);
-	float opa1 = imageLoad(opacityBuffer, int(segId)).x;
-	float opa2 = imageLoad(opacityBuffer, int(segId+1)).x;
-	float opa = mix(opa1, opa2, fract(weight));
-
-	vec3 color;
-
-	if(isCenter())
-	{
-	    vec3 L = normalize(lightPos - FragPos);
-	    vec3 V = normalize(-FragPos);
-	    // vec3 V = viewDirection;
-	    float LT = abs(dot(L, T));
-	    float VT = abs(dot(V, T));
-
-		// ambient
-	    float ambient = 0.3;
-
-	    // diffuse
-	    float diffuse = sqrt(1 - LT * LT);
-
-	    //specular
-	    float specular = LT * VT - sqrt(1 - LT * LT) * sqrt(1 - VT * VT);
-	    specular = abs(specular);
-	    specular = pow(specular, 64);
-
-	   	color = (ambient + 0.5 * diffuse) * lineColor + 0.7 * specular * lightColor;
-	   	color = clamp(color, vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 1.0f, 1.0f));
-	}
-	else
-		color = vec3(0.1f, 0.1f, 0.1f);
-
-
-    return vec4(color, opa);
-}
+#include "shading.glsl"
 
 void main(void)
 {
-	if (isCenter()) gl_FragDepth = gl_FragCoord.z / gl_FragCoord.w;
-	//else gl_FragDepth = gl_FragCoord.z / gl_FragCoord.w;
-	else gl_FragDepth = (gl_FragCoord.z +  stripWidth * abs(TexCoords.y - 0.5)) / gl_FragCoord.w;
+	gl_FragDepth = fragmentDepth();
 
 	uint index = atomicCounterIncrement(listCounter);
+	//an overflowing fragment is dropped before it is linked, the list of its pixel stays intact
+	if (index >= listCapacity) return;
 	uint oldHead = imageAtomicExchange(headPointers, ivec2(gl_FragCoord.xy), index);
 
 	// x,y,z,w: next pointer, depth, weight, color
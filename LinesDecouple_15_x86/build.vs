@@ -1,4 +1,4 @@
-#version 460 core
+#version 450 core
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aDirection;
@@ -10,6 +10,10 @@ uniform vec3 viewDirection;
 uniform mat4 transform;
 uniform mat4 model;
 uniform float stripWidth;
+uniform int quantShift;//0: float vertices, else log2 of the vertices per block of the quantized stream
+
+//quantized vertices: 2 texels per block, the position and weight origin and scale
+layout (binding = 4) uniform samplerBuffer quantBlocks;
 
 out vec2 TexCoords;
 out float weight;
@@ -18,13 +22,23 @@ out vec3 T;
 
 void main(void)
 {
-	vec3 d = (transform * vec4(aDirection, 1.0f)).xyz;
+	vec3 pos = aPos;
+	weight = aWeight;
+	if (quantShift > 0)
+	{
+		int block = gl_VertexID >> quantShift;
+		vec4 lo = texelFetch(quantBlocks, 2 * block);
+		vec4 scale = texelFetch(quantBlocks, 2 * block + 1);
+		pos = lo.xyz + aPos * scale.xyz;
+		weight = lo.w + aWeight * scale.w;
+	}
+
+	vec3 d = (transform * vec4(aDirection, 0.0f)).xyz;
 	vec3 offset = normalize(cross(d, viewDirection)) * (aTexCoords.y - 0.5f) * stripWidth;
 
-	gl_Position = modelViewProjectionMatrix * (transform * vec4(aPos, 1.0f) + vec4(offset, 0.0f));
-	FragPos = vec3(model * (transform * vec4(aPos, 1.0f) + vec4(offset, 0.0f)));
+	gl_Position = modelViewProjectionMatrix * (transform * vec4(pos, 1.0f) + vec4(offset, 0.0f));
+	FragPos = vec3(model * (transform * vec4(pos, 1.0f) + vec4(offset, 0.0f)));
 
     TexCoords = aTexCoords;
-    weight = aWeight;
     T = aDirection;
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 
 #include <string>
 #include <cstdio>
+#include <cassert>
+#include <iostream>
+#include <sstream>
 #include <map>
 #include <vector>
 #include <fstream>
@@ -21,7 +24,8 @@ const unsigned int TOTAL_PIXELS = SCR_WIDTH * SCR_HEIGHT;
 
 #pragma region rendering related
 const unsigned int MAX_FRAGMENT_NUM = (unsigned int)1e7;
-const unsigned int RESTART_NUM = 0x5FFFFFu;//primitive restart number
+const unsigned int RESTART_NUM = 0xFFFFFFFFu;//primitive restart number, never a vertex index
+const unsigned int SCAN_BLOCK_SIZE = 1024;//counts scanned by one work group of scan.cs
 #pragma endregion
 
 #endif // !COMMONVARS_H
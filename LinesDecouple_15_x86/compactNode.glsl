@@ -0,0 +1,44 @@
+//8 byte fragment nodes of the contiguous A-buffer, included by fill.fs and resolveSpans.fs
+//the layout of CompactNode in ABuffer.h:
+//	x: bits 0-21 the depth as unorm of [0, depthRange], bits 22-31 the color code
+//	y: the blending weight
+//color code 0 is the strip border, otherwise bits 0-4 hold ambient + 0.5 * diffuse in [0.3, 0.8](codes 1-31)
+//and bits 5-9 sqrt(specular); the opacity is not stored
+
+const int COMPACT_DEPTH_BITS = 22;
+const uint COMPACT_DEPTH_MAX = (1u << COMPACT_DEPTH_BITS) - 1u;
+
+//largest depth: z_window * w_clip <= far, the border adds up to half the strip width
+float compactDepthRange(float farPlane, float stripWidth)
+{
+	return farPlane * (1.0 + 0.5 * stripWidth);
+}
+
+//terms: x = 1 at the center, 0 on the border, y = ambient + 0.5 * diffuse, z = specular
+uvec2 encodeCompactNode(float depth, float weight, vec3 terms, float depthRange)
+{
+	uint code = 0u;
+	if (terms.x != 0.0)
+	{
+		uint d = 1u + uint(clamp((terms.y - 0.3) / 0.5, 0.0, 1.0) * 30.0 + 0.5);
+		uint s = uint(min(sqrt(max(terms.z, 0.0)), 1.0) * 31.0 + 0.5);
+		code = d | (s << 5);
+	}
+	uint d = uint(clamp(depth / depthRange, 0.0, 1.0) * float(COMPACT_DEPTH_MAX) + 0.5);
+	return uvec2(d | (code << COMPACT_DEPTH_BITS), floatBitsToUint(weight));
+}
+
+//back to the uvec4 of the full nodes: unused, depth, weight, color
+uvec4 decodeCompactNode(uvec2 node, float depthRange, vec3 lineColor, vec3 lightColor, float opacity)
+{
+	float depth = float(node.x & COMPACT_DEPTH_MAX) * (depthRange / float(COMPACT_DEPTH_MAX));
+	uint code = node.x >> COMPACT_DEPTH_BITS;
+	vec3 color = vec3(0.1, 0.1, 0.1);
+	if (code != 0u)
+	{
+		float diffuse = 0.3 + 0.5 * float((code & 31u) - 1u) / 30.0;
+		float s = float(code >> 5) / 31.0;
+		color = clamp(lineColor * diffuse + lightColor * (0.7 * s * s), vec3(0.0), vec3(1.0));
+	}
+	return uvec4(0u, floatBitsToUint(depth), node.y, packUnorm4x8(vec4(color, opacity)));
+}
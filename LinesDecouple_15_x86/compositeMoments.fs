@@ -0,0 +1,18 @@
+#version 450 core
+
+//moment-based transparency, pass 3: the accumulated colors normalized by their weights cover the white background
+//by 1 - the total transmittance, which the absorbance sum gives exactly
+
+layout (binding = 5) uniform sampler2D moments0;
+layout (binding = 8) uniform sampler2D accumulation;
+
+out vec4 FragColor;
+
+void main(void)
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float transmittance = exp(-texelFetch(moments0, pixel, 0).x);
+	vec4 sum = texelFetch(accumulation, pixel, 0);
+	vec3 color = sum.a > 0.0 ? sum.rgb / sum.a : vec3(0.0);
+	FragColor = vec4(mix(color, vec3(1.0), transmittance), 1.0);
+}
@@ -0,0 +1,15 @@
+#version 450 core
+
+//contiguous A-buffer, pass 1: count the fragments of every pixel
+
+layout (early_fragment_tests) in;
+
+layout (std430, binding = 3) buffer FragmentCounts { uint fragmentCounts[]; };
+
+uniform int screenWidth;
+
+void main(void)
+{
+	ivec2 p = ivec2(gl_FragCoord.xy);
+	atomicAdd(fragmentCounts[p.y * screenWidth + p.x], 1u);
+}
@@ -0,0 +1,57 @@
+#version 450 core
+
+//contiguous A-buffer, pass 3: write every fragment into the span of its pixel
+//shading and depth are those of build.fs(shading.glsl)
+
+layout (binding = 1, rgba32ui) uniform uimageBuffer listBuffer;
+layout (binding = 2, r32f) uniform imageBuffer opacityBuffer;
+layout (binding = 3, rg32ui) uniform uimageBuffer compactBuffer;//the same buffer as listBuffer
+
+//cleared to 0 after the scan, used as per-pixel cursors here
+layout (std430, binding = 3) buffer FragmentCounts { uint fragmentCounts[]; };
+layout (std430, binding = 4) buffer SpanOffsets { uint spanOffsets[]; };
+
+uniform int segmentNum;
+uniform vec3 lightPos;
+uniform vec3 lightColor;
+uniform vec3 lineColor;
+uniform float stripWidth;
+uniform float farPlane;
+uniform int screenWidth;
+uniform uint listCapacity;
+uniform uint spanBase;//first fragment of the screen tile being rendered, its spans start at 0 in the buffer
+uniform bool compactNodes;//8 byte nodes in compactBuffer instead of listBuffer
+
+in vec2 TexCoords;
+in float weight;
+in vec3 FragPos;
+in vec3 T;
+
+#include "shading.glsl"
+#include "compactNode.glsl"
+
+void main(void)
+{
+	float depth = fragmentDepth();
+
+	ivec2 p = ivec2(gl_FragCoord.xy);
+	uint pixel = p.y * screenWidth + p.x;
+	uint index = spanOffsets[pixel] - spanBase + atomicAdd(fragmentCounts[pixel], 1u);
+	if (index >= listCapacity) return;
+
+	if (compactNodes)
+	{
+		uvec2 compact = encodeCompactNode(depth, weight, shadingTerms(), compactDepthRange(farPlane, stripWidth));
+		imageStore(compactBuffer, int(index), uvec4(compact, 0u, 0u));
+		return;
+	}
+
+	// x,y,z,w: unused, depth, weight, color
+	uvec4 node;
+	node.x = 0;
+	node.y = floatBitsToUint(depth);
+	node.z = floatBitsToUint(weight);
+	node.w = packUnorm4x8(setColor());
+
+	imageStore(listBuffer, int(index), node);
+}
@@ -7,19 +7,27 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include "Include/Shader.hpp"
-#include "Include/Camera.hpp"
-#include "Lines.cpp"
+#include "Include/shader.hpp"
+#include "Include/camera.hpp"
+#include "Lines.h"
+#include "RenderParams.h"
+#include "ABuffer.h"
+#include "OpacitySolver.h"
+#include "RenderPasses.h"
+#include "OpacityCache.h"
+#include "CameraPath.h"
+#include "FrameProfiler.h"
+#include "Tools.h"
+#include "Viewer.h"
 
 using namespace std;
 
-//constants
-const double EPS = 1e-10;
-
 //callbacks
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void processInput(GLFWwindow *window);
 
 //camera
@@ -29,6 +37,11 @@ float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 glm::mat4 rotMat = glm::mat4(1.0f);
+//right click: pick the line under the cursor in the next frame
+bool pickRequested = false;
+float pickX = 0.0f, pickY = 0.0f;
+//M: switch between the exact layout and moment-based transparency in the next frame
+bool switchTransparency = false;
 
 // timing
 float deltaTime = 0.0f;
@@ -37,12 +50,22 @@ float lastFrame = 0.0f;
 //init functions
 void initGlfw();
 void glfwWindowCreate(GLFWwindow* window);
-void openglConfig();
 
 
 //parameters
-enum ImportanceType { LENGTH, CURVATURE };
 ImportanceType importMode = CURVATURE;
+ABufferMode abufferMode = LINKED_LISTS;
+NodeFormat nodeFormat = FULL_NODES;
+GLuint fragmentBudget = 0;//fragments per pass before a frame is tiled, 0: the whole node buffer
+bool temporalOpacity = false;//smooth the opacities over frames and skip the solve while the view is still
+bool useOpacityCache = true;//blend the opacities of precompute-opacity instead of solving, if the model has a cache for coff
+bool frustumCulling = true;//draw only the line chunks whose boxes touch the view frustum
+bool lineLod = false;//draw every line at the coarsest level of detail within lodPixelError(main <model> lod)
+float lodPixelError = 0.5f;
+LineGeometry lineGeometry = RIBBONS;//screen-facing ribbons of stripWidth or 1 pixel line strips
+VertexFormat vertexFormat = FLOAT_VERTICES;//QUANTIZED_VERTICES: 16 bit positions and weights relative to blocks of points
+bool frameProfiling = false;//time the passes: rolling means in the window title, a report every 300 frames on stdout(main <model> profile)
+string traceFile = "";//Chrome trace of the profiled frames, written on exit if set
 string fileName = "cyclone.obj";
 double scaleH = 60;
 double coff[5] = { 1.0f, 2.0f, 0.2f, 0.3f, 5.0f };//p, q, r, s, lambda
@@ -50,10 +73,37 @@ float rotateHorizontal = 1.2f;
 int segPerLine = 4;
 float rotateVertical = 0.0f;
 
-Lines mesh;
+Lines *mesh = nullptr;
 
-int main()
+int main(int argc, char **argv)
 {
+	if (argc > 1 && isTool(argv[1]))
+		return runTool(argc, argv);
+	if (argc > 1)
+		fileName = argv[1];
+	//switches anywhere after the model, the other arguments keep their order: lod(lineLod), profile(frameProfiling)
+	vector<string> args;
+	for (int i = 2; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "lod") lineLod = true;
+		else if (arg == "profile") frameProfiling = true;
+		else args.push_back(arg);
+	}
+	//optional A-buffer layout: lists, spans, compact(spans of 8 byte nodes) or moments(no A-buffer, approximate)
+	if (args.size() > 0)
+	{
+		const string &layout = args[0];
+		if (layout == "spans" || layout == "compact") abufferMode = CONTIGUOUS_SPANS;
+		else if (layout == "lists") abufferMode = LINKED_LISTS;
+		else if (layout == "moments") abufferMode = MOMENT_OIT;
+		else cout << "WARNING::MAIN::UNKNOWN_LAYOUT " << layout << endl;
+		if (layout == "compact") nodeFormat = COMPACT_NODES;
+	}
+	//optional fragments per pass, larger frames are rendered in screen tiles
+	if (args.size() > 1)
+		fragmentBudget = (GLuint)atoll(args[1].c_str());
+
 	initGlfw();
 
 	// glfw window creation
@@ -75,8 +125,46 @@ int main()
 
 	// load models
 	// -----------
-
+	{
+		double t0 = glfwGetTime();
+		mesh = new Lines(fileName, segPerLine, true, lineGeometry, vertexFormat);
+		if (!mesh->loaded())
+		{
+			delete mesh;
+			glfwTerminate();
+			return 1;
+		}
+		mesh->computeImportance(importMode);
+		if (frustumCulling) mesh->buildBVH();
+		if (lineLod) mesh->buildLevels();
+		cout << "Loaded " << fileName << ": " << mesh->vertexNum_ << " vertices, " << mesh->segmentNum_ << " segments in "
+			<< glfwGetTime() - t0 << " s" << endl;
+	}
 	
+	// build and compile shaders
+	// -------------------------
+	std::unique_ptr<RenderPasses> passes = viewerPasses();
+
+	OpacitySolver solver;
+	mesh->setupSolver(solver);
+	vector<float> opacity(mesh->segmentNum_, 1.0f);
+	TemporalOpacity temporal;
+	temporal.enabled = temporalOpacity;
+
+	OpacityCache opacityCache;
+	if (useOpacityCache)
+	{
+		OpacityCacheKey key = makeOpacityCacheKey(mesh->lines_, mesh->segmentNum_, importMode, coff, makeRenderParams(*mesh),
+			mesh->geometry(), mesh->vertexFormat(), nodeFormat);
+		if (opacityCache.load(opacityCachePath(fileName, key), key))
+			cout << "Loaded opacity cache: " << opacityCache.viewNum() << " views" << endl;
+	}
+
+	FrameProfiler profiler;
+	profiler.reportInterval = 300;
+	FrameProfiler *profile = frameProfiling ? &profiler : nullptr;
+	passes->profiler = profile;
+
 	// render loop
 	// -----------
 	while (!glfwWindowShouldClose(window))
@@ -89,27 +177,73 @@ int main()
 		lastFrame = currentFrame;
 
 		processInput(window);
+		if (profile) profile->beginFrame();
 
-		// view/projection/model/rotate matrix
-		glm::mat4 projection, view, model, modelViewProjectionMatrix, rotMat2;
-		projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.001f, 5.0f);
-		view = camera.GetViewMatrix();
-		//model is vec4(1) here
-		modelViewProjectionMatrix = projection * view * model;
+		// rotate matrix
+		glm::mat4 rotMat2 = glm::mat4(1.0f);
 		rotMat2 = glm::rotate(rotMat2, rotateHorizontal, glm::vec3(0.0f, 1.0f, 0.0f));
 		rotMat2 = glm::rotate(rotMat2, rotateVertical, glm::vec3(1.0f, 0.0f, 0.0f));
 		rotateHorizontal = rotateVertical = 0.0f;
 		rotMat = rotMat2 * rotMat;
+		RenderParams params = makeRenderParams(*mesh);
+		{
+			ProfileScope scope(profile, "cull", false);
+			if (frustumCulling) mesh->cull(params);
+			if (lineLod) mesh->selectLevels(params, lodPixelError);
+		}
+		if (pickRequested)
+		{
+			PickResult picked = mesh->pick(params, pickX, pickY);
+			if (picked.line >= 0) cout << "Picked line " << picked.line << " at vertex " << picked.vertex << endl;
+			else cout << "Picked no line" << endl;
+			pickRequested = false;
+		}
+		if (switchTransparency)
+		{
+			//the exact layout of the command line, lists if it asked for moments
+			ABufferMode exact = abufferMode == MOMENT_OIT ? LINKED_LISTS : abufferMode;
+			passes->mode = passes->mode == MOMENT_OIT ? exact : MOMENT_OIT;
+			temporal.reset();
+			cout << "Transparency: " << (passes->mode == MOMENT_OIT ? "moments" : "exact") << endl;
+			switchTransparency = false;
+		}
 
+#pragma region build and resolve with the opacities of the last frame(or the cached ones), opacity optimization on the CPU
+		if (!opacityCache.empty())
+		{
+			opacityCache.lookup(dataViewDirection(params), &opacity[0]);
+			mesh->uploadOpacity(&opacity[0]);
+			passes->draw(*mesh, params);
+		}
+		else
+			passes->frame(*mesh, solver, makeOpacityParams(), params, opacity, &temporal);
+#pragma endregion
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
-		glfwSwapBuffers(window);
+		{
+			ProfileScope scope(profile, "swap", false);
+			glfwSwapBuffers(window);
+		}
+		if (profile)
+		{
+			profile->endFrame();
+			if (profile->frameCpuMs().size() > 0 && profile->frames().back().index % 30 == 0)
+				glfwSetWindowTitle(window, ("Lines - " + profile->summary()).c_str());
+		}
 		glfwPollEvents();
 	}
+	if (profile)
+	{
+		profile->flush();
+		cout << profile->report();
+		if (!traceFile.empty() && profile->writeTrace(traceFile)) cout << "Wrote " << traceFile << endl;
+	}
 
 	//cin.get();
 
+	delete mesh;
+
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
 	glfwTerminate();
@@ -117,6 +251,60 @@ int main()
 	return 0;
 }
 
+
+//uniforms of the current camera and rotation
+RenderParams makeRenderParams(const Lines &lines)
+{
+	RenderParams params;
+	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.001f, params.farPlane);
+	glm::mat4 view = camera.GetViewMatrix();
+	glm::mat4 model = glm::mat4(1.0f);
+	params.modelViewProjectionMatrix = projection * view * model;
+	params.model = model;
+	params.transform = rotMat * lines.normalization();
+	params.viewDirection = camera.Front;
+	params.segmentNum = lines.segmentNum_;
+	params.quantShift = lines.quantShift();
+	return params;
+}
+
+//camera and data rotation of a camera path key
+void applyCameraKey(const CameraKey &key)
+{
+	camera.Position = key.position;
+	camera.Front = glm::normalize(key.target - key.position);
+	camera.Right = glm::normalize(glm::cross(camera.Front, camera.WorldUp));
+	camera.Up = glm::normalize(glm::cross(camera.Right, camera.Front));
+	camera.Zoom = key.zoom;
+	rotMat = glm::rotate(glm::mat4(1.0f), key.rotateHorizontal, glm::vec3(0.0f, 1.0f, 0.0f));
+	rotMat = glm::rotate(rotMat, key.rotateVertical, glm::vec3(1.0f, 0.0f, 0.0f));
+}
+
+OpacityParams makeOpacityParams()
+{
+	OpacityParams params;
+	params.p = (float)coff[0];
+	params.q = (float)coff[1];
+	params.r = (float)coff[2];
+	params.s = (float)coff[3];
+	params.lambda = (float)coff[4];
+	return params;
+}
+
+void resetRotation(float degrees)
+{
+	rotMat = glm::rotate(glm::mat4(1.0f), rotateHorizontal + glm::radians(degrees), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+std::unique_ptr<RenderPasses> viewerPasses()
+{
+	std::unique_ptr<RenderPasses> passes(new RenderPasses());
+	passes->mode = abufferMode;
+	passes->format = nodeFormat;
+	passes->fragmentBudget = fragmentBudget;
+	return passes;
+}
+
 void initGlfw()
 {
 	// glfw: initialize and configure
@@ -137,6 +325,8 @@ void glfwWindowCreate(GLFWwindow* window)
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
+	glfwSetMouseButtonCallback(window, mouse_button_callback);
+	glfwSetKeyCallback(window, key_callback);
 }
 
 void openglConfig()
@@ -153,6 +343,7 @@ void openglConfig()
 }
 
 
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window)
@@ -220,4 +411,26 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
 	camera.ProcessMouseScroll((float)yoffset);
-}
\ No newline at end of file
+}
+
+// glfw: a right click picks the line under the cursor
+// ----------------------------------------------------
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+	if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS)
+	{
+		double xpos, ypos;
+		glfwGetCursorPos(window, &xpos, &ypos);
+		pickX = (float)xpos;
+		pickY = (float)ypos;
+		pickRequested = true;
+	}
+}
+
+// glfw: M switches the transparency between the exact A-buffer and the moments
+// ----------------------------------------------------------------------------
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	if (key == GLFW_KEY_M && action == GLFW_PRESS)
+		switchTransparency = true;
+}
@@ -0,0 +1,52 @@
+#version 450 core
+
+//moment-based transparency, pass 1: every fragment adds the moments of its absorbance and of its squared importance,
+//blended additively into the float targets of Lines::FBO_MOMENTS; depth and opacity are those of build.fs(shading.glsl)
+
+layout (binding = 2, r32f) uniform imageBuffer opacityBuffer;
+layout (std430, binding = 6) readonly buffer SegmentImportance { float importance[]; };
+
+layout(binding = 0, offset = 0) uniform atomic_uint fragmentCounter;
+
+uniform int segmentNum;
+uniform vec3 lightPos;//declared for shading.glsl, this pass does not shade
+uniform vec3 lightColor;
+uniform vec3 lineColor;
+uniform float stripWidth;
+uniform vec2 depthRange;
+
+in vec2 TexCoords;
+in float weight;
+in vec3 FragPos;
+in vec3 T;
+
+layout (location = 0) out vec4 moments0;
+layout (location = 1) out vec4 moments1;
+layout (location = 2) out vec4 moments2;
+
+#include "moments.glsl"
+#include "shading.glsl"
+
+//interpolated between the two segment nodes like the opacity, 0 past the last one
+float fragmentImportance()
+{
+	int segId = int(weight);
+	float g1 = segId < segmentNum ? importance[segId] : 0.0;
+	float g2 = segId + 1 < segmentNum ? importance[segId + 1] : 0.0;
+	return mix(g1, g2, fract(weight));
+}
+
+void main(void)
+{
+	float z = warpMomentDepth(fragmentDepth(), depthRange);
+	vec4 powers = vec4(z, z * z, z * z * z, z * z * z * z);
+
+	float a = -log(1.0 - min(fragmentOpacity(), MOMENT_MAX_ALPHA));
+	float g = fragmentImportance();
+	float w = g * g;
+	moments0 = vec4(a, a * powers.xyz);
+	moments1 = vec4(a * powers.w, w, w * powers.xy);
+	moments2 = vec4(w * powers.zw, 0.0, 0.0);
+
+	atomicCounterIncrement(fragmentCounter);
+}
@@ -0,0 +1,51 @@
+//moment-based transparency, included by moments.fs, resolveMoments.fs and compositeMoments.fs
+//the GLSL twin of MomentOIT.h: per pixel the sums of w z^k, k = 0..4, of the absorbance and of the squared importance
+//	moments0: (a, a z, a z^2, a z^3)
+//	moments1: (a z^4, g^2, g^2 z, g^2 z^2)
+//	moments2: (g^2 z^3, g^2 z^4, -, -)
+
+const float MOMENT_BIAS = 5e-7;
+const float MOMENT_OVERESTIMATION = 0.25;
+const float MOMENT_MAX_ALPHA = 0.9999;
+
+//the depth of build.fs linearly into [-1, 1] over depthRange(momentDepthRange() in MomentOIT.h)
+float warpMomentDepth(float depth, vec2 depthRange)
+{
+	return clamp(2.0 * (depth - depthRange.x) / (depthRange.y - depthRange.x) - 1.0, -1.0, 1.0);
+}
+
+//the part of the total weight b0 in front of z, in [0, 1]; moments: the sums of w z^k, k = 1..4
+float momentFractionInFront(float b0, vec4 moments, float z)
+{
+	if (b0 <= 0.0) return 0.0;
+	vec4 b = mix(moments / b0, vec4(0.0, 0.375, 0.0, 0.375), MOMENT_BIAS);
+
+	//Cholesky factorization of the Hankel matrix of (1, b1, b2, b3, b4)
+	float L21D11 = b[2] - b[0] * b[1];
+	float D11 = b[1] - b[0] * b[0];
+	float L21 = L21D11 / D11;
+	float D22 = (b[3] - b[1] * b[1]) - L21D11 * L21;
+
+	//c = B^-1 (1, z, z^2), the polynomial c0 + c1 x + c2 x^2 vanishes at the other support points
+	vec3 c = vec3(1.0, z, z * z);
+	c[1] -= b[0];
+	c[2] -= b[1] + L21 * c[1];
+	c[1] /= D11;
+	c[2] /= D22;
+	c[1] -= L21 * c[2];
+	c[0] -= c[1] * b[0] + c[2] * b[1];
+
+	float p = c[1] / c[2], q = c[0] / c[2];
+	float r = sqrt(max(0.25 * p * p - q, 0.0));
+	float z1 = -0.5 * p - r, z2 = -0.5 * p + r;
+
+	//1 in front of z, MOMENT_OVERESTIMATION at z, 0 behind, interpolated by a quadratic and integrated
+	float f0 = MOMENT_OVERESTIMATION, f1 = z1 < z ? 1.0 : 0.0, f2 = z2 < z ? 1.0 : 0.0;
+	float f01 = (f1 - f0) / (z1 - z);
+	float f12 = (f2 - f1) / (z2 - z1);
+	float f012 = (f12 - f01) / (z2 - z);
+	float poly2 = f012;
+	float poly1 = f01 - f012 * (z + z1);
+	float poly0 = f0 - f01 * z + f012 * z * z1;
+	return clamp(poly0 + poly1 * b[0] + poly2 * b[1], 0.0, 1.0);
+}
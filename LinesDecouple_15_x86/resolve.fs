@@ -1,4 +1,4 @@
-#version 460 core
+#version 450 core
 
 layout (early_fragment_tests) in;
 
@@ -9,12 +9,10 @@ layout(binding = 0, offset = 4) uniform atomic_uint debugOut;
 
 out vec4 FragColor;
 
+#include "sort.glsl"
+
 void main(void)
 {
-	//node list
-	const int MAX_NODES_NUM = 800;
-	uvec4 nodeList[MAX_NODES_NUM];
-
 	//collect nodes of this pixel
 	//---------------------------
 	uint cnt = 0;//the number of fragments in this pixel
@@ -30,27 +28,7 @@ void main(void)
 	}
 
 	//sort nodeList
-	if(cnt > 1)
-	{
-		for(uint i = 0; i < cnt - 1; ++i)
-		{
-			for(uint j = i + 1; j < cnt; ++j)
-			{
-				uvec4 node1 = nodeList[i];
-				uvec4 node2 = nodeList[j];
-
-				float depth1 = uintBitsToFloat(node1.y);
-				float depth2 = uintBitsToFloat(node2.y);
-
-				if(depth1 < depth2)
-				{
-					nodeList[i] = node2;
-					nodeList[j] = node1;
-				}
-			}
-		}
-	}
-
+	sortNodes(int(cnt));
 
 	vec4 finalColor = vec4(1.0);
 
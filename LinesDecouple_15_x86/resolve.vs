@@ -1,18 +1,30 @@
-#version 460 core
+#version 450 core
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aDirection;
 layout (location = 2) in vec2 aTexCoords;
 
 uniform float stripWidth;
+uniform int quantShift;//0: float vertices, else log2 of the vertices per block of the quantized stream
+
+//quantized vertices: 2 texels per block, the position and weight origin and scale
+layout (binding = 4) uniform samplerBuffer quantBlocks;
 uniform mat4 modelViewProjectionMatrix;
 uniform vec3 viewDirection;
 uniform mat4 transform;
 
 void main(void)
 {
-	vec3 d = (transform * vec4(aDirection, 1.0f)).xyz;
+	vec3 pos = aPos;
+	if (quantShift > 0)
+	{
+		int block = gl_VertexID >> quantShift;
+		vec4 lo = texelFetch(quantBlocks, 2 * block);
+		pos = lo.xyz + aPos * texelFetch(quantBlocks, 2 * block + 1).xyz;
+	}
+
+	vec3 d = (transform * vec4(aDirection, 0.0f)).xyz;
 	vec3 offset = normalize(cross(d, viewDirection)) * (aTexCoords.y - 0.5f) * stripWidth;
 
-	gl_Position = modelViewProjectionMatrix * (transform * vec4(aPos, 1.0f) + vec4(offset, 0.0f));
+	gl_Position = modelViewProjectionMatrix * (transform * vec4(pos, 1.0f) + vec4(offset, 0.0f));
 }
\ No newline at end of file
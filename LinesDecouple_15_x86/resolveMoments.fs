@@ -0,0 +1,74 @@
+#version 450 core
+
+//moment-based transparency, pass 2: every fragment adds its premultiplied color times the transmittance in front of it,
+//estimated from the absorbance moments of its pixel, into Lines::FBO_MOMENT_ACCUM(additive blending);
+//accumulateOcclusion also estimates h- and h+ from the squared importance moments and keeps their maxima per segment node
+//shading and depth are those of build.fs(shading.glsl)
+
+layout (binding = 2, r32f) uniform imageBuffer opacityBuffer;
+layout (std430, binding = 6) readonly buffer SegmentImportance { float importance[]; };
+//float bits of h- of every segment node, then of h+; non-negative floats order like their bits
+layout (std430, binding = 7) buffer SegmentOcclusion { uint occlusion[]; };
+
+layout (binding = 5) uniform sampler2D moments0;
+layout (binding = 6) uniform sampler2D moments1;
+layout (binding = 7) uniform sampler2D moments2;
+
+uniform int segmentNum;
+uniform vec3 lightPos;
+uniform vec3 lightColor;
+uniform vec3 lineColor;
+uniform float stripWidth;
+uniform vec2 depthRange;
+uniform bool accumulateOcclusion;
+
+in vec2 TexCoords;
+in float weight;
+in vec3 FragPos;
+in vec3 T;
+
+out vec4 FragColor;
+
+#include "moments.glsl"
+#include "shading.glsl"
+
+float fragmentImportance()
+{
+	int segId = int(weight);
+	float g1 = segId < segmentNum ? importance[segId] : 0.0;
+	float g2 = segId + 1 < segmentNum ? importance[segId + 1] : 0.0;
+	return mix(g1, g2, fract(weight));
+}
+
+void main(void)
+{
+	float z = warpMomentDepth(fragmentDepth(), depthRange);
+
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec4 m0 = texelFetch(moments0, pixel, 0);
+	vec4 m1 = texelFetch(moments1, pixel, 0);
+
+	vec4 color = setColor();
+	float alpha = min(color.a, MOMENT_MAX_ALPHA);
+	float transmittance = exp(-m0.x * momentFractionInFront(m0.x, vec4(m0.yzw, m1.x), z));
+	FragColor = vec4(color.rgb, 1.0) * (alpha * transmittance);
+
+	if (!accumulateOcclusion) return;
+	vec4 m2 = texelFetch(moments2, pixel, 0);
+	float g = fragmentImportance();
+	float g2 = g * g;
+	float total = m1.y;
+	float front = max(total * momentFractionInFront(total, vec4(m1.zw, m2.xy), z) - MOMENT_OVERESTIMATION * g2, 0.0);
+	float behind = max(total - front - g2, 0.0);
+	int segId = int(weight);
+	if (segId >= 0 && segId < segmentNum)
+	{
+		atomicMax(occlusion[segId], floatBitsToUint(front));
+		atomicMax(occlusion[segmentNum + segId], floatBitsToUint(behind));
+	}
+	if (segId + 1 >= 0 && segId + 1 < segmentNum)
+	{
+		atomicMax(occlusion[segId + 1], floatBitsToUint(front));
+		atomicMax(occlusion[segmentNum + segId + 1], floatBitsToUint(behind));
+	}
+}
@@ -0,0 +1,73 @@
+#version 450 core
+
+//resolve.fs for the contiguous A-buffer: the fragments of a pixel are one span of listBuffer
+
+layout (early_fragment_tests) in;
+
+layout (binding = 1, rgba32ui) uniform uimageBuffer listBuffer;
+layout (binding = 2, r32f) uniform imageBuffer opacityBuffer;
+layout (binding = 3, rg32ui) uniform uimageBuffer compactBuffer;//the same buffer as listBuffer
+layout (std430, binding = 4) buffer SpanOffsets { uint spanOffsets[]; };
+
+uniform int screenWidth;
+uniform uint listCapacity;
+uniform uint spanBase;//first fragment of the screen tile being rendered, its spans start at 0 in the buffer
+uniform bool compactNodes;//8 byte nodes in compactBuffer instead of listBuffer
+uniform vec3 lightColor;
+uniform vec3 lineColor;
+uniform float stripWidth;
+uniform float farPlane;
+
+out vec4 FragColor;
+
+#include "sort.glsl"
+#include "compactNode.glsl"
+
+//the opacity of the segment the compact node belongs to, as build.fs interpolates it
+float nodeOpacity(uint weightBits)
+{
+	float w = uintBitsToFloat(weightBits);
+	int segId = int(w);
+	return mix(imageLoad(opacityBuffer, segId).x, imageLoad(opacityBuffer, segId + 1).x, fract(w));
+}
+
+void main(void)
+{
+	//collect nodes of this pixel
+	//---------------------------
+	ivec2 p = ivec2(gl_FragCoord.xy);
+	uint pixel = p.y * screenWidth + p.x;
+	uint begin = min(spanOffsets[pixel] - spanBase, listCapacity);
+	uint end = min(spanOffsets[pixel + 1] - spanBase, listCapacity);
+	uint cnt = min(end - begin, uint(MAX_NODES_NUM));//the number of fragments in this pixel
+	if (compactNodes)
+	{
+		float depthRange = compactDepthRange(farPlane, stripWidth);
+		for (uint i = 0; i < cnt; ++i)
+		{
+			uvec2 node = imageLoad(compactBuffer, int(begin + i)).xy;
+			nodeList[i] = decodeCompactNode(node, depthRange, lineColor, lightColor, nodeOpacity(node.y));
+		}
+	}
+	else
+	{
+		for (uint i = 0; i < cnt; ++i)
+		{
+			// x,y,z,w: unused, depth, weight, color
+			nodeList[i] = imageLoad(listBuffer, int(begin + i));
+		}
+	}
+
+	//sort nodeList
+	sortNodes(int(cnt));
+
+	vec4 finalColor = vec4(1.0);
+
+	for(uint i = 0; i < cnt; ++i)
+	{
+		vec4 fragColor = unpackUnorm4x8(nodeList[i].w);
+		finalColor = mix(finalColor, fragColor ,fragColor.a);
+	}
+
+	FragColor = finalColor;
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#version 450 core
+
+//contiguous A-buffer, pass 2: exclusive prefix sum of the fragment counts into the span offsets
+//stage 0: scan blocks of 1024 counts, one block per work group, block totals go to blockSums
+//stage 1: scan blockSums in a single work group
+//stage 2: add the scanned block sums to the offsets, offsets[pixelNum] becomes the total
+
+layout (local_size_x = 256) in;
+
+layout (std430, binding = 3) buffer FragmentCounts { uint fragmentCounts[]; };
+layout (std430, binding = 4) buffer SpanOffsets { uint spanOffsets[]; };
+layout (std430, binding = 5) buffer BlockSums { uint blockSums[]; };
+
+uniform int stage;
+uniform uint pixelNum;
+uniform uint blockNum;
+
+const uint PER_THREAD = 4;
+const uint BLOCK_SIZE = 256 * PER_THREAD;
+
+shared uint partialSums[256];
+
+//exclusive scan of 'sum' over the work group, returns the prefix of this invocation and sets 'total'
+uint scanGroup(uint sum, out uint total)
+{
+	uint id = gl_LocalInvocationID.x;
+	partialSums[id] = sum;
+	barrier();
+	for (uint offset = 1; offset < 256; offset <<= 1)
+	{
+		uint v = id >= offset ? partialSums[id - offset] : 0;
+		barrier();
+		partialSums[id] += v;
+		barrier();
+	}
+	total = partialSums[255];
+	uint prefix = partialSums[id] - sum;
+	barrier();
+	return prefix;
+}
+
+void main(void)
+{
+	uint id = gl_LocalInvocationID.x;
+	if (stage == 0)
+	{
+		uint base = gl_WorkGroupID.x * BLOCK_SIZE + id * PER_THREAD;
+		uint v[PER_THREAD];
+		uint sum = 0;
+		for (uint k = 0; k < PER_THREAD; ++k)
+		{
+			v[k] = base + k < pixelNum ? fragmentCounts[base + k] : 0;
+			sum += v[k];
+		}
+		uint total;
+		uint prefix = scanGroup(sum, total);
+		for (uint k = 0; k < PER_THREAD; ++k)
+		{
+			if (base + k < pixelNum) spanOffsets[base + k] = prefix;
+			prefix += v[k];
+		}
+		if (id == 0) blockSums[gl_WorkGroupID.x] = total;
+	}
+	else if (stage == 1)
+	{
+		//any number of blocks, BLOCK_SIZE at a time with a carry
+		uint carry = 0;
+		for (uint chunk = 0; chunk < blockNum; chunk += BLOCK_SIZE)
+		{
+			uint base = chunk + id * PER_THREAD;
+			uint v[PER_THREAD];
+			uint sum = 0;
+			for (uint k = 0; k < PER_THREAD; ++k)
+			{
+				v[k] = base + k < blockNum ? blockSums[base + k] : 0;
+				sum += v[k];
+			}
+			uint total;
+			uint prefix = scanGroup(sum, total) + carry;
+			for (uint k = 0; k < PER_THREAD; ++k)
+			{
+				if (base + k < blockNum) blockSums[base + k] = prefix;
+				prefix += v[k];
+			}
+			carry += total;
+		}
+		if (id == 0) spanOffsets[pixelNum] = carry;
+	}
+	else
+	{
+		uint base = gl_WorkGroupID.x * BLOCK_SIZE + id * PER_THREAD;
+		uint blockOffset = blockSums[gl_WorkGroupID.x];
+		for (uint k = 0; k < PER_THREAD; ++k)
+		{
+			if (base + k < pixelNum) spanOffsets[base + k] += blockOffset;
+		}
+	}
+}
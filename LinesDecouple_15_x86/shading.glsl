@@ -0,0 +1,58 @@
+//shading and depth of a line fragment, included by build.fs, fill.fs, moments.fs and resolveMoments.fs
+//the GLSL twin of the build.fs(shading.glsl) region of ABuffer.h; the including shader declares
+//	in TexCoords, weight, FragPos, T(the outputs of build.vs)
+//	uniform lightPos, lightColor, lineColor, stripWidth and the r32f imageBuffer opacityBuffer
+
+bool isCenter()
+{
+	return (abs(TexCoords.y - 0.5f) < 0.35f);
+}
+
+//the border of the strip lies behind its center by up to half the strip width
+float fragmentDepth()
+{
+	if (isCenter()) return gl_FragCoord.z / gl_FragCoord.w;
+	return (gl_FragCoord.z +  stripWidth * abs(TexCoords.y - 0.5)) / gl_FragCoord.w;
+}
+
+//interpolated between the two segment nodes of the fragment
+float fragmentOpacity()
+{
+	int segId = int(weight);
+	float opa1 = imageLoad(opacityBuffer, int(segId)).x;
+	float opa2 = imageLoad(opacityBuffer, int(segId+1)).x;
+	return mix(opa1, opa2, fract(weight));
+}
+
+//x: 1 at the center, 0 on the border, y: ambient + 0.5 * diffuse, z: specular
+vec3 shadingTerms()
+{
+	if(!isCenter()) return vec3(0.0);
+
+	vec3 L = normalize(lightPos - FragPos);
+	vec3 V = normalize(-FragPos);
+	float LT = abs(dot(L, T));
+	float VT = abs(dot(V, T));
+
+	// ambient
+	float ambient = 0.3;
+
+	// diffuse
+	float diffuse = sqrt(1 - LT * LT);
+
+	//specular
+	float specular = LT * VT - sqrt(1 - LT * LT) * sqrt(1 - VT * VT);
+	specular = abs(specular);
+	specular = pow(specular, 64);
+
+	return vec3(1.0, ambient + 0.5 * diffuse, specular);
+}
+
+vec4 setColor()
+{
+	vec3 terms = shadingTerms();
+	vec3 color = vec3(0.1f, 0.1f, 0.1f);
+	if (terms.x != 0.0)
+		color = clamp(terms.y * lineColor + 0.7 * terms.z * lightColor, vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 1.0f, 1.0f));
+	return vec4(color, fragmentOpacity());
+}
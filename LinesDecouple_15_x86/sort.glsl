@@ -0,0 +1,195 @@
+//per-pixel fragment sorting, included by resolve.fs, resolveSpans.fs and sortBench.cs
+//sortNodes(cnt) sorts nodeList[0, cnt) farthest first, the strategies are the ones of FragmentSort.h
+
+const int MAX_NODES_NUM = 800;
+//merge and radix sort use nodeList[cnt, 2 * cnt) as scratch, a second array would double the private memory of
+//every invocation(about 30% slower resolves on llvmpipe); longer lists fall back to the in-place bitonic sort
+uvec4 nodeList[MAX_NODES_NUM];
+
+const int SORT_ADAPTIVE = 0;
+const int SORT_INSERTION = 1;
+const int SORT_BITONIC = 2;
+const int SORT_MERGE = 3;
+const int SORT_RADIX = 4;
+const int SORT_EXCHANGE = 5;
+
+//the adaptive choice by list length, measured with bench-sort
+const int SORT_INSERTION_MAX = 16;
+const int SORT_MERGE_MAX = 64;
+
+uniform int sortStrategy;//SORT_ADAPTIVE unless set
+
+//ascending keys are farthest first
+uint sortKey(uvec4 node)
+{
+	uint bits = node.y;
+	bits = (bits & 0x80000000u) != 0u ? ~bits : (bits | 0x80000000u);
+	return ~bits;
+}
+
+void insertionSort(int begin, int end)
+{
+	for (int i = begin + 1; i < end; ++i)
+	{
+		uvec4 node = nodeList[i];
+		uint key = sortKey(node);
+		int j = i - 1;
+		while (j >= begin && sortKey(nodeList[j]) > key)
+		{
+			nodeList[j + 1] = nodeList[j];
+			--j;
+		}
+		nodeList[j + 1] = node;
+	}
+}
+
+//the O(n^2) sort resolve.fs used to run
+void exchangeSort(int cnt)
+{
+	for (int i = 0; i < cnt - 1; ++i)
+	{
+		for (int j = i + 1; j < cnt; ++j)
+		{
+			uvec4 node1 = nodeList[i];
+			uvec4 node2 = nodeList[j];
+			if (uintBitsToFloat(node1.y) < uintBitsToFloat(node2.y))
+			{
+				nodeList[i] = node2;
+				nodeList[j] = node1;
+			}
+		}
+	}
+}
+
+void compareExchange(inout uvec4 a, inout uint ka, inout uvec4 b, inout uint kb)
+{
+	if (ka > kb)
+	{
+		uvec4 n = a; a = b; b = n;
+		uint k = ka; ka = kb; kb = k;
+	}
+}
+
+void compareExchangeAt(int i, int l)
+{
+	uvec4 a = nodeList[i];
+	uvec4 b = nodeList[l];
+	if (sortKey(a) > sortKey(b))
+	{
+		nodeList[i] = b;
+		nodeList[l] = a;
+	}
+}
+
+//a block of 4 in registers, 5 comparators
+void sortBlock4(int b)
+{
+	uvec4 n0 = nodeList[b], n1 = nodeList[b + 1], n2 = nodeList[b + 2], n3 = nodeList[b + 3];
+	uint k0 = sortKey(n0), k1 = sortKey(n1), k2 = sortKey(n2), k3 = sortKey(n3);
+	compareExchange(n0, k0, n1, k1);
+	compareExchange(n2, k2, n3, k3);
+	compareExchange(n0, k0, n2, k2);
+	compareExchange(n1, k1, n3, k3);
+	compareExchange(n1, k1, n2, k2);
+	nodeList[b] = n0; nodeList[b + 1] = n1; nodeList[b + 2] = n2; nodeList[b + 3] = n3;
+}
+
+//network in flip form: every comparator puts the smaller key first, so a count that is not a power of two
+//behaves like padding with keys that sort last, whose comparators are skipped
+void bitonicSort(int cnt)
+{
+	int blocks = cnt & ~3;
+	for (int b = 0; b < blocks; b += 4) sortBlock4(b);
+	insertionSort(blocks, cnt);
+
+	int n = 4;
+	while (n < cnt) n *= 2;
+	for (int k = 8; k <= n; k *= 2)
+	{
+		for (int i = 0; i < cnt; ++i)
+		{
+			int inBlock = i & (k - 1);
+			int l = i - inBlock + k - 1 - inBlock;
+			if (inBlock < k / 2 && l < cnt) compareExchangeAt(i, l);
+		}
+		for (int j = k / 4; j > 0; j /= 2)
+		{
+			for (int i = 0; i < cnt - j; ++i)
+				if ((i & j) == 0) compareExchangeAt(i, i + j);
+		}
+	}
+}
+
+//bottom-up from insertion sorted runs of 8, alternating between nodeList[0, cnt) and the scratch
+void mergeSort(int cnt)
+{
+	const int RUN = 8;
+	for (int b = 0; b < cnt; b += RUN) insertionSort(b, min(b + RUN, cnt));
+
+	int src = 0, dst = cnt;
+	for (int width = RUN; width < cnt; width *= 2)
+	{
+		for (int b = 0; b < cnt; b += 2 * width)
+		{
+			int m = min(b + width, cnt), e = min(b + 2 * width, cnt);
+			int i = b, j = m;
+			for (int o = b; o < e; ++o)
+			{
+				bool takeRight = i >= m || (j < e && sortKey(nodeList[src + j]) < sortKey(nodeList[src + i]));
+				nodeList[dst + o] = takeRight ? nodeList[src + j++] : nodeList[src + i++];
+			}
+		}
+		dst = src;
+		src = cnt - src;
+	}
+	if (src != 0)
+		for (int i = 0; i < cnt; ++i) nodeList[i] = nodeList[src + i];
+}
+
+//LSD on 8 bit digits, a pass is skipped when all keys share its digit
+void radixSort(int cnt)
+{
+	uint counts[256];
+	int src = 0, dst = cnt;
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		for (int d = 0; d < 256; ++d) counts[d] = 0u;
+		for (int i = 0; i < cnt; ++i) ++counts[(sortKey(nodeList[src + i]) >> shift) & 0xFFu];
+		if (counts[(sortKey(nodeList[src]) >> shift) & 0xFFu] == uint(cnt)) continue;
+
+		uint sum = 0u;
+		for (int d = 0; d < 256; ++d)
+		{
+			uint c = counts[d];
+			counts[d] = sum;
+			sum += c;
+		}
+		for (int i = 0; i < cnt; ++i)
+		{
+			uvec4 node = nodeList[src + i];
+			uint d = (sortKey(node) >> shift) & 0xFFu;
+			nodeList[dst + int(counts[d])] = node;
+			++counts[d];
+		}
+		dst = src;
+		src = cnt - src;
+	}
+	if (src != 0)
+		for (int i = 0; i < cnt; ++i) nodeList[i] = nodeList[src + i];
+}
+
+void sortNodes(int cnt)
+{
+	if (cnt < 2) return;
+	int strategy = sortStrategy;
+	if (strategy == SORT_ADAPTIVE)
+		strategy = cnt <= SORT_INSERTION_MAX ? SORT_INSERTION : (cnt <= SORT_MERGE_MAX ? SORT_MERGE : SORT_RADIX);
+	if ((strategy == SORT_MERGE || strategy == SORT_RADIX) && 2 * cnt > MAX_NODES_NUM)
+		strategy = SORT_BITONIC;
+
+	if (strategy == SORT_INSERTION) insertionSort(0, cnt);
+	else if (strategy == SORT_BITONIC) bitonicSort(cnt);
+	else if (strategy == SORT_MERGE) mergeSort(cnt);
+	else if (strategy == SORT_RADIX) radixSort(cnt);
+	else exchangeSort(cnt);
+}
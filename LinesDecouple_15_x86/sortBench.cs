@@ -0,0 +1,25 @@
+#version 450 core
+
+//bench-sort: sorts the replayed pixels [pixelBegin, pixelEnd) in place, one pixel per invocation
+
+layout (local_size_x = 64) in;
+
+layout (std430, binding = 6) buffer ReplayNodes { uvec4 replayNodes[]; };
+layout (std430, binding = 7) buffer ReplayOffsets { uint replayOffsets[]; };
+
+uniform uint pixelBegin;
+uniform uint pixelEnd;
+
+#include "sort.glsl"
+
+void main(void)
+{
+	uint pixel = pixelBegin + gl_GlobalInvocationID.x;
+	if (pixel >= pixelEnd) return;
+
+	uint begin = replayOffsets[pixel];
+	int cnt = min(int(replayOffsets[pixel + 1] - begin), MAX_NODES_NUM);
+	for (int i = 0; i < cnt; ++i) nodeList[i] = replayNodes[begin + i];
+	sortNodes(cnt);
+	for (int i = 0; i < cnt; ++i) replayNodes[begin + i] = nodeList[i];
+}